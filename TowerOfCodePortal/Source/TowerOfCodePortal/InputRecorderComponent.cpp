@@ -0,0 +1,373 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "InputRecorderComponent.h"
+#include "GameFramework/Pawn.h"
+#include "GameFramework/PlayerController.h"
+#include "Engine/World.h"
+#include "Misc/App.h"
+#include "Misc/CommandLine.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "Serialization/MemoryReader.h"
+#include "Serialization/MemoryWriter.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogInputRecorder, Log, All);
+
+namespace
+{
+    const uint32 InputRecordMagic = 0x52434F54; // "TOCR"
+    const uint16 InputRecordVersion = 1;
+}
+
+UInputRecorderComponent::UInputRecorderComponent()
+{
+    PrimaryComponentTick.bCanEverTick = true;
+    PrimaryComponentTick.TickGroup = TG_PrePhysics;
+
+    FixedDeltaSeconds = 1.f / 60.f;
+    bExitAfterReplay = false;
+    Mode = EInputRecorderMode::Idle;
+    StartFrameCounter = 0;
+    bPreviousUseFixedTimeStep = false;
+    PreviousFixedDeltaTime = 0.0;
+    bDispatchingReplay = false;
+    bCommandLineHandled = false;
+}
+
+void UInputRecorderComponent::BeginPlay()
+{
+    Super::BeginPlay();
+
+    if (FParse::Param(FCommandLine::Get(), TEXT("ExitAfterReplay")))
+    {
+        bExitAfterReplay = true;
+    }
+}
+
+void UInputRecorderComponent::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+    StopRecording();
+    StopReplay();
+
+    Super::EndPlay(EndPlayReason);
+}
+
+void UInputRecorderComponent::TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction)
+{
+    Super::TickComponent(DeltaTime, TickType, ThisTickFunction);
+
+    // The pawn is possessed after BeginPlay, so the command line is handled on the first tick
+    if (!bCommandLineHandled)
+    {
+        HandleCommandLine();
+    }
+
+    if (Mode != EInputRecorderMode::Replaying)
+        return;
+
+    const int32 FrameIndex = GetFrameIndex();
+    if (!Frames.IsValidIndex(FrameIndex))
+    {
+        UE_LOG(LogInputRecorder, Log, TEXT("Replay of %s finished after %d frames"), *FilePath, Frames.Num());
+        StopReplay();
+
+        if (bExitAfterReplay)
+        {
+            FPlatformMisc::RequestExit(false);
+        }
+        return;
+    }
+
+    const FInputRecordFrame& Frame = Frames[FrameIndex];
+
+    bDispatchingReplay = true;
+    for (int32 Action = 0; Action < (int32)EInputRecordAction::Count; Action++)
+    {
+        if ((Frame.ReleasedMask & (1 << Action)) != 0)
+        {
+            ReleasedHandlers[Action].ExecuteIfBound();
+        }
+        if ((Frame.PressedMask & (1 << Action)) != 0)
+        {
+            PressedHandlers[Action].ExecuteIfBound();
+        }
+    }
+
+    // Live axis bindings fire every frame, so zero values are replayed as well
+    for (int32 Axis = 0; Axis < (int32)EInputRecordAxis::Count; Axis++)
+    {
+        AxisHandlers[Axis].ExecuteIfBound(Frame.AxisValues[Axis]);
+    }
+    bDispatchingReplay = false;
+}
+
+void UInputRecorderComponent::HandleCommandLine()
+{
+    bCommandLineHandled = true;
+
+    APawn* Pawn = Cast<APawn>(GetOwner());
+    if (Pawn == nullptr || !Pawn->IsLocallyControlled())
+        return;
+
+    // Only the first local player is recorded so split-screen players don't share one file
+    if (Pawn->GetController() != GetWorld()->GetFirstPlayerController())
+        return;
+
+    FString FileName;
+    if (FParse::Value(FCommandLine::Get(), TEXT("InputReplay="), FileName))
+    {
+        StartReplay(FileName);
+    }
+    else if (FParse::Value(FCommandLine::Get(), TEXT("InputRecord="), FileName))
+    {
+        StartRecording(FileName);
+    }
+}
+
+void UInputRecorderComponent::BindAxis(EInputRecordAxis Axis, FInputRecordAxisHandler Handler)
+{
+    AxisHandlers[(int32)Axis] = Handler;
+}
+
+void UInputRecorderComponent::BindAction(EInputRecordAction Action, bool bPressed, FInputRecordActionHandler Handler)
+{
+    if (bPressed)
+    {
+        PressedHandlers[(int32)Action] = Handler;
+    }
+    else
+    {
+        ReleasedHandlers[(int32)Action] = Handler;
+    }
+}
+
+bool UInputRecorderComponent::FilterAxis(EInputRecordAxis Axis, float Value)
+{
+    switch (Mode)
+    {
+    case EInputRecorderMode::Recording:
+        if (Value != 0.f)
+        {
+            FInputRecordFrame& Frame = GetRecordFrame();
+            Frame.AxisMask |= 1 << (int32)Axis;
+            Frame.AxisValues[(int32)Axis] = Value;
+        }
+        return true;
+    case EInputRecorderMode::Replaying:
+        return bDispatchingReplay;
+    default:
+        return true;
+    }
+}
+
+bool UInputRecorderComponent::FilterAction(EInputRecordAction Action, bool bPressed)
+{
+    switch (Mode)
+    {
+    case EInputRecorderMode::Recording:
+    {
+        FInputRecordFrame& Frame = GetRecordFrame();
+        if (bPressed)
+        {
+            Frame.PressedMask |= 1 << (int32)Action;
+        }
+        else
+        {
+            Frame.ReleasedMask |= 1 << (int32)Action;
+        }
+        return true;
+    }
+    case EInputRecorderMode::Replaying:
+        return bDispatchingReplay;
+    default:
+        return true;
+    }
+}
+
+void UInputRecorderComponent::StartRecording(const FString& FileName)
+{
+    if (Mode != EInputRecorderMode::Idle)
+        return;
+
+    FilePath = ResolvePath(FileName);
+    Frames.Reset();
+    StartFrameCounter = GFrameCounter;
+    SetFixedTimeStep(true);
+    Mode = EInputRecorderMode::Recording;
+
+    UE_LOG(LogInputRecorder, Log, TEXT("Recording input to %s"), *FilePath);
+}
+
+void UInputRecorderComponent::StopRecording()
+{
+    if (Mode != EInputRecorderMode::Recording)
+        return;
+
+    Mode = EInputRecorderMode::Idle;
+    SetFixedTimeStep(false);
+
+    // Trailing frames without any input still count, the replay must last as long as the recording
+    GetRecordFrame();
+
+    if (!SaveFrames(FilePath, FixedDeltaSeconds, Frames))
+    {
+        UE_LOG(LogInputRecorder, Error, TEXT("Failed to write input recording %s"), *FilePath);
+        return;
+    }
+    UE_LOG(LogInputRecorder, Log, TEXT("Wrote %d frames to %s"), Frames.Num(), *FilePath);
+}
+
+bool UInputRecorderComponent::StartReplay(const FString& FileName)
+{
+    if (Mode != EInputRecorderMode::Idle)
+        return false;
+
+    FilePath = ResolvePath(FileName);
+    float RecordedDeltaSeconds;
+    if (!LoadFrames(FilePath, RecordedDeltaSeconds, Frames))
+    {
+        UE_LOG(LogInputRecorder, Error, TEXT("Failed to read input recording %s"), *FilePath);
+        return false;
+    }
+
+    FixedDeltaSeconds = RecordedDeltaSeconds;
+    // Inputs applied this frame are already dispatched, the first recorded frame starts on the next one
+    StartFrameCounter = GFrameCounter + 1;
+    SetFixedTimeStep(true);
+    Mode = EInputRecorderMode::Replaying;
+
+    UE_LOG(LogInputRecorder, Log, TEXT("Replaying %d frames from %s at %.4fs steps"), Frames.Num(), *FilePath, FixedDeltaSeconds);
+    return true;
+}
+
+void UInputRecorderComponent::StopReplay()
+{
+    if (Mode != EInputRecorderMode::Replaying)
+        return;
+
+    Mode = EInputRecorderMode::Idle;
+    SetFixedTimeStep(false);
+    Frames.Empty();
+}
+
+FInputRecordFrame& UInputRecorderComponent::GetRecordFrame()
+{
+    const int32 FrameIndex = GetFrameIndex();
+    if (FrameIndex >= Frames.Num())
+    {
+        const int32 FirstNewFrame = Frames.Num();
+        Frames.SetNum(FrameIndex + 1);
+        for (int32 Index = FirstNewFrame; Index < Frames.Num(); Index++)
+        {
+            Frames[Index].TimeStamp = Index * FixedDeltaSeconds;
+        }
+    }
+    return Frames[FrameIndex];
+}
+
+int32 UInputRecorderComponent::GetFrameIndex() const
+{
+    // Frame counter rather than time, so tick order inside a frame doesn't matter
+    return (int32)(GFrameCounter - StartFrameCounter);
+}
+
+void UInputRecorderComponent::SetFixedTimeStep(bool bEnable)
+{
+    if (bEnable)
+    {
+        bPreviousUseFixedTimeStep = FApp::UseFixedTimeStep();
+        PreviousFixedDeltaTime = FApp::GetFixedDeltaTime();
+        FApp::SetUseFixedTimeStep(true);
+        FApp::SetFixedDeltaTime(FixedDeltaSeconds);
+    }
+    else
+    {
+        FApp::SetUseFixedTimeStep(bPreviousUseFixedTimeStep);
+        FApp::SetFixedDeltaTime(PreviousFixedDeltaTime);
+    }
+}
+
+FString UInputRecorderComponent::ResolvePath(const FString& FileName)
+{
+    if (FPaths::IsRelative(FileName))
+    {
+        return FPaths::Combine(FPaths::ProjectSavedDir(), TEXT("InputRecordings"), FileName);
+    }
+    return FileName;
+}
+
+bool UInputRecorderComponent::SaveFrames(const FString& Path, float DeltaSeconds, const TArray<FInputRecordFrame>& InFrames)
+{
+    TArray<uint8> Bytes;
+    FMemoryWriter Writer(Bytes);
+
+    uint32 Magic = InputRecordMagic;
+    uint16 Version = InputRecordVersion;
+    uint8 NumAxes = (uint8)EInputRecordAxis::Count;
+    uint8 NumActions = (uint8)EInputRecordAction::Count;
+    int32 NumFrames = InFrames.Num();
+    Writer << Magic << Version << NumAxes << NumActions << DeltaSeconds << NumFrames;
+
+    for (const FInputRecordFrame& Frame : InFrames)
+    {
+        float TimeStamp = Frame.TimeStamp;
+        uint8 AxisMask = Frame.AxisMask;
+        uint8 PressedMask = Frame.PressedMask;
+        uint8 ReleasedMask = Frame.ReleasedMask;
+        Writer << TimeStamp << AxisMask << PressedMask << ReleasedMask;
+
+        // Only the axes that moved are stored
+        for (int32 Axis = 0; Axis < (int32)EInputRecordAxis::Count; Axis++)
+        {
+            if ((AxisMask & (1 << Axis)) != 0)
+            {
+                float Value = Frame.AxisValues[Axis];
+                Writer << Value;
+            }
+        }
+    }
+
+    return FFileHelper::SaveArrayToFile(Bytes, *Path);
+}
+
+bool UInputRecorderComponent::LoadFrames(const FString& Path, float& OutDeltaSeconds, TArray<FInputRecordFrame>& OutFrames)
+{
+    TArray<uint8> Bytes;
+    if (!FFileHelper::LoadFileToArray(Bytes, *Path))
+        return false;
+
+    FMemoryReader Reader(Bytes);
+
+    uint32 Magic = 0;
+    uint16 Version = 0;
+    uint8 NumAxes = 0;
+    uint8 NumActions = 0;
+    int32 NumFrames = 0;
+    Reader << Magic << Version << NumAxes << NumActions << OutDeltaSeconds << NumFrames;
+
+    if (Magic != InputRecordMagic
+        || Version != InputRecordVersion
+        || NumAxes != (uint8)EInputRecordAxis::Count
+        || NumActions != (uint8)EInputRecordAction::Count
+        || NumFrames < 0
+        || OutDeltaSeconds <= 0.f)
+        return false;
+
+    OutFrames.Reset(NumFrames);
+    for (int32 Index = 0; Index < NumFrames && !Reader.IsError(); Index++)
+    {
+        FInputRecordFrame& Frame = OutFrames.AddDefaulted_GetRef();
+        Reader << Frame.TimeStamp << Frame.AxisMask << Frame.PressedMask << Frame.ReleasedMask;
+
+        for (int32 Axis = 0; Axis < (int32)EInputRecordAxis::Count; Axis++)
+        {
+            if ((Frame.AxisMask & (1 << Axis)) != 0)
+            {
+                Reader << Frame.AxisValues[Axis];
+            }
+        }
+    }
+
+    return !Reader.IsError() && OutFrames.Num() == NumFrames;
+}
@@ -0,0 +1,140 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Components/ActorComponent.h"
+#include "InputRecorderComponent.generated.h"
+
+/** Axis bindings of the character that can be recorded */
+UENUM()
+enum class EInputRecordAxis : uint8
+{
+    MoveForward,
+    MoveRight,
+    Turn,
+    TurnRate,
+    LookUp,
+    LookUpRate,
+    Count UMETA(Hidden)
+};
+
+/** Action bindings of the character that can be recorded */
+UENUM()
+enum class EInputRecordAction : uint8
+{
+    Jump,
+    Fire,
+    Count UMETA(Hidden)
+};
+
+UENUM()
+enum class EInputRecorderMode : uint8
+{
+    Idle,
+    Recording,
+    Replaying
+};
+
+/** Input of a single frame. Axes that stayed at zero are not stored. */
+struct FInputRecordFrame
+{
+    float TimeStamp = 0.f;
+    uint8 AxisMask = 0;
+    uint8 PressedMask = 0;
+    uint8 ReleasedMask = 0;
+    float AxisValues[(int32)EInputRecordAxis::Count] = {};
+};
+
+DECLARE_DELEGATE_OneParam(FInputRecordAxisHandler, float);
+DECLARE_DELEGATE(FInputRecordActionHandler);
+
+/**
+ * Records the character's input bindings frame by frame into a compact binary file
+ * and replays them deterministically at a fixed timestep.
+ *
+ * Start from the command line with -InputRecord=<File> or -InputReplay=<File>,
+ * e.g. "-InputReplay=Portal.inrec -nullrhi -ExitAfterReplay".
+ * Relative paths are resolved against Saved/InputRecordings.
+ */
+UCLASS(ClassGroup = (Custom), meta = (BlueprintSpawnableComponent))
+class UInputRecorderComponent : public UActorComponent
+{
+    GENERATED_BODY()
+
+public:
+    UInputRecorderComponent();
+
+    /** Timestep used while recording and replaying, in seconds */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "InputRecord")
+        float FixedDeltaSeconds;
+
+    /** Request engine exit once the replay has consumed every frame */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "InputRecord")
+        bool bExitAfterReplay;
+
+protected:
+    virtual void BeginPlay() override;
+    virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+public:
+    virtual void TickComponent(float DeltaTime, ELevelTick TickType, FActorComponentTickFunction* ThisTickFunction) override;
+
+    /** Handlers the replay drives instead of the player input */
+    void BindAxis(EInputRecordAxis Axis, FInputRecordAxisHandler Handler);
+    void BindAction(EInputRecordAction Action, bool bPressed, FInputRecordActionHandler Handler);
+
+    /**
+     * Routes a live axis value through the recorder.
+     * @returns false if the live value must be dropped because a replay is driving the character.
+     */
+    bool FilterAxis(EInputRecordAxis Axis, float Value);
+
+    /**
+     * Routes a live action event through the recorder.
+     * @returns false if the live event must be dropped because a replay is driving the character.
+     */
+    bool FilterAction(EInputRecordAction Action, bool bPressed);
+
+    UFUNCTION(BlueprintCallable, Category = "InputRecord")
+        void StartRecording(const FString& FileName);
+
+    UFUNCTION(BlueprintCallable, Category = "InputRecord")
+        void StopRecording();
+
+    UFUNCTION(BlueprintCallable, Category = "InputRecord")
+        bool StartReplay(const FString& FileName);
+
+    UFUNCTION(BlueprintCallable, Category = "InputRecord")
+        void StopReplay();
+
+    UFUNCTION(BlueprintPure, Category = "InputRecord")
+        bool IsReplaying() const { return Mode == EInputRecorderMode::Replaying; }
+
+    UFUNCTION(BlueprintPure, Category = "InputRecord")
+        bool IsRecording() const { return Mode == EInputRecorderMode::Recording; }
+
+    static bool SaveFrames(const FString& Path, float DeltaSeconds, const TArray<FInputRecordFrame>& InFrames);
+    static bool LoadFrames(const FString& Path, float& OutDeltaSeconds, TArray<FInputRecordFrame>& OutFrames);
+
+private:
+    void HandleCommandLine();
+    FInputRecordFrame& GetRecordFrame();
+    int32 GetFrameIndex() const;
+    void SetFixedTimeStep(bool bEnable);
+    static FString ResolvePath(const FString& FileName);
+
+    EInputRecorderMode Mode;
+    FString FilePath;
+    uint64 StartFrameCounter;
+    TArray<FInputRecordFrame> Frames;
+
+    bool bPreviousUseFixedTimeStep;
+    double PreviousFixedDeltaTime;
+    bool bDispatchingReplay;
+    bool bCommandLineHandled;
+
+    FInputRecordAxisHandler AxisHandlers[(int32)EInputRecordAxis::Count];
+    FInputRecordActionHandler PressedHandlers[(int32)EInputRecordAction::Count];
+    FInputRecordActionHandler ReleasedHandlers[(int32)EInputRecordAction::Count];
+};
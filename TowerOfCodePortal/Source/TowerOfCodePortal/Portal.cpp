@@ -2,7 +2,22 @@
 
 
 #include "Portal.h"
+#include "PortalPlacementSubsystem.h"
+#include "PortalRegistrySubsystem.h"
+#include "PortalRenderTargetSubsystem.h"
+#include "PortalViewExtension.h"
+#include "CanvasTypes.h"
 #include "DrawDebugHelpers.h"
+#include "EngineModule.h"
+#include "LegacyScreenPercentageDriver.h"
+#include "RendererInterface.h"
+#include "SceneView.h"
+#include "Components/StaticMeshComponent.h"
+#include "Engine/Engine.h"
+#include "GameFramework/PlayerController.h"
+#include "Materials/MaterialInstanceDynamic.h"
+#include "Net/UnrealNetwork.h"
+#include "TimerManager.h"
 
 void PrintMatrix(FMatrix matrix)
 {
@@ -20,6 +35,19 @@ void PrintVector(FVector vector)
     GEngine->AddOnScreenDebugMessage(-1, 15.0f, FColor::Yellow, FString::Printf(TEXT("%.2f, %.2f, %.2f"), vector.X, vector.Y, vector.Z));
 }
 
+namespace
+{
+    /**
+     * What stereo captures write into their targets. Linear color without the tone curve, as the main view
+     * tonemaps the surface again. The scene color sources of mono captures are only resolved into the target
+     * by the scene capture component's own renderer, not by a view family built by hand.
+     */
+    const ESceneCaptureSource StereoCaptureSource = ESceneCaptureSource::SCS_FinalColorHDR;
+}
+
+FPortalFrameStats APortal::FrameStats;
+TMap<TWeakObjectPtr<ULevelStreaming>, int32> APortal::StreamedLevelRequests;
+
 // Sets default values
 APortal::APortal()
 {
@@ -27,64 +55,471 @@ APortal::APortal()
 	PrimaryActorTick.bCanEverTick = true;
     bIsActive = true;
     RecursionThreshold = 5;
+    StreamInDistance = 3000.f;
+    StreamOutDistance = 4000.f;
+    PlaceholderTexture = nullptr;
+    bStreamedLevelRequested = false;
+    SurfaceTextureParameter = TEXT("Texture");
+    SceneSignature = 0;
+    bReuseCaptures = false;
+    ReuseLocationTolerance = 0.5f;
+    ReuseAngleTolerance = 0.05f;
+    StaticRefreshRate = 2.f;
+    bCaptureInViewFamily = false;
+    bStereoCapture = false;
+    StereoLayoutParameter = TEXT("StereoLayout");
+    bPrewarmCapture = false;
+    ReleaseUnseenDelay = 10.f;
+    WakeCheckInterval = 0.25f;
+    LastSeenTime = 0.f;
+    PoolSlot = INDEX_NONE;
+    bParked = false;
+    SurfaceExtent = FVector2D::ZeroVector;
+    RenderTargetSize = FIntPoint(FMath::Clamp(int(1920 / 1.7), 128, 1920), FMath::Clamp(int(1080 / 1.7), 128, 1920));
+    RenderTargetFormat = ETextureRenderTargetFormat::RTF_RGBA16f;
+    bAllowRenderTargetDowngrade = true;
+
+    // Full quality at every depth and distance, cheaper tiers are added per portal
+    FPortalCaptureTier& FullTier = CaptureTiers.AddDefaulted_GetRef();
+    FullTier.PostProcessSettings = MakeCapturePostProcessSettings();
 }
 
 // Called when the game starts or when spawned
 void APortal::BeginPlay()
 {
 	Super::BeginPlay();
-    CreateRenderTarget();
-    CreateSceneCapture();
-    SetRTT(RenderTarget);
+
+    // Pooled portals replicated from the server join the client's pool before they are prewarmed
+    if (PoolSlot != INDEX_NONE && !HasAuthority())
+    {
+        if (UPortalPlacementSubsystem* Placement = GetWorld()->GetSubsystem<UPortalPlacementSubsystem>())
+        {
+            Placement->AddReplicatedPortal(this);
+        }
+    }
+
+    // Capture resources are otherwise created the first time a viewer may see through the portal
+    LastSeenTime = GetWorld()->GetTimeSeconds();
+    if (bPrewarmCapture)
+    {
+        PrewarmCapture();
+    }
+
+    if (UPortalRegistrySubsystem* Registry = GetWorld()->GetSubsystem<UPortalRegistrySubsystem>())
+    {
+        Registry->Register(this);
+    }
+
+    if (StreamedLink.IsNull())
+    {
+        ShowViewerTexture(0, RenderTarget);
+    }
+    else
+    {
+        // Resolved on tick once the destination's sublevel is loaded
+        Link = nullptr;
+        UpdateCaptureEveryFrame();
+        SetRTT(GetSurfacePlaceholder());
+        UpdateStreamedLink();
+    }
+}
+
+void APortal::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+    if (bStreamedLevelRequested)
+    {
+        RequestStreamedLevel(false);
+    }
+
+    ReleaseRenderTargets();
+
+    if (UPortalRegistrySubsystem* Registry = GetWorld()->GetSubsystem<UPortalRegistrySubsystem>())
+    {
+        Registry->Unregister(this);
+    }
+
+    Super::EndPlay(EndPlayReason);
+}
+
+void APortal::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+    Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+    // Only pooled portals replicate, level portals are loaded with their links on every machine
+    DOREPLIFETIME(APortal, Link);
+    DOREPLIFETIME_CONDITION(APortal, PoolSlot, COND_InitialOnly);
+    DOREPLIFETIME(APortal, bParked);
+}
+
+void APortal::OnRep_Link()
+{
+    SetLink(Link);
+}
+
+void APortal::OnRep_PoolSlot()
+{
+    // BeginPlay adds it otherwise
+    if (!HasActorBegunPlay())
+        return;
+
+    if (UPortalPlacementSubsystem* Placement = GetWorld()->GetSubsystem<UPortalPlacementSubsystem>())
+    {
+        Placement->AddReplicatedPortal(this);
+    }
+    if (bPrewarmCapture && !HasCaptureResources())
+    {
+        PrewarmCapture();
+    }
+}
+
+void APortal::SetParked(bool bNewParked)
+{
+    bParked = bNewParked;
+    OnRep_Parked();
+}
+
+void APortal::OnRep_Parked()
+{
+    SetActorHiddenInGame(bParked);
+    SetActorEnableCollision(!bParked);
+    SetActorTickEnabled(!bParked);
+}
+
+void APortal::NotifyActorBeginOverlap(AActor* OtherActor)
+{
+    Super::NotifyActorBeginOverlap(OtherActor);
+
+    Wake();
+}
+
+void APortal::PrewarmCapture()
+{
+    CreateCaptureResources(0);
+}
+
+bool APortal::HasCaptureResources() const
+{
+    if (SceneCapture != nullptr)
+        return true;
+
+    for (const FPortalViewerCapture& Viewer : ViewerCaptures)
+    {
+        if (Viewer.SceneCapture != nullptr)
+            return true;
+    }
+    return false;
+}
+
+void APortal::CreateCaptureResources(int32 ViewerIndex)
+{
+    UTextureRenderTarget2D* Target = nullptr;
+    if (ViewerIndex == 0)
+    {
+        CreateRenderTarget();
+        if (SceneCapture == nullptr)
+        {
+            CreateSceneCapture();
+        }
+        if (ViewerCaptures.IsValidIndex(0))
+        {
+            ViewerCaptures[0].SceneCapture = SceneCapture;
+            ViewerCaptures[0].RenderTarget = RenderTarget;
+        }
+        Target = RenderTarget;
+    }
+    else
+    {
+        FPortalViewerCapture& Viewer = ViewerCaptures[ViewerIndex];
+        Viewer.RenderTarget = AcquireRenderTarget();
+        Viewer.SceneCapture = NewSceneCapture(
+            Viewer.RenderTarget,
+            *FString::Printf(TEXT("PortalSceneCapture_%d"), ViewerIndex));
+        Target = Viewer.RenderTarget;
+    }
+
+    HideOtherViewerSurfaces(ViewerIndex);
+    if (Link != nullptr)
+    {
+        ShowViewerTexture(ViewerIndex, Target);
+    }
+}
+
+void APortal::ReleaseCaptureResources()
+{
+    if (!HasCaptureResources())
+        return;
+
+    ReleaseRenderTargets();
+
+    // The extra surfaces of split-screen viewers are kept, they are cheap and keep the hidden primitive lists valid
+    for (int32 ViewerIndex = 0; ViewerIndex < ViewerCaptures.Num(); ViewerIndex++)
+    {
+        FPortalViewerCapture& Viewer = ViewerCaptures[ViewerIndex];
+        if (Viewer.SceneCapture != nullptr && Viewer.SceneCapture != SceneCapture)
+        {
+            Viewer.SceneCapture->DestroyComponent();
+        }
+        Viewer.SceneCapture = nullptr;
+        Viewer.RenderTarget = nullptr;
+        Viewer.AppliedTier = INDEX_NONE;
+        Viewer.LastCaptureTime = -1.f;
+        Viewer.TargetSize = FIntPoint::ZeroValue;
+        ShowStereoLayout(ViewerIndex, false);
+    }
+
+    if (SceneCapture != nullptr)
+    {
+        SceneCapture->DestroyComponent();
+        SceneCapture = nullptr;
+    }
+}
+
+void APortal::Sleep()
+{
+    // Streamed links poll the viewer distance, and overlapping actors may be about to cross
+    if (!StreamedLink.IsNull() || !IsActorTickEnabled())
+        return;
+
+    TArray<AActor*> OverlappingActors;
+    GetOverlappingActors(OverlappingActors);
+    if (OverlappingActors.Num() > 0)
+        return;
+
+    SetActorTickEnabled(false);
+    GetWorldTimerManager().SetTimer(WakeCheckTimer, this, &APortal::CheckWake, FMath::Max(WakeCheckInterval, 0.05f), true);
+}
+
+void APortal::Wake()
+{
+    UWorld* World = GetWorld();
+    if (World == nullptr)
+        return;
+
+    LastSeenTime = World->GetTimeSeconds();
+    if (!bIsActive)
+        return;
+
+    GetWorldTimerManager().ClearTimer(WakeCheckTimer);
+    SetActorTickEnabled(true);
+}
+
+void APortal::CheckWake()
+{
+    if (IsPotentiallyVisibleToAnyViewer())
+    {
+        Wake();
+    }
+}
+
+bool APortal::IsPotentiallyVisibleToAnyViewer() const
+{
+    if (Link == nullptr)
+        return false;
+
+    // The same tests UpdateViewerCapture starts with
+    const UPortalRegistrySubsystem* Registry = GetWorld()->GetSubsystem<UPortalRegistrySubsystem>();
+    for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+    {
+        APlayerController* PlayerController = It->Get();
+        if (PlayerController == nullptr
+            || !PlayerController->IsLocalController()
+            || PlayerController->PlayerCameraManager == nullptr)
+            continue;
+
+        const FVector CameraLocation = PlayerController->PlayerCameraManager->GetCameraLocation();
+        if (Registry != nullptr && !Registry->IsPortalPotentiallyVisible(this, CameraLocation))
+            continue;
+
+        if (FVector::DotProduct(
+                CameraLocation - GetActorLocation(),
+                PlayerController->PlayerCameraManager->GetActorForwardVector()
+            ) > 0)
+            continue;
+
+        return true;
+    }
+    return false;
 }
 
 void APortal::CreateRenderTarget()
 {
     if (RenderTarget == nullptr)
     {
-        // Create new RTT
-        RenderTarget = NewObject<UTextureRenderTarget2D>(
-            this,
-            UTextureRenderTarget2D::StaticClass(),
-            *FString("PortalRenderTarget")
-            );
-        check(RenderTarget);
+        RenderTarget = AcquireRenderTarget();
+    }
+}
+
+UTextureRenderTarget2D* APortal::AcquireRenderTarget()
+{
+    UPortalRenderTargetSubsystem* RenderTargets = GetWorld()->GetSubsystem<UPortalRenderTargetSubsystem>();
+    if (RenderTargets == nullptr)
+        return nullptr;
+
+    // Side-by-side targets keep the full resolution per eye, until the first stereo view gives the headset's size
+    const FIntPoint Size(RenderTargetSize.X * (IsStereoCaptureActive() ? 2 : 1), RenderTargetSize.Y);
+    return RenderTargets->Acquire(this, Size, RenderTargetFormat, bAllowRenderTargetDowngrade);
+}
+
+bool APortal::IsStereoCaptureActive() const
+{
+    return bStereoCapture && bCaptureInViewFamily && GEngine != nullptr && GEngine->IsStereoscopic3D();
+}
+
+void APortal::ReleaseRenderTargets()
+{
+    UPortalRenderTargetSubsystem* RenderTargets = GetWorld()->GetSubsystem<UPortalRenderTargetSubsystem>();
+    if (RenderTargets == nullptr)
+        return;
+
+    // The surfaces stop sampling the targets first, the pool may free them right away
+    for (int32 ViewerIndex = 0; ViewerIndex < FMath::Max(1, ViewerCaptures.Num()); ViewerIndex++)
+    {
+        ShowViewerTexture(ViewerIndex, nullptr);
+    }
+
+    // The first viewer shares RenderTarget
+    for (int32 ViewerIndex = 1; ViewerIndex < ViewerCaptures.Num(); ViewerIndex++)
+    {
+        RenderTargets->Release(ViewerCaptures[ViewerIndex].RenderTarget);
+        ViewerCaptures[ViewerIndex].RenderTarget = nullptr;
+    }
+    RenderTargets->Release(RenderTarget);
+    RenderTarget = nullptr;
+}
+
+void APortal::OnRenderTargetEvicted(UTextureRenderTarget2D* Target)
+{
+    if (RenderTarget == Target)
+    {
+        RenderTarget = nullptr;
+        if (SceneCapture != nullptr)
+        {
+            SceneCapture->TextureTarget = nullptr;
+        }
+    }
+
+    for (int32 ViewerIndex = 0; ViewerIndex < ViewerCaptures.Num(); ViewerIndex++)
+    {
+        FPortalViewerCapture& Viewer = ViewerCaptures[ViewerIndex];
+        if (Viewer.RenderTarget != Target)
+            continue;
+
+        Viewer.RenderTarget = nullptr;
+        if (Viewer.SceneCapture != nullptr)
+        {
+            Viewer.SceneCapture->TextureTarget = nullptr;
+        }
+        Viewer.LastCaptureTime = -1.f;
+        ShowViewerTexture(ViewerIndex, nullptr);
+    }
+
+    if (ViewerCaptures.Num() == 0 && RenderTarget == nullptr)
+    {
+        ShowViewerTexture(0, nullptr);
+    }
+}
+
+bool APortal::RestoreRenderTarget(int32 ViewerIndex, FIntPoint Size)
+{
+    UPortalRenderTargetSubsystem* RenderTargets = GetWorld()->GetSubsystem<UPortalRenderTargetSubsystem>();
+    if (RenderTargets == nullptr)
+        return false;
+
+    FPortalViewerCapture& Viewer = ViewerCaptures[ViewerIndex];
+    if (Viewer.RenderTarget != nullptr)
+    {
+        // The surface stops sampling the old target first, the pool may free it right away
+        ShowViewerTexture(ViewerIndex, nullptr);
+        RenderTargets->Release(Viewer.RenderTarget);
+    }
+
+    Viewer.RenderTarget = RenderTargets->Acquire(this, Size, RenderTargetFormat, bAllowRenderTargetDowngrade);
+    Viewer.TargetSize = Viewer.RenderTarget != nullptr ? Size : FIntPoint::ZeroValue;
+    Viewer.LastCaptureTime = -1.f;
+    Viewer.SceneCapture->TextureTarget = Viewer.RenderTarget;
+    if (ViewerIndex == 0)
+    {
+        RenderTarget = Viewer.RenderTarget;
+    }
+    if (Viewer.RenderTarget == nullptr)
+        return false;
 
-        RenderTarget->RenderTargetFormat = ETextureRenderTargetFormat::RTF_RGBA16f;
-        RenderTarget->Filter = TextureFilter::TF_Bilinear;
-        RenderTarget->SizeX = FMath::Clamp(int(1920 / 1.7), 128, 1920);
-        RenderTarget->SizeY = FMath::Clamp(int(1080 / 1.7), 128, 1920);
-        RenderTarget->ClearColor = FLinearColor::Black;
-        RenderTarget->TargetGamma = 2.2f;
-        RenderTarget->bNeedsTwoCopies = false;
-        RenderTarget->AddressX = TextureAddress::TA_Clamp;
-        RenderTarget->AddressY = TextureAddress::TA_Clamp;
+    ShowViewerTexture(ViewerIndex, Viewer.RenderTarget);
+    return true;
+}
 
-        // Not needed since the texture is displayed on screen directly
-        // in some engine versions this can even lead to crashes (notably 4.24/4.25)
-        RenderTarget->bAutoGenerateMips = false;
+FIntPoint APortal::GetViewerTargetSize(const FPortalEyeView* StereoEyes) const
+{
+    if (StereoEyes == nullptr)
+        return RenderTargetSize;
 
-        // This force the engine to create the render target 
-        // with the parameters we defined just above
-        RenderTarget->UpdateResource();
+    // Each half gets the eye's aspect, no larger than RenderTargetSize
+    FIntPoint EyeSize = RenderTargetSize;
+    const FIntPoint ViewSize = StereoEyes[0].ViewSize;
+    if (ViewSize.X > 0 && ViewSize.Y > 0)
+    {
+        const float Scale = FMath::Min3(1.f, float(RenderTargetSize.X) / ViewSize.X, float(RenderTargetSize.Y) / ViewSize.Y);
+        EyeSize = FIntPoint(FMath::Max(1, FMath::RoundToInt(ViewSize.X * Scale)), FMath::Max(1, FMath::RoundToInt(ViewSize.Y * Scale)));
     }
+    return FIntPoint(EyeSize.X * 2, EyeSize.Y);
+}
+
+void APortal::ShowViewerTexture(int32 ViewerIndex, UTexture* Texture)
+{
+    // Never leave a surface on a target that is about to be freed
+    if (Texture == nullptr)
+    {
+        Texture = GetSurfacePlaceholder();
+    }
+
+    if (ViewerIndex == 0)
+    {
+        SetRTT(Texture);
+        return;
+    }
+
+    UStaticMeshComponent* Surface = ViewerCaptures[ViewerIndex].Surface;
+    UMaterialInstanceDynamic* SurfaceMaterial = Surface != nullptr ? Cast<UMaterialInstanceDynamic>(Surface->GetMaterial(0)) : nullptr;
+    if (SurfaceMaterial != nullptr)
+    {
+        SurfaceMaterial->SetTextureParameterValue(SurfaceTextureParameter, Texture);
+    }
+}
+
+UTexture* APortal::GetSurfacePlaceholder() const
+{
+    return PlaceholderTexture != nullptr ? PlaceholderTexture : GEngine->DefaultTexture;
 }
 
 void APortal::CreateSceneCapture()
 {
-    SceneCapture = NewObject<USceneCaptureComponent2D>(this, USceneCaptureComponent2D::StaticClass(), *FString("PortalSceneCapture"));
+    SceneCapture = NewSceneCapture(RenderTarget, TEXT("PortalSceneCapture"));
+}
 
-    SceneCapture->AttachToComponent(GetRootComponent(), FAttachmentTransformRules::SnapToTargetIncludingScale);
-    SceneCapture->RegisterComponent();
-    SceneCapture->FOVAngle = 105;
-    SceneCapture->bCaptureEveryFrame = true;
-    SceneCapture->bCaptureOnMovement = true;
-    SceneCapture->CompositeMode = ESceneCaptureCompositeMode::SCCM_Composite;
-    SceneCapture->TextureTarget = RenderTarget;
-    SceneCapture->bEnableClipPlane = true;
-    SceneCapture->CaptureSource = ESceneCaptureSource::SCS_SceneColorHDRNoAlpha;
+USceneCaptureComponent2D* APortal::NewSceneCapture(UTextureRenderTarget2D* Target, const FName& Name)
+{
+    // Released captures may not be garbage collected yet, so their names can still be taken
+    USceneCaptureComponent2D* NewCapture = NewObject<USceneCaptureComponent2D>(
+        this,
+        USceneCaptureComponent2D::StaticClass(),
+        MakeUniqueObjectName(this, USceneCaptureComponent2D::StaticClass(), Name));
+
+    NewCapture->AttachToComponent(GetRootComponent(), FAttachmentTransformRules::SnapToTargetIncludingScale);
+    NewCapture->RegisterComponent();
+    NewCapture->FOVAngle = 105;
+    NewCapture->bCaptureEveryFrame = ShouldCaptureEveryFrame();
+    NewCapture->bCaptureOnMovement = !bReuseCaptures;
+    NewCapture->CompositeMode = ESceneCaptureCompositeMode::SCCM_Composite;
+    NewCapture->TextureTarget = Target;
+    NewCapture->bEnableClipPlane = true;
+    NewCapture->CaptureSource = ESceneCaptureSource::SCS_SceneColorHDRNoAlpha;
+    NewCapture->PostProcessSettings = MakeCapturePostProcessSettings();
 
+    return NewCapture;
+}
 
+FPostProcessSettings APortal::MakeCapturePostProcessSettings()
+{
     //Setup Post-Process of SceneCapture (optimization : disable Motion Blur, etc)
     FPostProcessSettings CaptureSettings;
 
@@ -103,8 +538,7 @@ void APortal::CreateSceneCapture()
     CaptureSettings.bOverride_ScreenPercentage = true;
     CaptureSettings.ScreenPercentage = 100.0f;
 
-    SceneCapture->PostProcessSettings = CaptureSettings;
-
+    return CaptureSettings;
 }
 
 // Called every frame
@@ -113,81 +547,728 @@ void APortal::Tick(float DeltaTime)
     //if (!IsActive())
     //    return;
 	Super::Tick(DeltaTime);
+
+    if (!StreamedLink.IsNull())
+    {
+        UpdateStreamedLink();
+    }
+
+    // The blueprint's tick has just called UpdateCapture, which keeps LastSeenTime current while the portal is seen
+    if (ReleaseUnseenDelay > 0.f && GetWorld()->GetTimeSeconds() - LastSeenTime > ReleaseUnseenDelay)
+    {
+        ReleaseCaptureResources();
+        Sleep();
+    }
+}
+
+void APortal::UpdateStreamedLink()
+{
+    ULevelStreaming* Level = GetStreamedLinkLevel();
+    if (Level == nullptr)
+    {
+        // The destination lives in the persistent level, nothing to stream
+        SetResolvedLink(StreamedLink.Get());
+        return;
+    }
+
+    const float Distance = GetClosestViewerDistance();
+    if (!bStreamedLevelRequested && Distance < StreamInDistance)
+    {
+        RequestStreamedLevel(true);
+    }
+    else if (bStreamedLevelRequested && Distance > StreamOutDistance)
+    {
+        RequestStreamedLevel(false);
+    }
+
+    SetResolvedLink(
+        bStreamedLevelRequested && Level->IsLevelVisible() ? StreamedLink.Get() : nullptr);
+}
+
+void APortal::RequestStreamedLevel(bool bLoad)
+{
+    ULevelStreaming* Level = GetStreamedLinkLevel();
+    bStreamedLevelRequested = bLoad;
+    if (Level == nullptr)
+        return;
+
+    int32& Requests = StreamedLevelRequests.FindOrAdd(Level);
+    Requests = FMath::Max(0, Requests + (bLoad ? 1 : -1));
+
+    // Loading is asynchronous, UpdateStreamedLink picks the destination up once the level is visible
+    const bool bShouldBeLoaded = Requests > 0;
+    Level->SetShouldBeLoaded(bShouldBeLoaded);
+    Level->SetShouldBeVisible(bShouldBeLoaded);
+
+    if (!bShouldBeLoaded)
+    {
+        StreamedLevelRequests.Remove(Level);
+    }
+}
+
+void APortal::SetResolvedLink(APortal* Target)
+{
+    if (Link == Target)
+        return;
+
+    Link = Target;
+    MarkRegistryDirty();
+
+    // Nothing to capture until the destination arrives
+    UpdateCaptureEveryFrame();
+
+    if (Target != nullptr && RenderTarget != nullptr)
+    {
+        SetRTT(RenderTarget);
+    }
+    else
+    {
+        SetRTT(GetSurfacePlaceholder());
+    }
+}
+
+ULevelStreaming* APortal::GetStreamedLinkLevel() const
+{
+    const FString PackageName = StreamedLink.ToSoftObjectPath().GetLongPackageName();
+    if (PackageName.IsEmpty())
+        return nullptr;
+
+    return UGameplayStatics::GetStreamingLevel(this, FName(*PackageName));
+}
+
+float APortal::GetClosestViewerDistance() const
+{
+    float ClosestDistance = TNumericLimits<float>::Max();
+
+    for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+    {
+        APlayerController* PlayerController = It->Get();
+        if (PlayerController == nullptr
+            || !PlayerController->IsLocalController()
+            || PlayerController->PlayerCameraManager == nullptr)
+            continue;
+
+        ClosestDistance = FMath::Min(
+            ClosestDistance,
+            FVector::Dist(PlayerController->PlayerCameraManager->GetCameraLocation(), GetActorLocation()));
+    }
+
+    return ClosestDistance;
 }
 
 void APortal::UpdateCapture()
 {
-    APlayerCameraManager* PlayerCamera = 
-        GetWorld()->GetFirstPlayerController()->PlayerCameraManager;
+    // Those are driven by FPortalViewExtension
+    if (Link == nullptr || !bIsActive || bCaptureInViewFamily)
+        return;
+
+    // Split-screen players look through the portal from different places, so each gets its own capture
+    int32 ViewerIndex = 0;
+    for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+    {
+        APlayerController* PlayerController = It->Get();
+        if (PlayerController == nullptr
+            || !PlayerController->IsLocalController()
+            || PlayerController->PlayerCameraManager == nullptr)
+            continue;
+
+        GetViewerCapture(ViewerIndex, PlayerController);
+        UpdateViewerCapture(
+            ViewerIndex,
+            PlayerController->PlayerCameraManager->GetCameraLocation(),
+            FQuat(PlayerController->PlayerCameraManager->GetActorQuat()),
+            0.f);
+        ViewerIndex++;
+    }
+
+    //SetRTT(RenderTarget);
+}
+
+void APortal::UpdateCaptureFromView(APlayerController* PlayerController, const FVector& ViewLocation, const FQuat& ViewRotation, float FOVAngle)
+{
+    if (Link == nullptr || !bIsActive)
+        return;
+
+    const int32 ViewerIndex = GetLocalViewerIndex(PlayerController);
+    if (ViewerIndex == INDEX_NONE)
+        return;
+
+    GetViewerCapture(ViewerIndex, PlayerController);
+    UpdateViewerCapture(ViewerIndex, ViewLocation, ViewRotation, FOVAngle);
+}
+
+void APortal::UpdateStereoCaptureFromView(APlayerController* PlayerController, const FPortalEyeView& LeftEye, const FPortalEyeView& RightEye)
+{
+    if (Link == nullptr || !bIsActive)
+        return;
+
+    const int32 ViewerIndex = GetLocalViewerIndex(PlayerController);
+    if (ViewerIndex == INDEX_NONE)
+        return;
+
+    const FPortalEyeView Eyes[2] = { LeftEye, RightEye };
+    GetViewerCapture(ViewerIndex, PlayerController);
+    UpdateViewerCapture(ViewerIndex, LeftEye.Location, LeftEye.Rotation, 0.f, Eyes);
+}
+
+int32 APortal::GetLocalViewerIndex(const APlayerController* PlayerController) const
+{
+    // Same viewer numbering as UpdateCapture
+    int32 ViewerIndex = 0;
+    for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+    {
+        const APlayerController* Other = It->Get();
+        if (Other == nullptr
+            || !Other->IsLocalController()
+            || Other->PlayerCameraManager == nullptr)
+            continue;
+
+        if (Other == PlayerController)
+            return ViewerIndex;
+        ViewerIndex++;
+    }
+    return INDEX_NONE;
+}
+
+void APortal::UpdateViewerCapture(int32 ViewerIndex, const FVector& CameraLocation, const FQuat& CameraQuat, float FOVAngle, const FPortalEyeView* StereoEyes)
+{
+    FPortalViewerCapture& Viewer = ViewerCaptures[ViewerIndex];
+
+    // One lookup in the baked visibility rejects most portals before any other test
+    UPortalRegistrySubsystem* Registry = GetWorld()->GetSubsystem<UPortalRegistrySubsystem>();
+    if (Registry != nullptr && !Registry->IsPortalPotentiallyVisible(this, CameraLocation))
+    {
+        FrameStats.VisibilityRejectedCount++;
+        return;
+    }
+
     FVector CameraRelativeLocation = 
-        PlayerCamera->GetCameraLocation() - GetActorLocation();
+        CameraLocation - GetActorLocation();
 
     if (FVector::DotProduct(
             CameraRelativeLocation, 
-            PlayerCamera->GetActorForwardVector()
+            CameraQuat.GetForwardVector()
         ) > 0)
         return;
 
-    SceneCapture->ClipPlaneNormal = 
+    const FPortalPairTransform* Pair = Registry != nullptr ? Registry->FindPortalPair(this) : nullptr;
+    if (Pair == nullptr)
+        return;
+
+    LastSeenTime = GetWorld()->GetTimeSeconds();
+    if (Viewer.SceneCapture == nullptr)
+    {
+        CreateCaptureResources(ViewerIndex);
+    }
+
+    // Targets of portals out of sight may have been handed to other portals,
+    // and side-by-side targets follow the headset's eye size and switches between mono and stereo
+    const FIntPoint TargetSize = GetViewerTargetSize(StereoEyes);
+    if ((Viewer.RenderTarget == nullptr || Viewer.TargetSize != TargetSize) && !RestoreRenderTarget(ViewerIndex, TargetSize))
+        return;
+
+    if (UPortalRenderTargetSubsystem* RenderTargets = GetWorld()->GetSubsystem<UPortalRenderTargetSubsystem>())
+    {
+        RenderTargets->MarkVisible(Viewer.RenderTarget);
+    }
+
+    Viewer.SceneCapture->ClipPlaneNormal = 
         Link->GetActorForwardVector();
-    SceneCapture->ClipPlaneBase = 
+    Viewer.SceneCapture->ClipPlaneBase = 
         Link->GetActorLocation();
 
-    UpdateCaptureRecursive(
-        CameraRelativeLocation, 
-        FQuat(PlayerCamera->GetActorQuat()), 
-        1
-    );
+    HideActorsNotVisible(Viewer.SceneCapture);
+    // Link may have made surfaces for more viewers since the last update
+    HideOtherViewerSurfaces(ViewerIndex);
 
-    //SetRTT(RenderTarget);
+    TArray<FPortalView> Views;
+    FPortalViewExtension::BuildViewChain(*Pair, FTransform(CameraQuat, CameraLocation), RecursionThreshold, Views);
+    if (Views.Num() == 0)
+        return;
+
+    // The last view is the first recursion level
+    const bool bStereo = StereoEyes != nullptr;
+    if (Viewer.bStereoLayout == bStereo && CanReuseCapture(Viewer, Views.Last().CameraTransform))
+    {
+        FrameStats.ReusedCaptureCount++;
+        return;
+    }
+
+    Viewer.CapturedSceneSignature = SceneSignature;
+    Viewer.LastCaptureTime = GetWorld()->GetTimeSeconds();
+
+    if (FOVAngle > 0.f)
+    {
+        Viewer.SceneCapture->FOVAngle = FOVAngle;
+    }
+
+    if (bStereo)
+    {
+        TArray<FPortalView> RightViews;
+        FPortalViewExtension::BuildViewChain(*Pair, FTransform(StereoEyes[1].Rotation, StereoEyes[1].Location), RecursionThreshold, RightViews);
+        CaptureStereoViewChain(Viewer, Views, RightViews, StereoEyes, CameraRelativeLocation.Size());
+    }
+    else
+    {
+        CaptureViewChain(Viewer, Views, CameraRelativeLocation.Size());
+    }
+    ShowStereoLayout(ViewerIndex, bStereo);
+}
+
+bool APortal::CanReuseCapture(const FPortalViewerCapture& Viewer, const FTransform& CameraTransform) const
+{
+    if (!bReuseCaptures || Viewer.LastCaptureTime < 0.f)
+        return false;
+
+    if (Viewer.CapturedSceneSignature != SceneSignature)
+        return false;
+
+    if (FVector::Dist(Viewer.VirtualCameraTransform.GetLocation(), CameraTransform.GetLocation()) > ReuseLocationTolerance
+        || FMath::RadiansToDegrees(Viewer.VirtualCameraTransform.GetRotation().AngularDistance(CameraTransform.GetRotation())) > ReuseAngleTolerance)
+        return false;
+
+    if (StaticRefreshRate > 0.f && GetWorld()->GetTimeSeconds() - Viewer.LastCaptureTime >= 1.f / StaticRefreshRate)
+        return false;
+
+    return true;
+}
+
+bool APortal::ShouldCaptureEveryFrame() const
+{
+    // Captures driven from the view family would be overwritten by the engine's own
+    return Link != nullptr && !bReuseCaptures && !bCaptureInViewFamily;
+}
+
+void APortal::HideActorsNotVisible(USceneCaptureComponent2D* Capture)
+{
+    UPortalRegistrySubsystem* Registry = GetWorld()->GetSubsystem<UPortalRegistrySubsystem>();
+    if (Registry == nullptr)
+        return;
+
+    // The first portal asking in a frame pays for the pass shared by every portal, viewer and recursion level
+    const double StartTime = FPlatformTime::Seconds();
+    const FPortalCullingResult* Culling = Registry->GetCulling(this);
+    FrameStats.HideActorsSeconds += FPlatformTime::Seconds() - StartTime;
+    if (Culling == nullptr)
+        return;
+
+    Capture->HiddenActors = Culling->HiddenActors;
+    SceneSignature = Culling->SceneSignature;
+}
+
+FPortalViewerCapture& APortal::GetViewerCapture(int32 ViewerIndex, APlayerController* PlayerController)
+{
+    if (ViewerCaptures.Num() == 0)
+    {
+        // The first viewer uses the capture the surface material was set up with
+        FPortalViewerCapture& FirstViewer = ViewerCaptures.AddDefaulted_GetRef();
+        FirstViewer.SceneCapture = SceneCapture;
+        FirstViewer.RenderTarget = RenderTarget;
+    }
+
+    while (ViewerCaptures.Num() <= ViewerIndex)
+    {
+        CreateViewerCapture();
+    }
+
+    FPortalViewerCapture& Viewer = ViewerCaptures[ViewerIndex];
+    if (Viewer.Viewer != PlayerController)
+    {
+        Viewer.Viewer = PlayerController;
+        UpdateSurfaceVisibility();
+    }
+    return Viewer;
+}
+
+void APortal::CreateViewerCapture()
+{
+    const int32 ViewerIndex = ViewerCaptures.Num();
+    FPortalViewerCapture& Viewer = ViewerCaptures.AddDefaulted_GetRef();
+
+    // The capture and render target come once this viewer may see through the portal, see CreateCaptureResources.
+    // A material can't show a different texture per view, so this viewer gets
+    // its own copy of the surface and the other viewers hide it
+    UStaticMeshComponent* OriginalSurface = GetOriginalSurface();
+    if (OriginalSurface == nullptr)
+        return;
+
+    Viewer.Surface = NewObject<UStaticMeshComponent>(
+        this,
+        *FString::Printf(TEXT("PortalSurface_%d"), ViewerIndex));
+    Viewer.Surface->SetStaticMesh(OriginalSurface->GetStaticMesh());
+    Viewer.Surface->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+    Viewer.Surface->AttachToComponent(OriginalSurface, FAttachmentTransformRules::SnapToTargetIncludingScale);
+    Viewer.Surface->RegisterComponent();
+
+    UMaterialInstanceDynamic* SurfaceMaterial =
+        Viewer.Surface->CreateDynamicMaterialInstance(0, OriginalSurface->GetMaterial(0));
+    if (SurfaceMaterial != nullptr)
+    {
+        SurfaceMaterial->SetTextureParameterValue(SurfaceTextureParameter, GetSurfacePlaceholder());
+    }
+}
+
+void APortal::UpdateSurfaceVisibility()
+{
+    if (ViewerCaptures.Num() < 2)
+        return;
+
+    // Main views, each portal keeps the lists of its own surfaces
+    for (int32 SurfaceIndex = 0; SurfaceIndex < ViewerCaptures.Num(); SurfaceIndex++)
+    {
+        UPrimitiveComponent* Surface = GetViewerSurface(SurfaceIndex);
+        if (Surface == nullptr)
+            continue;
+
+        for (int32 ViewerIndex = 0; ViewerIndex < ViewerCaptures.Num(); ViewerIndex++)
+        {
+            APlayerController* PlayerController = ViewerCaptures[ViewerIndex].Viewer.Get();
+            if (PlayerController == nullptr)
+                continue;
+
+            if (ViewerIndex == SurfaceIndex)
+            {
+                PlayerController->HiddenPrimitiveComponents.Remove(Surface);
+            }
+            else
+            {
+                PlayerController->HiddenPrimitiveComponents.AddUnique(Surface);
+            }
+        }
+    }
+
+    // Captures see this portal again in deeper levels, and Link's surfaces behind it
+    for (int32 ViewerIndex = 0; ViewerIndex < ViewerCaptures.Num(); ViewerIndex++)
+    {
+        HideOtherViewerSurfaces(ViewerIndex);
+    }
+}
+
+void APortal::HideOtherViewerSurfaces(int32 ViewerIndex)
+{
+    USceneCaptureComponent2D* Capture = ViewerCaptures.IsValidIndex(ViewerIndex) ? ViewerCaptures[ViewerIndex].SceneCapture : nullptr;
+    if (Capture == nullptr)
+        return;
+
+    TArray<UPrimitiveComponent*> Surfaces;
+    GetSurfacesHiddenFromViewer(ViewerIndex, Surfaces);
+
+    Capture->HiddenComponents.Reset(Surfaces.Num());
+    for (UPrimitiveComponent* Surface : Surfaces)
+    {
+        Capture->HiddenComponents.Add(Surface);
+    }
+}
+
+void APortal::GetSurfacesHiddenFromViewer(int32 ViewerIndex, TArray<UPrimitiveComponent*>& OutSurfaces) const
+{
+    OutSurfaces.Reset();
+
+    // Viewers are numbered by local player on every portal, so the indices match across the pair
+    const APortal* Portals[] = { this, Link };
+    for (const APortal* Portal : Portals)
+    {
+        if (Portal == nullptr || Portal->ViewerCaptures.Num() < 2)
+            continue;
+
+        for (int32 SurfaceIndex = 0; SurfaceIndex < Portal->ViewerCaptures.Num(); SurfaceIndex++)
+        {
+            if (SurfaceIndex == ViewerIndex)
+                continue;
+
+            if (UPrimitiveComponent* Surface = Portal->GetViewerSurface(SurfaceIndex))
+            {
+                OutSurfaces.AddUnique(Surface);
+            }
+        }
+    }
+}
+
+UPrimitiveComponent* APortal::GetViewerSurface(int32 ViewerIndex) const
+{
+    if (ViewerIndex == 0)
+        return GetOriginalSurface();
+
+    return ViewerCaptures[ViewerIndex].Surface;
+}
+
+UStaticMeshComponent* APortal::GetOriginalSurface() const
+{
+    // The viewer copies are static meshes too, and component order isn't guaranteed
+    TInlineComponentArray<UStaticMeshComponent*> Meshes(this);
+    for (UStaticMeshComponent* Mesh : Meshes)
+    {
+        if (!ViewerCaptures.ContainsByPredicate([Mesh](const FPortalViewerCapture& Viewer) { return Viewer.Surface == Mesh; }))
+            return Mesh;
+    }
+    return nullptr;
+}
+
+FTransform APortal::GetViewerCameraTransform(int32 ViewerIndex) const
+{
+    if (!ViewerCaptures.IsValidIndex(ViewerIndex))
+        return FTransform::Identity;
+
+    return ViewerCaptures[ViewerIndex].VirtualCameraTransform;
+}
+
+int32 APortal::GetViewerCount() const
+{
+    return ViewerCaptures.Num();
+}
+
+FVector2D APortal::GetSurfaceExtent() const
+{
+    if (!SurfaceExtent.IsZero())
+        return SurfaceExtent;
+
+    UStaticMeshComponent* Surface = GetOriginalSurface();
+    if (Surface == nullptr)
+        return FVector2D::ZeroVector;
+
+    // Bounds in unscaled actor space, so the result doesn't depend on how the portal is rotated
+    const FBoxSphereBounds LocalBounds = Surface->CalcBounds(
+        Surface->GetComponentTransform().GetRelativeTransform(GetActorTransform()));
+    const FVector Scale = GetActorScale3D().GetAbs();
+    return FVector2D(LocalBounds.BoxExtent.Y * Scale.Y, LocalBounds.BoxExtent.Z * Scale.Z);
 }
 
-void APortal::HideActorsNotVisible()
+void APortal::CaptureViewChain(FPortalViewerCapture& Viewer, const TArray<FPortalView>& Views, float ViewerDistance)
 {
-    TArray<AActor*> AllActors;
-    UGameplayStatics::GetAllActorsOfClass(GetWorld(), AActor::StaticClass(), AllActors);
+    // Deepest level first, every level renders the previous one into the surface it sees
+    for (const FPortalView& View : Views)
+    {
+        Viewer.SceneCapture->SetWorldLocationAndRotation(
+            View.CameraTransform.GetLocation(),
+            View.CameraTransform.GetRotation());
+
+        if (View.Depth == 1)
+        {
+            Viewer.VirtualCameraTransform = Viewer.SceneCapture->GetComponentTransform();
+        }
+
+        ApplyCaptureTier(Viewer, SelectCaptureTier(View.Depth, ViewerDistance), GetLinkDistance(View));
+
+        const double CaptureStartTime = FPlatformTime::Seconds();
+        Viewer.SceneCapture->CaptureScene();
+        FrameStats.CaptureSeconds += FPlatformTime::Seconds() - CaptureStartTime;
+        FrameStats.CaptureCount++;
+    }
+}
+
+void APortal::CaptureStereoViewChain(FPortalViewerCapture& Viewer, const TArray<FPortalView>& LeftViews, const TArray<FPortalView>& RightViews, const FPortalEyeView* Eyes, float ViewerDistance)
+{
+    UWorld* World = GetWorld();
+    FTextureRenderTargetResource* Target = Viewer.RenderTarget->GameThread_GetRenderTargetResource();
+    if (Target == nullptr || World->Scene == nullptr)
+        return;
+
+    USceneCaptureComponent2D* Capture = Viewer.SceneCapture;
+    const int32 EyeWidth = Viewer.RenderTarget->SizeX / 2;
+    const int32 EyeHeight = Viewer.RenderTarget->SizeY;
+
+    TSet<FPrimitiveComponentId> HiddenPrimitives;
+    for (const AActor* Actor : Capture->HiddenActors)
+    {
+        if (Actor == nullptr)
+            continue;
+
+        for (const UActorComponent* Component : Actor->GetComponents())
+        {
+            const UPrimitiveComponent* Primitive = Cast<UPrimitiveComponent>(Component);
+            if (Primitive != nullptr && Primitive->IsRegistered())
+            {
+                HiddenPrimitives.Add(Primitive->ComponentId);
+            }
+        }
+    }
+    for (const TWeakObjectPtr<UPrimitiveComponent>& Primitive : Capture->HiddenComponents)
+    {
+        if (Primitive.IsValid() && Primitive->IsRegistered())
+        {
+            HiddenPrimitives.Add(Primitive->ComponentId);
+        }
+    }
 
-    for (AActor* Actor : AllActors)
+    // One view family per level with both eyes in it, so the renderer draws them in the same pass,
+    // instanced when vr.InstancedStereo is on. Deepest level first, as in CaptureViewChain.
+    for (int32 Level = 0; Level < LeftViews.Num(); Level++)
     {
-        FVector Origin;
-        FVector Extent;
-        Actor->GetActorBounds(false, Origin, Extent);
+        const int32 Depth = LeftViews[Level].Depth;
+        ApplyCaptureTier(Viewer, SelectCaptureTier(Depth, ViewerDistance), GetLinkDistance(LeftViews[Level]));
+
+        FSceneViewFamilyContext ViewFamily(FSceneViewFamily::ConstructionValues(Target, World->Scene, Capture->ShowFlags)
+            .SetWorldTimes(World->GetTimeSeconds(), World->GetDeltaSeconds(), World->GetRealTimeSeconds())
+            .SetRealtimeUpdate(true));
+        ViewFamily.SceneCaptureSource = StereoCaptureSource;
+        ViewFamily.SetScreenPercentageInterface(new FLegacyScreenPercentageDriver(ViewFamily, 1.f, false));
 
-        FVector Distance = Origin - Link->GetActorLocation();
+        for (int32 Eye = 0; Eye < 2; Eye++)
+        {
+            const FPortalView& View = Eye == 0 ? LeftViews[Level] : RightViews[Level];
+
+            FSceneViewInitOptions InitOptions;
+            InitOptions.ViewFamily = &ViewFamily;
+            InitOptions.SetViewRectangle(FIntRect(EyeWidth * Eye, 0, EyeWidth * (Eye + 1), EyeHeight));
+            InitOptions.ViewOrigin = View.CameraTransform.GetLocation();
+            InitOptions.ViewRotationMatrix = View.ViewMatrix.RemoveTranslation();
+            InitOptions.ProjectionMatrix = Eyes[Eye].ProjectionMatrix;
+            InitOptions.StereoPass = Eye == 0 ? eSSP_LEFT_EYE : eSSP_RIGHT_EYE;
+            InitOptions.BackgroundColor = FLinearColor::Black;
+            InitOptions.LODDistanceFactor = Capture->LODDistanceFactor;
+            InitOptions.OverrideFarClippingPlaneDistance = Capture->MaxViewDistanceOverride;
+            InitOptions.HiddenPrimitives = HiddenPrimitives;
+
+            FSceneView* SceneView = new FSceneView(InitOptions);
+            SceneView->bIsSceneCapture = true;
+            SceneView->bAllowTemporalJitter = false;
+            SceneView->GlobalClippingPlane = FPlane(Capture->ClipPlaneBase, Capture->ClipPlaneNormal.GetSafeNormal());
+            SceneView->StartFinalPostprocessSettings(SceneView->ViewLocation);
+            SceneView->OverridePostProcessSettings(Capture->PostProcessSettings, Capture->PostProcessBlendWeight);
+            SceneView->EndFinalPostprocessSettings(InitOptions);
+            ViewFamily.Views.Add(SceneView);
+        }
 
-        if (Distance.Size() > Extent.Size() && FVector::DotProduct(Link->GetActorForwardVector(), Distance) < 0.f)
+        if (Depth == 1)
         {
-            SceneCapture->HideActorComponents(Actor, true);
+            Viewer.VirtualCameraTransform = LeftViews[Level].CameraTransform;
         }
+
+        const double CaptureStartTime = FPlatformTime::Seconds();
+        FCanvas Canvas(Target, nullptr, World, World->Scene->GetFeatureLevel(), FCanvas::CDM_DeferDrawing, 1.f);
+        GetRendererModule().BeginRenderingViewFamily(&Canvas, &ViewFamily);
+        FrameStats.CaptureSeconds += FPlatformTime::Seconds() - CaptureStartTime;
+        FrameStats.CaptureCount++;
     }
 }
 
-void APortal::UpdateCaptureRecursive(FVector CameraRelativeLocation, FQuat CameraQuat, int Depth)
+void APortal::ShowStereoLayout(int32 ViewerIndex, bool bStereoLayout)
+{
+    FPortalViewerCapture& Viewer = ViewerCaptures[ViewerIndex];
+    if (Viewer.bStereoLayout == bStereoLayout)
+        return;
+    Viewer.bStereoLayout = bStereoLayout;
+
+    if (UMeshComponent* Surface = Cast<UMeshComponent>(GetViewerSurface(ViewerIndex)))
+    {
+        Surface->SetScalarParameterValueOnMaterials(StereoLayoutParameter, bStereoLayout ? 1.f : 0.f);
+    }
+}
+
+int32 APortal::SelectCaptureTier(int32 Depth, float ViewerDistance) const
+{
+    for (int32 TierIndex = CaptureTiers.Num() - 1; TierIndex >= 0; TierIndex--)
+    {
+        const FPortalCaptureTier& Tier = CaptureTiers[TierIndex];
+        if (Depth >= Tier.MinDepth || (Tier.MinDistance > 0.f && ViewerDistance >= Tier.MinDistance))
+            return TierIndex;
+    }
+
+    return INDEX_NONE;
+}
+
+int32 APortal::GetAppliedCaptureTier(int32 ViewerIndex) const
+{
+    if (!ViewerCaptures.IsValidIndex(ViewerIndex))
+        return INDEX_NONE;
+
+    return ViewerCaptures[ViewerIndex].AppliedTier;
+}
+
+float APortal::GetCaptureViewDistance(int32 TierIndex, float LinkDistance) const
+{
+    if (!CaptureTiers.IsValidIndex(TierIndex) || CaptureTiers[TierIndex].MaxViewDistance <= 0.f)
+        return -1.f;
+
+    // Everything up to the link is clipped anyway, the view distance starts behind it
+    return LinkDistance + CaptureTiers[TierIndex].MaxViewDistance;
+}
+
+float APortal::GetLinkDistance(const FPortalView& View) const
+{
+    return Link != nullptr ? FVector::Dist(View.CameraTransform.GetLocation(), Link->GetActorLocation()) : 0.f;
+}
+
+void APortal::ApplyCaptureTier(FPortalViewerCapture& Viewer, int32 TierIndex, float LinkDistance)
 {
-    if (Depth > RecursionThreshold)
+    if (TierIndex == INDEX_NONE)
         return;
 
-    FVector ConvertedCameraLocation =
-        ConvertVectorToOppositeSpace(CameraRelativeLocation);
+    if (FrameStats.CapturesPerTier.Num() <= TierIndex)
+    {
+        FrameStats.CapturesPerTier.SetNumZeroed(TierIndex + 1);
+    }
+    FrameStats.CapturesPerTier[TierIndex]++;
+
+    // Every level sits at its own distance behind the link
+    USceneCaptureComponent2D* Capture = Viewer.SceneCapture;
+    Capture->MaxViewDistanceOverride = GetCaptureViewDistance(TierIndex, LinkDistance);
+
+    // Recursion levels share one capture component, so only switch when the tier changes
+    if (Viewer.AppliedTier == TierIndex)
+        return;
 
-    FQuat ConvertedCameraQuat =
-        ConvertQuatToOppositeSpace(CameraQuat);
+    const FPortalCaptureTier& Tier = CaptureTiers[TierIndex];
+    Capture->ShowFlags.SetDynamicShadows(Tier.bShadows);
+    Capture->ShowFlags.SetTranslucency(Tier.bTranslucency);
+    Capture->ShowFlags.SetParticles(Tier.bParticles);
+    Capture->ShowFlags.SetFog(Tier.bFog);
+    Capture->ShowFlags.SetVolumetricFog(Tier.bFog);
+    Capture->LODDistanceFactor = Tier.LODDistanceScale;
+    Capture->PostProcessSettings = Tier.PostProcessSettings;
 
-    UpdateCaptureRecursive(
-        Link->GetActorLocation() + ConvertedCameraLocation - GetActorLocation(), 
-        ConvertedCameraQuat, 
-        Depth + 1
-    );
-    SceneCapture->SetWorldLocation(Link->GetActorLocation() + ConvertedCameraLocation);
-    SceneCapture->SetWorldRotation(ConvertedCameraQuat);
-    HideActorsNotVisible();
-    SceneCapture->CaptureScene();
-    SceneCapture->ClearHiddenComponents();
+    Viewer.AppliedTier = TierIndex;
 }
 
 void APortal::SetLink(APortal* Target)
 {
 	Link = Target;
+    MarkRegistryDirty();
+    UpdateCaptureEveryFrame();
+
+    // Pooled portals are prewarmed before they have a destination
+    if (Link != nullptr && RenderTarget != nullptr)
+    {
+        SetRTT(RenderTarget);
+    }
+    else
+    {
+        SetRTT(GetSurfacePlaceholder());
+    }
+
+    if (Link != nullptr)
+    {
+        Wake();
+    }
+}
+
+void APortal::UpdateCaptureEveryFrame()
+{
+    if (SceneCapture != nullptr)
+    {
+        SceneCapture->bCaptureEveryFrame = ShouldCaptureEveryFrame();
+    }
+    for (FPortalViewerCapture& Viewer : ViewerCaptures)
+    {
+        if (Viewer.SceneCapture != nullptr)
+        {
+            Viewer.SceneCapture->bCaptureEveryFrame = ShouldCaptureEveryFrame();
+        }
+        // The kept content shows the previous destination
+        Viewer.LastCaptureTime = -1.f;
+    }
+}
+
+void APortal::MarkRegistryDirty()
+{
+    UWorld* World = GetWorld();
+    if (World == nullptr)
+        return;
+
+    if (UPortalRegistrySubsystem* Registry = World->GetSubsystem<UPortalRegistrySubsystem>())
+    {
+        Registry->MarkDirty();
+    }
 }
 
 APortal* APortal::GetLink()
@@ -202,6 +1283,29 @@ bool APortal::IsPointBehindPortal(FVector Point, FVector PortalLocation, FVector
 
 void APortal::TeleportActor(AActor* Target, FVector Offset)
 {
+    if (Link == nullptr)
+        return;
+
+    // Networked characters are only moved by their owner, the server replays it from the teleport event
+    ATowerOfCodePortalCharacter* PortalCharacter = Cast<ATowerOfCodePortalCharacter>(Target);
+    if (PortalCharacter != nullptr && !PortalCharacter->CanPredictPortalTeleport())
+        return;
+
+    ApplyTeleport(Target, Offset);
+
+    if (PortalCharacter != nullptr)
+    {
+        PortalCharacter->OnPortalTeleportPredicted(this, Offset);
+    }
+}
+
+void APortal::ApplyTeleport(AActor* Target, FVector Offset)
+{
+    if (Link == nullptr)
+        return;
+
+    const double StartTime = FPlatformTime::Seconds();
+
     // Convert position and velocity
     FVector ActorLocationOnOppositeSpace = ConvertVectorToOppositeSpace(
         Target->GetActorLocation() - GetActorLocation());
@@ -227,15 +1331,23 @@ void APortal::TeleportActor(AActor* Target, FVector Offset)
             VelocityOnOppositeSpace;
 
         AController* Controller = Character->GetController();
+        if (Controller != nullptr)
+        {
+            FQuat ControllerQuat = 
+                ConvertQuatToOppositeSpace(
+                    FQuat(Controller->GetControlRotation()));
 
-        FQuat ControllerQuat = 
-            ConvertQuatToOppositeSpace(
-                FQuat(Controller->GetControlRotation()));
+            Controller->SetControlRotation(ControllerQuat.Rotator());
+        }
+    }
 
-        Character
-            ->GetController()
-            ->SetControlRotation(ControllerQuat.Rotator());
+    if (ATowerOfCodePortalCharacter* PortalCharacter = Cast<ATowerOfCodePortalCharacter>(Target))
+    {
+        PortalCharacter->OnPortalTeleported();
     }
+
+    FrameStats.TeleportSeconds += FPlatformTime::Seconds() - StartTime;
+    FrameStats.TeleportCount++;
 }
 
 
@@ -295,7 +1407,19 @@ FQuat APortal::ConvertQuatToOppositeSpace(FQuat Quat)
 
 void APortal::SetActive(bool NewInput)
 {
+    if (bIsActive == NewInput)
+        return;
+
     bIsActive = NewInput;
+    if (bIsActive)
+    {
+        Wake();
+        return;
+    }
+
+    ReleaseCaptureResources();
+    GetWorldTimerManager().ClearTimer(WakeCheckTimer);
+    SetActorTickEnabled(false);
 }
 
 bool APortal::IsActive()
@@ -307,6 +1431,13 @@ void APortal::SetRTT_Implementation(UTexture* RenerTexture)
 {
 }
 
+FPortalFrameStats APortal::ConsumeFrameStats()
+{
+    FPortalFrameStats Result = FrameStats;
+    FrameStats = FPortalFrameStats();
+    return Result;
+}
+
 
 
 
@@ -11,9 +11,107 @@
 #include "Components/SceneCaptureComponent2D.h"
 #include "Components/DrawFrustumComponent.h"
 #include "Kismet/GameplayStatics.h"
+#include "Engine/LevelStreaming.h"
 #include "TowerOfCodePortalCharacter.h"
 #include "Portal.generated.h"
 
+class APlayerCameraManager;
+struct FPortalEyeView;
+struct FPortalView;
+
+/** Work done by all portals since the last ConsumeFrameStats call */
+struct FPortalFrameStats
+{
+    int32 CaptureCount = 0;
+    /** Viewer updates that kept the last render target content */
+    int32 ReusedCaptureCount = 0;
+    /** Viewer updates skipped by the baked portal visibility */
+    int32 VisibilityRejectedCount = 0;
+    double CaptureSeconds = 0.0;
+    double HideActorsSeconds = 0.0;
+    int32 TeleportCount = 0;
+    double TeleportSeconds = 0.0;
+    /** Captures rendered with each entry of APortal::CaptureTiers */
+    TArray<int32> CapturesPerTier;
+};
+
+/**
+ * Rendering cost of a portal capture. A capture uses the last tier it reaches,
+ * either by its recursion depth or by the viewer's distance to the portal.
+ */
+USTRUCT(BlueprintType)
+struct FPortalCaptureTier
+{
+    GENERATED_BODY()
+
+    /** Recursion depth from which this tier is used, 1 is the view straight through the portal */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, meta = (ClampMin = "1"))
+        int32 MinDepth = 1;
+
+    /** Viewer distance from which this tier is used, zero only goes by depth */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite)
+        float MinDistance = 0.f;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite)
+        bool bShadows = true;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite)
+        bool bTranslucency = true;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite)
+        bool bParticles = true;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite)
+        bool bFog = true;
+
+    /** Scales the distances at which meshes switch LODs, higher is cheaper */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite)
+        float LODDistanceScale = 1.f;
+
+    /** Nothing further than this behind the linked portal is rendered, zero keeps the full view distance */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite)
+        float MaxViewDistance = 0.f;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite)
+        FPostProcessSettings PostProcessSettings;
+};
+
+/** Capture state of one local player looking through the portal */
+USTRUCT()
+struct FPortalViewerCapture
+{
+    GENERATED_BODY()
+
+    UPROPERTY()
+        USceneCaptureComponent2D* SceneCapture = nullptr;
+
+    UPROPERTY()
+        UTextureRenderTarget2D* RenderTarget = nullptr;
+
+    /** Copy of the portal surface showing RenderTarget, only seen by this viewer. Null for the first viewer. */
+    UPROPERTY()
+        UStaticMeshComponent* Surface = nullptr;
+
+    TWeakObjectPtr<APlayerController> Viewer;
+
+    /** World transform of the virtual camera at the first recursion level */
+    FTransform VirtualCameraTransform;
+
+    /** Entry of APortal::CaptureTiers the capture is currently set up for */
+    int32 AppliedTier = INDEX_NONE;
+
+    /** Scene signature behind the portal when the render target was last captured */
+    uint32 CapturedSceneSignature = 0;
+
+    /** World time of the last capture, negative before the first one */
+    float LastCaptureTime = -1.f;
+
+    /** Whether RenderTarget holds both eyes side by side, see APortal::bStereoCapture */
+    bool bStereoLayout = false;
+
+    /** Size RenderTarget was leased for, before the pool rounds or downgrades it. Zero until the first update. */
+    FIntPoint TargetSize = FIntPoint::ZeroValue;
+};
 
 UCLASS()
 class TOWEROFCODEPORTAL_API APortal : public AActor
@@ -22,13 +120,116 @@ class TOWEROFCODEPORTAL_API APortal : public AActor
 
 
 public:
-	UPROPERTY(EditAnywhere, BlueprintReadWrite)
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, ReplicatedUsing = OnRep_Link)
 		APortal* Link;
 
         USceneCaptureComponent2D* SceneCapture;
 
         UTextureRenderTarget2D* RenderTarget;
 
+    /**
+     * Destination living in a streamed sublevel. When set, Link is resolved from it once
+     * the sublevel is loaded and cleared again when the sublevel is unloaded.
+     */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Streaming)
+        TSoftObjectPtr<APortal> StreamedLink;
+
+    /** Viewer distance under which the sublevel of StreamedLink is loaded */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Streaming)
+        float StreamInDistance;
+
+    /** Viewer distance over which the sublevel of StreamedLink is released, keep it above StreamInDistance */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Streaming)
+        float StreamOutDistance;
+
+    /** Shown on the portal surface while the destination is not loaded or the render target was taken, the engine's default texture if none */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Streaming)
+        UTexture* PlaceholderTexture;
+
+    /** Texture parameter of the surface material that receives a split-screen viewer's render target */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Splitscreen)
+        FName SurfaceTextureParameter;
+
+    /** Half size of the portal surface along the right and up axes, zero uses the bounds of the surface mesh */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite)
+        FVector2D SurfaceExtent;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Quality)
+        FIntPoint RenderTargetSize;
+
+    /** Lower precision formats such as RTF_RGB10A2 halve the memory of a target */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Quality)
+        TEnumAsByte<ETextureRenderTargetFormat> RenderTargetFormat;
+
+    /** Lets the render target manager hand out a cheaper format or a smaller target when the budget is tight */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Quality)
+        bool bAllowRenderTargetDowngrade;
+
+    /** Capture settings from the nearest and shallowest views to the cheapest ones, one full quality tier by default */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Quality)
+        TArray<FPortalCaptureTier> CaptureTiers;
+
+    /**
+     * Keeps the last render target content while the virtual camera and the scene behind the portal
+     * don't change. The captures are then only driven by UpdateCapture, not by the engine every frame.
+     * The scene only counts as changed when a movable actor's root moves, so animation, moving child
+     * components, lights and material parameters wait for StaticRefreshRate. Off unless the scene suits it.
+     */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Quality)
+        bool bReuseCaptures;
+
+    /** Virtual camera movement, in cm, under which the last capture is kept */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Quality)
+        float ReuseLocationTolerance;
+
+    /** Virtual camera rotation, in degrees, under which the last capture is kept */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Quality)
+        float ReuseAngleTolerance;
+
+    /** Refreshes per second of a kept capture, so animated materials and lights still update. Zero never refreshes it. */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Quality)
+        float StaticRefreshRate;
+
+    /**
+     * Triggers the captures from the main views when the engine begins rendering each frame, with their final
+     * camera and field of view, instead of from the player camera when the blueprint calls UpdateCapture,
+     * which then does nothing. Removes the one frame lag of a capture driven from tick. The captures are
+     * still rendered as their own scene captures, see FPortalViewExtension.
+     */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Quality)
+        bool bCaptureInViewFamily;
+
+    /**
+     * With bCaptureInViewFamily, renders both eyes of a stereo view in one pass into a side-by-side target,
+     * left eye on the left, each half at the eye's aspect and at most RenderTargetSize. The surface material
+     * needs the eye selection of Portal.AddStereoEyeSelection. Try it without a headset with -emulatestereo.
+     */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Stereo)
+        bool bStereoCapture;
+
+    /** Scalar parameter of the surface material, 1 while it shows a side-by-side target and has to sample the eye's half */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Stereo)
+        FName StereoLayoutParameter;
+
+    /** Creates the capture component and render target in BeginPlay, e.g. behind a loading screen, instead of when first seen */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Lifetime)
+        bool bPrewarmCapture;
+
+    /** Seconds without a viewer looking through the portal before its capture resources are released and it stops ticking. Zero keeps them. */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Lifetime)
+        float ReleaseUnseenDelay;
+
+    /** Seconds between the checks of a sleeping portal for viewers that may see it */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Lifetime)
+        float WakeCheckInterval;
+
+    /**
+     * Slot of a portal from UPortalPlacementSubsystem's pool, INDEX_NONE for other portals.
+     * Replicated, so a client's pool holds the server's portals in the same slots.
+     */
+    UPROPERTY(Transient, ReplicatedUsing = OnRep_PoolSlot)
+        int32 PoolSlot;
+
 protected:
 	UPROPERTY(BlueprintReadOnly)
 		USceneComponent* PortalRootComponent;
@@ -45,10 +246,27 @@ protected:
 	// Called when the game starts or when spawned
 	virtual void BeginPlay() override;
 
+    virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+    virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
+    /** Wakes a sleeping portal, the blueprint teleports overlapping actors on tick */
+    virtual void NotifyActorBeginOverlap(AActor* OtherActor) override;
+
     void CreateRenderTarget();
 
     void CreateSceneCapture();
 
+    /** Leases a render target from UPortalRenderTargetSubsystem, may return nullptr when over budget */
+    UTextureRenderTarget2D* AcquireRenderTarget();
+
+    void ReleaseRenderTargets();
+
+    USceneCaptureComponent2D* NewSceneCapture(UTextureRenderTarget2D* Target, const FName& Name);
+
+    /** Post-process every capture starts from, with the effects a portal doesn't need turned off */
+    static FPostProcessSettings MakeCapturePostProcessSettings();
+
 public:
 	// Called every frame
 	virtual void Tick(float DeltaTime) override;
@@ -56,18 +274,34 @@ public:
     UFUNCTION(BlueprintCallable)
         void UpdateCapture();
 
+    /** Updates PlayerController's capture from a view of the frame, FOVAngle zero keeps the capture's field of view */
+    void UpdateCaptureFromView(APlayerController* PlayerController, const FVector& ViewLocation, const FQuat& ViewRotation, float FOVAngle);
+
+    /** Updates PlayerController's capture with both eyes of a stereo view, see bStereoCapture */
+    void UpdateStereoCaptureFromView(APlayerController* PlayerController, const FPortalEyeView& LeftEye, const FPortalEyeView& RightEye);
+
 	UFUNCTION(BlueprintCallable)
 		void SetLink(APortal* Target);
 
 	UFUNCTION(BlueprintPure)
 		APortal* GetLink();
 
+    /** Hides a pooled portal without collision or tick while it waits for a placement, or brings it back. Replicated. */
+    void SetParked(bool bNewParked);
+
+    /** Whether the portal waits in UPortalPlacementSubsystem's pool, its capture resources are kept for the next placement */
+    UFUNCTION(BlueprintPure, Category = Lifetime)
+        bool IsParked() const { return bParked; }
+
 	UFUNCTION(BlueprintCallable)
 		bool IsPointBehindPortal(FVector Point, FVector PortalLocation, FVector PortalNormal, float Offset);
 
 	UFUNCTION(BlueprintCallable)
 		void TeleportActor(AActor* Target, FVector Offset);
 
+    /** Moves Target to the linked side without any network gating */
+    void ApplyTeleport(AActor* Target, FVector Offset);
+
     UFUNCTION(BlueprintCallable)
         FVector ConvertVectorToOppositeSpace(FVector Point);
 
@@ -80,10 +314,122 @@ public:
     UFUNCTION(BlueprintCallable)
         bool IsActive();
 
+    /** Creates the first viewer's capture component and render target ahead of time */
+    UFUNCTION(BlueprintCallable, Category = Lifetime)
+        void PrewarmCapture();
+
+    UFUNCTION(BlueprintPure, Category = Lifetime)
+        bool HasCaptureResources() const;
+
     UFUNCTION(BlueprintNativeEvent, BlueprintCallable)
         void SetRTT(UTexture* RenerTexture);
 
+    /** Virtual camera of a local player's first recursion level, as of the last UpdateCapture */
+    UFUNCTION(BlueprintPure)
+        FTransform GetViewerCameraTransform(int32 ViewerIndex) const;
+
+    UFUNCTION(BlueprintPure)
+        int32 GetViewerCount() const;
+
+    /** Copies of this portal's and Link's surface made for other local players than ViewerIndex, none of its views may show them */
+    void GetSurfacesHiddenFromViewer(int32 ViewerIndex, TArray<UPrimitiveComponent*>& OutSurfaces) const;
+
+    /** Half size of the portal surface along the right and up axes */
+    UFUNCTION(BlueprintPure)
+        FVector2D GetSurfaceExtent() const;
+
+    /** Entry of CaptureTiers used at a recursion depth and viewer distance, INDEX_NONE without tiers */
+    UFUNCTION(BlueprintPure, Category = Quality)
+        int32 SelectCaptureTier(int32 Depth, float ViewerDistance) const;
+
+    /**
+     * MaxViewDistanceOverride of a capture with a tier whose camera is LinkDistance from the linked portal,
+     * -1 for the full view distance
+     */
+    float GetCaptureViewDistance(int32 TierIndex, float LinkDistance) const;
+
+    /** Entry of CaptureTiers a local player's capture was last rendered with */
+    UFUNCTION(BlueprintPure, Category = Quality)
+        int32 GetAppliedCaptureTier(int32 ViewerIndex) const;
+
+    static FPortalFrameStats ConsumeFrameStats();
+
+    /** Called by UPortalRenderTargetSubsystem after handing Target to another portal */
+    void OnRenderTargetEvicted(UTextureRenderTarget2D* Target);
+
 private:
-    void UpdateCaptureRecursive(FVector CameraRelativeLocation, FQuat CameraQuat, int Depth);
-    void HideActorsNotVisible();
+    /** StereoEyes is nullptr for a mono view, or the left and right eye with CameraLocation and CameraQuat being the left one */
+    void UpdateViewerCapture(int32 ViewerIndex, const FVector& CameraLocation, const FQuat& CameraQuat, float FOVAngle, const FPortalEyeView* StereoEyes = nullptr);
+    void CaptureViewChain(FPortalViewerCapture& Viewer, const TArray<FPortalView>& Views, float ViewerDistance);
+    void CaptureStereoViewChain(FPortalViewerCapture& Viewer, const TArray<FPortalView>& LeftViews, const TArray<FPortalView>& RightViews, const FPortalEyeView* Eyes, float ViewerDistance);
+    void ShowStereoLayout(int32 ViewerIndex, bool bStereoLayout);
+    int32 GetLocalViewerIndex(const APlayerController* PlayerController) const;
+    bool IsStereoCaptureActive() const;
+    void ApplyCaptureTier(FPortalViewerCapture& Viewer, int32 TierIndex, float LinkDistance);
+    float GetLinkDistance(const FPortalView& View) const;
+    void HideActorsNotVisible(USceneCaptureComponent2D* Capture);
+
+    FPortalViewerCapture& GetViewerCapture(int32 ViewerIndex, APlayerController* PlayerController);
+    void CreateViewerCapture();
+    void CreateCaptureResources(int32 ViewerIndex);
+    void ReleaseCaptureResources();
+    void UpdateSurfaceVisibility();
+    void HideOtherViewerSurfaces(int32 ViewerIndex);
+    UPrimitiveComponent* GetViewerSurface(int32 ViewerIndex) const;
+    UStaticMeshComponent* GetOriginalSurface() const;
+    /** Leases a new target of Size for a viewer, in place of an evicted one or one of another size */
+    bool RestoreRenderTarget(int32 ViewerIndex, FIntPoint Size);
+    /** RenderTargetSize, or for a stereo view both eyes side by side at the headset's aspect */
+    FIntPoint GetViewerTargetSize(const FPortalEyeView* StereoEyes) const;
+    /** Texture is nullptr for the placeholder */
+    void ShowViewerTexture(int32 ViewerIndex, UTexture* Texture);
+    UTexture* GetSurfacePlaceholder() const;
+
+    UPROPERTY(Transient)
+        TArray<FPortalViewerCapture> ViewerCaptures;
+
+    /** Hash of the movable actors in front of Link, from this frame's culling pass */
+    uint32 SceneSignature;
+
+    bool CanReuseCapture(const FPortalViewerCapture& Viewer, const FTransform& CameraTransform) const;
+    bool ShouldCaptureEveryFrame() const;
+    void UpdateCaptureEveryFrame();
+
+    void MarkRegistryDirty();
+
+    UFUNCTION()
+        void OnRep_Link();
+
+    UFUNCTION()
+        void OnRep_PoolSlot();
+
+    UFUNCTION()
+        void OnRep_Parked();
+
+    UPROPERTY(Transient, ReplicatedUsing = OnRep_Parked)
+        bool bParked;
+
+    void UpdateStreamedLink();
+    void RequestStreamedLevel(bool bLoad);
+    void SetResolvedLink(APortal* Target);
+    ULevelStreaming* GetStreamedLinkLevel() const;
+    float GetClosestViewerDistance() const;
+
+    bool bStreamedLevelRequested;
+
+    /** Stops ticking until a viewer may see the portal or something overlaps it */
+    void Sleep();
+    void Wake();
+    void CheckWake();
+    bool IsPotentiallyVisibleToAnyViewer() const;
+
+    /** World time a viewer last looked through the portal */
+    float LastSeenTime;
+
+    FTimerHandle WakeCheckTimer;
+
+    static FPortalFrameStats FrameStats;
+
+    /** Portals requesting each sublevel, so a level shared by several destinations stays loaded */
+    static TMap<TWeakObjectPtr<ULevelStreaming>, int32> StreamedLevelRequests;
 };
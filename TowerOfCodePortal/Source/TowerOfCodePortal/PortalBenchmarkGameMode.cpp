@@ -0,0 +1,337 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "PortalBenchmarkGameMode.h"
+#include "Portal.h"
+#include "PortalRegistrySubsystem.h"
+#include "PortalRenderTargetSubsystem.h"
+#include "Engine/StaticMesh.h"
+#include "Engine/StaticMeshActor.h"
+#include "GameFramework/Character.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "GameFramework/PlayerController.h"
+#include "HAL/PlatformMemory.h"
+#include "Misc/CommandLine.h"
+#include "Misc/DateTime.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+#include "UObject/ConstructorHelpers.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogPortalBenchmark, Log, All);
+
+namespace
+{
+    void ParseIntList(const TCHAR* Key, TArray<int32>& OutValues)
+    {
+        FString Value;
+        if (!FParse::Value(FCommandLine::Get(), Key, Value))
+            return;
+
+        TArray<FString> Parts;
+        Value.ParseIntoArray(Parts, TEXT(","));
+
+        OutValues.Reset();
+        for (const FString& Part : Parts)
+        {
+            OutValues.Add(FMath::Max(0, FCString::Atoi(*Part)));
+        }
+    }
+}
+
+APortalBenchmarkGameMode::APortalBenchmarkGameMode()
+    : Super()
+{
+    PrimaryActorTick.bCanEverTick = true;
+    PrimaryActorTick.TickGroup = TG_PrePhysics;
+
+    static ConstructorHelpers::FClassFinder<APortal> PortalClassFinder(TEXT("/Game/FirstPersonCPP/Blueprints/Portal"));
+    PortalClass = PortalClassFinder.Class;
+
+    static ConstructorHelpers::FObjectFinder<UStaticMesh> CubeFinder(TEXT("/Engine/BasicShapes/Cube"));
+    DynamicActorMesh = CubeFinder.Object;
+
+    PortalPairCounts = { 1, 2, 4, 8, 16 };
+    DynamicActorCounts = { 0, 100, 1000 };
+    WarmupFrames = 30;
+    MeasuredFrames = 300;
+    FlightSpeed = 600.f;
+    ApproachDistance = 400.f;
+    PairSpacing = 1000.f;
+    RandomSeed = 1234;
+
+    CaseIndex = 0;
+    FrameInCase = 0;
+    FlightLeg = 0;
+    FlightLegDistance = 0.f;
+    ElapsedTime = 0.f;
+    bSweepRunning = false;
+    bStereoCaptures = false;
+    bReuseCaptures = false;
+}
+
+void APortalBenchmarkGameMode::BeginPlay()
+{
+    Super::BeginPlay();
+
+    ParseCommandLine();
+
+    if (PortalClass == nullptr || PortalPairCounts.Num() == 0 || DynamicActorCounts.Num() == 0)
+    {
+        UE_LOG(LogPortalBenchmark, Error, TEXT("Nothing to run, check PortalClass and the sweep lists"));
+        return;
+    }
+
+    Rows.Reset();
+    Rows.Add(TEXT("Pairs,Actors,Frame,DeltaMs,Captures,ReusedCaptures,VisibilityRejected,CaptureMs,HideActorsMs,Teleports,TeleportMs,UsedPhysicalMB,RenderTargetMB,TierCaptures"));
+
+    CaseIndex = INDEX_NONE;
+    bSweepRunning = true;
+}
+
+void APortalBenchmarkGameMode::ParseCommandLine()
+{
+    ParseIntList(TEXT("BenchPairs="), PortalPairCounts);
+    ParseIntList(TEXT("BenchActors="), DynamicActorCounts);
+    FParse::Value(FCommandLine::Get(), TEXT("BenchWarmup="), WarmupFrames);
+    FParse::Value(FCommandLine::Get(), TEXT("BenchFrames="), MeasuredFrames);
+    bStereoCaptures = FParse::Param(FCommandLine::Get(), TEXT("BenchStereo"));
+    bReuseCaptures = FParse::Param(FCommandLine::Get(), TEXT("BenchReuseCaptures"));
+
+    if (!FParse::Value(FCommandLine::Get(), TEXT("BenchOutput="), OutputPath))
+    {
+        OutputPath = FPaths::Combine(
+            FPaths::ProjectSavedDir(),
+            TEXT("Benchmarks"),
+            FString::Printf(TEXT("PortalScaling_%s.csv"), *FDateTime::Now().ToString()));
+    }
+}
+
+void APortalBenchmarkGameMode::Tick(float DeltaSeconds)
+{
+    Super::Tick(DeltaSeconds);
+
+    if (!bSweepRunning)
+        return;
+
+    // The player is possessed after BeginPlay, so the first case starts on the first tick
+    if (CaseIndex == INDEX_NONE)
+    {
+        CaseIndex = 0;
+        StartCase();
+        APortal::ConsumeFrameStats();
+        return;
+    }
+
+    RecordFrame(DeltaSeconds);
+
+    FrameInCase++;
+    if (FrameInCase >= WarmupFrames + MeasuredFrames)
+    {
+        CaseIndex++;
+        if (CaseIndex >= PortalPairCounts.Num() * DynamicActorCounts.Num())
+        {
+            FinishSweep();
+            return;
+        }
+        StartCase();
+    }
+
+    ElapsedTime += DeltaSeconds;
+    MoveDynamicActors();
+    UpdateFlight(DeltaSeconds);
+}
+
+void APortalBenchmarkGameMode::StartCase()
+{
+    ClearCase();
+
+    const int32 Pairs = FMath::Max(1, PortalPairCounts[CaseIndex / DynamicActorCounts.Num()]);
+    const int32 Actors = DynamicActorCounts[CaseIndex % DynamicActorCounts.Num()];
+
+    UE_LOG(LogPortalBenchmark, Log, TEXT("Case %d: %d portal pairs, %d dynamic actors"), CaseIndex, Pairs, Actors);
+
+    SpawnPortalPairs(Pairs);
+    SpawnDynamicActors(Actors);
+
+    FrameInCase = 0;
+    ElapsedTime = 0.f;
+    StartFlightLeg(0);
+}
+
+void APortalBenchmarkGameMode::ClearCase()
+{
+    for (APortal* Portal : SpawnedPortals)
+    {
+        Portal->Destroy();
+    }
+    for (AStaticMeshActor* Actor : DynamicActors)
+    {
+        Actor->Destroy();
+    }
+    SpawnedPortals.Reset();
+    EntryPortals.Reset();
+    DynamicActors.Reset();
+    DynamicActorOrigins.Reset();
+}
+
+void APortalBenchmarkGameMode::FinishSweep()
+{
+    ClearCase();
+    bSweepRunning = false;
+
+    if (FFileHelper::SaveStringArrayToFile(Rows, *OutputPath))
+    {
+        UE_LOG(LogPortalBenchmark, Log, TEXT("Wrote %d frames to %s"), Rows.Num() - 1, *OutputPath);
+    }
+    else
+    {
+        UE_LOG(LogPortalBenchmark, Error, TEXT("Failed to write %s"), *OutputPath);
+    }
+
+    FPlatformMisc::RequestExit(false);
+}
+
+void APortalBenchmarkGameMode::SpawnPortalPairs(int32 Count)
+{
+    // Entry portals stand in a row facing -X, their exits stand in a parallel row facing +X
+    const float Height = 200.f;
+    const float ExitRowOffset = 5000.f;
+
+    for (int32 Index = 0; Index < Count; Index++)
+    {
+        const FVector EntryLocation(Index * PairSpacing, 0.f, Height);
+        const FVector ExitLocation(Index * PairSpacing, ExitRowOffset, Height);
+
+        APortal* Entry = GetWorld()->SpawnActor<APortal>(PortalClass, EntryLocation, FRotator(0.f, 180.f, 0.f));
+        APortal* Exit = GetWorld()->SpawnActor<APortal>(PortalClass, ExitLocation, FRotator::ZeroRotator);
+        if (Entry == nullptr || Exit == nullptr)
+            continue;
+
+        for (APortal* Portal : { Entry, Exit })
+        {
+            Portal->bCaptureInViewFamily = bStereoCaptures;
+            Portal->bStereoCapture = bStereoCaptures;
+            Portal->bReuseCaptures = bReuseCaptures;
+        }
+
+        Entry->SetLink(Exit);
+        Exit->SetLink(Entry);
+
+        EntryPortals.Add(Entry);
+        SpawnedPortals.Add(Entry);
+        SpawnedPortals.Add(Exit);
+    }
+}
+
+void APortalBenchmarkGameMode::SpawnDynamicActors(int32 Count)
+{
+    FRandomStream Random(RandomSeed);
+    const FBox Bounds(
+        FVector(-ApproachDistance * 2.f, -1000.f, 0.f),
+        FVector(FMath::Max(1, EntryPortals.Num()) * PairSpacing, 6000.f, 600.f));
+
+    for (int32 Index = 0; Index < Count; Index++)
+    {
+        const FVector Location = Random.RandPointInBox(Bounds);
+        AStaticMeshActor* Actor = GetWorld()->SpawnActor<AStaticMeshActor>(Location, FRotator::ZeroRotator);
+        if (Actor == nullptr)
+            continue;
+
+        Actor->SetMobility(EComponentMobility::Movable);
+        Actor->GetStaticMeshComponent()->SetStaticMesh(DynamicActorMesh);
+        Actor->GetStaticMeshComponent()->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+        Actor->SetActorScale3D(FVector(0.5f));
+
+        DynamicActors.Add(Actor);
+        DynamicActorOrigins.Add(Location);
+    }
+}
+
+void APortalBenchmarkGameMode::MoveDynamicActors()
+{
+    for (int32 Index = 0; Index < DynamicActors.Num(); Index++)
+    {
+        const float Phase = ElapsedTime * 2.f + Index;
+        const FVector Offset(FMath::Sin(Phase) * 100.f, FMath::Cos(Phase) * 100.f, 0.f);
+        DynamicActors[Index]->SetActorLocation(DynamicActorOrigins[Index] + Offset);
+    }
+}
+
+void APortalBenchmarkGameMode::StartFlightLeg(int32 Leg)
+{
+    APlayerController* PlayerController = GetWorld()->GetFirstPlayerController();
+    if (PlayerController == nullptr || PlayerController->GetPawn() == nullptr || EntryPortals.Num() == 0)
+        return;
+
+    FlightLeg = Leg;
+    FlightLegDistance = 0.f;
+
+    APortal* Entry = EntryPortals[Leg % EntryPortals.Num()];
+    const FVector Start = Entry->GetActorLocation() + Entry->GetActorForwardVector() * ApproachDistance;
+    const FRotator Facing = (-Entry->GetActorForwardVector()).Rotation();
+
+    APawn* Pawn = PlayerController->GetPawn();
+    ACharacter* Character = Cast<ACharacter>(Pawn);
+    if (Character != nullptr)
+    {
+        Character->GetCharacterMovement()->SetMovementMode(MOVE_Flying);
+        Character->GetCharacterMovement()->Velocity = FVector::ZeroVector;
+    }
+
+    Pawn->SetActorLocationAndRotation(Start, FRotator(0.f, Facing.Yaw, 0.f), false, nullptr, ETeleportType::TeleportPhysics);
+    PlayerController->SetControlRotation(Facing);
+}
+
+void APortalBenchmarkGameMode::UpdateFlight(float DeltaSeconds)
+{
+    APlayerController* PlayerController = GetWorld()->GetFirstPlayerController();
+    if (PlayerController == nullptr || PlayerController->GetPawn() == nullptr)
+        return;
+
+    // Fly along the view direction, which the portal rotates on teleport, so the flight carries on out of the exit
+    APawn* Pawn = PlayerController->GetPawn();
+    const float Step = FlightSpeed * DeltaSeconds;
+    Pawn->SetActorLocation(Pawn->GetActorLocation() + PlayerController->GetControlRotation().Vector() * Step);
+
+    FlightLegDistance += Step;
+    if (FlightLegDistance > ApproachDistance * 2.f)
+    {
+        StartFlightLeg(FlightLeg + 1);
+    }
+}
+
+void APortalBenchmarkGameMode::RecordFrame(float DeltaSeconds)
+{
+    const FPortalFrameStats Stats = APortal::ConsumeFrameStats();
+    if (FrameInCase < WarmupFrames)
+        return;
+
+    const int32 Pairs = EntryPortals.Num();
+    const int32 Actors = DynamicActors.Num();
+    const double UsedPhysicalMB = FPlatformMemory::GetStats().UsedPhysical / (1024.0 * 1024.0);
+    UPortalRenderTargetSubsystem* RenderTargets = GetWorld()->GetSubsystem<UPortalRenderTargetSubsystem>();
+    const float RenderTargetMB = RenderTargets != nullptr ? RenderTargets->GetUsedMB() : 0.f;
+
+    // Captures per quality tier, e.g. "2/2/6"
+    FString TierCaptures;
+    for (int32 TierIndex = 0; TierIndex < Stats.CapturesPerTier.Num(); TierIndex++)
+    {
+        TierCaptures += FString::Printf(TierIndex == 0 ? TEXT("%d") : TEXT("/%d"), Stats.CapturesPerTier[TierIndex]);
+    }
+
+    Rows.Add(FString::Printf(TEXT("%d,%d,%d,%.4f,%d,%d,%d,%.4f,%.4f,%d,%.4f,%.2f,%.2f,%s"),
+        Pairs,
+        Actors,
+        FrameInCase - WarmupFrames,
+        DeltaSeconds * 1000.f,
+        Stats.CaptureCount,
+        Stats.ReusedCaptureCount,
+        Stats.VisibilityRejectedCount,
+        Stats.CaptureSeconds * 1000.0,
+        Stats.HideActorsSeconds * 1000.0,
+        Stats.TeleportCount,
+        Stats.TeleportSeconds * 1000.0,
+        UsedPhysicalMB,
+        RenderTargetMB,
+        *TierCaptures));
+}
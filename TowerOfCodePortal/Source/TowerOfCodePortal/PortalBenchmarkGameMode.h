@@ -0,0 +1,107 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "TowerOfCodePortalGameMode.h"
+#include "PortalBenchmarkGameMode.generated.h"
+
+class APortal;
+class AStaticMeshActor;
+class UStaticMesh;
+
+/**
+ * Measures how the portal system scales.
+ * For every combination of portal pair count and dynamic actor count it spawns the pairs,
+ * flies the player through them and writes one CSV row per measured frame.
+ *
+ * Runs on any map, e.g.
+ * "TowerOfCodePortal <Map>?game=PortalBenchmark -game -nullrhi -benchmark -fps=60 -BenchPairs=1,4,16 -BenchActors=0,500"
+ *
+ * -BenchStereo drives the portals from the view family with APortal::bStereoCapture. Together with
+ * -emulatestereo both eyes are captured without a headset, one capture per recursion level for both.
+ * -BenchReuseCaptures turns on APortal::bReuseCaptures for every portal.
+ */
+UCLASS(minimalapi)
+class APortalBenchmarkGameMode : public ATowerOfCodePortalGameMode
+{
+    GENERATED_BODY()
+
+public:
+    APortalBenchmarkGameMode();
+
+    /** Portal pair counts to sweep, overridden by -BenchPairs=1,2,4 */
+    UPROPERTY(EditAnywhere, Category = Benchmark)
+        TArray<int32> PortalPairCounts;
+
+    /** Dynamic actor counts to sweep, overridden by -BenchActors=0,100 */
+    UPROPERTY(EditAnywhere, Category = Benchmark)
+        TArray<int32> DynamicActorCounts;
+
+    /** Frames skipped after spawning a case, overridden by -BenchWarmup= */
+    UPROPERTY(EditAnywhere, Category = Benchmark)
+        int32 WarmupFrames;
+
+    /** Frames recorded per case, overridden by -BenchFrames= */
+    UPROPERTY(EditAnywhere, Category = Benchmark)
+        int32 MeasuredFrames;
+
+    UPROPERTY(EditAnywhere, Category = Benchmark)
+        TSubclassOf<APortal> PortalClass;
+
+    UPROPERTY(EditAnywhere, Category = Benchmark)
+        UStaticMesh* DynamicActorMesh;
+
+    /** Speed of the scripted flight, in cm/sec */
+    UPROPERTY(EditAnywhere, Category = Benchmark)
+        float FlightSpeed;
+
+    /** Distance in front of a portal where each flight leg starts */
+    UPROPERTY(EditAnywhere, Category = Benchmark)
+        float ApproachDistance;
+
+    /** Distance between neighbouring portal pairs */
+    UPROPERTY(EditAnywhere, Category = Benchmark)
+        float PairSpacing;
+
+    UPROPERTY(EditAnywhere, Category = Benchmark)
+        int32 RandomSeed;
+
+protected:
+    virtual void BeginPlay() override;
+
+public:
+    virtual void Tick(float DeltaSeconds) override;
+
+private:
+    void ParseCommandLine();
+    void StartCase();
+    void ClearCase();
+    void FinishSweep();
+
+    void SpawnPortalPairs(int32 Count);
+    void SpawnDynamicActors(int32 Count);
+    void MoveDynamicActors();
+
+    void StartFlightLeg(int32 Leg);
+    void UpdateFlight(float DeltaSeconds);
+
+    void RecordFrame(float DeltaSeconds);
+
+    TArray<APortal*> EntryPortals;
+    TArray<APortal*> SpawnedPortals;
+    TArray<AStaticMeshActor*> DynamicActors;
+    TArray<FVector> DynamicActorOrigins;
+
+    int32 CaseIndex;
+    int32 FrameInCase;
+    int32 FlightLeg;
+    float FlightLegDistance;
+    float ElapsedTime;
+    bool bSweepRunning;
+    bool bStereoCaptures;
+    bool bReuseCaptures;
+
+    FString OutputPath;
+    TArray<FString> Rows;
+};
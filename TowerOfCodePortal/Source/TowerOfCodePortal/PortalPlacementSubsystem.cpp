@@ -0,0 +1,362 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "PortalPlacementSubsystem.h"
+#include "Portal.h"
+#include "Engine/World.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogPortalPlacement, Log, All);
+
+namespace
+{
+    /** Where pooled portals wait, far from anything a capture could see */
+    const FVector ParkingLocation(0.f, 0.f, -100000.f);
+
+    /** Depth in front of the surface that has to be free of geometry */
+    const float ClearanceDepth = 20.f;
+
+    /** Settings of a pooled portal that its blueprint doesn't have, set on every machine before BeginPlay */
+    void SetUpPooledPortal(APortal* Portal)
+    {
+        Portal->bPrewarmCapture = true;
+        Portal->ReleaseUnseenDelay = 0.f;
+    }
+}
+
+UPortalPlacementSubsystem::UPortalPlacementSubsystem()
+{
+    PortalClass = FSoftClassPath(TEXT("/Game/FirstPersonCPP/Blueprints/Portal.Portal_C"));
+    PoolSize = 2;
+    SurfaceOffset = 1.f;
+    FlatnessTolerance = 2.f;
+    MaxFitIterations = 4;
+}
+
+void UPortalPlacementSubsystem::Deinitialize()
+{
+    Pool.Reset();
+    Pairs.Reset();
+    Slots.Reset();
+
+    Super::Deinitialize();
+}
+
+void UPortalPlacementSubsystem::ReservePool()
+{
+    int32 Count = Pool.Num();
+    for (const FPortalPlacementPair& Pair : Pairs)
+    {
+        Count += (Pair.Portals[0] != nullptr ? 1 : 0) + (Pair.Portals[1] != nullptr ? 1 : 0);
+    }
+
+    for (; Count < PoolSize; Count++)
+    {
+        if (SpawnPooledPortal() == nullptr)
+            return;
+    }
+}
+
+APortal* UPortalPlacementSubsystem::SpawnPooledPortal()
+{
+    // Clients get the server's pool by replication
+    if (GetWorld()->IsNetMode(NM_Client))
+        return nullptr;
+
+    UClass* Class = PortalClass.TryLoadClass<APortal>();
+    if (Class == nullptr)
+    {
+        UE_LOG(LogPortalPlacement, Error, TEXT("Portal class %s not found"), *PortalClass.ToString());
+        return nullptr;
+    }
+
+    // Deferred, so the capture is created in BeginPlay and kept while the portal waits in the pool
+    const FTransform Transform(ParkingLocation);
+    APortal* Portal = GetWorld()->SpawnActorDeferred<APortal>(Class, Transform, nullptr, nullptr, ESpawnActorCollisionHandlingMethod::AlwaysSpawn);
+    if (Portal == nullptr)
+        return nullptr;
+
+    Portal->Link = nullptr;
+    Portal->PoolSlot = Slots.Num();
+    SetUpPooledPortal(Portal);
+
+    // Parked far away, placed anywhere, and seen through other portals from everywhere
+    Portal->SetReplicates(true);
+    Portal->SetReplicateMovement(true);
+    Portal->bAlwaysRelevant = true;
+    Portal->FinishSpawning(Transform);
+
+    Slots.Add(Portal);
+    ReturnToPool(Portal);
+    return Portal;
+}
+
+APortal* UPortalPlacementSubsystem::TakeFromPool()
+{
+    if (Pool.Num() == 0)
+    {
+        UE_LOG(LogPortalPlacement, Warning, TEXT("Portal pool is empty, raise PoolSize to spawn them while loading"));
+        if (SpawnPooledPortal() == nullptr)
+            return nullptr;
+    }
+    return Pool.Pop(false);
+}
+
+void UPortalPlacementSubsystem::ReturnToPool(APortal* Portal)
+{
+    Portal->SetLink(nullptr);
+    Portal->SetParked(true);
+    Portal->SetActorLocation(ParkingLocation);
+    Pool.Add(Portal);
+}
+
+APortal* UPortalPlacementSubsystem::PlacePortal(AActor* Owner, int32 PortalIndex, const FHitResult& Hit, const FVector& UpHint)
+{
+    if (Owner == nullptr || (PortalIndex != 0 && PortalIndex != 1) || GetWorld()->IsNetMode(NM_Client))
+        return nullptr;
+
+    // Portals of owners that left go back to the pool first
+    for (int32 PairIndex = Pairs.Num() - 1; PairIndex >= 0; PairIndex--)
+    {
+        if (Pairs[PairIndex].Owner.IsValid())
+            continue;
+
+        for (APortal* Portal : Pairs[PairIndex].Portals)
+        {
+            if (Portal != nullptr)
+            {
+                ReturnToPool(Portal);
+            }
+        }
+        Pairs.RemoveAtSwap(PairIndex);
+    }
+
+    ReservePool();
+
+    FPortalPlacementPair* Pair = Pairs.FindByPredicate([Owner](const FPortalPlacementPair& Candidate) { return Candidate.Owner == Owner; });
+    if (Pair == nullptr)
+    {
+        Pair = &Pairs.AddDefaulted_GetRef();
+        Pair->Owner = Owner;
+    }
+
+    FTransform Transform;
+    if (!FindPlacement(Hit, UpHint, Pair->Portals[PortalIndex], Transform))
+        return nullptr;
+
+    APortal*& Portal = Pair->Portals[PortalIndex];
+    if (Portal == nullptr)
+    {
+        Portal = TakeFromPool();
+        if (Portal == nullptr)
+            return nullptr;
+    }
+
+    Portal->SetActorTransform(Transform, false, nullptr, ETeleportType::TeleportPhysics);
+    Portal->SetParked(false);
+
+    // Relinking also refreshes both portals' captures and the registry's pair transforms
+    APortal* Other = Pair->Portals[1 - PortalIndex];
+    Portal->SetLink(Other);
+    if (Other != nullptr)
+    {
+        Other->SetLink(Portal);
+    }
+    return Portal;
+}
+
+int32 UPortalPlacementSubsystem::GetPoolSlot(const APortal* Portal) const
+{
+    return Portal != nullptr ? Slots.IndexOfByKey(Portal) : INDEX_NONE;
+}
+
+APortal* UPortalPlacementSubsystem::GetPooledPortal(int32 Slot) const
+{
+    return Slots.IsValidIndex(Slot) ? Slots[Slot] : nullptr;
+}
+
+void UPortalPlacementSubsystem::AddReplicatedPortal(APortal* Portal)
+{
+    const int32 Slot = Portal != nullptr ? Portal->PoolSlot : INDEX_NONE;
+    if (Slot == INDEX_NONE || GetPooledPortal(Slot) == Portal)
+        return;
+
+    // Portals may arrive in any order
+    if (Slots.Num() <= Slot)
+    {
+        Slots.SetNum(Slot + 1);
+    }
+    Slots[Slot] = Portal;
+    SetUpPooledPortal(Portal);
+}
+
+void UPortalPlacementSubsystem::ClearPortals(AActor* Owner)
+{
+    const int32 PairIndex = Pairs.IndexOfByPredicate([Owner](const FPortalPlacementPair& Candidate) { return Candidate.Owner == Owner; });
+    if (PairIndex == INDEX_NONE)
+        return;
+
+    for (APortal* Portal : Pairs[PairIndex].Portals)
+    {
+        if (Portal != nullptr)
+        {
+            ReturnToPool(Portal);
+        }
+    }
+    Pairs.RemoveAtSwap(PairIndex);
+}
+
+bool UPortalPlacementSubsystem::FindPlacement(const FHitResult& Hit, const FVector& UpHint, const APortal* Ignored, FTransform& OutTransform)
+{
+    const UPrimitiveComponent* Surface = Hit.GetComponent();
+    if (!Hit.bBlockingHit || Surface == nullptr)
+        return false;
+
+    // A portal on something that moves would have to follow it
+    if (Cast<APortal>(Hit.GetActor()) != nullptr || Surface->Mobility == EComponentMobility::Movable)
+        return false;
+
+    const FVector2D Extent = GetPortalExtent();
+    if (Extent.IsZero())
+        return false;
+
+    const FVector Normal = Hit.ImpactNormal.GetSafeNormal();
+    FVector Up = FVector::VectorPlaneProject(FVector::UpVector, Normal);
+    if (Up.SizeSquared() < 0.01f)
+    {
+        // Floors and ceilings have no up, the portal faces the way it was shot
+        Up = FVector::VectorPlaneProject(UpHint, Normal);
+    }
+    if (!Up.Normalize())
+        return false;
+
+    const FQuat Rotation = FRotationMatrix::MakeFromXZ(Normal, Up).ToQuat();
+    const FVector Right = Rotation.GetRightVector();
+    FVector Location = Hit.ImpactPoint + Normal * SurfaceOffset;
+
+    // Shots near an edge are slid back onto the surface
+    for (int32 Iteration = 0; Iteration <= MaxFitIterations; Iteration++)
+    {
+        const FTransform Transform(Rotation, Location);
+        FVector2D Push;
+        if (TestFit(Transform, Extent, Ignored, Push))
+        {
+            OutTransform = Transform;
+            return true;
+        }
+        if (Push.IsZero())
+            return false;
+
+        Location += Right * Push.X + Up * Push.Y;
+    }
+    return false;
+}
+
+bool UPortalPlacementSubsystem::TestFit(const FTransform& Transform, const FVector2D& Extent, const APortal* Ignored, FVector2D& OutPush) const
+{
+    OutPush = FVector2D::ZeroVector;
+
+    const FVector Location = Transform.GetLocation();
+    const FVector Normal = Transform.GetUnitAxis(EAxis::X);
+    const FVector Right = Transform.GetUnitAxis(EAxis::Y);
+    const FVector Up = Transform.GetUnitAxis(EAxis::Z);
+
+    // Placed portals have collision, but they sit on the surface and aren't part of it
+    FCollisionQueryParams Params(SCENE_QUERY_STAT(PortalPlacement), false);
+    for (const FPortalPlacementPair& Pair : Pairs)
+    {
+        for (const APortal* Portal : Pair.Portals)
+        {
+            if (Portal != nullptr)
+            {
+                Params.AddIgnoredActor(Portal);
+            }
+        }
+    }
+
+    // Each corner has to be backed by a static surface at the same depth and angle
+    bool bFlat = true;
+    for (int32 Corner = 0; Corner < 4; Corner++)
+    {
+        const float SignX = (Corner & 1) ? 1.f : -1.f;
+        const float SignY = (Corner & 2) ? 1.f : -1.f;
+        const FVector Point = Location + Right * (Extent.X * SignX) + Up * (Extent.Y * SignY);
+
+        FHitResult Hit;
+        const bool bBacked = GetWorld()->LineTraceSingleByChannel(
+                Hit,
+                Point + Normal * FlatnessTolerance,
+                Point - Normal * (SurfaceOffset + FlatnessTolerance),
+                ECC_Visibility,
+                Params)
+            && Hit.GetComponent() != nullptr
+            && Hit.GetComponent()->Mobility != EComponentMobility::Movable
+            && FVector::DotProduct(Hit.ImpactNormal, Normal) > 0.99f;
+        if (!bBacked)
+        {
+            // Away from the corner hanging over the edge, opposite corners cancel out
+            OutPush.X -= SignX * Extent.X * 0.5f;
+            OutPush.Y -= SignY * Extent.Y * 0.5f;
+            bFlat = false;
+        }
+    }
+    if (!bFlat)
+        return false;
+
+    // Nothing may stick out of the surface in front of the portal
+    const FCollisionShape Clearance = FCollisionShape::MakeBox(FVector(ClearanceDepth * 0.5f, Extent.X, Extent.Y));
+    if (GetWorld()->OverlapBlockingTestByChannel(
+            Location + Normal * (FlatnessTolerance + ClearanceDepth * 0.5f),
+            Transform.GetRotation(),
+            ECC_Visibility,
+            Clearance,
+            Params))
+        return false;
+
+    return !OverlapsPlacedPortal(Transform, Extent, Ignored);
+}
+
+bool UPortalPlacementSubsystem::OverlapsPlacedPortal(const FTransform& Transform, const FVector2D& Extent, const APortal* Ignored) const
+{
+    const FVector Location = Transform.GetLocation();
+    const FVector Normal = Transform.GetUnitAxis(EAxis::X);
+    const FVector Right = Transform.GetUnitAxis(EAxis::Y);
+    const FVector Up = Transform.GetUnitAxis(EAxis::Z);
+
+    for (const FPortalPlacementPair& Pair : Pairs)
+    {
+        for (const APortal* Portal : Pair.Portals)
+        {
+            if (Portal == nullptr || Portal == Ignored)
+                continue;
+
+            // Only portals on the same plane can overlap
+            const FVector Delta = Portal->GetActorLocation() - Location;
+            if (FVector::DotProduct(Portal->GetActorForwardVector(), Normal) < 0.99f
+                || FMath::Abs(FVector::DotProduct(Delta, Normal)) > FlatnessTolerance)
+                continue;
+
+            if (FMath::Abs(FVector::DotProduct(Delta, Right)) < Extent.X * 2.f
+                && FMath::Abs(FVector::DotProduct(Delta, Up)) < Extent.Y * 2.f)
+                return true;
+        }
+    }
+    return false;
+}
+
+FVector2D UPortalPlacementSubsystem::GetPortalExtent()
+{
+    if (!PortalExtent.IsZero())
+        return PortalExtent;
+
+    if (Pool.Num() == 0)
+    {
+        SpawnPooledPortal();
+    }
+
+    // Every pooled portal is the same blueprint
+    if (Pool.Num() > 0)
+    {
+        PortalExtent = Pool[0]->GetSurfaceExtent();
+    }
+    return PortalExtent;
+}
@@ -0,0 +1,127 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "PortalPlacementSubsystem.generated.h"
+
+class APortal;
+
+/** The two portals one owner places, linked to each other once both are on a surface */
+USTRUCT()
+struct FPortalPlacementPair
+{
+    GENERATED_BODY()
+
+    TWeakObjectPtr<AActor> Owner;
+
+    UPROPERTY()
+        APortal* Portals[2] = { nullptr, nullptr };
+};
+
+/**
+ * Places portals at runtime, e.g. where a ATowerOfCodePortalProjectile hits a wall.
+ *
+ * Portals come from a pool spawned ahead of time with their capture resources already created,
+ * so placing or moving one is a transform change and a relink, without spawning an actor,
+ * a scene capture or a render target. Portals taken back from their owner return to the pool.
+ *
+ * In a networked game only the server spawns and places the pool. Its portals replicate their slot,
+ * transform, link and parked state, so every client's pool holds the same portals in the same places.
+ */
+UCLASS(config = Game)
+class UPortalPlacementSubsystem : public UWorldSubsystem
+{
+    GENERATED_BODY()
+
+public:
+    UPortalPlacementSubsystem();
+
+    /** Portal blueprint the pool is made of */
+    UPROPERTY(Config)
+        FSoftClassPath PortalClass;
+
+    /** Portals spawned by ReservePool, two per owner placing portals at the same time */
+    UPROPERTY(Config)
+        int32 PoolSize;
+
+    /** Distance from the surface to the placed portal, keeps the surface from showing through */
+    UPROPERTY(Config)
+        float SurfaceOffset;
+
+    /** Largest gap between the surface and the portal's edge that still counts as flat */
+    UPROPERTY(Config)
+        float FlatnessTolerance;
+
+    /** Times a placement hanging over an edge is pushed back onto the surface before giving up */
+    UPROPERTY(Config)
+        int32 MaxFitIterations;
+
+    virtual void Deinitialize() override;
+
+    /** Spawns the pooled portals that are still missing. Call it while loading, placing does it otherwise. */
+    UFUNCTION(BlueprintCallable, Category = Portal)
+        void ReservePool();
+
+    /**
+     * Fits a portal onto the surface of Hit. On floors and ceilings the portal's up axis follows
+     * UpHint, on walls it points up.
+     * @returns false if no spot near the hit has room for the whole portal.
+     */
+    bool FindPlacement(const FHitResult& Hit, const FVector& UpHint, const APortal* Ignored, FTransform& OutTransform);
+
+    /**
+     * Moves Owner's portal PortalIndex, 0 or 1, onto the surface of Hit and links it to the other one.
+     * Only places on the server, clients ask it with ATowerOfCodePortalCharacter::ServerPlacePortal.
+     * @returns the placed portal, or nullptr if the surface doesn't fit a portal.
+     */
+    APortal* PlacePortal(AActor* Owner, int32 PortalIndex, const FHitResult& Hit, const FVector& UpHint);
+
+    /** Returns Owner's portals to the pool */
+    UFUNCTION(BlueprintCallable, Category = Portal)
+        void ClearPortals(AActor* Owner);
+
+    UFUNCTION(BlueprintPure, Category = Portal)
+        int32 GetPooledCount() const { return Pool.Num(); }
+
+    /**
+     * Index a pooled portal keeps for its whole life, in spawn order, or INDEX_NONE for other portals.
+     * Pooled portals are spawned at runtime and have no stable name, so RPCs refer to them by slot.
+     */
+    int32 GetPoolSlot(const APortal* Portal) const;
+
+    /** Pooled portal of Slot, nullptr for an unknown slot */
+    APortal* GetPooledPortal(int32 Slot) const;
+
+    /** Takes a pooled portal replicated from the server into its slot on a client */
+    void AddReplicatedPortal(APortal* Portal);
+
+private:
+    APortal* SpawnPooledPortal();
+    APortal* TakeFromPool();
+    void ReturnToPool(APortal* Portal);
+
+    /**
+     * Whether a portal at Transform lies flat on a static surface with nothing in front of it.
+     * OutPush is the move along the portal's right and up axes back onto the surface, zero if moving won't help.
+     */
+    bool TestFit(const FTransform& Transform, const FVector2D& Extent, const APortal* Ignored, FVector2D& OutPush) const;
+
+    bool OverlapsPlacedPortal(const FTransform& Transform, const FVector2D& Extent, const APortal* Ignored) const;
+
+    /** Half size of a pooled portal's surface */
+    FVector2D GetPortalExtent();
+
+    UPROPERTY(Transient)
+        TArray<APortal*> Pool;
+
+    /** Every pooled portal, in the pool or placed, by slot */
+    UPROPERTY(Transient)
+        TArray<APortal*> Slots;
+
+    UPROPERTY(Transient)
+        TArray<FPortalPlacementPair> Pairs;
+
+    FVector2D PortalExtent = FVector2D::ZeroVector;
+};
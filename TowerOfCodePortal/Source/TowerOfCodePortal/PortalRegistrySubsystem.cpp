@@ -0,0 +1,274 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "PortalRegistrySubsystem.h"
+#include "Portal.h"
+#include "PortalViewExtension.h"
+#include "PortalVisibilitySet.h"
+#include "Async/ParallelFor.h"
+#include "EngineUtils.h"
+
+bool FPortalPairTransform::IntersectSegment(const FVector& Start, const FVector& End, float& OutTime) const
+{
+    // Portals are one-sided, only a segment going from the front to behind the surface teleports
+    const float StartDistance = FVector::DotProduct(Start - Location, Normal);
+    const float EndDistance = FVector::DotProduct(End - Location, Normal);
+    if (StartDistance <= 0.f || EndDistance > 0.f)
+        return false;
+
+    const float Time = StartDistance / (StartDistance - EndDistance);
+    const FVector Offset = FMath::Lerp(Start, End, Time) - Location;
+    if (FMath::Abs(FVector::DotProduct(Offset, Right)) > Extent.X
+        || FMath::Abs(FVector::DotProduct(Offset, Up)) > Extent.Y)
+        return false;
+
+    OutTime = Time;
+    return true;
+}
+
+void UPortalRegistrySubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+    Super::Initialize(Collection);
+
+    ViewExtension = FSceneViewExtensions::NewExtension<FPortalViewExtension>(GetWorld());
+}
+
+void UPortalRegistrySubsystem::Deinitialize()
+{
+    ViewExtension.Reset();
+    Portals.Reset();
+    VisibilitySets.Reset();
+    PortalPairs.Reset();
+    CullingPortals.Reset();
+    CullingActors.Reset();
+    CullingResults.Reset();
+    CullingFrame = 0;
+    bPairsDirty = true;
+
+    Super::Deinitialize();
+}
+
+void UPortalRegistrySubsystem::Register(APortal* Portal)
+{
+    check(IsInGameThread());
+
+    if (Portal == nullptr)
+        return;
+
+    Portals.AddUnique(Portal);
+    bPairsDirty = true;
+}
+
+void UPortalRegistrySubsystem::Unregister(APortal* Portal)
+{
+    check(IsInGameThread());
+
+    if (Portals.RemoveSingleSwap(Portal) > 0)
+    {
+        bPairsDirty = true;
+    }
+}
+
+const TArray<FPortalPairTransform>& UPortalRegistrySubsystem::GetPortalPairs()
+{
+    check(IsInGameThread());
+
+    // Portals can move or be relinked at any time, refreshing once per frame is cheap next to a single sweep
+    if (bPairsDirty || PairsFrame != GFrameCounter)
+    {
+        RebuildPortalPairs();
+    }
+    return PortalPairs;
+}
+
+const FPortalPairTransform* UPortalRegistrySubsystem::FindPortalPair(const APortal* Portal)
+{
+    return GetPortalPairs().FindByPredicate([Portal](const FPortalPairTransform& Pair) { return Pair.Portal == Portal; });
+}
+
+int32 UPortalRegistrySubsystem::FindFirstCrossing(const FVector& Start, const FVector& End, float& OutTime)
+{
+    return FindFirstCrossing(GetPortalPairs(), Start, End, OutTime);
+}
+
+int32 UPortalRegistrySubsystem::FindFirstCrossing(TArrayView<const FPortalPairTransform> Pairs, const FVector& Start, const FVector& End, float& OutTime)
+{
+    int32 FirstIndex = INDEX_NONE;
+    OutTime = 1.f;
+    for (int32 Index = 0; Index < Pairs.Num(); Index++)
+    {
+        float Time;
+        if (Pairs[Index].IntersectSegment(Start, End, Time) && Time <= OutTime)
+        {
+            FirstIndex = Index;
+            OutTime = Time;
+        }
+    }
+    return FirstIndex;
+}
+
+const FPortalCullingResult* UPortalRegistrySubsystem::GetCulling(const APortal* Portal)
+{
+    check(IsInGameThread());
+
+    if (CullingFrame != GFrameCounter)
+    {
+        RunCullingPass();
+    }
+
+    const int32 PortalIndex = CullingPortals.Find(Portal);
+    return PortalIndex != INDEX_NONE ? &CullingResults[PortalIndex] : nullptr;
+}
+
+void UPortalRegistrySubsystem::RunCullingPass()
+{
+    CullingFrame = GFrameCounter;
+    CullingPortals.Reset();
+    CullingPlanes.Reset();
+    CullingResults.Reset();
+    CullingActors.Reset();
+
+    for (const APortal* Portal : Portals)
+    {
+        const APortal* Link = Portal != nullptr ? Portal->Link : nullptr;
+        if (Link == nullptr)
+            continue;
+
+        CullingPortals.Add(Portal);
+        FCullingPlane& Plane = CullingPlanes.AddDefaulted_GetRef();
+        Plane.Location = Link->GetActorLocation();
+        Plane.Normal = Link->GetActorForwardVector();
+        Plane.LocationQuantum = 1.f / FMath::Max(Portal->ReuseLocationTolerance, KINDA_SMALL_NUMBER);
+        Plane.AngleQuantum = 1.f / FMath::Max(Portal->ReuseAngleTolerance, KINDA_SMALL_NUMBER);
+    }
+    CullingResults.SetNum(CullingPortals.Num());
+    if (CullingPortals.Num() == 0)
+        return;
+
+    // Actor and component state is gathered here on the game thread, the jobs below only see copies
+    for (TActorIterator<AActor> It(GetWorld()); It; ++It)
+    {
+        FCullingActor& Entry = CullingActors.AddDefaulted_GetRef();
+        Entry.Actor = *It;
+        FVector Extent;
+        Entry.Actor->GetActorBounds(false, Entry.Origin, Extent);
+        Entry.Radius = Extent.Size();
+        Entry.Location = Entry.Actor->GetActorLocation();
+        Entry.Rotation = Entry.Actor->GetActorRotation();
+        Entry.bMovable = Entry.Actor->IsRootComponentMovable();
+    }
+
+    // One job per portal and block of actors, only doing math on the copies and writing its own output
+    const int32 BlockSize = 256;
+    const int32 BlockCount = FMath::DivideAndRoundUp(CullingActors.Num(), BlockSize);
+    TArray<TArray<AActor*>> BlockHidden;
+    TArray<uint32> BlockSignatures;
+    BlockHidden.SetNum(CullingPlanes.Num() * BlockCount);
+    BlockSignatures.SetNumZeroed(CullingPlanes.Num() * BlockCount);
+
+    ParallelFor(BlockHidden.Num(), [this, BlockSize, BlockCount, &BlockHidden, &BlockSignatures](int32 JobIndex)
+    {
+        const FCullingPlane& Plane = CullingPlanes[JobIndex / BlockCount];
+        const int32 First = (JobIndex % BlockCount) * BlockSize;
+        const int32 Last = FMath::Min(First + BlockSize, CullingActors.Num());
+
+        TArray<AActor*>& Hidden = BlockHidden[JobIndex];
+        uint32 Signature = 0;
+        for (int32 ActorIndex = First; ActorIndex < Last; ActorIndex++)
+        {
+            const FCullingActor& Entry = CullingActors[ActorIndex];
+            const FVector Distance = Entry.Origin - Plane.Location;
+
+            if (Distance.Size() > Entry.Radius && FVector::DotProduct(Plane.Normal, Distance) < 0.f)
+            {
+                Hidden.Add(Entry.Actor);
+            }
+            else if (Entry.bMovable)
+            {
+                // Quantized, so the signature only changes when something visibly moved
+                const FVector Location = Entry.Location * Plane.LocationQuantum;
+                const FRotator Rotation = Entry.Rotation * Plane.AngleQuantum;
+                Signature = HashCombine(Signature, GetTypeHash(Entry.Actor));
+                Signature = HashCombine(Signature, GetTypeHash(FIntVector(FMath::RoundToInt(Location.X), FMath::RoundToInt(Location.Y), FMath::RoundToInt(Location.Z))));
+                Signature = HashCombine(Signature, GetTypeHash(FIntVector(FMath::RoundToInt(Rotation.Pitch), FMath::RoundToInt(Rotation.Yaw), FMath::RoundToInt(Rotation.Roll))));
+            }
+        }
+        BlockSignatures[JobIndex] = Signature;
+    });
+
+    for (int32 PlaneIndex = 0; PlaneIndex < CullingPlanes.Num(); PlaneIndex++)
+    {
+        FPortalCullingResult& Result = CullingResults[PlaneIndex];
+        for (int32 Block = 0; Block < BlockCount; Block++)
+        {
+            const int32 JobIndex = PlaneIndex * BlockCount + Block;
+            Result.HiddenActors.Append(BlockHidden[JobIndex]);
+            Result.SceneSignature = HashCombine(Result.SceneSignature, BlockSignatures[JobIndex]);
+        }
+    }
+}
+
+void UPortalRegistrySubsystem::AddVisibilitySet(APortalVisibilitySet* VisibilitySet)
+{
+    check(IsInGameThread());
+
+    if (VisibilitySet != nullptr)
+    {
+        VisibilitySets.AddUnique(VisibilitySet);
+    }
+}
+
+void UPortalRegistrySubsystem::RemoveVisibilitySet(APortalVisibilitySet* VisibilitySet)
+{
+    check(IsInGameThread());
+
+    VisibilitySets.RemoveSingleSwap(VisibilitySet);
+}
+
+bool UPortalRegistrySubsystem::IsPortalPotentiallyVisible(const APortal* Portal, const FVector& Location) const
+{
+    // Every set answers true for what it wasn't baked for, so any set may reject
+    for (const APortalVisibilitySet* VisibilitySet : VisibilitySets)
+    {
+        if (!VisibilitySet->IsPortalPotentiallyVisible(Portal, Location))
+            return false;
+    }
+    return true;
+}
+
+void UPortalRegistrySubsystem::RebuildPortalPairs()
+{
+    PortalPairs.Reset();
+
+    for (APortal* Portal : Portals)
+    {
+        APortal* Link = Portal != nullptr ? Portal->GetLink() : nullptr;
+        if (Link == nullptr)
+            continue;
+
+        FPortalPairTransform& Pair = PortalPairs.AddDefaulted_GetRef();
+        Pair.Portal = Portal;
+        Pair.Link = Link;
+        Pair.Location = Portal->GetActorLocation();
+        Pair.Normal = Portal->GetActorForwardVector();
+        Pair.Right = Portal->GetActorRightVector();
+        Pair.Up = Portal->GetActorUpVector();
+        Pair.Extent = Portal->GetSurfaceExtent();
+
+        // Express the offset in the portal basis, then rebuild it in the mirrored basis of the link
+        const FMatrix PortalBasis = FMatrix(Pair.Normal, Pair.Right, Pair.Up, FVector::ZeroVector);
+        const FMatrix OppositeBasis = FMatrix(
+            -Link->GetActorForwardVector(),
+            -Link->GetActorRightVector(),
+            Link->GetActorUpVector(),
+            FVector::ZeroVector);
+
+        Pair.ToLink = FTranslationMatrix(-Pair.Location)
+            * PortalBasis.Inverse()
+            * OppositeBasis
+            * FTranslationMatrix(Link->GetActorLocation());
+    }
+
+    PairsFrame = GFrameCounter;
+    bPairsDirty = false;
+}
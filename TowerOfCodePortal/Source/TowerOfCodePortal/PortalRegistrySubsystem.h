@@ -0,0 +1,139 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "PortalRegistrySubsystem.generated.h"
+
+class APortal;
+class APortalVisibilitySet;
+class FPortalViewExtension;
+
+/** Surface quad of a linked portal and the transform carrying points and directions to its link */
+struct FPortalPairTransform
+{
+    const APortal* Portal = nullptr;
+    const APortal* Link = nullptr;
+
+    FVector Location = FVector::ZeroVector;
+    FVector Normal = FVector::ForwardVector;
+    FVector Right = FVector::RightVector;
+    FVector Up = FVector::UpVector;
+
+    /** Half size of the surface along Right and Up */
+    FVector2D Extent = FVector2D::ZeroVector;
+
+    /** Maps world space in front of Portal to world space in front of Link, same as APortal::ConvertVectorToOppositeSpace */
+    FMatrix ToLink = FMatrix::Identity;
+
+    /**
+     * Analytic test of a segment entering the portal from its front side.
+     * @returns true with OutTime in [0, 1] if the segment crosses the surface quad.
+     */
+    bool IntersectSegment(const FVector& Start, const FVector& End, float& OutTime) const;
+};
+
+/** Culling of one portal's captures, shared by all its viewers and recursion levels for a frame */
+struct FPortalCullingResult
+{
+    /** Actors behind the link, which the captures must not show */
+    TArray<AActor*> HiddenActors;
+
+    /** Hash of where the movable actors in front of the link are, see APortal::bReuseCaptures */
+    uint32 SceneSignature = 0;
+};
+
+/**
+ * Keeps track of the portals of a world together with their cached pair transforms,
+ * so systems that follow things through portals don't have to walk the actor list
+ * or rebuild the portal bases per query.
+ */
+UCLASS()
+class UPortalRegistrySubsystem : public UWorldSubsystem
+{
+    GENERATED_BODY()
+
+public:
+    virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+    virtual void Deinitialize() override;
+
+    void Register(APortal* Portal);
+    void Unregister(APortal* Portal);
+
+    const TArray<APortal*>& GetPortals() const { return Portals; }
+
+    /** Linked portals, refreshed at most once per frame. Game thread only. */
+    const TArray<FPortalPairTransform>& GetPortalPairs();
+
+    /** Entry of GetPortalPairs starting at Portal, nullptr if it isn't linked */
+    const FPortalPairTransform* FindPortalPair(const APortal* Portal);
+
+    /** Forces the next GetPortalPairs and GetCulling calls to rebuild, e.g. after a portal moved or was relinked */
+    void MarkDirty() { bPairsDirty = true; CullingFrame = 0; }
+
+    /**
+     * Earliest portal the segment enters.
+     * @returns the index in GetPortalPairs, or INDEX_NONE.
+     */
+    int32 FindFirstCrossing(const FVector& Start, const FVector& End, float& OutTime);
+
+    /** Same as above against a copy of the pairs, safe on any thread */
+    static int32 FindFirstCrossing(TArrayView<const FPortalPairTransform> Pairs, const FVector& Start, const FVector& End, float& OutTime);
+
+    /**
+     * Culling of Portal's captures for this frame. The first call of a frame gathers every actor's
+     * bounds on the game thread, then classifies them against all link planes at once, in parallel.
+     * @returns nullptr if Portal is not registered or not linked.
+     */
+    const FPortalCullingResult* GetCulling(const APortal* Portal);
+
+    void AddVisibilitySet(APortalVisibilitySet* VisibilitySet);
+    void RemoveVisibilitySet(APortalVisibilitySet* VisibilitySet);
+
+    /** Whether the baked visibility sets allow Portal to be seen from Location, true without baked data */
+    bool IsPortalPotentiallyVisible(const APortal* Portal, const FVector& Location) const;
+
+private:
+    void RebuildPortalPairs();
+    void RunCullingPass();
+
+    UPROPERTY(Transient)
+        TArray<APortal*> Portals;
+
+    UPROPERTY(Transient)
+        TArray<APortalVisibilitySet*> VisibilitySets;
+
+    TArray<FPortalPairTransform> PortalPairs;
+    uint64 PairsFrame = 0;
+
+    TSharedPtr<FPortalViewExtension, ESPMode::ThreadSafe> ViewExtension;
+    bool bPairsDirty = true;
+
+    /** Link plane of a portal and the tolerances its scene signature is quantized with */
+    struct FCullingPlane
+    {
+        FVector Location;
+        FVector Normal;
+        float LocationQuantum;
+        float AngleQuantum;
+    };
+
+    /** Actor data gathered once per pass, laid out for the classification */
+    struct FCullingActor
+    {
+        AActor* Actor;
+        FVector Origin;
+        /** Length of the bounds extent */
+        float Radius;
+        FVector Location;
+        FRotator Rotation;
+        bool bMovable;
+    };
+
+    TArray<const APortal*> CullingPortals;
+    TArray<FCullingPlane> CullingPlanes;
+    TArray<FCullingActor> CullingActors;
+    TArray<FPortalCullingResult> CullingResults;
+    uint64 CullingFrame = 0;
+};
@@ -0,0 +1,267 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "PortalRenderTargetSubsystem.h"
+#include "Portal.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogPortalRenderTargets, Log, All);
+
+UPortalRenderTargetSubsystem::UPortalRenderTargetSubsystem()
+{
+    BudgetMB = 256;
+    EvictionDelay = 1.f;
+    MinDowngradeSize = 256;
+}
+
+void UPortalRenderTargetSubsystem::Deinitialize()
+{
+    for (const FPortalRenderTargetLease& Lease : Leases)
+    {
+        FreeTarget(Lease.Target);
+    }
+    for (UTextureRenderTarget2D* Target : Pool)
+    {
+        FreeTarget(Target);
+    }
+    Leases.Reset();
+    Pool.Reset();
+    UsedBytes = 0;
+
+    Super::Deinitialize();
+}
+
+UTextureRenderTarget2D* UPortalRenderTargetSubsystem::Acquire(APortal* Owner, FIntPoint Size, ETextureRenderTargetFormat Format, bool bAllowDowngrade)
+{
+    check(IsInGameThread());
+
+    FIntPoint BucketSize = GetBucketSize(Size);
+    ETextureRenderTargetFormat BucketFormat = Format;
+
+    while (true)
+    {
+        if (UTextureRenderTarget2D* Pooled = LeasePooled(Owner, BucketSize, BucketFormat))
+            return Pooled;
+
+        if (MakeRoom(GetTargetBytes(BucketSize.X, BucketSize.Y, BucketFormat), Owner))
+            return LeaseNew(Owner, BucketSize, BucketFormat);
+
+        if (!bAllowDowngrade)
+            break;
+
+        // Precision goes first, a blurry portal is more noticeable than some banding
+        ETextureRenderTargetFormat CheaperFormat;
+        if (GetCheaperFormat(BucketFormat, CheaperFormat))
+        {
+            BucketFormat = CheaperFormat;
+        }
+        else if (FMath::Min(BucketSize.X, BucketSize.Y) / 2 >= MinDowngradeSize)
+        {
+            BucketSize = GetBucketSize(BucketSize / 2);
+        }
+        else
+        {
+            break;
+        }
+    }
+
+    UE_LOG(LogPortalRenderTargets, Warning, TEXT("%s gets no render target, %.1f of %d MB in use"),
+        *GetNameSafe(Owner), GetUsedMB(), BudgetMB);
+    return nullptr;
+}
+
+void UPortalRenderTargetSubsystem::Release(UTextureRenderTarget2D* Target)
+{
+    check(IsInGameThread());
+
+    const int32 LeaseIndex = Leases.IndexOfByPredicate([Target](const FPortalRenderTargetLease& Lease) { return Lease.Target == Target; });
+    if (LeaseIndex == INDEX_NONE)
+        return;
+
+    Leases.RemoveAtSwap(LeaseIndex);
+    Pool.Add(Target);
+
+    // The pool only keeps what still fits, another portal may have been waiting for the memory
+    MakeRoom(0, nullptr);
+}
+
+void UPortalRenderTargetSubsystem::MarkVisible(UTextureRenderTarget2D* Target)
+{
+    for (FPortalRenderTargetLease& Lease : Leases)
+    {
+        if (Lease.Target == Target)
+        {
+            Lease.LastVisibleTime = GetWorld()->GetTimeSeconds();
+            return;
+        }
+    }
+}
+
+void UPortalRenderTargetSubsystem::SetBudgetMB(int32 NewBudgetMB)
+{
+    BudgetMB = FMath::Max(0, NewBudgetMB);
+    MakeRoom(0, nullptr);
+}
+
+int64 UPortalRenderTargetSubsystem::GetTargetBytes(int32 SizeX, int32 SizeY, ETextureRenderTargetFormat Format)
+{
+    int32 BytesPerPixel = 4;
+    switch (Format)
+    {
+    case RTF_R8:
+        BytesPerPixel = 1;
+        break;
+    case RTF_RG8:
+    case RTF_R16f:
+        BytesPerPixel = 2;
+        break;
+    case RTF_RG16f:
+    case RTF_R32f:
+    case RTF_RGBA8:
+    case RTF_RGBA8_SRGB:
+    case RTF_RGB10A2:
+        BytesPerPixel = 4;
+        break;
+    case RTF_RG32f:
+    case RTF_RGBA16f:
+        BytesPerPixel = 8;
+        break;
+    case RTF_RGBA32f:
+        BytesPerPixel = 16;
+        break;
+    default:
+        break;
+    }
+    return int64(SizeX) * SizeY * BytesPerPixel;
+}
+
+UTextureRenderTarget2D* UPortalRenderTargetSubsystem::LeasePooled(APortal* Owner, FIntPoint Size, ETextureRenderTargetFormat Format)
+{
+    for (int32 PoolIndex = 0; PoolIndex < Pool.Num(); PoolIndex++)
+    {
+        UTextureRenderTarget2D* Target = Pool[PoolIndex];
+        if (Target->SizeX == Size.X && Target->SizeY == Size.Y && Target->RenderTargetFormat == Format)
+        {
+            Pool.RemoveAt(PoolIndex);
+            AddLease(Owner, Target);
+            return Target;
+        }
+    }
+    return nullptr;
+}
+
+UTextureRenderTarget2D* UPortalRenderTargetSubsystem::LeaseNew(APortal* Owner, FIntPoint Size, ETextureRenderTargetFormat Format)
+{
+    UTextureRenderTarget2D* NewTarget = NewObject<UTextureRenderTarget2D>(this);
+    check(NewTarget);
+
+    NewTarget->RenderTargetFormat = Format;
+    NewTarget->Filter = TextureFilter::TF_Bilinear;
+    NewTarget->SizeX = Size.X;
+    NewTarget->SizeY = Size.Y;
+    NewTarget->ClearColor = FLinearColor::Black;
+    NewTarget->TargetGamma = 2.2f;
+    NewTarget->bNeedsTwoCopies = false;
+    NewTarget->AddressX = TextureAddress::TA_Clamp;
+    NewTarget->AddressY = TextureAddress::TA_Clamp;
+
+    // Not needed since the texture is displayed on screen directly
+    // in some engine versions this can even lead to crashes (notably 4.24/4.25)
+    NewTarget->bAutoGenerateMips = false;
+
+    // This force the engine to create the render target
+    // with the parameters we defined just above
+    NewTarget->UpdateResource();
+
+    UsedBytes += GetTargetBytes(Size.X, Size.Y, Format);
+    AddLease(Owner, NewTarget);
+    return NewTarget;
+}
+
+FPortalRenderTargetLease& UPortalRenderTargetSubsystem::AddLease(APortal* Owner, UTextureRenderTarget2D* Target)
+{
+    FPortalRenderTargetLease& Lease = Leases.AddDefaulted_GetRef();
+    Lease.Target = Target;
+    Lease.Owner = Owner;
+    Lease.LastVisibleTime = GetWorld()->GetTimeSeconds();
+    return Lease;
+}
+
+bool UPortalRenderTargetSubsystem::MakeRoom(int64 Bytes, const APortal* Requester)
+{
+    const int64 BudgetBytes = GetBudgetBytes();
+
+    // Idle targets go first, oldest first
+    while (UsedBytes + Bytes > BudgetBytes && Pool.Num() > 0)
+    {
+        FreeTarget(Pool[0]);
+        Pool.RemoveAt(0);
+    }
+
+    const float EvictBefore = GetWorld()->GetTimeSeconds() - EvictionDelay;
+    while (UsedBytes + Bytes > BudgetBytes)
+    {
+        int32 OldestIndex = INDEX_NONE;
+        for (int32 LeaseIndex = 0; LeaseIndex < Leases.Num(); LeaseIndex++)
+        {
+            const FPortalRenderTargetLease& Lease = Leases[LeaseIndex];
+            const APortal* Owner = Lease.Owner.Get();
+            if (Owner == Requester || Lease.LastVisibleTime > EvictBefore)
+                continue;
+
+            // Parked pooled portals are never seen, their target is kept for the next placement
+            if (Owner != nullptr && Owner->IsParked())
+                continue;
+
+            if (OldestIndex == INDEX_NONE || Lease.LastVisibleTime < Leases[OldestIndex].LastVisibleTime)
+            {
+                OldestIndex = LeaseIndex;
+            }
+        }
+        if (OldestIndex == INDEX_NONE)
+            return false;
+
+        const FPortalRenderTargetLease Evicted = Leases[OldestIndex];
+        Leases.RemoveAtSwap(OldestIndex);
+        if (APortal* Owner = Evicted.Owner.Get())
+        {
+            Owner->OnRenderTargetEvicted(Evicted.Target);
+        }
+        FreeTarget(Evicted.Target);
+    }
+    return true;
+}
+
+void UPortalRenderTargetSubsystem::FreeTarget(UTextureRenderTarget2D* Target)
+{
+    if (Target == nullptr)
+        return;
+
+    UsedBytes -= GetTargetBytes(Target->SizeX, Target->SizeY, Target->RenderTargetFormat);
+
+    // Frees the GPU memory now rather than whenever the object is garbage collected
+    Target->ReleaseResource();
+}
+
+FIntPoint UPortalRenderTargetSubsystem::GetBucketSize(FIntPoint Size)
+{
+    // Rounding up to a coarse step lets portals of slightly different sizes share targets
+    const int32 Step = 128;
+    return FIntPoint(
+        FMath::Max(Step, FMath::DivideAndRoundUp(Size.X, Step) * Step),
+        FMath::Max(Step, FMath::DivideAndRoundUp(Size.Y, Step) * Step));
+}
+
+bool UPortalRenderTargetSubsystem::GetCheaperFormat(ETextureRenderTargetFormat Format, ETextureRenderTargetFormat& OutFormat)
+{
+    switch (Format)
+    {
+    case RTF_RGBA32f:
+        OutFormat = RTF_RGBA16f;
+        return true;
+    case RTF_RGBA16f:
+        OutFormat = RTF_RGB10A2;
+        return true;
+    default:
+        return false;
+    }
+}
@@ -0,0 +1,108 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/TextureRenderTarget2D.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "PortalRenderTargetSubsystem.generated.h"
+
+class APortal;
+
+/** Render target handed out to a portal */
+USTRUCT()
+struct FPortalRenderTargetLease
+{
+    GENERATED_BODY()
+
+    UPROPERTY()
+        UTextureRenderTarget2D* Target = nullptr;
+
+    TWeakObjectPtr<APortal> Owner;
+
+    /** World time the owner last looked through the target */
+    float LastVisibleTime = 0.f;
+};
+
+/**
+ * Hands out the render targets of all portals of a world from pools bucketed by size and format,
+ * and keeps their total memory under BudgetMB.
+ *
+ * When a new target doesn't fit, idle pooled targets are freed first, then the targets of portals
+ * nobody looked through for EvictionDelay seconds, least recently visible first. Parked pooled portals
+ * keep theirs. Evicted portals get APortal::OnRenderTargetEvicted and lease again once they are visible.
+ * If that still isn't enough, the request is downgraded to a cheaper format, then to a lower resolution.
+ */
+UCLASS(config = Game)
+class UPortalRenderTargetSubsystem : public UWorldSubsystem
+{
+    GENERATED_BODY()
+
+public:
+    UPortalRenderTargetSubsystem();
+
+    /** Memory all portal render targets may use together, leased and pooled */
+    UPROPERTY(Config)
+        int32 BudgetMB;
+
+    /** Seconds a portal has to be out of sight before its target can be evicted */
+    UPROPERTY(Config)
+        float EvictionDelay;
+
+    /** Downgraded targets are not made smaller than this along either axis */
+    UPROPERTY(Config)
+        int32 MinDowngradeSize;
+
+    virtual void Deinitialize() override;
+
+    /**
+     * Leases a target of at least Size, rounded up to the pool bucket.
+     * @returns nullptr if even the cheapest allowed target doesn't fit the budget.
+     */
+    UTextureRenderTarget2D* Acquire(APortal* Owner, FIntPoint Size, ETextureRenderTargetFormat Format, bool bAllowDowngrade);
+
+    /** Gives a leased target back to the pool */
+    void Release(UTextureRenderTarget2D* Target);
+
+    /** Records that the owner of Target is being looked through, keeping it from being evicted */
+    void MarkVisible(UTextureRenderTarget2D* Target);
+
+    UFUNCTION(BlueprintCallable, Category = Portal)
+        void SetBudgetMB(int32 NewBudgetMB);
+
+    /** Memory of the leased and pooled targets */
+    int64 GetUsedBytes() const { return UsedBytes; }
+    int64 GetBudgetBytes() const { return int64(BudgetMB) * 1024 * 1024; }
+
+    UFUNCTION(BlueprintPure, Category = Portal)
+        float GetUsedMB() const { return UsedBytes / (1024.f * 1024.f); }
+
+    UFUNCTION(BlueprintPure, Category = Portal)
+        int32 GetLeaseCount() const { return Leases.Num(); }
+
+    UFUNCTION(BlueprintPure, Category = Portal)
+        int32 GetPooledCount() const { return Pool.Num(); }
+
+    static int64 GetTargetBytes(int32 SizeX, int32 SizeY, ETextureRenderTargetFormat Format);
+
+private:
+    UTextureRenderTarget2D* LeasePooled(APortal* Owner, FIntPoint Size, ETextureRenderTargetFormat Format);
+    UTextureRenderTarget2D* LeaseNew(APortal* Owner, FIntPoint Size, ETextureRenderTargetFormat Format);
+    FPortalRenderTargetLease& AddLease(APortal* Owner, UTextureRenderTarget2D* Target);
+
+    /** Frees pooled and evictable targets until Bytes more fit, returns whether they do */
+    bool MakeRoom(int64 Bytes, const APortal* Requester);
+    void FreeTarget(UTextureRenderTarget2D* Target);
+
+    static FIntPoint GetBucketSize(FIntPoint Size);
+    static bool GetCheaperFormat(ETextureRenderTargetFormat Format, ETextureRenderTargetFormat& OutFormat);
+
+    UPROPERTY(Transient)
+        TArray<FPortalRenderTargetLease> Leases;
+
+    /** Released targets waiting for an owner, oldest first */
+    UPROPERTY(Transient)
+        TArray<UTextureRenderTarget2D*> Pool;
+
+    int64 UsedBytes = 0;
+};
@@ -0,0 +1,122 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "PortalStereoMaterial.h"
+
+#if WITH_EDITOR
+
+#include "Portal.h"
+#include "HAL/IConsoleManager.h"
+#include "Materials/Material.h"
+#include "Materials/MaterialExpressionCustom.h"
+#include "Materials/MaterialExpressionScalarParameter.h"
+#include "Materials/MaterialExpressionScreenPosition.h"
+#include "Materials/MaterialExpressionTextureSampleParameter2D.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogPortalStereoMaterial, Log, All);
+
+namespace
+{
+    /** Marks the custom expression, so running the step again doesn't add a second one */
+    const TCHAR* EyeSelectionDescription = TEXT("PortalEyeSelection");
+
+    /** Instanced stereo resolves the view per eye, so StereoPassIndex is 0 for the left eye and 1 for the right one */
+    const TCHAR* EyeSelectionCode = TEXT("return Layout > 0.5f ? float2(UV.x * 0.5f + ResolvedView.StereoPassIndex * 0.5f, UV.y) : UV;");
+
+    template<typename ExpressionType>
+    ExpressionType* AddExpression(UMaterial* Material, const UMaterialExpression* NextTo, int32 OffsetX, int32 OffsetY)
+    {
+        ExpressionType* Expression = NewObject<ExpressionType>(Material, NAME_None, RF_Transactional);
+        Expression->Material = Material;
+        Expression->MaterialExpressionEditorX = NextTo->MaterialExpressionEditorX + OffsetX;
+        Expression->MaterialExpressionEditorY = NextTo->MaterialExpressionEditorY + OffsetY;
+        Material->Expressions.Add(Expression);
+        return Expression;
+    }
+
+    void AddEyeSelectionCommand(const TArray<FString>& Args)
+    {
+        const FString Path = Args.Num() > 0 ? Args[0] : TEXT("/Game/FirstPersonCPP/Blueprints/MPortalBase");
+        UMaterial* Material = LoadObject<UMaterial>(nullptr, *Path);
+        if (Material == nullptr)
+        {
+            UE_LOG(LogPortalStereoMaterial, Error, TEXT("Material %s not found"), *Path);
+            return;
+        }
+
+        const APortal* Defaults = GetDefault<APortal>();
+        if (PortalStereoMaterial::AddEyeSelection(Material, Defaults->SurfaceTextureParameter, Defaults->StereoLayoutParameter))
+        {
+            UE_LOG(LogPortalStereoMaterial, Log, TEXT("%s samples the eye's half of side-by-side targets, save it to keep the change"), *Path);
+        }
+    }
+
+    FAutoConsoleCommand AddEyeSelectionConsoleCommand(
+        TEXT("Portal.AddStereoEyeSelection"),
+        TEXT("Makes a portal surface material sample its eye's half of a side-by-side stereo target. Argument: material path, MPortalBase by default."),
+        FConsoleCommandWithArgsDelegate::CreateStatic(&AddEyeSelectionCommand));
+}
+
+bool PortalStereoMaterial::AddEyeSelection(UMaterial* Material, FName TextureParameter, FName LayoutParameter)
+{
+    if (Material == nullptr)
+        return false;
+
+    UMaterialExpressionTextureSampleParameter2D* Sample = nullptr;
+    UMaterialExpressionScalarParameter* Layout = nullptr;
+    for (UMaterialExpression* Expression : Material->Expressions)
+    {
+        const UMaterialExpressionCustom* Custom = Cast<UMaterialExpressionCustom>(Expression);
+        if (Custom != nullptr && Custom->Description == EyeSelectionDescription)
+            return true;
+
+        UMaterialExpressionTextureSampleParameter2D* TextureExpression = Cast<UMaterialExpressionTextureSampleParameter2D>(Expression);
+        if (TextureExpression != nullptr && TextureExpression->ParameterName == TextureParameter)
+        {
+            Sample = TextureExpression;
+        }
+        UMaterialExpressionScalarParameter* ScalarExpression = Cast<UMaterialExpressionScalarParameter>(Expression);
+        if (ScalarExpression != nullptr && ScalarExpression->ParameterName == LayoutParameter)
+        {
+            Layout = ScalarExpression;
+        }
+    }
+
+    if (Sample == nullptr)
+    {
+        UE_LOG(LogPortalStereoMaterial, Error, TEXT("%s has no texture parameter %s"), *Material->GetPathName(), *TextureParameter.ToString());
+        return false;
+    }
+
+    // The sample keeps the UVs it had, portal surfaces usually sample at their screen position
+    FExpressionInput UV = Sample->Coordinates;
+    if (UV.Expression == nullptr)
+    {
+        UV.Connect(0, AddExpression<UMaterialExpressionScreenPosition>(Material, Sample, -600, 0));
+    }
+
+    if (Layout == nullptr)
+    {
+        Layout = AddExpression<UMaterialExpressionScalarParameter>(Material, Sample, -600, 150);
+        Layout->ParameterName = LayoutParameter;
+        Layout->DefaultValue = 0.f;
+    }
+
+    UMaterialExpressionCustom* Custom = AddExpression<UMaterialExpressionCustom>(Material, Sample, -300, 0);
+    Custom->Description = EyeSelectionDescription;
+    Custom->Code = EyeSelectionCode;
+    Custom->OutputType = CMOT_Float2;
+    Custom->Inputs.SetNum(2);
+    Custom->Inputs[0].InputName = TEXT("UV");
+    Custom->Inputs[0].Input = UV;
+    Custom->Inputs[1].InputName = TEXT("Layout");
+    Custom->Inputs[1].Input.Connect(0, Layout);
+
+    Material->PreEditChange(nullptr);
+    Sample->Coordinates.Connect(0, Custom);
+    Material->PostEditChange();
+    Material->MarkPackageDirty();
+    return true;
+}
+
+#endif
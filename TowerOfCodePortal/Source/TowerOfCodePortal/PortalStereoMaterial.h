@@ -0,0 +1,28 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#if WITH_EDITOR
+
+class UMaterial;
+
+/**
+ * Editor step that makes a portal surface material work with APortal::bStereoCapture.
+ * The material's texture parameter then samples the current eye's half of a side-by-side target
+ * while the StereoLayout scalar is 1, and the full target otherwise.
+ *
+ * Run it once from the editor console, then save the material:
+ * "Portal.AddStereoEyeSelection /Game/FirstPersonCPP/Blueprints/MPortalBase"
+ */
+namespace PortalStereoMaterial
+{
+    /**
+     * Puts the eye selection between TextureParameter's sample and its UVs, or screen UVs if it has none.
+     * @returns false if Material has no such texture parameter. Materials that already have it are left as they are.
+     */
+    TOWEROFCODEPORTAL_API bool AddEyeSelection(UMaterial* Material, FName TextureParameter, FName LayoutParameter);
+}
+
+#endif
@@ -0,0 +1,197 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "PortalTraceLibrary.h"
+#include "Portal.h"
+#include "PortalRegistrySubsystem.h"
+#include "Async/ParallelFor.h"
+#include "Engine/World.h"
+
+namespace
+{
+    /** How far a trace may end from the target, transforms through several portals add up float error */
+    const float TargetTolerance = 5.f;
+
+    bool TraceRequest(const UObject* WorldContextObject, const FPortalTraceRequest& Request, FPortalTraceResult& OutResult)
+    {
+        TArray<FPortalTraceResult> Results;
+        UPortalTraceLibrary::PortalTraceBatch(WorldContextObject, { Request }, Results);
+        OutResult = Results.Num() > 0 ? Results[0] : FPortalTraceResult();
+        return OutResult.bBlockingHit;
+    }
+}
+
+bool UPortalTraceLibrary::PortalLineTrace(const UObject* WorldContextObject, FVector Start, FVector End, ECollisionChannel TraceChannel, const TArray<AActor*>& ActorsToIgnore, int32 MaxPortalHops, FPortalTraceResult& OutResult)
+{
+    FPortalTraceRequest Request;
+    Request.Start = Start;
+    Request.End = End;
+    Request.TraceChannel = TraceChannel;
+    Request.ActorsToIgnore = ActorsToIgnore;
+    Request.MaxPortalHops = MaxPortalHops;
+    return TraceRequest(WorldContextObject, Request, OutResult);
+}
+
+bool UPortalTraceLibrary::PortalSphereTrace(const UObject* WorldContextObject, FVector Start, FVector End, float Radius, ECollisionChannel TraceChannel, const TArray<AActor*>& ActorsToIgnore, int32 MaxPortalHops, FPortalTraceResult& OutResult)
+{
+    FPortalTraceRequest Request;
+    Request.Start = Start;
+    Request.End = End;
+    Request.Radius = Radius;
+    Request.TraceChannel = TraceChannel;
+    Request.ActorsToIgnore = ActorsToIgnore;
+    Request.MaxPortalHops = MaxPortalHops;
+    return TraceRequest(WorldContextObject, Request, OutResult);
+}
+
+void UPortalTraceLibrary::PortalTraceBatch(const UObject* WorldContextObject, const TArray<FPortalTraceRequest>& Requests, TArray<FPortalTraceResult>& OutResults)
+{
+    OutResults.Reset();
+    OutResults.SetNum(Requests.Num());
+
+    UWorld* World = GEngine->GetWorldFromContextObject(WorldContextObject, EGetWorldErrorMode::LogAndReturnNull);
+    if (World == nullptr)
+        return;
+
+    // The pairs are read on the game thread, the workers only see this copy
+    TArray<FPortalPairTransform> Pairs;
+    if (UPortalRegistrySubsystem* Registry = World->GetSubsystem<UPortalRegistrySubsystem>())
+    {
+        Pairs = Registry->GetPortalPairs();
+    }
+
+    // A single trace isn't worth waking the workers for
+    ParallelFor(Requests.Num(), [World, &Pairs, &Requests, &OutResults](int32 Index)
+    {
+        TraceThroughPortals(World, Pairs, Requests[Index], OutResults[Index]);
+    }, Requests.Num() < 2);
+}
+
+bool UPortalTraceLibrary::HasPortalLineOfSight(const UObject* WorldContextObject, FVector From, AActor* To, const TArray<AActor*>& ActorsToIgnore, int32 MaxPortalHops)
+{
+    UWorld* World = GEngine->GetWorldFromContextObject(WorldContextObject, EGetWorldErrorMode::LogAndReturnNull);
+    if (World == nullptr || To == nullptr)
+        return false;
+
+    const FVector Target = To->GetActorLocation();
+
+    // The direct line may not pass any portal, it would end somewhere else
+    TArray<FPortalTraceRequest> Requests;
+    FPortalTraceRequest& Direct = Requests.AddDefaulted_GetRef();
+    Direct.Start = From;
+    Direct.End = Target;
+    Direct.ActorsToIgnore = ActorsToIgnore;
+    Direct.MaxPortalHops = 0;
+
+    // Then the image of the target through every chain of up to MaxPortalHops portals. Each request
+    // may only take as many hops as its chain, so it either follows the chain or is cut short.
+    if (UPortalRegistrySubsystem* Registry = World->GetSubsystem<UPortalRegistrySubsystem>())
+    {
+        const TArray<FPortalPairTransform>& Pairs = Registry->GetPortalPairs();
+        TFunction<void(const FVector&, int32)> AddImages = [&](const FVector& Point, int32 Hops)
+        {
+            if (Hops >= MaxPortalHops)
+                return;
+
+            for (const FPortalPairTransform& Pair : Pairs)
+            {
+                // Point is seen through Pair when it is behind Pair once mapped back from Pair's link
+                const FVector Image = Pair.ToLink.InverseTransformPosition(Point);
+                if (FVector::DotProduct(Image - Pair.Location, Pair.Normal) >= 0.f)
+                    continue;
+
+                if (FVector::DotProduct(From - Pair.Location, Pair.Normal) > 0.f)
+                {
+                    FPortalTraceRequest& Request = Requests.Add_GetRef(Direct);
+                    Request.End = Image;
+                    Request.MaxPortalHops = Hops + 1;
+                }
+                AddImages(Image, Hops + 1);
+            }
+        };
+        AddImages(Target, 0);
+    }
+
+    TArray<FPortalTraceResult> Results;
+    PortalTraceBatch(WorldContextObject, Requests, Results);
+
+    for (int32 Index = 0; Index < Results.Num(); Index++)
+    {
+        const FPortalTraceResult& Result = Results[Index];
+        if (Result.bHopLimitReached || Result.Hops.Num() != Requests[Index].MaxPortalHops)
+            continue;
+
+        // Either To blocks the line itself, or the line arrives where To is
+        if (Result.bBlockingHit ? Result.HitResult.GetActor() == To : FVector::Dist(Result.EndLocation, Target) <= TargetTolerance)
+            return true;
+    }
+    return false;
+}
+
+void UPortalTraceLibrary::TraceThroughPortals(const UWorld* World, TArrayView<const FPortalPairTransform> Pairs, const FPortalTraceRequest& Request, FPortalTraceResult& OutResult)
+{
+    OutResult = FPortalTraceResult();
+
+    const FCollisionShape Shape = Request.Radius > 0.f
+        ? FCollisionShape::MakeSphere(Request.Radius)
+        : FCollisionShape();
+
+    // Portals teleport by overlap, so their own collision must not stop the trace
+    FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(PortalTrace), false);
+    QueryParams.AddIgnoredActors(Request.ActorsToIgnore);
+    for (const FPortalPairTransform& Pair : Pairs)
+    {
+        QueryParams.AddIgnoredActor(Pair.Portal);
+    }
+
+    FVector SegmentStart = Request.Start;
+    FVector Direction = Request.End - Request.Start;
+    float Remaining = Direction.Size();
+    Direction = Direction.GetSafeNormal();
+
+    while (true)
+    {
+        FVector SegmentEnd = SegmentStart + Direction * Remaining;
+
+        // Only trace up to the surface of the first portal on the way
+        float PortalTime = 1.f;
+        const int32 PortalIndex = UPortalRegistrySubsystem::FindFirstCrossing(Pairs, SegmentStart, SegmentEnd, PortalTime);
+        if (PortalIndex != INDEX_NONE)
+        {
+            SegmentEnd = FMath::Lerp(SegmentStart, SegmentEnd, PortalTime);
+        }
+
+        FHitResult Hit;
+        if (World->SweepSingleByChannel(Hit, SegmentStart, SegmentEnd, FQuat::Identity, Request.TraceChannel, Shape, QueryParams))
+        {
+            OutResult.bBlockingHit = true;
+            OutResult.HitResult = Hit;
+            OutResult.EndLocation = Hit.Location;
+            OutResult.Distance += FVector::Dist(SegmentStart, Hit.Location);
+            return;
+        }
+
+        const float SegmentLength = FVector::Dist(SegmentStart, SegmentEnd);
+        OutResult.Distance += SegmentLength;
+        OutResult.EndLocation = SegmentEnd;
+        if (PortalIndex == INDEX_NONE)
+            return;
+
+        if (OutResult.Hops.Num() >= Request.MaxPortalHops)
+        {
+            OutResult.bHopLimitReached = true;
+            return;
+        }
+
+        const FPortalPairTransform& Pair = Pairs[PortalIndex];
+        FPortalTraceHop& Hop = OutResult.Hops.AddDefaulted_GetRef();
+        Hop.Portal = const_cast<APortal*>(Pair.Portal);
+        Hop.EntryLocation = SegmentEnd;
+        Hop.ExitLocation = Pair.ToLink.TransformPosition(SegmentEnd);
+        Hop.ExitDirection = Pair.ToLink.TransformVector(Direction).GetSafeNormal();
+
+        SegmentStart = Hop.ExitLocation;
+        Direction = Hop.ExitDirection;
+        Remaining -= SegmentLength;
+    }
+}
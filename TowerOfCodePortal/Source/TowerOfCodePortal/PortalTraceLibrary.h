@@ -0,0 +1,126 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Kismet/BlueprintFunctionLibrary.h"
+#include "Engine/EngineTypes.h"
+#include "PortalTraceLibrary.generated.h"
+
+class APortal;
+struct FPortalPairTransform;
+
+USTRUCT(BlueprintType)
+struct FPortalTraceRequest
+{
+    GENERATED_BODY()
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite)
+        FVector Start = FVector::ZeroVector;
+
+    /** Where the trace would end without portals, its length is kept across hops */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite)
+        FVector End = FVector::ZeroVector;
+
+    /** Radius of the swept sphere, zero traces a line */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite)
+        float Radius = 0.f;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite)
+        int32 MaxPortalHops = 4;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite)
+        TEnumAsByte<ECollisionChannel> TraceChannel = ECC_Visibility;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite)
+        TArray<AActor*> ActorsToIgnore;
+};
+
+/** One pass through a portal */
+USTRUCT(BlueprintType)
+struct FPortalTraceHop
+{
+    GENERATED_BODY()
+
+    /** Portal the trace entered */
+    UPROPERTY(BlueprintReadOnly)
+        APortal* Portal = nullptr;
+
+    /** Where the trace entered Portal */
+    UPROPERTY(BlueprintReadOnly)
+        FVector EntryLocation = FVector::ZeroVector;
+
+    /** Where the trace left the linked portal */
+    UPROPERTY(BlueprintReadOnly)
+        FVector ExitLocation = FVector::ZeroVector;
+
+    /** Trace direction after leaving the linked portal */
+    UPROPERTY(BlueprintReadOnly)
+        FVector ExitDirection = FVector::ZeroVector;
+};
+
+USTRUCT(BlueprintType)
+struct FPortalTraceResult
+{
+    GENERATED_BODY()
+
+    /** Portals passed in order, each one starts a new straight segment */
+    UPROPERTY(BlueprintReadOnly)
+        TArray<FPortalTraceHop> Hops;
+
+    UPROPERTY(BlueprintReadOnly)
+        bool bBlockingHit = false;
+
+    /** Blocking hit, in the world space of the last segment */
+    UPROPERTY(BlueprintReadOnly)
+        FHitResult HitResult;
+
+    /** The trace entered one more portal than MaxPortalHops allows and stopped on its surface */
+    UPROPERTY(BlueprintReadOnly)
+        bool bHopLimitReached = false;
+
+    /** Where the trace ended, on the blocking hit, a portal surface or at full length */
+    UPROPERTY(BlueprintReadOnly)
+        FVector EndLocation = FVector::ZeroVector;
+
+    /** Length travelled over all segments */
+    UPROPERTY(BlueprintReadOnly)
+        float Distance = 0.f;
+};
+
+/**
+ * Line and sphere traces that carry on through linked portals instead of stopping at the portal mesh.
+ * Crossings are found analytically against the pair transforms cached by UPortalRegistrySubsystem,
+ * so each segment costs a single scene query. Batches are spread over worker threads.
+ */
+UCLASS()
+class UPortalTraceLibrary : public UBlueprintFunctionLibrary
+{
+    GENERATED_BODY()
+
+public:
+    /** @returns true on a blocking hit */
+    UFUNCTION(BlueprintCallable, Category = "Portal", meta = (WorldContext = "WorldContextObject", AutoCreateRefTerm = "ActorsToIgnore"))
+        static bool PortalLineTrace(const UObject* WorldContextObject, FVector Start, FVector End, ECollisionChannel TraceChannel, const TArray<AActor*>& ActorsToIgnore, int32 MaxPortalHops, FPortalTraceResult& OutResult);
+
+    /** @returns true on a blocking hit */
+    UFUNCTION(BlueprintCallable, Category = "Portal", meta = (WorldContext = "WorldContextObject", AutoCreateRefTerm = "ActorsToIgnore"))
+        static bool PortalSphereTrace(const UObject* WorldContextObject, FVector Start, FVector End, float Radius, ECollisionChannel TraceChannel, const TArray<AActor*>& ActorsToIgnore, int32 MaxPortalHops, FPortalTraceResult& OutResult);
+
+    /** Runs every request in parallel, OutResults matches Requests by index */
+    UFUNCTION(BlueprintCallable, Category = "Portal", meta = (WorldContext = "WorldContextObject"))
+        static void PortalTraceBatch(const UObject* WorldContextObject, const TArray<FPortalTraceRequest>& Requests, TArray<FPortalTraceResult>& OutResults);
+
+    /**
+     * Whether To can be seen from From, directly or through chains of up to MaxPortalHops portals.
+     * A line counts when it hits To, or arrives at To's location when To doesn't block it.
+     */
+    UFUNCTION(BlueprintCallable, Category = "Portal", meta = (WorldContext = "WorldContextObject", AutoCreateRefTerm = "ActorsToIgnore"))
+        static bool HasPortalLineOfSight(const UObject* WorldContextObject, FVector From, AActor* To, const TArray<AActor*>& ActorsToIgnore, int32 MaxPortalHops = 2);
+
+    /**
+     * Follows one request through Pairs. Only reads the scene and Pairs, so it can run on any
+     * thread while the game thread isn't changing either of them.
+     */
+    static void TraceThroughPortals(const UWorld* World, TArrayView<const FPortalPairTransform> Pairs, const FPortalTraceRequest& Request, FPortalTraceResult& OutResult);
+};
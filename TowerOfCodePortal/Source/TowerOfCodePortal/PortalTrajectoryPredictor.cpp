@@ -0,0 +1,122 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "PortalTrajectoryPredictor.h"
+#include "Portal.h"
+#include "PortalRegistrySubsystem.h"
+#include "DrawDebugHelpers.h"
+#include "Engine/World.h"
+
+bool UPortalTrajectoryPredictor::PredictPortalTrajectory(const UObject* WorldContextObject, const FPortalTrajectoryParams& Params, FPortalTrajectoryResult& OutResult)
+{
+    OutResult = FPortalTrajectoryResult();
+
+    UWorld* World = GEngine->GetWorldFromContextObject(WorldContextObject, EGetWorldErrorMode::LogAndReturnNull);
+    if (World == nullptr || Params.SimFrequency <= 0.f)
+        return false;
+
+    UPortalRegistrySubsystem* Registry = World->GetSubsystem<UPortalRegistrySubsystem>();
+
+    const FVector Gravity(0.f, 0.f, Params.GravityZ != 0.f ? Params.GravityZ : World->GetGravityZ());
+    const FCollisionShape Shape = Params.ProjectileRadius > 0.f
+        ? FCollisionShape::MakeSphere(Params.ProjectileRadius)
+        : FCollisionShape();
+
+    // Portals teleport by overlap, so their own collision must not stop the arc
+    FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(PortalTrajectory), false);
+    QueryParams.AddIgnoredActors(Params.ActorsToIgnore);
+    if (Registry != nullptr)
+    {
+        for (const FPortalPairTransform& Pair : Registry->GetPortalPairs())
+        {
+            QueryParams.AddIgnoredActor(Pair.Portal);
+        }
+    }
+
+    // Each run follows the closed form from its own start, a portal hop starts a new run
+    FVector RunLocation = Params.StartLocation;
+    FVector RunVelocity = Params.LaunchVelocity;
+    float RunTime = 0.f;
+    float SimTime = 0.f;
+
+    FVector TraceStart = RunLocation;
+    OutResult.RunStarts.Add(0);
+    OutResult.PathPoints.Add(TraceStart);
+
+    while (SimTime < Params.MaxSimTime)
+    {
+        RunTime += Params.SimFrequency;
+        SimTime += Params.SimFrequency;
+        FVector TraceEnd = RunLocation + RunVelocity * RunTime + 0.5f * Gravity * RunTime * RunTime;
+
+        // Cheap plane test first, the sweep only has to reach the portal surface
+        float PortalTime = 1.f;
+        const int32 PortalIndex = (Registry != nullptr && OutResult.PortalHops < Params.MaxPortalHops)
+            ? Registry->FindFirstCrossing(TraceStart, TraceEnd, PortalTime)
+            : INDEX_NONE;
+        if (PortalIndex != INDEX_NONE)
+        {
+            TraceEnd = FMath::Lerp(TraceStart, TraceEnd, PortalTime);
+        }
+
+        FHitResult Hit;
+        if (World->SweepSingleByChannel(Hit, TraceStart, TraceEnd, FQuat::Identity, Params.TraceChannel, Shape, QueryParams))
+        {
+            OutResult.PathPoints.Add(Hit.Location);
+            OutResult.HitResult = Hit;
+            OutResult.bBlockingHit = true;
+            return true;
+        }
+
+        OutResult.PathPoints.Add(TraceEnd);
+
+        if (PortalIndex == INDEX_NONE)
+        {
+            TraceStart = TraceEnd;
+            continue;
+        }
+
+        // Carry the position and velocity at the surface over to the linked side
+        const FPortalPairTransform& Pair = Registry->GetPortalPairs()[PortalIndex];
+        const float CrossingTime = RunTime - Params.SimFrequency * (1.f - PortalTime);
+        const FVector CrossingVelocity = RunVelocity + Gravity * CrossingTime;
+
+        RunLocation = Pair.ToLink.TransformPosition(TraceEnd);
+        RunVelocity = Pair.ToLink.TransformVector(CrossingVelocity);
+        RunTime = 0.f;
+        SimTime -= Params.SimFrequency * (1.f - PortalTime);
+        TraceStart = RunLocation;
+
+        OutResult.PortalHops++;
+        OutResult.RunStarts.Add(OutResult.PathPoints.Num());
+        OutResult.PathPoints.Add(RunLocation);
+    }
+
+    return false;
+}
+
+void UPortalTrajectoryPredictor::DrawPortalTrajectory(const UObject* WorldContextObject, const FPortalTrajectoryResult& Result, FLinearColor Color, float Duration)
+{
+    UWorld* World = GEngine->GetWorldFromContextObject(WorldContextObject, EGetWorldErrorMode::LogAndReturnNull);
+    if (World == nullptr)
+        return;
+
+    const FColor LineColor = Color.ToFColor(true);
+    for (int32 RunIndex = 0; RunIndex < Result.RunStarts.Num(); RunIndex++)
+    {
+        const int32 First = Result.RunStarts[RunIndex];
+        const int32 Last = Result.RunStarts.IsValidIndex(RunIndex + 1)
+            ? Result.RunStarts[RunIndex + 1] - 1
+            : Result.PathPoints.Num() - 1;
+
+        for (int32 Index = First; Index < Last; Index++)
+        {
+            DrawDebugLine(World, Result.PathPoints[Index], Result.PathPoints[Index + 1], LineColor, false, Duration);
+        }
+    }
+
+    if (Result.bBlockingHit)
+    {
+        DrawDebugSphere(World, Result.HitResult.Location, 10.f, 8, LineColor, false, Duration);
+    }
+}
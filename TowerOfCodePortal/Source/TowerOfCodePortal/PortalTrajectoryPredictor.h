@@ -0,0 +1,89 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Kismet/BlueprintFunctionLibrary.h"
+#include "Engine/EngineTypes.h"
+#include "PortalTrajectoryPredictor.generated.h"
+
+USTRUCT(BlueprintType)
+struct FPortalTrajectoryParams
+{
+    GENERATED_BODY()
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite)
+        FVector StartLocation = FVector::ZeroVector;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite)
+        FVector LaunchVelocity = FVector::ZeroVector;
+
+    /** Zero uses the world gravity */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite)
+        float GravityZ = 0.f;
+
+    /** Radius of the swept sphere, zero traces a line */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite)
+        float ProjectileRadius = 0.f;
+
+    /** Simulated time, in seconds, shared by every portal hop */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite)
+        float MaxSimTime = 2.f;
+
+    /** Length of a simulation step, in seconds */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite)
+        float SimFrequency = 1.e-2f;
+
+    /** Portals the arc may pass through before the prediction stops */
+    UPROPERTY(EditAnywhere, BlueprintReadWrite)
+        int32 MaxPortalHops = 4;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite)
+        TEnumAsByte<ECollisionChannel> TraceChannel = ECC_WorldDynamic;
+
+    UPROPERTY(EditAnywhere, BlueprintReadWrite)
+        TArray<AActor*> ActorsToIgnore;
+};
+
+USTRUCT(BlueprintType)
+struct FPortalTrajectoryResult
+{
+    GENERATED_BODY()
+
+    /** Points along the arc. A portal hop starts a new run, see RunStarts. */
+    UPROPERTY(BlueprintReadOnly)
+        TArray<FVector> PathPoints;
+
+    /** Index in PathPoints of the first point of each run, one run per side of a portal */
+    UPROPERTY(BlueprintReadOnly)
+        TArray<int32> RunStarts;
+
+    UPROPERTY(BlueprintReadOnly)
+        int32 PortalHops = 0;
+
+    UPROPERTY(BlueprintReadOnly)
+        bool bBlockingHit = false;
+
+    UPROPERTY(BlueprintReadOnly)
+        FHitResult HitResult;
+};
+
+/**
+ * Predicts a projectile arc that carries on through linked portals.
+ * Portal surfaces are tested analytically against each step before the physics sweep,
+ * so following the arc through a portal costs no extra scene query.
+ */
+UCLASS()
+class UPortalTrajectoryPredictor : public UBlueprintFunctionLibrary
+{
+    GENERATED_BODY()
+
+public:
+    /** @returns true if the arc hit something blocking before running out of time or hops */
+    UFUNCTION(BlueprintCallable, Category = "Portal", meta = (WorldContext = "WorldContextObject"))
+        static bool PredictPortalTrajectory(const UObject* WorldContextObject, const FPortalTrajectoryParams& Params, FPortalTrajectoryResult& OutResult);
+
+    /** Draws each run of a prediction as debug lines */
+    UFUNCTION(BlueprintCallable, Category = "Portal", meta = (WorldContext = "WorldContextObject"))
+        static void DrawPortalTrajectory(const UObject* WorldContextObject, const FPortalTrajectoryResult& Result, FLinearColor Color, float Duration);
+};
@@ -0,0 +1,125 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "PortalViewExtension.h"
+#include "Portal.h"
+#include "PortalRegistrySubsystem.h"
+#include "Algo/Reverse.h"
+#include "GameFramework/PlayerController.h"
+#include "SceneInterface.h"
+#include "SceneView.h"
+
+FPortalViewExtension::FPortalViewExtension(const FAutoRegister& AutoRegister, UWorld* InWorld)
+    : FSceneViewExtensionBase(AutoRegister)
+    , World(InWorld)
+{
+}
+
+void FPortalViewExtension::BeginRenderViewFamily(FSceneViewFamily& InViewFamily)
+{
+    check(IsInGameThread());
+
+    // Scene captures are view families too, only the main views drive the portals
+    if (bCapturing
+        || InViewFamily.Scene == nullptr
+        || InViewFamily.Views.Num() == 0
+        || InViewFamily.Views[0]->bIsSceneCapture)
+        return;
+
+    UWorld* ViewWorld = World.Get();
+    if (ViewWorld == nullptr || InViewFamily.Scene->GetWorld() != ViewWorld)
+        return;
+
+    UPortalRegistrySubsystem* Registry = ViewWorld->GetSubsystem<UPortalRegistrySubsystem>();
+    if (Registry == nullptr)
+        return;
+
+    TGuardValue<bool> CapturingGuard(bCapturing, true);
+    for (int32 ViewIndex = 0; ViewIndex < InViewFamily.Views.Num(); ViewIndex++)
+    {
+        // Both eyes share one capture, the left eye drives it
+        const FSceneView* View = InViewFamily.Views[ViewIndex];
+        if (View->StereoPass != eSSP_FULL && View->StereoPass != eSSP_LEFT_EYE)
+            continue;
+
+        APlayerController* PlayerController = FindViewController(ViewWorld, *View);
+        if (PlayerController == nullptr)
+            continue;
+
+        const FSceneView* RightEye = View->StereoPass == eSSP_LEFT_EYE
+            && InViewFamily.Views.IsValidIndex(ViewIndex + 1)
+            && InViewFamily.Views[ViewIndex + 1]->StereoPass == eSSP_RIGHT_EYE
+            ? InViewFamily.Views[ViewIndex + 1]
+            : nullptr;
+
+        // The capture gets the main view's exact field of view from its projection
+        const float FOVAngle = FMath::RadiansToDegrees(2.f * FMath::Atan(1.f / View->ViewMatrices.GetProjectionMatrix().M[0][0]));
+        for (APortal* Portal : Registry->GetPortals())
+        {
+            if (Portal == nullptr || !Portal->bCaptureInViewFamily)
+                continue;
+
+            if (RightEye != nullptr && Portal->bStereoCapture)
+            {
+                Portal->UpdateStereoCaptureFromView(PlayerController, MakeEyeView(*View), MakeEyeView(*RightEye));
+            }
+            else
+            {
+                Portal->UpdateCaptureFromView(PlayerController, View->ViewLocation, View->ViewRotation.Quaternion(), FOVAngle);
+            }
+        }
+    }
+}
+
+FPortalEyeView FPortalViewExtension::MakeEyeView(const FSceneView& View)
+{
+    FPortalEyeView Eye;
+    Eye.Location = View.ViewLocation;
+    Eye.Rotation = View.ViewRotation.Quaternion();
+    Eye.ProjectionMatrix = View.ViewMatrices.GetProjectionMatrix();
+    Eye.ViewSize = View.UnscaledViewRect.Size();
+    return Eye;
+}
+
+APlayerController* FPortalViewExtension::FindViewController(UWorld* ViewWorld, const FSceneView& View) const
+{
+    for (FConstPlayerControllerIterator It = ViewWorld->GetPlayerControllerIterator(); It; ++It)
+    {
+        APlayerController* PlayerController = It->Get();
+        if (PlayerController != nullptr
+            && PlayerController->IsLocalController()
+            && PlayerController->GetViewTarget() == View.ViewActor)
+            return PlayerController;
+    }
+    return nullptr;
+}
+
+void FPortalViewExtension::BuildViewChain(const FPortalPairTransform& Pair, const FTransform& ViewTransform, int32 MaxDepth, TArray<FPortalView>& OutViews)
+{
+    OutViews.Reset();
+
+    // Each level moves the previous camera through the pair once more
+    const FQuat ToLinkRotation(Pair.ToLink.RemoveTranslation());
+    FVector Location = ViewTransform.GetLocation();
+    FQuat Rotation = ViewTransform.GetRotation();
+    for (int32 Depth = 1; Depth <= MaxDepth; Depth++)
+    {
+        Location = Pair.ToLink.TransformPosition(Location);
+        Rotation = ToLinkRotation * Rotation;
+
+        FPortalView& View = OutViews.AddDefaulted_GetRef();
+        View.Depth = Depth;
+        View.CameraTransform = FTransform(Rotation, Location);
+
+        // Same axis swap as the engine's views, x forward becomes z depth
+        View.ViewMatrix = FTranslationMatrix(-Location)
+            * FInverseRotationMatrix(Rotation.Rotator())
+            * FMatrix(
+                FPlane(0, 0, 1, 0),
+                FPlane(1, 0, 0, 0),
+                FPlane(0, 1, 0, 0),
+                FPlane(0, 0, 0, 1));
+    }
+
+    Algo::Reverse(OutViews);
+}
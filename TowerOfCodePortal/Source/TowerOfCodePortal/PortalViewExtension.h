@@ -0,0 +1,71 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "SceneViewExtension.h"
+
+class APlayerController;
+struct FPortalPairTransform;
+
+/** Virtual camera of one recursion level of a view through a portal */
+struct FPortalView
+{
+    /** 1 is the view straight through the portal, each level passes through the pair once more */
+    int32 Depth = 1;
+
+    FTransform CameraTransform;
+
+    /** World to view matrix, laid out like FViewMatrices::GetViewMatrix */
+    FMatrix ViewMatrix = FMatrix::Identity;
+};
+
+/** Camera of one eye of a stereo view */
+struct FPortalEyeView
+{
+    FVector Location = FVector::ZeroVector;
+    FQuat Rotation = FQuat::Identity;
+
+    /** The eye's own projection, usually off-center */
+    FMatrix ProjectionMatrix = FMatrix::Identity;
+
+    /** Size of the eye's view on screen in pixels, changes with the headset and its pixel density */
+    FIntPoint ViewSize = FIntPoint::ZeroValue;
+};
+
+/**
+ * Triggers the captures of portals with APortal::bCaptureInViewFamily from the main views of the frame.
+ * When the main view family begins rendering, each portal's own scene capture is updated with the
+ * final camera and field of view of every main view, so it renders in the same frame, right before
+ * the main views. The captures stay separate view families with their own scene renderers, they
+ * are not added to the main family and share none of its work.
+ * Both eyes of a stereo family go to portals with APortal::bStereoCapture together.
+ */
+class FPortalViewExtension : public FSceneViewExtensionBase
+{
+public:
+    FPortalViewExtension(const FAutoRegister& AutoRegister, UWorld* InWorld);
+
+    // ISceneViewExtension
+    virtual void SetupViewFamily(FSceneViewFamily& InViewFamily) override {}
+    virtual void SetupView(FSceneViewFamily& InViewFamily, FSceneView& InView) override {}
+    virtual void BeginRenderViewFamily(FSceneViewFamily& InViewFamily) override;
+    virtual void PreRenderViewFamily_RenderThread(FRHICommandListImmediate& RHICmdList, FSceneViewFamily& InViewFamily) override {}
+    virtual void PreRenderView_RenderThread(FRHICommandListImmediate& RHICmdList, FSceneView& InView) override {}
+
+    /**
+     * Virtual cameras of a view through Pair, from the deepest level to the first. That is the order
+     * they are rendered in, so each level shows the one behind it. Only math, it runs under -nullrhi.
+     */
+    static void BuildViewChain(const FPortalPairTransform& Pair, const FTransform& ViewTransform, int32 MaxDepth, TArray<FPortalView>& OutViews);
+
+private:
+    APlayerController* FindViewController(UWorld* ViewWorld, const FSceneView& View) const;
+
+    static FPortalEyeView MakeEyeView(const FSceneView& View);
+
+    TWeakObjectPtr<UWorld> World;
+
+    /** Set while the captures render, their own view families must not start more */
+    bool bCapturing = false;
+};
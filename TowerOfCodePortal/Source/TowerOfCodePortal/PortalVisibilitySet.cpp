@@ -0,0 +1,325 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "PortalVisibilitySet.h"
+#include "Portal.h"
+#include "PortalRegistrySubsystem.h"
+#include "Components/BoxComponent.h"
+#include "EngineUtils.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogPortalVisibility, Log, All);
+
+namespace
+{
+    /** Keeps samples off the surfaces they lie on */
+    const float SurfaceOffset = 10.f;
+
+    void OrBits(TArray<uint32>& Target, const TArray<uint32>& Source)
+    {
+        for (int32 Word = 0; Word < Target.Num(); Word++)
+        {
+            Target[Word] |= Source[Word];
+        }
+    }
+}
+
+APortalVisibilitySet::APortalVisibilitySet()
+{
+    PrimaryActorTick.bCanEverTick = false;
+
+    Bounds = CreateDefaultSubobject<UBoxComponent>(TEXT("Bounds"));
+    Bounds->SetBoxExtent(FVector(2000.f, 2000.f, 500.f));
+    Bounds->SetCollisionEnabled(ECollisionEnabled::NoCollision);
+    RootComponent = Bounds;
+
+    CellSize = 400.f;
+    CellFaceDivisions = 2;
+    MaxRecursionHops = 2;
+    MaxVisibleDistance = 0.f;
+    TraceChannel = ECC_Visibility;
+
+    GridOrigin = FVector::ZeroVector;
+    GridSize = FIntVector::ZeroValue;
+    BakedCellSize = 0.f;
+    RowWords = 0;
+}
+
+void APortalVisibilitySet::BeginPlay()
+{
+    Super::BeginPlay();
+
+    PortalIndices.Reset();
+    for (int32 PortalIndex = 0; PortalIndex < BakedPortals.Num(); PortalIndex++)
+    {
+        if (BakedPortals[PortalIndex] != nullptr)
+        {
+            PortalIndices.Add(BakedPortals[PortalIndex], PortalIndex);
+        }
+    }
+
+    if (!HasBakedData())
+    {
+        UE_LOG(LogPortalVisibility, Warning, TEXT("%s has not been baked, every portal is considered visible"), *GetName());
+        return;
+    }
+
+    if (UPortalRegistrySubsystem* Registry = GetWorld()->GetSubsystem<UPortalRegistrySubsystem>())
+    {
+        Registry->AddVisibilitySet(this);
+    }
+}
+
+void APortalVisibilitySet::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+    if (UPortalRegistrySubsystem* Registry = GetWorld()->GetSubsystem<UPortalRegistrySubsystem>())
+    {
+        Registry->RemoveVisibilitySet(this);
+    }
+
+    Super::EndPlay(EndPlayReason);
+}
+
+bool APortalVisibilitySet::IsPortalPotentiallyVisible(const APortal* Portal, const FVector& Location) const
+{
+    const int32* PortalIndex = PortalIndices.Find(Portal);
+    if (PortalIndex == nullptr)
+        return true;
+
+    const int32 CellIndex = GetCellIndex(Location);
+    if (CellIndex == INDEX_NONE)
+        return true;
+
+    return IsRowBitSet(CellRows[CellIndex], *PortalIndex);
+}
+
+int32 APortalVisibilitySet::GetCellIndex(const FVector& Location) const
+{
+    if (BakedCellSize <= 0.f || CellRows.Num() == 0)
+        return INDEX_NONE;
+
+    const FVector Cell = (Location - GridOrigin) / BakedCellSize;
+    const int32 X = FMath::FloorToInt(Cell.X);
+    const int32 Y = FMath::FloorToInt(Cell.Y);
+    const int32 Z = FMath::FloorToInt(Cell.Z);
+    if (X < 0 || Y < 0 || Z < 0 || X >= GridSize.X || Y >= GridSize.Y || Z >= GridSize.Z)
+        return INDEX_NONE;
+
+    return (Z * GridSize.Y + Y) * GridSize.X + X;
+}
+
+bool APortalVisibilitySet::IsRowBitSet(int32 Row, int32 PortalIndex) const
+{
+    return (RowBits[Row * RowWords + PortalIndex / 32] & (1u << (PortalIndex % 32))) != 0;
+}
+
+void APortalVisibilitySet::Bake()
+{
+    UWorld* World = GetWorld();
+    if (World == nullptr)
+        return;
+
+    const double StartTime = FPlatformTime::Seconds();
+
+    // Only portals of this level can be referenced from the data saved with it
+    TArray<APortal*> Portals;
+    for (TActorIterator<APortal> It(World); It; ++It)
+    {
+        if (It->GetLevel() == GetLevel())
+        {
+            Portals.Add(*It);
+        }
+    }
+
+    const FBox Box = Bounds->Bounds.GetBox();
+    const FIntVector NewGridSize(
+        FMath::Max(1, FMath::CeilToInt(Box.GetSize().X / CellSize)),
+        FMath::Max(1, FMath::CeilToInt(Box.GetSize().Y / CellSize)),
+        FMath::Max(1, FMath::CeilToInt(Box.GetSize().Z / CellSize)));
+    const int32 NewRowWords = FMath::Max(1, FMath::DivideAndRoundUp(Portals.Num(), 32));
+
+    Modify();
+    BakedPortals = Portals;
+    GridOrigin = Box.Min;
+    GridSize = NewGridSize;
+    BakedCellSize = CellSize;
+    RowWords = NewRowWords;
+    RowBits.Reset();
+    CellRows.Reset();
+
+    // What can be seen when looking out of each portal's link
+    TArray<TArray<uint32>> ThroughBits;
+    ThroughBits.SetNum(Portals.Num());
+    for (int32 PortalIndex = 0; PortalIndex < Portals.Num(); PortalIndex++)
+    {
+        ThroughBits[PortalIndex].SetNumZeroed(RowWords);
+
+        APortal* Link = Portals[PortalIndex]->GetLink();
+        if (Link == nullptr)
+        {
+            Link = Portals[PortalIndex]->StreamedLink.Get();
+        }
+        if (Link == nullptr)
+            continue;
+
+        TArray<FVector> LinkSamples;
+        GetSurfaceSamples(Link, LinkSamples);
+        for (const FVector& Sample : LinkSamples)
+        {
+            TArray<uint32> SampleBits;
+            TraceVisiblePortals(Sample, Link->GetActorForwardVector(), 0.f, SampleBits);
+            OrBits(ThroughBits[PortalIndex], SampleBits);
+        }
+    }
+
+    // Every lattice point on the surface of a cell, the interior ones can't see more than those
+    const int32 Divisions = FMath::Max(1, CellFaceDivisions);
+    const float Spacing = CellSize / Divisions;
+    const float DistanceSlack = Spacing * FMath::Sqrt(0.5f);
+    TArray<FVector> CellSamples;
+    for (int32 I = 0; I <= Divisions; I++)
+    {
+        for (int32 J = 0; J <= Divisions; J++)
+        {
+            for (int32 K = 0; K <= Divisions; K++)
+            {
+                if (I == 0 || I == Divisions || J == 0 || J == Divisions || K == 0 || K == Divisions)
+                {
+                    CellSamples.Add(FVector(I, J, K) * Spacing);
+                }
+            }
+        }
+    }
+
+    TMultiMap<uint32, int32> RowsByHash;
+    for (int32 Z = 0; Z < GridSize.Z; Z++)
+    {
+        for (int32 Y = 0; Y < GridSize.Y; Y++)
+        {
+            for (int32 X = 0; X < GridSize.X; X++)
+            {
+                // Portals seen from the faces of the cell
+                const FVector CellMin = GridOrigin + FVector(X, Y, Z) * CellSize;
+
+                TArray<uint32> Visible;
+                Visible.SetNumZeroed(RowWords);
+                TArray<uint32> SampleBits;
+                for (const FVector& Sample : CellSamples)
+                {
+                    TraceVisiblePortals(CellMin + Sample, FVector::ZeroVector, DistanceSlack, SampleBits);
+                    OrBits(Visible, SampleBits);
+                }
+
+                // Follow the visible portals through their links
+                TArray<uint32> Frontier = Visible;
+                for (int32 Hop = 0; Hop < MaxRecursionHops; Hop++)
+                {
+                    TArray<uint32> Next;
+                    Next.SetNumZeroed(RowWords);
+                    for (int32 PortalIndex = 0; PortalIndex < Portals.Num(); PortalIndex++)
+                    {
+                        if (Frontier[PortalIndex / 32] & (1u << (PortalIndex % 32)))
+                        {
+                            OrBits(Next, ThroughBits[PortalIndex]);
+                        }
+                    }
+
+                    bool bAnyNew = false;
+                    for (int32 Word = 0; Word < RowWords; Word++)
+                    {
+                        Next[Word] &= ~Visible[Word];
+                        Visible[Word] |= Next[Word];
+                        bAnyNew |= Next[Word] != 0;
+                    }
+                    if (!bAnyNew)
+                        break;
+                    Frontier = MoveTemp(Next);
+                }
+
+                // Most cells see the same few portals, so identical rows are stored once
+                const uint32 Hash = FCrc::MemCrc32(Visible.GetData(), Visible.Num() * sizeof(uint32));
+                int32 Row = INDEX_NONE;
+                for (auto It = RowsByHash.CreateConstKeyIterator(Hash); It; ++It)
+                {
+                    if (FMemory::Memcmp(&RowBits[It.Value() * RowWords], Visible.GetData(), RowWords * sizeof(uint32)) == 0)
+                    {
+                        Row = It.Value();
+                        break;
+                    }
+                }
+                if (Row == INDEX_NONE)
+                {
+                    Row = RowBits.Num() / RowWords;
+                    if (Row > MAX_uint16)
+                    {
+                        UE_LOG(LogPortalVisibility, Error, TEXT("%s has too many distinct cells, use larger cells"), *GetName());
+                        RowBits.Reset();
+                        CellRows.Reset();
+                        return;
+                    }
+                    RowBits.Append(Visible);
+                    RowsByHash.Add(Hash, Row);
+                }
+                CellRows.Add(uint16(Row));
+            }
+        }
+    }
+
+    UE_LOG(LogPortalVisibility, Log, TEXT("Baked %d portals into %dx%dx%d cells, %d distinct sets (%d bytes) in %.1f s"),
+        Portals.Num(), GridSize.X, GridSize.Y, GridSize.Z, RowBits.Num() / RowWords,
+        RowBits.Num() * int32(sizeof(uint32)) + CellRows.Num() * int32(sizeof(uint16)),
+        FPlatformTime::Seconds() - StartTime);
+}
+
+void APortalVisibilitySet::TraceVisiblePortals(const FVector& Location, const FVector& Facing, float DistanceSlack, TArray<uint32>& OutBits) const
+{
+    OutBits.SetNumZeroed(RowWords);
+    FMemory::Memzero(OutBits.GetData(), OutBits.Num() * sizeof(uint32));
+
+    // Portal surfaces don't block the view, what is behind them is what the captures show
+    FCollisionQueryParams Params(SCENE_QUERY_STAT(PortalVisibilityBake), false);
+    for (APortal* Portal : BakedPortals)
+    {
+        Params.AddIgnoredActor(Portal);
+    }
+
+    TArray<FVector> Samples;
+    for (int32 PortalIndex = 0; PortalIndex < BakedPortals.Num(); PortalIndex++)
+    {
+        const APortal* Portal = BakedPortals[PortalIndex];
+        const FVector ToLocation = Location - Portal->GetActorLocation();
+
+        // Portals are only seen from the front
+        if (FVector::DotProduct(ToLocation, Portal->GetActorForwardVector()) <= 0.f)
+            continue;
+        if (MaxVisibleDistance > 0.f && ToLocation.Size() > MaxVisibleDistance + DistanceSlack)
+            continue;
+
+        GetSurfaceSamples(Portal, Samples);
+        for (const FVector& Sample : Samples)
+        {
+            if (!Facing.IsZero() && FVector::DotProduct(Sample - Location, Facing) <= 0.f)
+                continue;
+
+            if (!GetWorld()->LineTraceTestByChannel(Location, Sample, TraceChannel, Params))
+            {
+                OutBits[PortalIndex / 32] |= 1u << (PortalIndex % 32);
+                break;
+            }
+        }
+    }
+}
+
+void APortalVisibilitySet::GetSurfaceSamples(const APortal* Portal, TArray<FVector>& OutSamples) const
+{
+    const FVector Center = Portal->GetActorLocation() + Portal->GetActorForwardVector() * SurfaceOffset;
+    const FVector2D Extent = Portal->GetSurfaceExtent() * 0.9f;
+    const FVector Right = Portal->GetActorRightVector() * Extent.X;
+    const FVector Up = Portal->GetActorUpVector() * Extent.Y;
+
+    OutSamples.Reset();
+    OutSamples.Add(Center);
+    OutSamples.Add(Center + Right + Up);
+    OutSamples.Add(Center + Right - Up);
+    OutSamples.Add(Center - Right + Up);
+    OutSamples.Add(Center - Right - Up);
+}
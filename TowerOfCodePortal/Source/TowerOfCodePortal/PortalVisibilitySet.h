@@ -0,0 +1,104 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "PortalVisibilitySet.generated.h"
+
+class APortal;
+class UBoxComponent;
+
+/**
+ * Baked potentially visible portals for the cells of a box.
+ *
+ * Bake traces from sample points in every cell to the surfaces of the portals, then adds what
+ * can be seen through the visible portals up to MaxRecursionHops. Cells sharing the same set
+ * share one row of bits, and everything is saved with the level. At runtime a portal whose bit
+ * is cleared for the camera's cell is skipped before any capture work.
+ *
+ * The samples cover the faces of each cell, corners and edges included: any line of sight from
+ * inside a cell leaves it through a face, and the rest of that line starts from the face. This is
+ * still sampling, not a conservative solid-angle test. A portal seen only through a gap narrower
+ * than the sample spacing, or only past the portal surface samples, can be missed. Raise
+ * CellFaceDivisions for levels with narrow openings.
+ */
+UCLASS()
+class TOWEROFCODEPORTAL_API APortalVisibilitySet : public AActor
+{
+    GENERATED_BODY()
+
+public:
+    APortalVisibilitySet();
+
+    /** Area covered by the cells, cameras outside of it see every portal */
+    UPROPERTY(VisibleAnywhere, BlueprintReadOnly)
+        UBoxComponent* Bounds;
+
+    UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Bake, meta = (ClampMin = "50"))
+        float CellSize;
+
+    /** Sample spacing on the faces of a cell is CellSize divided by this */
+    UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Bake, meta = (ClampMin = "1", ClampMax = "16"))
+        int32 CellFaceDivisions;
+
+    /** Portals seen through portals seen through ... up to this many times are included */
+    UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Bake, meta = (ClampMin = "0"))
+        int32 MaxRecursionHops;
+
+    /** Portals further than this from a cell are never visible from it, zero for no limit */
+    UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Bake)
+        float MaxVisibleDistance;
+
+    UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = Bake)
+        TEnumAsByte<ECollisionChannel> TraceChannel;
+
+    /** Traces every cell against the portals of the level and stores the result */
+    UFUNCTION(CallInEditor, BlueprintCallable, Category = Bake)
+        void Bake();
+
+    /** Whether Portal can be seen from Location, true for portals and locations the bake doesn't know */
+    bool IsPortalPotentiallyVisible(const APortal* Portal, const FVector& Location) const;
+
+    UFUNCTION(BlueprintPure)
+        bool HasBakedData() const { return CellRows.Num() > 0; }
+
+protected:
+    virtual void BeginPlay() override;
+    virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+private:
+    int32 GetCellIndex(const FVector& Location) const;
+    bool IsRowBitSet(int32 Row, int32 PortalIndex) const;
+
+    /** Portals visible from Location, as bits in OutBits. DistanceSlack widens MaxVisibleDistance for the points between samples. */
+    void TraceVisiblePortals(const FVector& Location, const FVector& Facing, float DistanceSlack, TArray<uint32>& OutBits) const;
+    void GetSurfaceSamples(const APortal* Portal, TArray<FVector>& OutSamples) const;
+
+    /** Portals a bit index refers to, in bake order */
+    UPROPERTY()
+        TArray<APortal*> BakedPortals;
+
+    UPROPERTY()
+        FVector GridOrigin;
+
+    UPROPERTY()
+        FIntVector GridSize;
+
+    UPROPERTY()
+        float BakedCellSize;
+
+    /** Words per row, 32 portals each */
+    UPROPERTY()
+        int32 RowWords;
+
+    /** Unique visibility rows, RowWords each */
+    UPROPERTY()
+        TArray<uint32> RowBits;
+
+    /** Row of every cell, X fastest */
+    UPROPERTY()
+        TArray<uint16> CellRows;
+
+    TMap<const APortal*, int32> PortalIndices;
+};
@@ -0,0 +1,83 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "PortalTestWorld.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FPortalCaptureTierTest, "TowerOfCode.Portal.CaptureTier",
+    EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FPortalCaptureTierTest::RunTest(const FString& Parameters)
+{
+    FPortalTestWorld TestWorld;
+    APortal* Portal = TestWorld.SpawnPortal(FVector::ZeroVector);
+
+    // Existing portals keep full quality everywhere
+    TestEqual(TEXT("One default tier"), Portal->CaptureTiers.Num(), 1);
+    TestEqual(TEXT("Default, near view straight through"), Portal->SelectCaptureTier(1, 0.f), 0);
+    TestEqual(TEXT("Default, fifth level"), Portal->SelectCaptureTier(5, 0.f), 0);
+    TestEqual(TEXT("Default, 100 m away"), Portal->SelectCaptureTier(1, 10000.f), 0);
+    TestTrue(TEXT("Default shadows"), Portal->CaptureTiers[0].bShadows);
+    TestEqual(TEXT("Default view distance"), Portal->GetCaptureViewDistance(0, 10000.f), -1.f);
+
+    Portal->CaptureTiers.Reset();
+    TestEqual(TEXT("No tiers"), Portal->SelectCaptureTier(1, 0.f), (int32)INDEX_NONE);
+
+    // Full quality straight through, cheaper from the second level or 20 m, cheapest from the fourth level or 50 m
+    Portal->CaptureTiers.SetNum(3);
+    Portal->CaptureTiers[0].MinDepth = 1;
+    Portal->CaptureTiers[1].MinDepth = 2;
+    Portal->CaptureTiers[1].MinDistance = 2000.f;
+    Portal->CaptureTiers[2].MinDepth = 4;
+    Portal->CaptureTiers[2].MinDistance = 5000.f;
+
+    struct FCase
+    {
+        int32 Depth;
+        float Distance;
+        int32 Tier;
+    };
+    const FCase Cases[] =
+    {
+        { 1, 0.f, 0 },
+        { 1, 1999.f, 0 },
+        { 1, 2000.f, 1 },
+        { 1, 6000.f, 2 },
+        { 2, 0.f, 1 },
+        { 3, 100.f, 1 },
+        { 3, 5000.f, 2 },
+        { 4, 0.f, 2 },
+        { 8, 0.f, 2 },
+    };
+    for (const FCase& Case : Cases)
+    {
+        TestEqual(FString::Printf(TEXT("Depth %d at %.0f cm"), Case.Depth, Case.Distance), Portal->SelectCaptureTier(Case.Depth, Case.Distance), Case.Tier);
+    }
+
+    // A tier without a distance is only reached by depth
+    Portal->CaptureTiers[2].MinDistance = 0.f;
+    TestEqual(TEXT("Far view of a depth-only tier"), Portal->SelectCaptureTier(1, 100000.f), 1);
+    TestEqual(TEXT("Deep view of a depth-only tier"), Portal->SelectCaptureTier(4, 0.f), 2);
+
+    // The view distance is counted from the link, so far and deep captures still see past its plane
+    Portal->CaptureTiers[2].MaxViewDistance = 5000.f;
+    const float LinkDistances[] = { 0.f, 3000.f, 6000.f, 20000.f };
+    for (float LinkDistance : LinkDistances)
+    {
+        TestEqual(FString::Printf(TEXT("View distance %.0f cm behind the link"), LinkDistance),
+            Portal->GetCaptureViewDistance(2, LinkDistance), LinkDistance + 5000.f);
+        TestTrue(FString::Printf(TEXT("Reaches past the link %.0f cm away"), LinkDistance),
+            Portal->GetCaptureViewDistance(2, LinkDistance) > LinkDistance);
+    }
+    TestEqual(TEXT("Full view distance without a limit"), Portal->GetCaptureViewDistance(1, 6000.f), -1.f);
+    TestEqual(TEXT("Full view distance without a tier"), Portal->GetCaptureViewDistance(INDEX_NONE, 6000.f), -1.f);
+
+    // Nothing was rendered yet
+    TestEqual(TEXT("No applied tier"), Portal->GetAppliedCaptureTier(0), (int32)INDEX_NONE);
+
+    return true;
+}
+
+#endif
@@ -0,0 +1,73 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "PortalTestWorld.h"
+#include "PortalTraceLibrary.h"
+#include "Components/BoxComponent.h"
+#include "Engine/CollisionProfile.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+    /** Actor at Location, blocking every trace with a box of Extent, or nothing without one */
+    AActor* SpawnTarget(UWorld* World, const FVector& Location, const FVector& Extent = FVector::ZeroVector)
+    {
+        AActor* Actor = World->SpawnActorDeferred<AActor>(AActor::StaticClass(), FTransform(Location));
+        UBoxComponent* Box = NewObject<UBoxComponent>(Actor, TEXT("Box"));
+        Box->SetBoxExtent(Extent);
+        Box->SetCollisionProfileName(Extent.IsZero() ? UCollisionProfile::NoCollision_ProfileName : UCollisionProfile::BlockAll_ProfileName);
+        Actor->SetRootComponent(Box);
+        Box->RegisterComponent();
+        Actor->FinishSpawning(FTransform(Location));
+        return Actor;
+    }
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FPortalLineOfSightTest, "TowerOfCode.Portal.LineOfSight",
+    EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FPortalLineOfSightTest::RunTest(const FString& Parameters)
+{
+    FPortalTestWorld TestWorld;
+    UWorld* World = TestWorld.Get();
+
+    // Facing each other's backs, so going into Portal only moves 10 m along Y
+    APortal* Portal = TestWorld.SpawnPortal(FVector::ZeroVector);
+    APortal* Link = TestWorld.SpawnPortal(FVector(0.f, 1000.f, 0.f), FRotator(0.f, 180.f, 0.f));
+    Portal->SurfaceExtent = FVector2D(100.f, 100.f);
+    Link->SurfaceExtent = FVector2D(100.f, 100.f);
+    Portal->SetLink(Link);
+    Link->SetLink(Portal);
+
+    const FVector From(300.f, 0.f, 0.f);
+    const TArray<AActor*> NoActors;
+
+    // Direct lines that don't pass a portal
+    AActor* Beside = SpawnTarget(World, FVector(300.f, 500.f, 0.f));
+    TestTrue(TEXT("Open direct line"), UPortalTraceLibrary::HasPortalLineOfSight(World, From, Beside, NoActors));
+    AActor* Wall = SpawnTarget(World, FVector(300.f, 250.f, 0.f), FVector(50.f, 10.f, 50.f));
+    TestFalse(TEXT("Direct line behind a wall"), UPortalTraceLibrary::HasPortalLineOfSight(World, From, Beside, NoActors));
+    TestTrue(TEXT("The wall itself"), UPortalTraceLibrary::HasPortalLineOfSight(World, From, Wall, NoActors));
+    TestTrue(TEXT("Ignoring the wall"), UPortalTraceLibrary::HasPortalLineOfSight(World, From, Beside, { Wall }));
+
+    // Right behind the portal, the line goes through it and comes out 10 m away
+    AActor* BehindPortal = SpawnTarget(World, FVector(-300.f, 0.f, 0.f));
+    TestFalse(TEXT("Hidden by the portal"), UPortalTraceLibrary::HasPortalLineOfSight(World, From, BehindPortal, NoActors));
+
+    // In front of the link, seen through the portal
+    AActor* ThroughPortal = SpawnTarget(World, FVector(-300.f, 1000.f, 0.f));
+    TestTrue(TEXT("Seen through the portal"), UPortalTraceLibrary::HasPortalLineOfSight(World, From, ThroughPortal, NoActors));
+    TestFalse(TEXT("Not without hops"), UPortalTraceLibrary::HasPortalLineOfSight(World, From, ThroughPortal, NoActors, 0));
+
+    // Blocking the target makes it visible by its hit, a blocker on the far side hides it
+    AActor* BlockingThroughPortal = SpawnTarget(World, FVector(-300.f, 1020.f, 0.f), FVector(20.f));
+    TestTrue(TEXT("Blocking target seen through the portal"), UPortalTraceLibrary::HasPortalLineOfSight(World, From, BlockingThroughPortal, NoActors));
+    SpawnTarget(World, FVector(-150.f, 1000.f, 0.f), FVector(10.f, 50.f, 50.f));
+    TestFalse(TEXT("Blocked beyond the portal"), UPortalTraceLibrary::HasPortalLineOfSight(World, From, ThroughPortal, NoActors));
+
+    return true;
+}
+
+#endif
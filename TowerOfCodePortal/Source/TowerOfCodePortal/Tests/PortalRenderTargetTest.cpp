@@ -0,0 +1,46 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "PortalTestWorld.h"
+#include "PortalRenderTargetSubsystem.h"
+#include "Engine/TextureRenderTarget2D.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FPortalRenderTargetEvictionTest, "TowerOfCode.Portal.RenderTargets.Eviction",
+    EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FPortalRenderTargetEvictionTest::RunTest(const FString& Parameters)
+{
+    FPortalTestWorld TestWorld;
+    UPortalRenderTargetSubsystem* RenderTargets = TestWorld.Get()->GetSubsystem<UPortalRenderTargetSubsystem>();
+    if (!TestNotNull(TEXT("Render target subsystem"), RenderTargets))
+        return false;
+
+    // One 512x512 RGBA8 target fills the budget, and is evictable as soon as it's leased
+    RenderTargets->SetBudgetMB(1);
+    RenderTargets->EvictionDelay = 0.f;
+    const FIntPoint Size(512, 512);
+
+    APortal* Parked = TestWorld.SpawnPortal(FVector::ZeroVector);
+    APortal* Placed = TestWorld.SpawnPortal(FVector(500.f, 0.f, 0.f));
+    Parked->SetParked(true);
+
+    UTextureRenderTarget2D* ParkedTarget = RenderTargets->Acquire(Parked, Size, RTF_RGBA8, false);
+    if (!TestNotNull(TEXT("Parked portal's target"), ParkedTarget))
+        return false;
+
+    // A pooled portal waiting for a placement keeps its prewarmed target
+    TestNull(TEXT("Parked portal not evicted"), RenderTargets->Acquire(Placed, Size, RTF_RGBA8, false));
+    TestEqual(TEXT("Parked lease kept"), RenderTargets->GetLeaseCount(), 1);
+
+    // Once placed it's a portal like any other
+    Parked->SetParked(false);
+    TestNotNull(TEXT("Placed portal evicted"), RenderTargets->Acquire(Placed, Size, RTF_RGBA8, false));
+    TestEqual(TEXT("Only the new lease"), RenderTargets->GetLeaseCount(), 1);
+
+    return true;
+}
+
+#endif
@@ -0,0 +1,57 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "PortalStereoMaterial.h"
+#include "Materials/Material.h"
+#include "Materials/MaterialExpressionCustom.h"
+#include "Materials/MaterialExpressionScalarParameter.h"
+#include "Materials/MaterialExpressionScreenPosition.h"
+#include "Materials/MaterialExpressionTextureSampleParameter2D.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS && WITH_EDITOR
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FPortalStereoMaterialTest, "TowerOfCode.Portal.StereoMaterial",
+    EAutomationTestFlags::EditorContext | EAutomationTestFlags::ProductFilter)
+
+bool FPortalStereoMaterialTest::RunTest(const FString& Parameters)
+{
+    // A surface material like MPortalBase, sampling the target at the screen position
+    UMaterial* Material = NewObject<UMaterial>(GetTransientPackage());
+    UMaterialExpressionScreenPosition* ScreenPosition = NewObject<UMaterialExpressionScreenPosition>(Material);
+    UMaterialExpressionTextureSampleParameter2D* Sample = NewObject<UMaterialExpressionTextureSampleParameter2D>(Material);
+    Sample->ParameterName = TEXT("Texture");
+    Sample->Coordinates.Connect(0, ScreenPosition);
+    Material->Expressions.Add(ScreenPosition);
+    Material->Expressions.Add(Sample);
+
+    TestFalse(TEXT("Unknown texture parameter"), PortalStereoMaterial::AddEyeSelection(Material, TEXT("Missing"), TEXT("StereoLayout")));
+    TestEqual(TEXT("Nothing added without the parameter"), Material->Expressions.Num(), 2);
+
+    if (!TestTrue(TEXT("Eye selection added"), PortalStereoMaterial::AddEyeSelection(Material, TEXT("Texture"), TEXT("StereoLayout"))))
+        return false;
+
+    // Screen position, then the eye selection with the layout switch, then the sample
+    const UMaterialExpressionCustom* Custom = Cast<UMaterialExpressionCustom>(Sample->Coordinates.Expression);
+    if (!TestNotNull(TEXT("Sample reads the eye selection"), Custom))
+        return false;
+
+    TestEqual(TEXT("Inputs"), Custom->Inputs.Num(), 2);
+    TestEqual(TEXT("Float2 output"), (int32)Custom->OutputType, (int32)CMOT_Float2);
+    TestTrue(TEXT("Selects by stereo pass"), Custom->Code.Contains(TEXT("StereoPassIndex")));
+    if (Custom->Inputs.Num() == 2)
+    {
+        TestEqual(TEXT("Keeps the screen UVs"), Custom->Inputs[0].Input.Expression, (UMaterialExpression*)ScreenPosition);
+        const UMaterialExpressionScalarParameter* Layout = Cast<UMaterialExpressionScalarParameter>(Custom->Inputs[1].Input.Expression);
+        TestTrue(TEXT("Switched by the layout scalar"), Layout != nullptr && Layout->ParameterName == TEXT("StereoLayout"));
+    }
+
+    // Running it on a material that has it already changes nothing
+    const int32 ExpressionCount = Material->Expressions.Num();
+    TestTrue(TEXT("Already added"), PortalStereoMaterial::AddEyeSelection(Material, TEXT("Texture"), TEXT("StereoLayout")));
+    TestEqual(TEXT("Added once"), Material->Expressions.Num(), ExpressionCount);
+
+    return true;
+}
+
+#endif
@@ -0,0 +1,74 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "PortalTestWorld.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FPortalSurfaceVisibilityTest, "TowerOfCode.Portal.SurfaceVisibility",
+    EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FPortalSurfaceVisibilityTest::RunTest(const FString& Parameters)
+{
+    FPortalTestWorld TestWorld;
+    APortal* Portal = TestWorld.SpawnPortal(FVector::ZeroVector);
+    APortal* Link = TestWorld.SpawnPortal(FVector(0.f, 1000.f, 0.f), FRotator(0.f, 180.f, 0.f));
+    Portal->SetLink(Link);
+    Link->SetLink(Portal);
+
+    APlayerController* Players[] = { TestWorld.SpawnPlayerController(), TestWorld.SpawnPlayerController() };
+
+    // Cameras in front of the portals, looking away, so each player gets a surface but nothing renders
+    for (APlayerController* Player : Players)
+    {
+        Portal->UpdateCaptureFromView(Player, FVector(100.f, 0.f, 0.f), FQuat::Identity, 0.f);
+        Link->UpdateCaptureFromView(Player, FVector(-100.f, 1000.f, 0.f), FRotator(0.f, 180.f, 0.f).Quaternion(), 0.f);
+    }
+    TestEqual(TEXT("Viewers"), Portal->GetViewerCount(), 2);
+    TestEqual(TEXT("Link viewers"), Link->GetViewerCount(), 2);
+
+    // The blueprint's surface belongs to the first player, the copy to the second
+    UPrimitiveComponent* Surfaces[] = { Cast<UPrimitiveComponent>(Portal->GetRootComponent()), nullptr };
+    TArray<UStaticMeshComponent*> Meshes;
+    Portal->GetComponents<UStaticMeshComponent>(Meshes);
+    for (UStaticMeshComponent* Mesh : Meshes)
+    {
+        if (Mesh != Surfaces[0])
+        {
+            Surfaces[1] = Mesh;
+        }
+    }
+    if (!TestNotNull(TEXT("Second player's surface"), Surfaces[1]))
+        return false;
+
+    // Main views
+    TestFalse(TEXT("Player 0 sees its surface"), Players[0]->HiddenPrimitiveComponents.Contains(Surfaces[0]));
+    TestTrue(TEXT("Player 0 doesn't see player 1's surface"), Players[0]->HiddenPrimitiveComponents.Contains(Surfaces[1]));
+    TestTrue(TEXT("Player 1 doesn't see player 0's surface"), Players[1]->HiddenPrimitiveComponents.Contains(Surfaces[0]));
+    TestFalse(TEXT("Player 1 sees its surface"), Players[1]->HiddenPrimitiveComponents.Contains(Surfaces[1]));
+
+    // Views through the portal hide the other player's surfaces of both portals
+    TArray<UPrimitiveComponent*> Hidden;
+    for (int32 ViewerIndex = 0; ViewerIndex < 2; ViewerIndex++)
+    {
+        Portal->GetSurfacesHiddenFromViewer(ViewerIndex, Hidden);
+        TestEqual(TEXT("Hidden surfaces of both portals"), Hidden.Num(), 2);
+        TestFalse(TEXT("Own surface isn't hidden"), Hidden.Contains(Surfaces[ViewerIndex]));
+        TestTrue(TEXT("Other player's surface is hidden"), Hidden.Contains(Surfaces[1 - ViewerIndex]));
+    }
+
+    // Captures created afterwards get the list too
+    Portal->PrewarmCapture();
+    if (TestNotNull(TEXT("Capture"), Portal->SceneCapture))
+    {
+        Portal->GetSurfacesHiddenFromViewer(0, Hidden);
+        TestEqual(TEXT("Capture hides the same surfaces"), Portal->SceneCapture->HiddenComponents.Num(), Hidden.Num());
+        TestTrue(TEXT("Capture hides player 1's surface"), Portal->SceneCapture->HiddenComponents.Contains(Surfaces[1]));
+        TestFalse(TEXT("Capture shows player 0's surface"), Portal->SceneCapture->HiddenComponents.Contains(Surfaces[0]));
+    }
+
+    return true;
+}
+
+#endif
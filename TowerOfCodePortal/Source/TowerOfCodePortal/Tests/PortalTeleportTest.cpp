@@ -0,0 +1,174 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "PortalTestWorld.h"
+#include "PortalPlacementSubsystem.h"
+#include "TowerOfCodePortalCharacter.h"
+#include "GameFramework/CharacterMovementComponent.h"
+#include "Misc/AutomationTest.h"
+#include "Misc/NetworkGuid.h"
+#include "UObject/CoreNet.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FPortalTeleportAcceptanceTest, "TowerOfCode.Portal.Teleport.Acceptance",
+    EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FPortalTeleportAcceptanceTest::RunTest(const FString& Parameters)
+{
+    FPortalTestWorld TestWorld;
+    APortal* Portal = TestWorld.SpawnPortal(FVector::ZeroVector);
+    APortal* Link = TestWorld.SpawnPortal(FVector(0.f, 1000.f, 0.f), FRotator(0.f, 180.f, 0.f));
+    Portal->SetLink(Link);
+    Link->SetLink(Portal);
+    APortal* Unlinked = TestWorld.SpawnPortal(FVector(0.f, -1000.f, 0.f));
+
+    const FVector Near(50.f, 0.f, 0.f);
+    const FVector Far(500.f, 0.f, 0.f);
+    const float MaxDistance = 300.f;
+
+    TestTrue(TEXT("Near a linked portal"), ATowerOfCodePortalCharacter::ShouldAcceptPortalTeleport(Portal, Near, 2.f, 1.f, MaxDistance));
+    TestFalse(TEXT("Too far from the portal"), ATowerOfCodePortalCharacter::ShouldAcceptPortalTeleport(Portal, Far, 2.f, 1.f, MaxDistance));
+    TestFalse(TEXT("Unlinked portal"), ATowerOfCodePortalCharacter::ShouldAcceptPortalTeleport(Unlinked, Unlinked->GetActorLocation(), 2.f, 1.f, MaxDistance));
+    TestFalse(TEXT("Unresolved portal"), ATowerOfCodePortalCharacter::ShouldAcceptPortalTeleport(nullptr, Near, 2.f, 1.f, MaxDistance));
+    TestFalse(TEXT("Same event twice"), ATowerOfCodePortalCharacter::ShouldAcceptPortalTeleport(Portal, Near, 1.f, 1.f, MaxDistance));
+    TestFalse(TEXT("Older event"), ATowerOfCodePortalCharacter::ShouldAcceptPortalTeleport(Portal, Near, 0.5f, 1.f, MaxDistance));
+    TestTrue(TEXT("Timestamp restarted from zero"), ATowerOfCodePortalCharacter::ShouldAcceptPortalTeleport(Portal, Near, 0.5f, 100.f, MaxDistance));
+
+    return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FPortalTeleportPoolSlotTest, "TowerOfCode.Portal.Teleport.PoolSlot",
+    EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FPortalTeleportPoolSlotTest::RunTest(const FString& Parameters)
+{
+    FPortalTestWorld TestWorld;
+    UPortalPlacementSubsystem* Placement = TestWorld.Get()->GetSubsystem<UPortalPlacementSubsystem>();
+    if (!TestNotNull(TEXT("Placement subsystem"), Placement))
+        return false;
+
+    Placement->PortalClass = FSoftClassPath(APortal::StaticClass());
+    Placement->PoolSize = 3;
+    Placement->ReservePool();
+    TestEqual(TEXT("Pooled portals"), Placement->GetPooledCount(), 3);
+
+    // Slots are handed out in spawn order and resolve back to the same portal
+    for (int32 Slot = 0; Slot < 3; Slot++)
+    {
+        APortal* Pooled = Placement->GetPooledPortal(Slot);
+        if (TestNotNull(TEXT("Pooled portal"), Pooled))
+        {
+            TestEqual(TEXT("Slot of the pooled portal"), Placement->GetPoolSlot(Pooled), Slot);
+            TestEqual(TEXT("Replicated slot"), Pooled->PoolSlot, Slot);
+            TestTrue(TEXT("Pooled portal replicates"), Pooled->GetIsReplicated());
+            TestTrue(TEXT("Pooled portal is parked"), Pooled->IsParked() && Pooled->IsHidden() && !Pooled->GetActorEnableCollision());
+        }
+    }
+    TestNull(TEXT("Unknown slot"), Placement->GetPooledPortal(3));
+    TestNull(TEXT("No slot"), Placement->GetPooledPortal(INDEX_NONE));
+
+    // Level portals are sent as actors
+    APortal* LevelPortal = TestWorld.SpawnPortal(FVector::ZeroVector);
+    TestEqual(TEXT("Level portal has no slot"), Placement->GetPoolSlot(LevelPortal), int32(INDEX_NONE));
+    TestEqual(TEXT("Null portal has no slot"), Placement->GetPoolSlot(nullptr), int32(INDEX_NONE));
+
+    // Clients take the server's portals into the slots they replicate, in any order
+    APortal* Replicated = TestWorld.SpawnPortal(FVector::ZeroVector);
+    Replicated->PoolSlot = 5;
+    Placement->AddReplicatedPortal(Replicated);
+    TestEqual(TEXT("Replicated portal in its slot"), Placement->GetPooledPortal(5), Replicated);
+    TestNull(TEXT("Slot not replicated yet"), Placement->GetPooledPortal(4));
+    TestTrue(TEXT("Replicated portal is prewarmed"), Replicated->bPrewarmCapture);
+
+    // Parking is what the server replicates to hide and show a pooled portal
+    Replicated->SetParked(true);
+    TestTrue(TEXT("Parked portal is hidden"), Replicated->IsHidden() && !Replicated->GetActorEnableCollision());
+    Replicated->SetParked(false);
+    TestTrue(TEXT("Placed portal is shown"), !Replicated->IsHidden() && Replicated->GetActorEnableCollision());
+
+    return true;
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FPortalTeleportPayloadTest, "TowerOfCode.Portal.Teleport.Payload",
+    EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FPortalTeleportPayloadTest::RunTest(const FString& Parameters)
+{
+    FPortalTestWorld TestWorld;
+    ACharacter* Character = TestWorld.Get()->SpawnActor<ACharacter>();
+    if (!TestNotNull(TEXT("Character"), Character))
+        return false;
+
+    // A walk through a portal 10 m away, turned around
+    const float TimeStamp = 12.345f;
+    const FVector Location(1234.56f, -2345.67f, 120.f);
+    const FVector Velocity(350.f, -420.f, 0.f);
+    const FRotator Rotation(0.f, 135.f, 0.f);
+    const FRotator ControlRotation(-12.f, 135.f, 0.f);
+    const FVector Offset(80.f, -35.f, 5.f);
+    bool bSuccess = true;
+
+    // Parameters in the order and with the serialization the net driver uses for the RPCs.
+    // Object references are written as their NetGUID, the pooled portal sends a null one.
+    FNetBitWriter Event(nullptr, 1024);
+    {
+        FNetworkGUID PortalGuid;
+        int32 PoolSlot = 1;
+        float EventTimeStamp = TimeStamp;
+        Event << PortalGuid;
+        Event << PoolSlot;
+        FVector_NetQuantize10(Offset).NetSerialize(Event, nullptr, bSuccess);
+        Event << EventTimeStamp;
+    }
+
+    FNetBitWriter Reject(nullptr, 1024);
+    {
+        float RejectTimeStamp = TimeStamp;
+        FRotator RejectRotation = Rotation;
+        FRotator RejectControlRotation = ControlRotation;
+        Reject << RejectTimeStamp;
+        FVector_NetQuantize100(Location).NetSerialize(Reject, nullptr, bSuccess);
+        RejectRotation.NetSerialize(Reject, nullptr, bSuccess);
+        RejectControlRotation.NetSerialize(Reject, nullptr, bSuccess);
+        FVector_NetQuantize10(Velocity).NetSerialize(Reject, nullptr, bSuccess);
+    }
+
+    // The server's position correction the event replaces, serialized by the engine itself
+    auto SerializeCorrection = [Character, &Location, &Velocity, &Rotation, TimeStamp](bool bHasRotation)
+    {
+        FCharacterMoveResponseDataContainer Response;
+        Response.ClientAdjustment.bAckGoodMove = false;
+        Response.ClientAdjustment.TimeStamp = TimeStamp;
+        Response.ClientAdjustment.NewLoc = Location;
+        Response.ClientAdjustment.NewVel = Velocity;
+        Response.ClientAdjustment.NewRot = Rotation;
+        Response.ClientAdjustment.MovementMode = MOVE_Walking;
+        Response.bHasRotation = bHasRotation;
+
+        FNetBitWriter Writer(nullptr, 1024);
+        Response.Serialize(*Character->GetCharacterMovement(), Writer, nullptr);
+        return Writer.GetNumBits();
+    };
+    const int64 CorrectionBits = SerializeCorrection(false);
+    const int64 RotatedCorrectionBits = SerializeCorrection(true);
+
+    FNetBitWriter RotationOnly(nullptr, 1024);
+    FRotator(ControlRotation).NetSerialize(RotationOnly, nullptr, bSuccess);
+
+    AddInfo(FString::Printf(TEXT("Teleport event %lld bits, rejection %lld bits, correction %lld bits, %lld with its rotation"),
+        Event.GetNumBits(), Reject.GetNumBits(), CorrectionBits, RotatedCorrectionBits));
+    TestTrue(TEXT("Serialized"), bSuccess && !Event.IsError() && !Reject.IsError());
+
+    // The client's event is cheaper than the correction the server no longer sends
+    TestTrue(TEXT("Event smaller than the correction"), Event.GetNumBits() < CorrectionBits);
+    TestTrue(TEXT("Event within 16 bytes"), Event.GetNumBits() <= 16 * 8);
+
+    // A rejection is the correction with the rotation, plus the control rotation it also puts back
+    TestTrue(TEXT("Rejection no larger than a rotated correction and the control rotation"),
+        Reject.GetNumBits() <= RotatedCorrectionBits + RotationOnly.GetNumBits());
+
+    return true;
+}
+
+#endif
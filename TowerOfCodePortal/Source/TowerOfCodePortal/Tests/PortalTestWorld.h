@@ -0,0 +1,63 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "Portal.h"
+#include "Components/StaticMeshComponent.h"
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "GameFramework/PlayerController.h"
+
+/**
+ * Playing game world for the automation tests, destroyed with the helper.
+ * Runs without a map or a renderer, e.g.
+ * "UE4Editor.exe TowerOfCodePortal.uproject -ExecCmds="Automation RunTests TowerOfCode.Portal; Quit" -unattended -nullrhi"
+ */
+class FPortalTestWorld
+{
+public:
+    FPortalTestWorld()
+    {
+        World = UWorld::CreateWorld(EWorldType::Game, false);
+        FWorldContext& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+        WorldContext.SetCurrentWorld(World);
+
+        World->SetGameMode(FURL());
+        World->InitializeActorsForPlay(FURL());
+        World->BeginPlay();
+    }
+
+    ~FPortalTestWorld()
+    {
+        GEngine->DestroyWorldContext(World);
+        World->DestroyWorld(false);
+    }
+
+    UWorld* Get() const { return World; }
+
+    /** Portal with a bare surface mesh as its root, like the blueprint's, facing Rotation */
+    APortal* SpawnPortal(const FVector& Location, const FRotator& Rotation = FRotator::ZeroRotator) const
+    {
+        APortal* Portal = World->SpawnActorDeferred<APortal>(APortal::StaticClass(), FTransform(Rotation, Location));
+        UStaticMeshComponent* Surface = NewObject<UStaticMeshComponent>(Portal, TEXT("PortalSurface"));
+        Portal->SetRootComponent(Surface);
+        Surface->RegisterComponent();
+        Portal->FinishSpawning(FTransform(Rotation, Location));
+        return Portal;
+    }
+
+    /** Local player controller without a player, seen as local in a standalone world */
+    APlayerController* SpawnPlayerController() const
+    {
+        return World->SpawnActor<APlayerController>();
+    }
+
+private:
+    UWorld* World;
+};
+
+#endif
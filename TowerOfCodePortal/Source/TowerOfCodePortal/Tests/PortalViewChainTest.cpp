@@ -0,0 +1,83 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "PortalTestWorld.h"
+#include "PortalRegistrySubsystem.h"
+#include "PortalViewExtension.h"
+#include "Math/RandomStream.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FPortalViewChainTest, "TowerOfCode.Portal.ViewChain",
+    EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FPortalViewChainTest::RunTest(const FString& Parameters)
+{
+    FPortalTestWorld TestWorld;
+    UPortalRegistrySubsystem* Registry = TestWorld.Get()->GetSubsystem<UPortalRegistrySubsystem>();
+    if (!TestNotNull(TEXT("Registry"), Registry))
+        return false;
+
+    // A wall portal linked to a tilted one, so every level turns the camera on all axes
+    APortal* Portal = TestWorld.SpawnPortal(FVector(0.f, 0.f, 100.f));
+    APortal* Link = TestWorld.SpawnPortal(FVector(2000.f, 500.f, 300.f), FRotator(30.f, 120.f, 10.f));
+    Portal->SurfaceExtent = FVector2D(100.f, 100.f);
+    Link->SurfaceExtent = FVector2D(100.f, 100.f);
+    Portal->SetLink(Link);
+    Link->SetLink(Portal);
+
+    const FPortalPairTransform* Pair = Registry->FindPortalPair(Portal);
+    if (!TestNotNull(TEXT("Pair transform"), Pair))
+        return false;
+
+    const int32 MaxDepth = 5;
+    FRandomStream Random(1234);
+    TArray<FPortalView> Views;
+
+    for (int32 Sample = 0; Sample < 32; Sample++)
+    {
+        // Cameras in front of the portal, roughly looking at it
+        const FVector Location = Portal->GetActorLocation()
+            + Portal->GetActorForwardVector() * Random.FRandRange(50.f, 2000.f)
+            + Random.GetUnitVector() * 300.f;
+        const FQuat Rotation = FRotator(
+            Random.FRandRange(-60.f, 60.f),
+            Random.FRandRange(0.f, 360.f),
+            Random.FRandRange(-10.f, 10.f)).Quaternion();
+
+        FPortalViewExtension::BuildViewChain(*Pair, FTransform(Rotation, Location), MaxDepth, Views);
+        if (!TestEqual(TEXT("Levels"), Views.Num(), MaxDepth))
+            return false;
+
+        // Deepest first, each level one more pass through the pair as the portal's own recursion does it
+        FVector ExpectedLocation = Location;
+        FQuat ExpectedRotation = Rotation;
+        for (int32 Depth = 1; Depth <= MaxDepth; Depth++)
+        {
+            ExpectedLocation = Link->GetActorLocation() + Portal->ConvertVectorToOppositeSpace(ExpectedLocation - Portal->GetActorLocation());
+            ExpectedRotation = Portal->ConvertQuatToOppositeSpace(ExpectedRotation);
+
+            const FPortalView& View = Views[MaxDepth - Depth];
+            const FString Level = FString::Printf(TEXT("Sample %d, depth %d"), Sample, Depth);
+            TestEqual(Level + TEXT(" order"), View.Depth, Depth);
+            TestTrue(Level + TEXT(" location"), View.CameraTransform.GetLocation().Equals(ExpectedLocation, 0.5f));
+            TestTrue(Level + TEXT(" rotation"), View.CameraTransform.GetRotation().AngularDistance(ExpectedRotation) < 0.01f);
+
+            // The view matrix puts what's ahead of the camera on +Z, its right on +X and its up on +Y
+            const FVector Ahead = View.ViewMatrix.TransformPosition(ExpectedLocation + ExpectedRotation.GetForwardVector() * 100.f);
+            const FVector Right = View.ViewMatrix.TransformPosition(ExpectedLocation + ExpectedRotation.GetRightVector() * 100.f);
+            const FVector Up = View.ViewMatrix.TransformPosition(ExpectedLocation + ExpectedRotation.GetUpVector() * 100.f);
+            TestTrue(Level + TEXT(" view depth"), Ahead.Equals(FVector(0.f, 0.f, 100.f), 0.5f));
+            TestTrue(Level + TEXT(" view right"), Right.Equals(FVector(100.f, 0.f, 0.f), 0.5f));
+            TestTrue(Level + TEXT(" view up"), Up.Equals(FVector(0.f, 100.f, 0.f), 0.5f));
+        }
+    }
+
+    FPortalViewExtension::BuildViewChain(*Pair, FTransform::Identity, 0, Views);
+    TestEqual(TEXT("No levels"), Views.Num(), 0);
+
+    return true;
+}
+
+#endif
@@ -0,0 +1,64 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "PortalTestWorld.h"
+#include "PortalRegistrySubsystem.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FPortalViewerCameraTest, "TowerOfCode.Portal.ViewerCamera",
+    EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FPortalViewerCameraTest::RunTest(const FString& Parameters)
+{
+    FPortalTestWorld TestWorld;
+    UPortalRegistrySubsystem* Registry = TestWorld.Get()->GetSubsystem<UPortalRegistrySubsystem>();
+    if (!TestNotNull(TEXT("Registry"), Registry))
+        return false;
+
+    APortal* Portal = TestWorld.SpawnPortal(FVector::ZeroVector);
+    APortal* Link = TestWorld.SpawnPortal(FVector(0.f, 1000.f, 200.f), FRotator(0.f, 150.f, 0.f));
+    Portal->SetLink(Link);
+    Link->SetLink(Portal);
+
+    const FPortalPairTransform* Pair = Registry->FindPortalPair(Portal);
+    if (!TestNotNull(TEXT("Pair transform"), Pair))
+        return false;
+
+    // Split-screen players in front of the portal, both looking into it from different places
+    APlayerController* Players[] = { TestWorld.SpawnPlayerController(), TestWorld.SpawnPlayerController() };
+    const FTransform Cameras[] =
+    {
+        FTransform(FRotator(0.f, 180.f, 0.f), FVector(300.f, -50.f, 20.f)),
+        FTransform(FRotator(10.f, 160.f, 5.f), FVector(800.f, 200.f, -40.f)),
+    };
+    for (int32 ViewerIndex = 0; ViewerIndex < 2; ViewerIndex++)
+    {
+        Portal->UpdateCaptureFromView(Players[ViewerIndex], Cameras[ViewerIndex].GetLocation(), Cameras[ViewerIndex].GetRotation(), 90.f);
+    }
+    if (!TestEqual(TEXT("Viewers"), Portal->GetViewerCount(), 2))
+        return false;
+
+    // Each viewer's first level is its own camera moved through the pair once
+    const FQuat ToLinkRotation(Pair->ToLink.RemoveTranslation());
+    for (int32 ViewerIndex = 0; ViewerIndex < 2; ViewerIndex++)
+    {
+        const FTransform Virtual = Portal->GetViewerCameraTransform(ViewerIndex);
+        const FVector ExpectedLocation = Pair->ToLink.TransformPosition(Cameras[ViewerIndex].GetLocation());
+        const FQuat ExpectedRotation = ToLinkRotation * Cameras[ViewerIndex].GetRotation();
+        TestTrue(FString::Printf(TEXT("Viewer %d location is %.2f cm off"), ViewerIndex, FVector::Dist(Virtual.GetLocation(), ExpectedLocation)),
+            Virtual.GetLocation().Equals(ExpectedLocation, 0.5f));
+        TestTrue(FString::Printf(TEXT("Viewer %d rotation"), ViewerIndex),
+            Virtual.GetRotation().AngularDistance(ExpectedRotation) < 0.01f);
+    }
+
+    // The second viewer didn't overwrite the first one's camera
+    TestFalse(TEXT("Separate virtual cameras"),
+        Portal->GetViewerCameraTransform(0).GetLocation().Equals(Portal->GetViewerCameraTransform(1).GetLocation(), 1.f));
+    TestTrue(TEXT("No camera past the viewers"), Portal->GetViewerCameraTransform(2).Equals(FTransform::Identity));
+
+    return true;
+}
+
+#endif
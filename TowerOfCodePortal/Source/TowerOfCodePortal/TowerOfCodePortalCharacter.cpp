@@ -2,12 +2,19 @@
 
 #include "TowerOfCodePortalCharacter.h"
 #include "TowerOfCodePortalProjectile.h"
+#include "InputRecorderComponent.h"
+#include "Portal.h"
+#include "PortalPlacementSubsystem.h"
+#include "PortalTrajectoryPredictor.h"
 #include "Animation/AnimInstance.h"
 #include "Camera/CameraComponent.h"
 #include "Components/CapsuleComponent.h"
 #include "Components/InputComponent.h"
 #include "GameFramework/InputSettings.h"
+#include "GameFramework/CharacterMovementComponent.h"
 #include "GameFramework/Controller.h"
+#include "GameFramework/ProjectileMovementComponent.h"
+#include "Components/SphereComponent.h"
 #include "HeadMountedDisplayFunctionLibrary.h"
 #include "Kismet/GameplayStatics.h"
 #include "MotionControllerComponent.h"
@@ -57,6 +64,11 @@ ATowerOfCodePortalCharacter::ATowerOfCodePortalCharacter()
 	// Default offset from the character location for projectiles to spawn
 	GunOffset = FVector(100.0f, 0.0f, 10.0f);
 
+	bPreviewTrajectory = false;
+	PreviewPortalHops = 4;
+	bFirePlacesPortals = false;
+	NextPortalIndex = 0;
+
 	// Note: The ProjectileClass and the skeletal mesh/anim blueprints for Mesh1P, FP_Gun, and VR_Gun 
 	// are set in the derived blueprint asset named MyCharacter to avoid direct content references in C++.
 
@@ -81,6 +93,12 @@ ATowerOfCodePortalCharacter::ATowerOfCodePortalCharacter()
 	VR_MuzzleLocation->SetRelativeLocation(FVector(0.000004, 53.999992, 10.000000));
 	VR_MuzzleLocation->SetRelativeRotation(FRotator(0.0f, 90.0f, 0.0f));		// Counteract the rotation of the VR gun model.
 
+	InputRecorder = CreateDefaultSubobject<UInputRecorderComponent>(TEXT("InputRecorder"));
+
+	MaxPortalTeleportDistance = 300.f;
+	LastPortalTeleportTimeStamp = 0.f;
+	bRecoveringRotation = false;
+
 	// Uncomment the following line to turn motion controllers on by default:
 	//bUsingMotionControllers = true;
 }
@@ -104,53 +122,212 @@ void ATowerOfCodePortalCharacter::BeginPlay()
 		VR_Gun->SetHiddenInGame(true, true);
 		Mesh1P->SetHiddenInGame(false, true);
 	}
+
+	UpdateActorTickEnabled();
+
+	// Spawns the pooled portals and their captures before the first shot instead of on it
+	if (bFirePlacesPortals)
+	{
+		if (UPortalPlacementSubsystem* Placement = GetWorld()->GetSubsystem<UPortalPlacementSubsystem>())
+		{
+			Placement->ReservePool();
+		}
+	}
 }
 
 void ATowerOfCodePortalCharacter::Tick(float DeltaSeconds)
 {
     Super::Tick(DeltaSeconds);
-    float Threshold = 1.f;
-
-    FRotator ControllerRotation = GetController()->GetControlRotation();
-    FRotator NewControllerRotation = FRotator(
-        ControllerRotation.Pitch, 
-        ControllerRotation.Yaw, 
-        ControllerRotation.Roll - GetRecoveryDelta(
-            ControllerRotation.Roll, 
-            RollRecoverySpeed, 
-            Threshold)
-    );
-
-    FRotator ActorRotation = GetActorRotation();
-    FRotator NewActorRotation = FRotator(
-        ActorRotation.Pitch - GetRecoveryDelta(
-            ActorRotation.Pitch, 
-            RollRecoverySpeed, 
-            Threshold), 
-        ActorRotation.Yaw, 
-        ActorRotation.Roll - GetRecoveryDelta(
-            ActorRotation.Roll, 
-            RollRecoverySpeed, 
-            Threshold)
-    );
-
-    GetController()->SetControlRotation(NewControllerRotation);
-    SetActorRotation(NewActorRotation);
+
+    if (bPreviewTrajectory && IsLocallyControlled())
+    {
+        DrawTrajectoryPreview();
+    }
+
+    if (bRecoveringRotation && RecoverRotation(DeltaSeconds))
+    {
+        bRecoveringRotation = false;
+        UpdateActorTickEnabled();
+    }
 }
 
-float ATowerOfCodePortalCharacter::GetRecoveryDelta(float Target, float RecoverySpeed, float Threshold)
+void ATowerOfCodePortalCharacter::SetPreviewTrajectory(bool bNewPreviewTrajectory)
 {
-    float Delta = 0.f;
+    bPreviewTrajectory = bNewPreviewTrajectory;
+    UpdateActorTickEnabled();
+}
+
+void ATowerOfCodePortalCharacter::UpdateActorTickEnabled()
+{
+    SetActorTickEnabled(bPreviewTrajectory || bRecoveringRotation);
+}
+
+void ATowerOfCodePortalCharacter::OnPortalTeleported()
+{
+    if (bRecoveringRotation)
+        return;
+
+    // Nothing to do for portals on walls facing each other, the usual case
+    const FRotator ActorRotation = GetActorRotation();
+    const AController* CharacterController = GetController();
+    const float ControlRoll = CharacterController != nullptr ? CharacterController->GetControlRotation().Roll : 0.f;
+    if (FMath::IsNearlyZero(FRotator::NormalizeAxis(ActorRotation.Pitch))
+        && FMath::IsNearlyZero(FRotator::NormalizeAxis(ActorRotation.Roll))
+        && FMath::IsNearlyZero(FRotator::NormalizeAxis(ControlRoll)))
+        return;
+
+    bRecoveringRotation = true;
+    UpdateActorTickEnabled();
+}
+
+bool ATowerOfCodePortalCharacter::RecoverRotation(float DeltaSeconds)
+{
+    const float Threshold = 1.f;
+
+    // The same decay at any frame rate, RollRecoverySpeed is what a 60 fps frame takes off
+    const float Alpha = 1.f - FMath::Pow(1.f - FMath::Clamp(RollRecoverySpeed, 0.f, 1.f), DeltaSeconds * 60.f);
+
+    bool bRecovered = true;
+
+    AController* CharacterController = GetController();
+    if (CharacterController != nullptr)
+    {
+        const FRotator ControllerRotation = CharacterController->GetControlRotation();
+        const float Roll = GetRecoveredAngle(ControllerRotation.Roll, Alpha, Threshold);
+        if (Roll != ControllerRotation.Roll)
+        {
+            CharacterController->SetControlRotation(FRotator(ControllerRotation.Pitch, ControllerRotation.Yaw, Roll));
+        }
+        bRecovered &= Roll == 0.f;
+    }
 
-    if (Target > 180)
-        Target -= 360;
-    Delta = Target / (1.f / RecoverySpeed);
-    if (FMath::Abs(Target) < Threshold)
+    const FRotator ActorRotation = GetActorRotation();
+    const float Pitch = GetRecoveredAngle(ActorRotation.Pitch, Alpha, Threshold);
+    const float Roll = GetRecoveredAngle(ActorRotation.Roll, Alpha, Threshold);
+    if (Pitch != ActorRotation.Pitch || Roll != ActorRotation.Roll)
     {
-        Delta = Target;
+        SetActorRotation(FRotator(Pitch, ActorRotation.Yaw, Roll));
     }
+    bRecovered &= Pitch == 0.f && Roll == 0.f;
+
+    return bRecovered;
+}
+
+float ATowerOfCodePortalCharacter::GetRecoveredAngle(float Angle, float Alpha, float Threshold)
+{
+    Angle = FRotator::NormalizeAxis(Angle);
+    if (FMath::Abs(Angle) < Threshold)
+        return 0.f;
+
+    return Angle * (1.f - Alpha);
+}
+
+bool ATowerOfCodePortalCharacter::CanPredictPortalTeleport() const
+{
+	return GetNetMode() == NM_Standalone || IsLocallyControlled();
+}
+
+void ATowerOfCodePortalCharacter::OnPortalTeleportPredicted(APortal* Portal, const FVector& Offset)
+{
+	if (HasAuthority())
+		return;
+
+	// Moves made before the teleport must reach the server ahead of the event
+	GetCharacterMovement()->FlushServerMoves();
+
+	FNetworkPredictionData_Client_Character* ClientData = GetCharacterMovement()->GetPredictionData_Client_Character();
+	const float TimeStamp = ClientData != nullptr ? ClientData->CurrentTimeStamp : GetWorld()->GetTimeSeconds();
+
+	UPortalPlacementSubsystem* Placement = GetWorld()->GetSubsystem<UPortalPlacementSubsystem>();
+	const int32 PoolSlot = Placement != nullptr ? Placement->GetPoolSlot(Portal) : INDEX_NONE;
+
+	ServerPortalTeleport(PoolSlot == INDEX_NONE ? Portal : nullptr, PoolSlot, Offset, TimeStamp);
+}
+
+bool ATowerOfCodePortalCharacter::ShouldAcceptPortalTeleport(const APortal* Portal, const FVector& Location, float TimeStamp, float LastTimeStamp, float MaxDistance)
+{
+	const bool bIsNewEvent =
+		TimeStamp > LastTimeStamp
+		|| LastTimeStamp - TimeStamp > 10.f;
+
+	return bIsNewEvent
+		&& Portal != nullptr
+		&& Portal->Link != nullptr
+		&& FVector::Dist(Location, Portal->GetActorLocation()) < MaxDistance;
+}
+
+bool ATowerOfCodePortalCharacter::ServerPortalTeleport_Validate(APortal* Portal, int32 PoolSlot, const FVector_NetQuantize10& Offset, float TimeStamp)
+{
+	// Only what no honest client sends, a portal that moved or a late event is rejected without a kick
+	return PoolSlot >= INDEX_NONE
+		&& FMath::IsFinite(TimeStamp)
+		&& TimeStamp >= 0.f
+		&& !Offset.ContainsNaN()
+		&& Offset.SizeSquared() < FMath::Square(MaxPortalTeleportDistance);
+}
+
+void ATowerOfCodePortalCharacter::ServerPortalTeleport_Implementation(APortal* Portal, int32 PoolSlot, const FVector_NetQuantize10& Offset, float TimeStamp)
+{
+	if (PoolSlot != INDEX_NONE)
+	{
+		UPortalPlacementSubsystem* Placement = GetWorld()->GetSubsystem<UPortalPlacementSubsystem>();
+		Portal = Placement != nullptr ? Placement->GetPooledPortal(PoolSlot) : nullptr;
+	}
+
+	if (ShouldAcceptPortalTeleport(Portal, GetActorLocation(), TimeStamp, LastPortalTeleportTimeStamp, MaxPortalTeleportDistance))
+	{
+		Portal->ApplyTeleport(this, Offset);
+		LastPortalTeleportTimeStamp = TimeStamp;
+		return;
+	}
+
+	// The client already moved through, the regular movement correction would only catch up after its next moves
+	const AController* OwningController = GetController();
+	ClientRejectPortalTeleport(
+		TimeStamp,
+		GetActorLocation(),
+		GetActorRotation(),
+		OwningController != nullptr ? OwningController->GetControlRotation() : GetActorRotation(),
+		GetCharacterMovement()->Velocity);
+}
 
-    return Delta;
+bool ATowerOfCodePortalCharacter::ServerPlacePortal_Validate(int32 PortalIndex, const FVector_NetQuantize10& ImpactPoint, const FVector_NetQuantizeNormal& ImpactNormal, const FVector_NetQuantizeNormal& UpHint)
+{
+	return (PortalIndex == 0 || PortalIndex == 1)
+		&& !ImpactPoint.ContainsNaN()
+		&& !ImpactNormal.ContainsNaN()
+		&& !UpHint.ContainsNaN();
+}
+
+void ATowerOfCodePortalCharacter::ServerPlacePortal_Implementation(int32 PortalIndex, const FVector_NetQuantize10& ImpactPoint, const FVector_NetQuantizeNormal& ImpactNormal, const FVector_NetQuantizeNormal& UpHint)
+{
+	UPortalPlacementSubsystem* Placement = GetWorld()->GetSubsystem<UPortalPlacementSubsystem>();
+	if (Placement == nullptr)
+		return;
+
+	// A few cm on both sides of the reported point cover the quantization
+	const float SurfaceSearchDepth = 10.f;
+	FCollisionQueryParams Params(SCENE_QUERY_STAT(ServerPlacePortal), false, this);
+	FHitResult Hit;
+	if (!GetWorld()->LineTraceSingleByChannel(Hit, ImpactPoint + ImpactNormal * SurfaceSearchDepth, ImpactPoint - ImpactNormal * SurfaceSearchDepth, ECC_Visibility, Params))
+		return;
+
+	Placement->PlacePortal(this, PortalIndex, Hit, UpHint);
+}
+
+void ATowerOfCodePortalCharacter::ClientRejectPortalTeleport_Implementation(float TimeStamp, const FVector_NetQuantize100& Location, const FRotator& Rotation, const FRotator& ControlRotation, const FVector_NetQuantize10& Velocity)
+{
+	UE_LOG(LogFPChar, Warning, TEXT("Server rejected the portal teleport predicted at %.3f"), TimeStamp);
+
+	SetActorLocationAndRotation(Location, Rotation, false, nullptr, ETeleportType::TeleportPhysics);
+	GetCharacterMovement()->Velocity = Velocity;
+	if (Controller != nullptr)
+	{
+		Controller->SetControlRotation(ControlRotation);
+	}
+
+	// Moves saved since the teleport start from the wrong side of the portal
+	GetCharacterMovement()->ResetPredictionData_Client();
 }
 
 //////////////////////////////////////////////////////////////////////////
@@ -162,8 +339,8 @@ void ATowerOfCodePortalCharacter::SetupPlayerInputComponent(class UInputComponen
 	check(PlayerInputComponent);
 
 	// Bind jump events
-	PlayerInputComponent->BindAction("Jump", IE_Pressed, this, &ACharacter::Jump);
-	PlayerInputComponent->BindAction("Jump", IE_Released, this, &ACharacter::StopJumping);
+	PlayerInputComponent->BindAction("Jump", IE_Pressed, this, &ATowerOfCodePortalCharacter::OnJumpPressed);
+	PlayerInputComponent->BindAction("Jump", IE_Released, this, &ATowerOfCodePortalCharacter::OnJumpReleased);
 
 	// Bind fire event
 	PlayerInputComponent->BindAction("Fire", IE_Pressed, this, &ATowerOfCodePortalCharacter::OnFire);
@@ -180,25 +357,82 @@ void ATowerOfCodePortalCharacter::SetupPlayerInputComponent(class UInputComponen
 	// We have 2 versions of the rotation bindings to handle different kinds of devices differently
 	// "turn" handles devices that provide an absolute delta, such as a mouse.
 	// "turnrate" is for devices that we choose to treat as a rate of change, such as an analog joystick
-	PlayerInputComponent->BindAxis("Turn", this, &APawn::AddControllerYawInput);
+	PlayerInputComponent->BindAxis("Turn", this, &ATowerOfCodePortalCharacter::Turn);
 	PlayerInputComponent->BindAxis("TurnRate", this, &ATowerOfCodePortalCharacter::TurnAtRate);
-	PlayerInputComponent->BindAxis("LookUp", this, &APawn::AddControllerPitchInput);
+	PlayerInputComponent->BindAxis("LookUp", this, &ATowerOfCodePortalCharacter::LookUp);
 	PlayerInputComponent->BindAxis("LookUpRate", this, &ATowerOfCodePortalCharacter::LookUpAtRate);
+
+	// The same handlers are driven by the recorder while replaying
+	InputRecorder->BindAction(EInputRecordAction::Jump, true, FInputRecordActionHandler::CreateUObject(this, &ATowerOfCodePortalCharacter::OnJumpPressed));
+	InputRecorder->BindAction(EInputRecordAction::Jump, false, FInputRecordActionHandler::CreateUObject(this, &ATowerOfCodePortalCharacter::OnJumpReleased));
+	InputRecorder->BindAction(EInputRecordAction::Fire, true, FInputRecordActionHandler::CreateUObject(this, &ATowerOfCodePortalCharacter::OnFire));
+	InputRecorder->BindAxis(EInputRecordAxis::MoveForward, FInputRecordAxisHandler::CreateUObject(this, &ATowerOfCodePortalCharacter::MoveForward));
+	InputRecorder->BindAxis(EInputRecordAxis::MoveRight, FInputRecordAxisHandler::CreateUObject(this, &ATowerOfCodePortalCharacter::MoveRight));
+	InputRecorder->BindAxis(EInputRecordAxis::Turn, FInputRecordAxisHandler::CreateUObject(this, &ATowerOfCodePortalCharacter::Turn));
+	InputRecorder->BindAxis(EInputRecordAxis::TurnRate, FInputRecordAxisHandler::CreateUObject(this, &ATowerOfCodePortalCharacter::TurnAtRate));
+	InputRecorder->BindAxis(EInputRecordAxis::LookUp, FInputRecordAxisHandler::CreateUObject(this, &ATowerOfCodePortalCharacter::LookUp));
+	InputRecorder->BindAxis(EInputRecordAxis::LookUpRate, FInputRecordAxisHandler::CreateUObject(this, &ATowerOfCodePortalCharacter::LookUpAtRate));
+}
+
+void ATowerOfCodePortalCharacter::OnJumpPressed()
+{
+	if (!InputRecorder->FilterAction(EInputRecordAction::Jump, true))
+		return;
+
+	Jump();
+}
+
+void ATowerOfCodePortalCharacter::OnJumpReleased()
+{
+	if (!InputRecorder->FilterAction(EInputRecordAction::Jump, false))
+		return;
+
+	StopJumping();
+}
+
+void ATowerOfCodePortalCharacter::DrawTrajectoryPreview()
+{
+	if (ProjectileClass == nullptr)
+		return;
+
+	const ATowerOfCodePortalProjectile* Projectile = ProjectileClass.GetDefaultObject();
+	const UProjectileMovementComponent* Movement = Projectile->GetProjectileMovement();
+
+	const FRotator SpawnRotation = bUsingMotionControllers ? VR_MuzzleLocation->GetComponentRotation() : GetControlRotation();
+	const FVector SpawnLocation = bUsingMotionControllers
+		? VR_MuzzleLocation->GetComponentLocation()
+		: ((FP_MuzzleLocation != nullptr) ? FP_MuzzleLocation->GetComponentLocation() : GetActorLocation()) + SpawnRotation.RotateVector(GunOffset);
+
+	FPortalTrajectoryParams Params;
+	Params.StartLocation = SpawnLocation;
+	Params.LaunchVelocity = SpawnRotation.Vector() * Movement->InitialSpeed;
+	Params.GravityZ = GetWorld()->GetGravityZ() * Movement->ProjectileGravityScale;
+	Params.ProjectileRadius = Projectile->GetCollisionComp()->GetUnscaledSphereRadius();
+	Params.MaxPortalHops = PreviewPortalHops;
+	Params.ActorsToIgnore.Add(this);
+
+	FPortalTrajectoryResult Result;
+	UPortalTrajectoryPredictor::PredictPortalTrajectory(this, Params, Result);
+	UPortalTrajectoryPredictor::DrawPortalTrajectory(this, Result, FLinearColor::Green, 0.f);
 }
 
 void ATowerOfCodePortalCharacter::OnFire()
 {
+	if (!InputRecorder->FilterAction(EInputRecordAction::Fire, true))
+		return;
+
 	// try and fire a projectile
 	if (ProjectileClass != nullptr)
 	{
 		UWorld* const World = GetWorld();
 		if (World != nullptr)
 		{
+			ATowerOfCodePortalProjectile* Projectile = nullptr;
 			if (bUsingMotionControllers)
 			{
 				const FRotator SpawnRotation = VR_MuzzleLocation->GetComponentRotation();
 				const FVector SpawnLocation = VR_MuzzleLocation->GetComponentLocation();
-				World->SpawnActor<ATowerOfCodePortalProjectile>(ProjectileClass, SpawnLocation, SpawnRotation);
+				Projectile = World->SpawnActor<ATowerOfCodePortalProjectile>(ProjectileClass, SpawnLocation, SpawnRotation);
 			}
 			else
 			{
@@ -211,7 +445,14 @@ void ATowerOfCodePortalCharacter::OnFire()
 				ActorSpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButDontSpawnIfColliding;
 
 				// spawn the projectile at the muzzle
-				World->SpawnActor<ATowerOfCodePortalProjectile>(ProjectileClass, SpawnLocation, SpawnRotation, ActorSpawnParams);
+				Projectile = World->SpawnActor<ATowerOfCodePortalProjectile>(ProjectileClass, SpawnLocation, SpawnRotation, ActorSpawnParams);
+			}
+
+			if (Projectile != nullptr && bFirePlacesPortals)
+			{
+				Projectile->SetInstigator(this);
+				Projectile->PortalIndex = NextPortalIndex;
+				NextPortalIndex = 1 - NextPortalIndex;
 			}
 		}
 	}
@@ -304,6 +545,9 @@ void ATowerOfCodePortalCharacter::EndTouch(const ETouchIndex::Type FingerIndex,
 
 void ATowerOfCodePortalCharacter::MoveForward(float Value)
 {
+	if (!InputRecorder->FilterAxis(EInputRecordAxis::MoveForward, Value))
+		return;
+
 	if (Value != 0.0f)
 	{
 		// add movement in that direction
@@ -313,6 +557,9 @@ void ATowerOfCodePortalCharacter::MoveForward(float Value)
 
 void ATowerOfCodePortalCharacter::MoveRight(float Value)
 {
+	if (!InputRecorder->FilterAxis(EInputRecordAxis::MoveRight, Value))
+		return;
+
 	if (Value != 0.0f)
 	{
 		// add movement in that direction
@@ -320,14 +567,36 @@ void ATowerOfCodePortalCharacter::MoveRight(float Value)
 	}
 }
 
+void ATowerOfCodePortalCharacter::Turn(float Value)
+{
+	if (!InputRecorder->FilterAxis(EInputRecordAxis::Turn, Value))
+		return;
+
+	AddControllerYawInput(Value);
+}
+
+void ATowerOfCodePortalCharacter::LookUp(float Value)
+{
+	if (!InputRecorder->FilterAxis(EInputRecordAxis::LookUp, Value))
+		return;
+
+	AddControllerPitchInput(Value);
+}
+
 void ATowerOfCodePortalCharacter::TurnAtRate(float Rate)
 {
+	if (!InputRecorder->FilterAxis(EInputRecordAxis::TurnRate, Rate))
+		return;
+
 	// calculate delta for this frame from the rate information
 	AddControllerYawInput(Rate * BaseTurnRate * GetWorld()->GetDeltaSeconds());
 }
 
 void ATowerOfCodePortalCharacter::LookUpAtRate(float Rate)
 {
+	if (!InputRecorder->FilterAxis(EInputRecordAxis::LookUpRate, Rate))
+		return;
+
 	// calculate delta for this frame from the rate information
 	AddControllerPitchInput(Rate * BaseLookUpRate * GetWorld()->GetDeltaSeconds());
 }
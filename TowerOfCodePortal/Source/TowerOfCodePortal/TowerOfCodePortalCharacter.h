@@ -4,6 +4,7 @@
 
 #include "CoreMinimal.h"
 #include "GameFramework/Character.h"
+#include "Engine/NetSerialization.h"
 #include "TowerOfCodePortalCharacter.generated.h"
 
 class UInputComponent;
@@ -13,6 +14,8 @@ class UCameraComponent;
 class UMotionControllerComponent;
 class UAnimMontage;
 class USoundBase;
+class UInputRecorderComponent;
+class APortal;
 
 UCLASS(config=Game)
 class ATowerOfCodePortalCharacter : public ACharacter
@@ -51,6 +54,10 @@ class ATowerOfCodePortalCharacter : public ACharacter
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, meta = (AllowPrivateAccess = "true"))
 	UMotionControllerComponent* L_MotionController;
 
+	/** Records or replays the input bindings for repeatable performance runs */
+	UPROPERTY(VisibleDefaultsOnly, Category = Input)
+	UInputRecorderComponent* InputRecorder;
+
 public:
 	ATowerOfCodePortalCharacter();
 
@@ -58,7 +65,14 @@ protected:
 	virtual void BeginPlay();
     virtual void Tick(float DeltaSeconds);
 
-    float GetRecoveryDelta(float Target, float RecoverySpeed, float Threshold);
+    /** Moves roll and pitch towards zero, @returns true once both are there */
+    bool RecoverRotation(float DeltaSeconds);
+
+    /** Angle after decaying by Alpha, snapped to zero below Threshold degrees */
+    static float GetRecoveredAngle(float Angle, float Alpha, float Threshold);
+
+    /** Ticks only while previewing the trajectory or recovering */
+    void UpdateActorTickEnabled();
 
 public:
 	/** Base turn rate, in deg/sec. Other scaling may affect final turn rate. */
@@ -77,6 +91,21 @@ public:
 	UPROPERTY(EditDefaultsOnly, Category=Projectile)
 	TSubclassOf<class ATowerOfCodePortalProjectile> ProjectileClass;
 
+	/** Draws where a fired projectile would go, following it through portals. Use SetPreviewTrajectory during play */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category=Projectile)
+	bool bPreviewTrajectory;
+
+	UFUNCTION(BlueprintCallable, Category=Projectile)
+	void SetPreviewTrajectory(bool bNewPreviewTrajectory);
+
+	/** Portals the trajectory preview follows the projectile through */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category=Projectile)
+	int32 PreviewPortalHops;
+
+	/** Fired projectiles place this character's two portals, alternating between them */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category=Projectile)
+	bool bFirePlacesPortals;
+
 	/** Sound to play each time we fire */
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category=Gameplay)
 	USoundBase* FireSound;
@@ -89,14 +118,46 @@ public:
 	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Gameplay)
 	uint8 bUsingMotionControllers : 1;
 
+    /** Fraction of the roll and pitch left by a teleport that is recovered every 1/60 s */
     UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Portal)
         float RollRecoverySpeed;
 
+    /** Called after a portal moved and rotated the character, starts recovering if it's left tilted */
+    void OnPortalTeleported();
+
+	/** Farthest from the source portal the server still accepts a teleport event, in cm */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Portal)
+	float MaxPortalTeleportDistance;
+
+	/** Whether this machine moves the character through portals itself */
+	bool CanPredictPortalTeleport() const;
+
+	/** Sends a teleport the owning client already applied to the server */
+	void OnPortalTeleportPredicted(APortal* Portal, const FVector& Offset);
+
+	/**
+	 * Whether the server applies a teleport event through Portal from a character at Location.
+	 * Client timestamps restart from zero now and then, so only recent older stamps count as duplicates.
+	 */
+	static bool ShouldAcceptPortalTeleport(const APortal* Portal, const FVector& Location, float TimeStamp, float LastTimeStamp, float MaxDistance);
+
+	/**
+	 * Places portal PortalIndex where a projectile fired on a client hit. The projectile only exists
+	 * on the client, so the server traces the reported surface again and checks it fits a portal.
+	 */
+	UFUNCTION(Server, Reliable, WithValidation)
+	void ServerPlacePortal(int32 PortalIndex, const FVector_NetQuantize10& ImpactPoint, const FVector_NetQuantizeNormal& ImpactNormal, const FVector_NetQuantizeNormal& UpHint);
+
 protected:
 	
+	void DrawTrajectoryPreview();
+
 	/** Fires a projectile. */
 	void OnFire();
 
+	void OnJumpPressed();
+	void OnJumpReleased();
+
 	/** Resets HMD orientation and position in VR. */
 	void OnResetVR();
 
@@ -106,6 +167,10 @@ protected:
 	/** Handles stafing movement, left and right */
 	void MoveRight(float Val);
 
+	/** Handles absolute yaw and pitch deltas such as a mouse */
+	void Turn(float Val);
+	void LookUp(float Val);
+
 	/**
 	 * Called via input to turn at a given rate.
 	 * @param Rate	This is a normalized rate, i.e. 1.0 means 100% of desired turn rate
@@ -131,6 +196,26 @@ protected:
 	void TouchUpdate(const ETouchIndex::Type FingerIndex, const FVector Location);
 	TouchData	TouchItem;
 	
+	/**
+	 * Compact teleport event, the server replays it instead of correcting the client's position.
+	 * Pooled portals can't be sent as actors, PoolSlot names them instead and Portal is only used when it's INDEX_NONE.
+	 */
+	UFUNCTION(Server, Reliable, WithValidation)
+	void ServerPortalTeleport(APortal* Portal, int32 PoolSlot, const FVector_NetQuantize10& Offset, float TimeStamp);
+
+	/** Puts a client whose teleport the server rejected back where the server has it */
+	UFUNCTION(Client, Reliable)
+	void ClientRejectPortalTeleport(float TimeStamp, const FVector_NetQuantize100& Location, const FRotator& Rotation, const FRotator& ControlRotation, const FVector_NetQuantize10& Velocity);
+
+	/** Client timestamp of the last teleport event the server applied */
+	float LastPortalTeleportTimeStamp;
+
+	/** Roll or pitch left by a teleport is being recovered */
+	bool bRecoveringRotation;
+
+	/** Portal the next shot places when bFirePlacesPortals is set */
+	int32 NextPortalIndex;
+
 protected:
 	// APawn interface
 	virtual void SetupPlayerInputComponent(UInputComponent* InputComponent) override;
@@ -3,6 +3,8 @@
 #include "TowerOfCodePortalProjectile.h"
 #include "GameFramework/ProjectileMovementComponent.h"
 #include "Components/SphereComponent.h"
+#include "PortalPlacementSubsystem.h"
+#include "TowerOfCodePortalCharacter.h"
 
 ATowerOfCodePortalProjectile::ATowerOfCodePortalProjectile() 
 {
@@ -29,10 +31,32 @@ ATowerOfCodePortalProjectile::ATowerOfCodePortalProjectile()
 
 	// Die after 3 seconds by default
 	InitialLifeSpan = 3.0f;
+
+	PortalIndex = INDEX_NONE;
 }
 
 void ATowerOfCodePortalProjectile::OnHit(UPrimitiveComponent* HitComp, AActor* OtherActor, UPrimitiveComponent* OtherComp, FVector NormalImpulse, const FHitResult& Hit)
 {
+	// Portal shots open a portal on the surface instead of bouncing off it
+	if (PortalIndex != INDEX_NONE && OtherActor != nullptr && OtherActor != this)
+	{
+		const FVector UpHint = Hit.TraceEnd - Hit.TraceStart;
+		if (GetNetMode() == NM_Client)
+		{
+			// Fired on this client only, the server places the replicated portal
+			if (ATowerOfCodePortalCharacter* Character = Cast<ATowerOfCodePortalCharacter>(GetInstigator()))
+			{
+				Character->ServerPlacePortal(PortalIndex, Hit.ImpactPoint, Hit.ImpactNormal, UpHint.GetSafeNormal());
+			}
+		}
+		else if (UPortalPlacementSubsystem* Placement = GetWorld()->GetSubsystem<UPortalPlacementSubsystem>())
+		{
+			Placement->PlacePortal(GetInstigator(), PortalIndex, Hit, UpHint);
+		}
+		Destroy();
+		return;
+	}
+
 	// Only add impulse and destroy projectile if we hit a physics
 	if ((OtherActor != nullptr) && (OtherActor != this) && (OtherComp != nullptr) && OtherComp->IsSimulatingPhysics())
 	{
@@ -25,6 +25,10 @@ class ATowerOfCodePortalProjectile : public AActor
 public:
 	ATowerOfCodePortalProjectile();
 
+	/** Which of the instigator's two portals to place where this hits, INDEX_NONE bounces off instead */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category=Projectile)
+	int32 PortalIndex;
+
 	/** called when projectile hits something */
 	UFUNCTION()
 	void OnHit(UPrimitiveComponent* HitComp, AActor* OtherActor, UPrimitiveComponent* OtherComp, FVector NormalImpulse, const FHitResult& Hit);
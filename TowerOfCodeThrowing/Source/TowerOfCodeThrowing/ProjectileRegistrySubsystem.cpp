@@ -0,0 +1,56 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ProjectileRegistrySubsystem.h"
+#include "TowerOfCodeThrowingProjectile.h"
+
+void UProjectileRegistrySubsystem::Deinitialize()
+{
+	Projectiles.Reset();
+	Snapshot.Reset();
+	bSnapshotDirty = true;
+
+	Super::Deinitialize();
+}
+
+void UProjectileRegistrySubsystem::Register(ATowerOfCodeThrowingProjectile* Projectile)
+{
+	check(IsInGameThread());
+
+	if (Projectile == nullptr)
+		return;
+
+	Projectiles.AddUnique(Projectile);
+	bSnapshotDirty = true;
+}
+
+void UProjectileRegistrySubsystem::Unregister(ATowerOfCodeThrowingProjectile* Projectile)
+{
+	check(IsInGameThread());
+
+	if (Projectiles.RemoveSingleSwap(Projectile) > 0)
+	{
+		bSnapshotDirty = true;
+	}
+}
+
+FProjectileRegistrySnapshotPtr UProjectileRegistrySubsystem::GetSnapshot()
+{
+	check(IsInGameThread());
+
+	// Readers keep their old snapshot alive through the shared pointer, so a new one is built instead of touching it
+	if (bSnapshotDirty || !Snapshot.IsValid())
+	{
+		TSharedPtr<FProjectileRegistrySnapshot, ESPMode::ThreadSafe> NewSnapshot = MakeShared<FProjectileRegistrySnapshot, ESPMode::ThreadSafe>();
+		NewSnapshot->Projectiles.Reserve(Projectiles.Num());
+		for (ATowerOfCodeThrowingProjectile* Projectile : Projectiles)
+		{
+			NewSnapshot->Projectiles.Add(Projectile);
+		}
+
+		Snapshot = NewSnapshot;
+		bSnapshotDirty = false;
+	}
+
+	return Snapshot;
+}
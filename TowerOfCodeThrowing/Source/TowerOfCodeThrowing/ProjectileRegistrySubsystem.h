@@ -0,0 +1,49 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "ProjectileRegistrySubsystem.generated.h"
+
+class ATowerOfCodeThrowingProjectile;
+
+/** Immutable view of the live projectiles at the time it was taken */
+struct FProjectileRegistrySnapshot
+{
+	TArray<const AActor*> Projectiles;
+};
+
+typedef TSharedPtr<const FProjectileRegistrySnapshot, ESPMode::ThreadSafe> FProjectileRegistrySnapshotPtr;
+
+/**
+ * Keeps track of the live projectiles of a world, so callers don't have to walk the actor list.
+ * Projectiles register themselves in BeginPlay and unregister in EndPlay.
+ *
+ * Snapshots are never modified once published. Take one on the game thread and hand it
+ * to worker threads, which can read it without locking while the registry keeps changing.
+ */
+UCLASS()
+class UProjectileRegistrySubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	virtual void Deinitialize() override;
+
+	void Register(ATowerOfCodeThrowingProjectile* Projectile);
+	void Unregister(ATowerOfCodeThrowingProjectile* Projectile);
+
+	/** Live projectiles, game thread only */
+	const TArray<ATowerOfCodeThrowingProjectile*>& GetProjectiles() const { return Projectiles; }
+
+	/** Snapshot of the live projectiles, rebuilt only if the registry changed since the last call. Game thread only. */
+	FProjectileRegistrySnapshotPtr GetSnapshot();
+
+private:
+	UPROPERTY(Transient)
+		TArray<ATowerOfCodeThrowingProjectile*> Projectiles;
+
+	FProjectileRegistrySnapshotPtr Snapshot;
+	bool bSnapshotDirty = true;
+};
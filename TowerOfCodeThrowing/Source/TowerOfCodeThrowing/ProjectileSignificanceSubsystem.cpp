@@ -0,0 +1,209 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ProjectileSignificanceSubsystem.h"
+#include "ProjectileRegistrySubsystem.h"
+#include "TowerOfCodeThrowingProjectile.h"
+#include "Camera/PlayerCameraManager.h"
+#include "Components/SphereComponent.h"
+#include "GameFramework/PlayerController.h"
+#include "GameFramework/ProjectileMovementComponent.h"
+
+UProjectileSignificanceSubsystem::UProjectileSignificanceSubsystem()
+{
+	OffscreenScale = 0.1f;
+	LocalInstigatorBonus = 0.05f;
+	MinVisualRadius = 20.f;
+
+	FProjectileSignificanceTier& Full = Tiers.AddDefaulted_GetRef();
+	Full.MinSignificance = 0.02f;
+
+	// Still on screen, so the jumps stay small
+	FProjectileSignificanceTier& Reduced = Tiers.AddDefaulted_GetRef();
+	Reduced.MinSignificance = 0.005f;
+	Reduced.TickInterval = 1.f / 30.f;
+	Reduced.MaxTravelPerTick = 15.f;
+
+	FProjectileSignificanceTier& Low = Tiers.AddDefaulted_GetRef();
+	Low.MinSignificance = 0.001f;
+	Low.TickInterval = 0.1f;
+	Low.MaxSimulationTimeStep = 0.1f;
+
+	FProjectileSignificanceTier& Minimal = Tiers.AddDefaulted_GetRef();
+	Minimal.TickInterval = 0.25f;
+	Minimal.MaxSimulationTimeStep = 0.125f;
+}
+
+void UProjectileSignificanceSubsystem::SetEnabled(bool bNewEnabled)
+{
+	if (bEnabled == bNewEnabled)
+		return;
+
+	bEnabled = bNewEnabled;
+	if (bEnabled)
+		return;
+
+	if (UProjectileRegistrySubsystem* Registry = GetWorld()->GetSubsystem<UProjectileRegistrySubsystem>())
+	{
+		for (ATowerOfCodeThrowingProjectile* Projectile : Registry->GetProjectiles())
+		{
+			ApplyTier(Projectile, INDEX_NONE);
+		}
+	}
+	TierCounts.Reset();
+}
+
+void UProjectileSignificanceSubsystem::Tick(float DeltaTime)
+{
+	UProjectileRegistrySubsystem* Registry = GetWorld()->GetSubsystem<UProjectileRegistrySubsystem>();
+	if (Registry == nullptr)
+		return;
+
+	GatherViewers();
+
+	TierCounts.Reset();
+	TierCounts.SetNumZeroed(Tiers.Num());
+	for (ATowerOfCodeThrowingProjectile* Projectile : Registry->GetProjectiles())
+	{
+		const int32 TierIndex = SelectTier(GetSignificance(Projectile));
+		if (TierIndex != INDEX_NONE)
+		{
+			TierCounts[TierIndex]++;
+		}
+		ApplyTier(Projectile, TierIndex);
+	}
+}
+
+ETickableTickType UProjectileSignificanceSubsystem::GetTickableTickType() const
+{
+	return IsTemplate() ? ETickableTickType::Never : ETickableTickType::Conditional;
+}
+
+bool UProjectileSignificanceSubsystem::IsTickable() const
+{
+	const UWorld* World = GetWorld();
+	return bEnabled && World != nullptr && World->IsGameWorld();
+}
+
+TStatId UProjectileSignificanceSubsystem::GetStatId() const
+{
+	RETURN_QUICK_DECLARE_CYCLE_STAT(UProjectileSignificanceSubsystem, STATGROUP_Tickables);
+}
+
+float UProjectileSignificanceSubsystem::GetSignificance(const ATowerOfCodeThrowingProjectile* Projectile) const
+{
+	const FVector Location = Projectile->GetActorLocation();
+	const float Radius = FMath::Max(MinVisualRadius, Projectile->GetCollisionComp()->GetScaledSphereRadius());
+
+	// Without viewers, e.g. on a dedicated server with nobody connected, nothing needs to be smooth
+	float Significance = 0.f;
+	for (const FViewer& Viewer : Viewers)
+	{
+		const FVector ToProjectile = Location - Viewer.Location;
+		const float Distance = FMath::Max(ToProjectile.Size(), 1.f);
+
+		// Radius over half the screen width at that distance
+		float ScreenSize = Radius / (Distance * Viewer.TanHalfFOV);
+
+		// Cone test against the horizontal field of view, widened by the radius
+		if (FVector::DotProduct(ToProjectile, Viewer.Forward) < Distance * Viewer.CosHalfFOV - Radius)
+		{
+			ScreenSize *= OffscreenScale;
+		}
+		Significance = FMath::Max(Significance, ScreenSize);
+	}
+
+	const APawn* Instigator = Projectile->GetInstigator();
+	if (Instigator != nullptr && Instigator->IsLocallyControlled())
+	{
+		Significance += LocalInstigatorBonus;
+	}
+
+	return Significance + Projectile->SignificanceBias;
+}
+
+void UProjectileSignificanceSubsystem::GatherViewers()
+{
+	Viewers.Reset();
+	for (FConstPlayerControllerIterator It = GetWorld()->GetPlayerControllerIterator(); It; ++It)
+	{
+		APlayerController* PlayerController = It->Get();
+		if (PlayerController == nullptr)
+			continue;
+
+		// Remote players count too, the server runs their projectiles' gameplay
+		FViewer& Viewer = Viewers.AddDefaulted_GetRef();
+		FRotator Rotation;
+		PlayerController->GetPlayerViewPoint(Viewer.Location, Rotation);
+		Viewer.Forward = Rotation.Vector();
+
+		const float FOV = PlayerController->PlayerCameraManager != nullptr
+			? PlayerController->PlayerCameraManager->GetFOVAngle()
+			: 90.f;
+		const float HalfFOV = FMath::DegreesToRadians(FMath::Clamp(FOV, 5.f, 170.f) * 0.5f);
+		Viewer.TanHalfFOV = FMath::Tan(HalfFOV);
+		Viewer.CosHalfFOV = FMath::Cos(HalfFOV);
+	}
+}
+
+int32 UProjectileSignificanceSubsystem::SelectTier(float Significance) const
+{
+	for (int32 TierIndex = 0; TierIndex < Tiers.Num(); TierIndex++)
+	{
+		if (Significance >= Tiers[TierIndex].MinSignificance)
+			return TierIndex;
+	}
+	return Tiers.Num() - 1;
+}
+
+float UProjectileSignificanceSubsystem::GetThrottledTickInterval(const FProjectileSignificanceTier& Tier, float Speed)
+{
+	if (Tier.TickInterval <= 0.f)
+		return 0.f;
+
+	return Speed > KINDA_SMALL_NUMBER
+		? FMath::Min(Tier.TickInterval, FMath::Max(Tier.MaxTravelPerTick, 0.f) / Speed)
+		: Tier.TickInterval;
+}
+
+float UProjectileSignificanceSubsystem::GetThrottledTimeStep(const FProjectileSignificanceTier& Tier, float Radius, float GravityZ)
+{
+	// A chord of a parabola strays at most |g| * t^2 / 8 from it
+	float TimeStep = Tier.MaxSimulationTimeStep;
+	if (FMath::Abs(GravityZ) > KINDA_SMALL_NUMBER)
+	{
+		TimeStep = FMath::Min(TimeStep, FMath::Sqrt(8.f * Radius / FMath::Abs(GravityZ)));
+	}
+	return FMath::Max(TimeStep, 0.0166f);
+}
+
+void UProjectileSignificanceSubsystem::ApplyTier(ATowerOfCodeThrowingProjectile* Projectile, int32 TierIndex) const
+{
+	const bool bTierChanged = Projectile->SignificanceTier != TierIndex;
+	Projectile->SignificanceTier = TierIndex;
+
+	UProjectileMovementComponent* Movement = Projectile->GetProjectileMovement();
+	const UProjectileMovementComponent* Defaults = Projectile->GetClass()->GetDefaultObject<ATowerOfCodeThrowingProjectile>()->GetProjectileMovement();
+	if (!Tiers.IsValidIndex(TierIndex) || Tiers[TierIndex].TickInterval <= 0.f)
+	{
+		if (!bTierChanged)
+			return;
+
+		Movement->SetComponentTickInterval(0.f);
+		Movement->MaxSimulationTimeStep = Defaults->MaxSimulationTimeStep;
+		Movement->MaxSimulationIterations = Defaults->MaxSimulationIterations;
+		return;
+	}
+
+	// The interval follows the speed, so it is updated every time
+	const FProjectileSignificanceTier& Tier = Tiers[TierIndex];
+	const float TickInterval = GetThrottledTickInterval(Tier, Movement->Velocity.Size());
+	const float TimeStep = GetThrottledTimeStep(Tier, Projectile->GetCollisionComp()->GetScaledSphereRadius(), Movement->GetGravityZ());
+
+	// Enough substeps to cover an interval and a slow frame, so the remaining time isn't moved in one piece
+	const int32 Iterations = FMath::CeilToInt((TickInterval + 0.1f) / TimeStep);
+
+	Movement->SetComponentTickInterval(TickInterval);
+	Movement->MaxSimulationTimeStep = TimeStep;
+	Movement->MaxSimulationIterations = FMath::Clamp(Iterations, Defaults->MaxSimulationIterations, 25);
+}
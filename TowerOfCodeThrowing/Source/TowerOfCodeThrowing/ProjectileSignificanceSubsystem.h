@@ -0,0 +1,115 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Tickable.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "ProjectileSignificanceSubsystem.generated.h"
+
+class ATowerOfCodeThrowingProjectile;
+
+/** How often the projectiles of a significance band simulate */
+USTRUCT()
+struct FProjectileSignificanceTier
+{
+	GENERATED_BODY()
+
+	/** Lowest significance of the band, roughly the fraction of the screen the projectile covers */
+	UPROPERTY(Config)
+		float MinSignificance = 0.f;
+
+	/** Seconds between movement ticks, zero ticks every frame */
+	UPROPERTY(Config)
+		float TickInterval = 0.f;
+
+	/**
+	 * Farthest the projectile may move between two movement ticks, which shortens TickInterval for fast ones.
+	 * Moving objects are only seen where they are at each tick, so keep it below the thinnest one that must be hit.
+	 * It also bounds the visible jumps.
+	 */
+	UPROPERTY(Config)
+		float MaxTravelPerTick = 50.f;
+
+	/** Longest substep of the movement, UProjectileMovementComponent::MaxSimulationTimeStep */
+	UPROPERTY(Config)
+		float MaxSimulationTimeStep = 0.05f;
+};
+
+/**
+ * Ranks the live projectiles by how much they matter to the players and lowers the movement tick rate
+ * of the ones nobody looks at. Significance is the screen size seen from the closest viewer, reduced
+ * off-screen and raised by ATowerOfCodeThrowingProjectile::SignificanceBias and for projectiles of local players.
+ *
+ * Throttled projectiles simulate the whole interval in larger substeps. Every substep is a sweep, and
+ * substeps are kept short enough that the swept chord stays within the collision radius of the arc.
+ * Intervals shrink with speed, see FProjectileSignificanceTier::MaxTravelPerTick, so fast projectiles
+ * stay close to full rate and the savings come from the slow, rolling and settling ones.
+ */
+UCLASS(config = Game)
+class UProjectileSignificanceSubsystem : public UWorldSubsystem, public FTickableGameObject
+{
+	GENERATED_BODY()
+
+public:
+	UProjectileSignificanceSubsystem();
+
+	/** Bands from the most to the least significant */
+	UPROPERTY(Config)
+		TArray<FProjectileSignificanceTier> Tiers;
+
+	/** Multiplies the significance of projectiles outside every view */
+	UPROPERTY(Config)
+		float OffscreenScale;
+
+	/** Added for projectiles instigated by a local player, so their own shots stay smooth */
+	UPROPERTY(Config)
+		float LocalInstigatorBonus;
+
+	/** Radius used for the screen size, projectiles are usually drawn larger than their collision */
+	UPROPERTY(Config)
+		float MinVisualRadius;
+
+	/** Turning it off puts every projectile back to full rate */
+	UFUNCTION(BlueprintCallable, Category = Projectile)
+		void SetEnabled(bool bNewEnabled);
+
+	UFUNCTION(BlueprintPure, Category = Projectile)
+		bool IsEnabled() const { return bEnabled; }
+
+	/** Projectiles in each tier after the last update */
+	const TArray<int32>& GetTierCounts() const { return TierCounts; }
+
+	float GetSignificance(const ATowerOfCodeThrowingProjectile* Projectile) const;
+
+	/** Movement tick interval of a projectile of the tier moving at Speed */
+	static float GetThrottledTickInterval(const FProjectileSignificanceTier& Tier, float Speed);
+
+	/** Longest substep of the tier for which a chord under GravityZ strays less than Radius from the arc */
+	static float GetThrottledTimeStep(const FProjectileSignificanceTier& Tier, float Radius, float GravityZ);
+
+	// FTickableGameObject
+	virtual void Tick(float DeltaTime) override;
+	virtual UWorld* GetTickableGameObjectWorld() const override { return GetWorld(); }
+	virtual ETickableTickType GetTickableTickType() const override;
+	virtual bool IsTickable() const override;
+	virtual TStatId GetStatId() const override;
+
+private:
+	struct FViewer
+	{
+		FVector Location;
+		FVector Forward;
+		/** Tangent and cosine of half the horizontal field of view */
+		float TanHalfFOV;
+		float CosHalfFOV;
+	};
+
+	void GatherViewers();
+	int32 SelectTier(float Significance) const;
+	void ApplyTier(ATowerOfCodeThrowingProjectile* Projectile, int32 TierIndex) const;
+
+	TArray<FViewer> Viewers;
+	TArray<int32> TierCounts;
+	bool bEnabled = true;
+};
@@ -0,0 +1,202 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ProjectileStressGameMode.h"
+#include "ProjectileRegistrySubsystem.h"
+#include "ProjectileSignificanceSubsystem.h"
+#include "TowerOfCodeThrowingCharacter.h"
+#include "TowerOfCodeThrowingProjectile.h"
+#include "GameFramework/PlayerController.h"
+#include "Misc/CommandLine.h"
+#include "Misc/DateTime.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogProjectileStress, Log, All);
+
+AProjectileStressGameMode::AProjectileStressGameMode()
+	: Super()
+{
+	PrimaryActorTick.bCanEverTick = true;
+
+	ProjectileCounts = { 500, 1000, 2000 };
+	WarmupFrames = 120;
+	MeasuredFrames = 600;
+	MinSpawnDistance = 300.f;
+	MaxSpawnDistance = 5000.f;
+	RandomSeed = 1234;
+	MinSpeedup = 1.f;
+	Origin = FVector::ZeroVector;
+	bStarted = false;
+	PassIndex = INDEX_NONE;
+	PassFrame = 0;
+	FrameSeconds = 0.0;
+	GameThreadSeconds = 0.0;
+	FullRateGameThreadMs = 0.0;
+}
+
+void AProjectileStressGameMode::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	// The player is possessed after BeginPlay, so the setup happens on the first tick
+	if (!bStarted)
+	{
+		bStarted = true;
+
+		FString Counts;
+		if (FParse::Value(FCommandLine::Get(), TEXT("StressProjectiles="), Counts, false))
+		{
+			TArray<FString> Values;
+			Counts.ParseIntoArray(Values, TEXT(","));
+			ProjectileCounts.Reset();
+			for (const FString& Value : Values)
+			{
+				ProjectileCounts.Add(FCString::Atoi(*Value));
+			}
+		}
+		FParse::Value(FCommandLine::Get(), TEXT("StressWarmup="), WarmupFrames);
+		FParse::Value(FCommandLine::Get(), TEXT("StressFrames="), MeasuredFrames);
+
+		APlayerController* PlayerController = GetWorld()->GetFirstPlayerController();
+		APawn* Pawn = PlayerController != nullptr ? PlayerController->GetPawn() : nullptr;
+		if (Pawn != nullptr)
+		{
+			Origin = Pawn->GetActorLocation();
+		}
+		if (ProjectileClass == nullptr)
+		{
+			const ATowerOfCodeThrowingCharacter* Character = Cast<ATowerOfCodeThrowingCharacter>(Pawn);
+			ProjectileClass = Character != nullptr && Character->ProjectileClass != nullptr
+				? Character->ProjectileClass
+				: TSubclassOf<ATowerOfCodeThrowingProjectile>(ATowerOfCodeThrowingProjectile::StaticClass());
+		}
+
+		Random.Initialize(RandomSeed);
+		Rows.Reset();
+		Rows.Add(TEXT("Projectiles,Significance,Frames,FrameMs,GameThreadMs,TierCounts,Speedup,Passed"));
+		if (!StartPass())
+		{
+			WriteResults();
+			FPlatformMisc::RequestExit(false);
+		}
+		return;
+	}
+
+	TopUp();
+
+	PassFrame++;
+	if (PassFrame <= WarmupFrames)
+		return;
+
+	// GGameThreadTime is the previous frame's, which is one of this pass too after the warmup
+	FrameSeconds += DeltaSeconds;
+	GameThreadSeconds += FPlatformTime::ToMilliseconds(GGameThreadTime) / 1000.0;
+	if (PassFrame < WarmupFrames + MeasuredFrames)
+		return;
+
+	const UProjectileSignificanceSubsystem* Significance = GetWorld()->GetSubsystem<UProjectileSignificanceSubsystem>();
+	FString TierCounts;
+	int32 ThrottledCount = 0;
+	for (int32 TierIndex = 0; TierIndex < Significance->GetTierCounts().Num(); TierIndex++)
+	{
+		const int32 Count = Significance->GetTierCounts()[TierIndex];
+		TierCounts += (TierCounts.IsEmpty() ? TEXT("") : TEXT("/")) + FString::FromInt(Count);
+		if (Significance->Tiers[TierIndex].TickInterval > 0.f)
+		{
+			ThrottledCount += Count;
+		}
+	}
+
+	const int32 Frames = FMath::Max(1, MeasuredFrames);
+	const double GameThreadMs = GameThreadSeconds * 1000.0 / Frames;
+
+	// The full rate pass is the baseline of the throttled one that follows it
+	double Speedup = 1.0;
+	bool bPassed = true;
+	if (!Significance->IsEnabled())
+	{
+		FullRateGameThreadMs = GameThreadMs;
+	}
+	else
+	{
+		Speedup = GameThreadMs > 0.0 ? FullRateGameThreadMs / GameThreadMs : 0.0;
+		bPassed = ThrottledCount > 0 && Speedup >= MinSpeedup;
+		if (!bPassed)
+		{
+			UE_LOG(LogProjectileStress, Error, TEXT("%d projectiles: %d throttled, %.2fx the full rate game thread speed, %.2fx required"),
+				ProjectileCounts[PassIndex / 2], ThrottledCount, Speedup, MinSpeedup);
+		}
+	}
+
+	Rows.Add(FString::Printf(TEXT("%d,%s,%d,%.3f,%.3f,%s,%.2f,%d"),
+		ProjectileCounts[PassIndex / 2],
+		Significance->IsEnabled() ? TEXT("On") : TEXT("Off"),
+		Frames,
+		FrameSeconds * 1000.0 / Frames,
+		GameThreadMs,
+		*TierCounts,
+		Speedup,
+		bPassed ? 1 : 0));
+	UE_LOG(LogProjectileStress, Log, TEXT("%s"), *Rows.Last());
+
+	if (!StartPass())
+	{
+		WriteResults();
+		FPlatformMisc::RequestExit(false);
+	}
+}
+
+bool AProjectileStressGameMode::StartPass()
+{
+	PassIndex++;
+	if (PassIndex >= ProjectileCounts.Num() * 2)
+		return false;
+
+	PassFrame = 0;
+	FrameSeconds = 0.0;
+	GameThreadSeconds = 0.0;
+
+	// Every count is measured at full rate first, then throttled
+	UProjectileSignificanceSubsystem* Significance = GetWorld()->GetSubsystem<UProjectileSignificanceSubsystem>();
+	Significance->SetEnabled(PassIndex % 2 == 1);
+	return true;
+}
+
+void AProjectileStressGameMode::TopUp()
+{
+	UWorld* World = GetWorld();
+	const UProjectileRegistrySubsystem* Registry = World->GetSubsystem<UProjectileRegistrySubsystem>();
+	const int32 Target = ProjectileCounts[PassIndex / 2];
+
+	// Extra projectiles of a larger previous pass are left to expire
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	for (int32 Count = Registry->GetProjectiles().Num(); Count < Target; Count++)
+	{
+		const FVector Offset = Random.GetUnitVector() * Random.FRandRange(MinSpawnDistance, MaxSpawnDistance);
+		const FRotator Aim(Random.FRandRange(-30.f, 60.f), Random.FRandRange(0.f, 360.f), 0.f);
+		World->SpawnActor<ATowerOfCodeThrowingProjectile>(ProjectileClass, Origin + Offset * FVector(1.f, 1.f, 0.25f), Aim, SpawnParams);
+	}
+}
+
+void AProjectileStressGameMode::WriteResults()
+{
+	FString OutputPath;
+	if (!FParse::Value(FCommandLine::Get(), TEXT("BenchOutput="), OutputPath))
+	{
+		OutputPath = FPaths::Combine(
+			FPaths::ProjectSavedDir(),
+			TEXT("Benchmarks"),
+			FString::Printf(TEXT("ProjectileStress_%s.csv"), *FDateTime::Now().ToString()));
+	}
+
+	if (FFileHelper::SaveStringArrayToFile(Rows, *OutputPath))
+	{
+		UE_LOG(LogProjectileStress, Log, TEXT("Wrote %s"), *OutputPath);
+	}
+	else
+	{
+		UE_LOG(LogProjectileStress, Error, TEXT("Failed to write %s"), *OutputPath);
+	}
+}
@@ -0,0 +1,78 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "TowerOfCodeThrowingGameMode.h"
+#include "ProjectileStressGameMode.generated.h"
+
+class ATowerOfCodeThrowingProjectile;
+
+/**
+ * Measures the game thread cost of many live projectiles with and without UProjectileSignificanceSubsystem.
+ * Keeps the requested number of projectiles flying around the player, replacing the ones that expire,
+ * and writes the average frame and game thread times and the final tier counts of every pass as CSV.
+ * A throttled pass fails, and is logged as an error, when it isn't MinSpeedup times faster on the game
+ * thread than the full rate pass of the same count or when it left every projectile at full rate.
+ *
+ * Runs on any map, e.g.
+ * "TowerOfCodeThrowing <Map>?game=ProjectileStress -game -nullrhi -StressProjectiles=1000,2000"
+ */
+UCLASS(minimalapi)
+class AProjectileStressGameMode : public ATowerOfCodeThrowingGameMode
+{
+	GENERATED_BODY()
+
+public:
+	AProjectileStressGameMode();
+
+	/** Live projectile counts to measure, overridden by -StressProjectiles= as a comma separated list */
+	UPROPERTY(EditAnywhere, Category = Benchmark)
+		TArray<int32> ProjectileCounts;
+
+	/** Frames spent filling up and settling before each pass is measured, overridden by -StressWarmup= */
+	UPROPERTY(EditAnywhere, Category = Benchmark)
+		int32 WarmupFrames;
+
+	/** Frames measured per pass, overridden by -StressFrames= */
+	UPROPERTY(EditAnywhere, Category = Benchmark)
+		int32 MeasuredFrames;
+
+	/** Spawned projectiles, the player's projectile class when unset */
+	UPROPERTY(EditAnywhere, Category = Benchmark)
+		TSubclassOf<ATowerOfCodeThrowingProjectile> ProjectileClass;
+
+	/** Projectiles are spawned between these distances from the player */
+	UPROPERTY(EditAnywhere, Category = Benchmark)
+		float MinSpawnDistance;
+
+	UPROPERTY(EditAnywhere, Category = Benchmark)
+		float MaxSpawnDistance;
+
+	UPROPERTY(EditAnywhere, Category = Benchmark)
+		int32 RandomSeed;
+
+	/** Game thread speedup a throttled pass needs over the full rate pass to pass */
+	UPROPERTY(EditAnywhere, Category = Benchmark)
+		float MinSpeedup;
+
+	virtual void Tick(float DeltaSeconds) override;
+
+private:
+	/** Starts the next count and significance setting, @returns false once every pass has run */
+	bool StartPass();
+
+	void TopUp();
+	void WriteResults();
+
+	FRandomStream Random;
+	FVector Origin;
+	bool bStarted;
+	int32 PassIndex;
+	int32 PassFrame;
+	double FrameSeconds;
+	double GameThreadSeconds;
+	/** Game thread milliseconds of the last full rate pass */
+	double FullRateGameThreadMs;
+	TArray<FString> Rows;
+};
@@ -0,0 +1,89 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ThrowingTestWorld.h"
+#include "ProjectileSignificanceSubsystem.h"
+#include "TowerOfCodeThrowingProjectile.h"
+#include "GameFramework/Pawn.h"
+#include "GameFramework/PlayerController.h"
+#include "GameFramework/ProjectileMovementComponent.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FProjectileSignificanceTest, "TowerOfCode.Throwing.Significance",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FProjectileSignificanceTest::RunTest(const FString& Parameters)
+{
+	FProjectileSignificanceTier Tier;
+	Tier.TickInterval = 0.25f;
+	Tier.MaxTravelPerTick = 50.f;
+	Tier.MaxSimulationTimeStep = 0.5f;
+
+	// Fast projectiles may not move further than MaxTravelPerTick between ticks
+	TestEqual(TEXT("Resting"), UProjectileSignificanceSubsystem::GetThrottledTickInterval(Tier, 0.f), 0.25f);
+	TestEqual(TEXT("Rolling"), UProjectileSignificanceSubsystem::GetThrottledTickInterval(Tier, 100.f), 0.25f);
+	TestEqual(TEXT("Flying"), UProjectileSignificanceSubsystem::GetThrottledTickInterval(Tier, 3000.f), 50.f / 3000.f, KINDA_SMALL_NUMBER);
+	FProjectileSignificanceTier FullRate = Tier;
+	FullRate.TickInterval = 0.f;
+	TestEqual(TEXT("Full rate tier"), UProjectileSignificanceSubsystem::GetThrottledTickInterval(FullRate, 100.f), 0.f);
+
+	// Chords stray at most g t^2 / 8 from the arc, which has to stay within the radius
+	const float TimeStep = UProjectileSignificanceSubsystem::GetThrottledTimeStep(Tier, 5.f, -980.f);
+	TestEqual(TEXT("Substep under gravity"), TimeStep, FMath::Sqrt(8.f * 5.f / 980.f), KINDA_SMALL_NUMBER);
+	TestTrue(TEXT("Chord within the radius"), 980.f * TimeStep * TimeStep / 8.f <= 5.f + KINDA_SMALL_NUMBER);
+	TestEqual(TEXT("Substep without gravity"), UProjectileSignificanceSubsystem::GetThrottledTimeStep(Tier, 5.f, 0.f), 0.5f);
+	TestEqual(TEXT("Substep floor"), UProjectileSignificanceSubsystem::GetThrottledTimeStep(Tier, 0.01f, -980.f), 0.0166f);
+
+	// Without viewers every projectile is in the least significant tier
+	FThrowingTestWorld TestWorld;
+	UProjectileSignificanceSubsystem* Significance = TestWorld.Get()->GetSubsystem<UProjectileSignificanceSubsystem>();
+	ATowerOfCodeThrowingProjectile* Projectile = TestWorld.Get()->SpawnActor<ATowerOfCodeThrowingProjectile>(
+		ATowerOfCodeThrowingProjectile::StaticClass(), FVector(0.f, 0.f, 1000.f), FRotator::ZeroRotator);
+	if (!TestNotNull(TEXT("Significance"), Significance) || !TestNotNull(TEXT("Projectile"), Projectile))
+		return false;
+
+	UProjectileMovementComponent* Movement = Projectile->GetProjectileMovement();
+	const FProjectileSignificanceTier& Minimal = Significance->Tiers.Last();
+
+	Movement->Velocity = FVector(3000.f, 0.f, 0.f);
+	Significance->Tick(1.f / 60.f);
+	TestEqual(TEXT("Least significant tier"), Projectile->SignificanceTier, Significance->Tiers.Num() - 1);
+	TestEqual(TEXT("Fast projectile interval"), Movement->GetComponentTickInterval(), Minimal.MaxTravelPerTick / 3000.f, KINDA_SMALL_NUMBER);
+	TestTrue(TEXT("Substep keeps the chord within the radius"),
+		FMath::Abs(Movement->GetGravityZ()) * FMath::Square(Movement->MaxSimulationTimeStep) / 8.f <= Projectile->GetCollisionComp()->GetScaledSphereRadius() + KINDA_SMALL_NUMBER);
+
+	// The interval follows the speed while the tier stays the same
+	Movement->Velocity = FVector(50.f, 0.f, 0.f);
+	Significance->Tick(1.f / 60.f);
+	TestEqual(TEXT("Slow projectile interval"), Movement->GetComponentTickInterval(), FMath::Min(Minimal.TickInterval, Minimal.MaxTravelPerTick / 50.f), KINDA_SMALL_NUMBER);
+
+	// The local player's own shots outrank the same shot of a remote player's pawn, which has no local controller
+	APawn* LocalPawn = TestWorld.Get()->SpawnActor<APawn>();
+	APawn* RemotePawn = TestWorld.Get()->SpawnActor<APawn>();
+	APlayerController* LocalPlayer = TestWorld.Get()->SpawnActor<APlayerController>();
+	LocalPlayer->Possess(LocalPawn);
+	FActorSpawnParameters SpawnParams;
+	SpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AlwaysSpawn;
+	SpawnParams.Instigator = LocalPawn;
+	ATowerOfCodeThrowingProjectile* LocalShot = TestWorld.Get()->SpawnActor<ATowerOfCodeThrowingProjectile>(
+		ATowerOfCodeThrowingProjectile::StaticClass(), FVector(0.f, 500.f, 1000.f), FRotator::ZeroRotator, SpawnParams);
+	SpawnParams.Instigator = RemotePawn;
+	ATowerOfCodeThrowingProjectile* RemoteShot = TestWorld.Get()->SpawnActor<ATowerOfCodeThrowingProjectile>(
+		ATowerOfCodeThrowingProjectile::StaticClass(), FVector(0.f, 500.f, 1000.f), FRotator::ZeroRotator, SpawnParams);
+	if (TestNotNull(TEXT("Local shot"), LocalShot) && TestNotNull(TEXT("Remote shot"), RemoteShot))
+	{
+		TestTrue(TEXT("Locally controlled instigator"), LocalPawn->IsLocallyControlled());
+		TestFalse(TEXT("Remote instigator"), RemotePawn->IsLocallyControlled());
+		TestEqual(TEXT("Local instigator bonus"), Significance->GetSignificance(LocalShot) - Significance->GetSignificance(RemoteShot),
+			Significance->LocalInstigatorBonus, KINDA_SMALL_NUMBER);
+	}
+
+	Significance->SetEnabled(false);
+	TestEqual(TEXT("Full rate once disabled"), Movement->GetComponentTickInterval(), 0.f);
+
+	return true;
+}
+
+#endif
@@ -0,0 +1,74 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+#include "Engine/Engine.h"
+#include "Engine/World.h"
+#include "GameFramework/Actor.h"
+
+/**
+ * Playing game world for the automation tests, destroyed with the helper.
+ * Runs without a map or a renderer, e.g.
+ * "UE4Editor.exe TowerOfCodeThrowing.uproject -ExecCmds="Automation RunTests TowerOfCode.Throwing; Quit" -unattended -nullrhi"
+ */
+class FThrowingTestWorld
+{
+public:
+	FThrowingTestWorld()
+	{
+		World = UWorld::CreateWorld(EWorldType::Game, false);
+		FWorldContext& WorldContext = GEngine->CreateNewWorldContext(EWorldType::Game);
+		WorldContext.SetCurrentWorld(World);
+
+		World->SetGameMode(FURL());
+		World->InitializeActorsForPlay(FURL());
+		World->BeginPlay();
+	}
+
+	~FThrowingTestWorld()
+	{
+		GEngine->DestroyWorldContext(World);
+		World->DestroyWorld(false);
+	}
+
+	UWorld* Get() const { return World; }
+
+	/** Adds a blocking static collision component of ComponentType to a new actor, configured by Setup before it is registered */
+	template<typename ComponentType, typename SetupType>
+	ComponentType* SpawnStatic(const FTransform& Transform, SetupType Setup) const
+	{
+		return SpawnCollision<ComponentType>(Transform, EComponentMobility::Static, ECC_WorldStatic, Setup);
+	}
+
+	/** Same for a movable WorldDynamic component */
+	template<typename ComponentType, typename SetupType>
+	ComponentType* SpawnDynamic(const FTransform& Transform, SetupType Setup) const
+	{
+		return SpawnCollision<ComponentType>(Transform, EComponentMobility::Movable, ECC_WorldDynamic, Setup);
+	}
+
+	template<typename ComponentType, typename SetupType>
+	ComponentType* SpawnCollision(const FTransform& Transform, EComponentMobility::Type Mobility, ECollisionChannel ObjectType, SetupType Setup) const
+	{
+		AActor* Actor = World->SpawnActor<AActor>();
+		ComponentType* Component = NewObject<ComponentType>(Actor);
+		Component->SetMobility(Mobility);
+		Component->SetCollisionEnabled(ECollisionEnabled::QueryAndPhysics);
+		Component->SetCollisionObjectType(ObjectType);
+		Component->SetCollisionResponseToAllChannels(ECR_Block);
+		Component->SetWorldTransform(Transform);
+		Setup(Component);
+		Actor->SetRootComponent(Component);
+		Component->RegisterComponent();
+		return Component;
+	}
+
+private:
+	UWorld* World;
+};
+
+#endif
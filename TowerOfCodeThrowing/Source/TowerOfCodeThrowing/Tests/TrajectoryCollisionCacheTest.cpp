@@ -0,0 +1,88 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ThrowingTestWorld.h"
+#include "TrajectoryCollisionSubsystem.h"
+#include "Components/BoxComponent.h"
+#include "Components/CapsuleComponent.h"
+#include "Components/SphereComponent.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTrajectoryCollisionCacheTest, "TowerOfCode.Throwing.CollisionCache",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FTrajectoryCollisionCacheTest::RunTest(const FString& Parameters)
+{
+	FThrowingTestWorld TestWorld;
+	UWorld* World = TestWorld.Get();
+
+	UPrimitiveComponent* Shapes[] = {
+		TestWorld.SpawnStatic<UBoxComponent>(FTransform(FRotator(10.f, 30.f, 0.f), FVector(0.f, 0.f, 0.f)),
+			[](UBoxComponent* Box) { Box->SetBoxExtent(FVector(200.f, 100.f, 50.f), false); }),
+		TestWorld.SpawnStatic<USphereComponent>(FTransform(FVector(1000.f, 0.f, 0.f)),
+			[](USphereComponent* Sphere) { Sphere->SetSphereRadius(80.f, false); }),
+		TestWorld.SpawnStatic<UCapsuleComponent>(FTransform(FRotator(0.f, 0.f, 60.f), FVector(0.f, 1000.f, 0.f)),
+			[](UCapsuleComponent* Capsule) { Capsule->SetCapsuleSize(40.f, 120.f, false); }),
+	};
+
+	UTrajectoryCollisionSubsystem* Subsystem = World->GetSubsystem<UTrajectoryCollisionSubsystem>();
+	if (!TestNotNull(TEXT("Collision subsystem"), Subsystem))
+		return false;
+
+	FTrajectoryCollisionCachePtr Cache = Subsystem->EnsureCoverage(FVector::ZeroVector);
+	if (!TestTrue(TEXT("Cache built"), Cache.IsValid()))
+		return false;
+	TestEqual(TEXT("Cached shapes"), Cache->GetShapeCount(), 3);
+
+	const float SweepRadius = 10.f;
+	// Boxes may be hit early near their edges, see FTrajectoryCollisionCache
+	const float EarlyTolerance = SweepRadius * (FMath::Sqrt(3.f) - 1.f) + 1.f;
+	const FCollisionShape SweepShape = FCollisionShape::MakeSphere(SweepRadius);
+	const FCollisionObjectQueryParams ObjectParams(ECC_WorldStatic);
+	const FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(TrajectoryCollisionCacheTest), false);
+
+	FRandomStream Random(42);
+	for (UPrimitiveComponent* Shape : Shapes)
+	{
+		const FVector Center = Shape->Bounds.Origin;
+		const float Reach = Shape->Bounds.SphereRadius;
+		for (int32 Sweep = 0; Sweep < 32; Sweep++)
+		{
+			const FVector Direction = Random.GetUnitVector();
+			const FVector Start = Center + Direction * (Reach + 500.f);
+
+			// Towards the shape's center, both have to hit at the same distance
+			{
+				const FVector End = Center - Direction * (Reach + 500.f);
+				FHitResult SceneHit;
+				FHitResult CacheHit;
+				const bool bSceneHit = World->SweepSingleByObjectType(SceneHit, Start, End, FQuat::Identity, ObjectParams, SweepShape, QueryParams);
+				const bool bCacheHit = Cache->SweepSphere(Start, End, SweepRadius, CacheHit);
+				TestTrue(TEXT("Physics hits the shape"), bSceneHit);
+				TestTrue(TEXT("Cache hits the shape"), bCacheHit);
+				if (bSceneHit && bCacheHit)
+				{
+					TestTrue(FString::Printf(TEXT("Cache hit %.2f cm from physics"), CacheHit.Distance - SceneHit.Distance),
+						CacheHit.Distance <= SceneHit.Distance + 1.f && CacheHit.Distance >= SceneHit.Distance - EarlyTolerance);
+					TestTrue(TEXT("Same component"), CacheHit.GetComponent() == SceneHit.GetComponent());
+				}
+			}
+
+			// Past the shape's bounds, both have to miss
+			{
+				const FVector Side = FVector::CrossProduct(Direction, FMath::Abs(Direction.Z) < 0.9f ? FVector::UpVector : FVector::ForwardVector).GetSafeNormal();
+				const FVector Offset = Side * (Reach + SweepRadius + 50.f);
+				FHitResult SceneHit;
+				FHitResult CacheHit;
+				TestFalse(TEXT("Physics misses beside the shape"), World->SweepSingleByObjectType(SceneHit, Start + Offset, Center + Offset, FQuat::Identity, ObjectParams, SweepShape, QueryParams));
+				TestFalse(TEXT("Cache misses beside the shape"), Cache->SweepSphere(Start + Offset, Center + Offset, SweepRadius, CacheHit));
+			}
+		}
+	}
+
+	return true;
+}
+
+#endif
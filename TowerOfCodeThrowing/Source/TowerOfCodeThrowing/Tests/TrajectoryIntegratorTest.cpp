@@ -0,0 +1,152 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TrajectoryIntegrator.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+	/** Classic Runge-Kutta in double precision with a step far below the integrators', as the ground truth */
+	FVector IntegrateReference(const FTrajectoryFlightParams& Params, const FVector& Location, const FVector& Velocity, float Time)
+	{
+		struct FState
+		{
+			double P[3];
+			double V[3];
+		};
+
+		auto Derive = [&Params](const FState& State)
+		{
+			const FVector Acceleration = Params.Gravity + Params.GetDragAcceleration(FVector(State.V[0], State.V[1], State.V[2]));
+			FState Derivative;
+			for (int32 Axis = 0; Axis < 3; Axis++)
+			{
+				Derivative.P[Axis] = State.V[Axis];
+				Derivative.V[Axis] = Acceleration[Axis];
+			}
+			return Derivative;
+		};
+
+		auto Offset = [](const FState& State, const FState& Derivative, double Scale)
+		{
+			FState Result;
+			for (int32 Axis = 0; Axis < 3; Axis++)
+			{
+				Result.P[Axis] = State.P[Axis] + Derivative.P[Axis] * Scale;
+				Result.V[Axis] = State.V[Axis] + Derivative.V[Axis] * Scale;
+			}
+			return Result;
+		};
+
+		FState State = { { Location.X, Location.Y, Location.Z }, { Velocity.X, Velocity.Y, Velocity.Z } };
+		const int32 Steps = FMath::Max(1, FMath::CeilToInt(Time * 2000.f));
+		const double Step = (double)Time / Steps;
+		for (int32 StepIndex = 0; StepIndex < Steps; StepIndex++)
+		{
+			const FState K1 = Derive(State);
+			const FState K2 = Derive(Offset(State, K1, 0.5 * Step));
+			const FState K3 = Derive(Offset(State, K2, 0.5 * Step));
+			const FState K4 = Derive(Offset(State, K3, Step));
+			for (int32 Axis = 0; Axis < 3; Axis++)
+			{
+				State.P[Axis] += (K1.P[Axis] + 2.0 * K2.P[Axis] + 2.0 * K3.P[Axis] + K4.P[Axis]) * Step / 6.0;
+				State.V[Axis] += (K1.V[Axis] + 2.0 * K2.V[Axis] + 2.0 * K3.V[Axis] + K4.V[Axis]) * Step / 6.0;
+			}
+		}
+		return FVector(State.P[0], State.P[1], State.P[2]);
+	}
+
+	FTrajectoryFlightParams MakeParams(ETrajectoryDragModel DragModel, float DragCoefficient, const FVector& Wind)
+	{
+		FTrajectoryFlightParams Params;
+		Params.DragModel = DragModel;
+		Params.DragCoefficient = DragCoefficient;
+		Params.Wind = Wind;
+		return Params;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTrajectoryIntegratorTest, "TowerOfCode.Throwing.Integrator",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FTrajectoryIntegratorTest::RunTest(const FString& Parameters)
+{
+	const FVector CrossWind(0.f, 500.f, 0.f);
+	struct FModel
+	{
+		const TCHAR* Name;
+		FTrajectoryFlightParams Params;
+	};
+	const FModel Models[] =
+	{
+		{ TEXT("Gravity"), MakeParams(ETrajectoryDragModel::None, 0.f, FVector::ZeroVector) },
+		{ TEXT("Linear"), MakeParams(ETrajectoryDragModel::Linear, 0.5f, FVector::ZeroVector) },
+		{ TEXT("LinearWind"), MakeParams(ETrajectoryDragModel::Linear, 0.5f, CrossWind) },
+		{ TEXT("Quadratic"), MakeParams(ETrajectoryDragModel::Quadratic, 1.e-4f, FVector::ZeroVector) },
+		{ TEXT("QuadraticWind"), MakeParams(ETrajectoryDragModel::Quadratic, 1.e-4f, CrossWind) },
+	};
+
+	// The closed forms are exact and the midpoint steps are within a few hundredths of a cm over these flights
+	const float Tolerance = 0.5f;
+	const FVector Launch(0.f, 0.f, 100.f);
+	const FVector LaunchVelocity = FRotator(30.f, 20.f, 0.f).Vector() * 3000.f;
+	const float Times[] = { 0.5f, 1.f, 2.f };
+
+	for (const FModel& Model : Models)
+	{
+		TrajectoryIntegrator::Visit(Model.Params, [this, &Model, &Launch, &LaunchVelocity, &Times, Tolerance](auto Integrator)
+		{
+			Integrator.BeginLeg(Launch, LaunchVelocity);
+			for (float Time : Times)
+			{
+				const FVector Expected = IntegrateReference(Model.Params, Launch, LaunchVelocity, Time);
+				const FVector Sampled = Integrator.Sample(Time);
+				TestTrue(FString::Printf(TEXT("%s at %.1f s is %.3f cm off the reference"), Model.Name, Time, FVector::Dist(Sampled, Expected)),
+					FVector::Dist(Sampled, Expected) <= Tolerance);
+			}
+
+			// Going back in time gives the same location as sampling there first
+			const FVector Again = Integrator.Sample(Times[0]);
+			const FVector Expected = IntegrateReference(Model.Params, Launch, LaunchVelocity, Times[0]);
+			TestTrue(FString::Printf(TEXT("%s sampled backwards"), Model.Name), FVector::Dist(Again, Expected) <= Tolerance);
+
+			// The velocity follows the samples
+			const FVector Ahead = IntegrateReference(Model.Params, Launch, LaunchVelocity, Times[0] + 1.e-3f);
+			const FVector Behind = IntegrateReference(Model.Params, Launch, LaunchVelocity, Times[0] - 1.e-3f);
+			TestTrue(FString::Printf(TEXT("%s velocity"), Model.Name), Integrator.GetVelocity().Equals((Ahead - Behind) / 2.e-3f, 1.f));
+		});
+	}
+
+	// Visit picks the policies matching the params
+	bool bVisited = false;
+	TrajectoryIntegrator::Visit(Models[0].Params, [&bVisited](auto Integrator)
+	{
+		bVisited = TIsSame<decltype(Integrator), TTrajectoryIntegrator<FTrajectoryNoDrag, FTrajectoryNoWind, FTrajectoryProjectileBounce>>::Value;
+	});
+	TestTrue(TEXT("Gravity only"), bVisited);
+	TrajectoryIntegrator::Visit(Models[2].Params, [&bVisited](auto Integrator)
+	{
+		bVisited = TIsSame<decltype(Integrator), TTrajectoryIntegrator<FTrajectoryLinearDrag, FTrajectoryConstantWind, FTrajectoryProjectileBounce>>::Value;
+	});
+	TestTrue(TEXT("Linear drag with wind"), bVisited);
+	FTrajectoryFlightParams NoBounce = Models[3].Params;
+	NoBounce.bBounce = false;
+	TrajectoryIntegrator::Visit(NoBounce, [&bVisited](auto Integrator)
+	{
+		bVisited = TIsSame<decltype(Integrator), TTrajectoryIntegrator<FTrajectoryQuadraticDrag, FTrajectoryNoWind, FTrajectoryNoBounce>>::Value;
+	});
+	TestTrue(TEXT("Quadratic drag without bounces"), bVisited);
+
+	// Bounces lose Bounciness of the normal speed and Friction of the tangential speed, like UProjectileMovementComponent
+	FTrajectoryFlightParams BounceParams;
+	BounceParams.Bounciness = 0.6f;
+	BounceParams.Friction = 0.2f;
+	TestEqual(TEXT("Bounce"), FTrajectoryProjectileBounce::Bounce(BounceParams, FVector::UpVector, FVector(100.f, 0.f, -200.f)), FVector(80.f, 0.f, 120.f));
+	TestFalse(TEXT("No bounce"), FTrajectoryNoBounce::bBounces);
+
+	return true;
+}
+
+#endif
@@ -0,0 +1,116 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ThrowingTestWorld.h"
+#include "TowerOfCodeThrowingProjectile.h"
+#include "TrajectoryIntegrator.h"
+#include "TrajectoryProjectileMovementComponent.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTrajectoryMovementAgreementTest, "TowerOfCode.Throwing.MovementAgreement",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FTrajectoryMovementAgreementTest::RunTest(const FString& Parameters)
+{
+	FThrowingTestWorld TestWorld;
+	UWorld* World = TestWorld.Get();
+
+	// The flights of the integrator benchmark, ticked like a 60 Hz game for a second
+	const float LaunchSpeed = 3000.f;
+	const float TickSeconds = 1.f / 60.f;
+	const int32 Ticks = 60;
+	const float Tolerance = 0.01f;
+
+	struct FFlightModel
+	{
+		const TCHAR* Name;
+		ETrajectoryDragModel DragModel;
+		float DragCoefficient;
+		FVector Wind;
+	};
+	const FVector CrossWind(0.f, 500.f, 0.f);
+	const FFlightModel Models[] =
+	{
+		{ TEXT("Gravity"), ETrajectoryDragModel::None, 0.f, FVector::ZeroVector },
+		{ TEXT("Linear"), ETrajectoryDragModel::Linear, 0.5f, FVector::ZeroVector },
+		{ TEXT("LinearWind"), ETrajectoryDragModel::Linear, 0.5f, CrossWind },
+		{ TEXT("Quadratic"), ETrajectoryDragModel::Quadratic, 1.e-4f, FVector::ZeroVector },
+		{ TEXT("QuadraticWind"), ETrajectoryDragModel::Quadratic, 1.e-4f, CrossWind },
+	};
+	const FRotator Aims[] = { FRotator(30.f, 0.f, 0.f), FRotator(-20.f, 135.f, 0.f), FRotator(70.f, -60.f, 0.f) };
+
+	for (const FFlightModel& Model : Models)
+	{
+		for (const FRotator& Aim : Aims)
+		{
+			const FString Name = FString::Printf(TEXT("%s aimed at %s"), Model.Name, *Aim.ToCompactString());
+			const FTransform SpawnTransform(Aim, FVector::ZeroVector);
+			ATowerOfCodeThrowingProjectile* Projectile = World->SpawnActorDeferred<ATowerOfCodeThrowingProjectile>(
+				ATowerOfCodeThrowingProjectile::StaticClass(), SpawnTransform, nullptr, nullptr, ESpawnActorCollisionHandlingMethod::AlwaysSpawn);
+			if (!TestNotNull(Name + TEXT(" projectile"), Projectile))
+				return false;
+
+			UTrajectoryProjectileMovementComponent* Movement = Cast<UTrajectoryProjectileMovementComponent>(Projectile->GetProjectileMovement());
+			if (!TestNotNull(Name + TEXT(" trajectory movement"), Movement))
+			{
+				Projectile->Destroy();
+				return false;
+			}
+
+			Movement->InitialSpeed = LaunchSpeed;
+			Movement->MaxSpeed = 0.f;
+			Movement->DragModel = Model.DragModel;
+			Movement->DragCoefficient = Model.DragCoefficient;
+			Movement->WindVelocity = Model.Wind;
+			Projectile->FinishSpawning(SpawnTransform);
+			Projectile->SetActorEnableCollision(false);
+
+			// Ticked here rather than by the world, so both see the same flight time
+			Movement->SetComponentTickEnabled(false);
+			const FVector LaunchLocation = Projectile->GetActorLocation();
+			const FVector LaunchVelocity = Movement->Velocity;
+			TestTrue(Name + TEXT(" launch speed"), FMath::IsNearlyEqual(LaunchVelocity.Size(), LaunchSpeed, 1.f));
+
+			TArray<FVector> Flown;
+			for (int32 TickIndex = 0; TickIndex < Ticks; TickIndex++)
+			{
+				Movement->TickComponent(TickSeconds, LEVELTICK_All, &Movement->PrimaryComponentTick);
+				Flown.Add(Projectile->GetActorLocation());
+			}
+
+			TArray<FVector> Predicted;
+			TrajectoryIntegrator::Visit(UTrajectoryProjectileMovementComponent::MakeFlightParams(Movement, World->GetGravityZ()),
+				[&Predicted, &LaunchLocation, &LaunchVelocity, Ticks, TickSeconds](auto Integrator)
+			{
+				Integrator.BeginLeg(LaunchLocation, LaunchVelocity);
+				for (int32 TickIndex = 1; TickIndex <= Ticks; TickIndex++)
+				{
+					Predicted.Add(Integrator.Sample(TickIndex * TickSeconds));
+				}
+			});
+			Projectile->Destroy();
+
+			if (!TestEqual(Name + TEXT(" samples"), Predicted.Num(), Flown.Num()))
+				continue;
+
+			// Within a percent of the distance flown so far, all along the flight
+			for (int32 TickIndex = 0; TickIndex < Ticks; TickIndex++)
+			{
+				const float Error = FVector::Dist(Flown[TickIndex], Predicted[TickIndex]);
+				const float Allowed = 1.f + FVector::Dist(LaunchLocation, Predicted[TickIndex]) * Tolerance;
+				if (Error > Allowed)
+				{
+					AddError(FString::Printf(TEXT("%s: tick %d ended %.2f cm away from the integrator, %.2f cm allowed"),
+						*Name, TickIndex + 1, Error, Allowed));
+					break;
+				}
+			}
+		}
+	}
+
+	return true;
+}
+
+#endif
@@ -0,0 +1,65 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TowerOfCodeThrowingCharacter.h"
+#include "TrajectoryIntegrator.h"
+#include "Misc/AutomationTest.h"
+#include "UObject/CoreNet.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTrajectoryPreviewPayloadTest, "TowerOfCode.Throwing.PreviewPayload",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FTrajectoryPreviewPayloadTest::RunTest(const FString& Parameters)
+{
+	// An aim in the middle of a map
+	FTrajectoryPreviewState State;
+	State.bActive = true;
+	State.MuzzleLocation = FVector(1250.f, -3400.f, 180.f);
+	State.Direction = FRotator(20.f, 135.f, 0.f).Vector();
+	State.Speed = 3000;
+	State.BounceCount = 2;
+
+	// Every property the way the net driver serializes it
+	bool bSuccess = true;
+	FNetBitWriter StateWriter(nullptr, 1024);
+	State.MuzzleLocation.NetSerialize(StateWriter, nullptr, bSuccess);
+	State.Direction.NetSerialize(StateWriter, nullptr, bSuccess);
+	StateWriter << State.Speed;
+	StateWriter << State.BounceCount;
+	StateWriter.WriteBit(State.bActive);
+
+	// The points the preview simulates for the same throw, 2 seconds in steps of 1/100 s without bounces
+	FTrajectoryFlightParams FlightParams;
+	FlightParams.bBounce = false;
+	TTrajectoryIntegrator<FTrajectoryNoDrag, FTrajectoryNoWind, FTrajectoryNoBounce> Integrator(FlightParams);
+	Integrator.BeginLeg(State.MuzzleLocation, State.Direction * State.Speed);
+	TArray<FVector> Points;
+	for (float SimTime = 0.f; SimTime < 2.f; SimTime += 1.e-2f)
+	{
+		Points.Add(Integrator.Sample(SimTime));
+	}
+
+	// A replicated array is its element count followed by the elements
+	FNetBitWriter PointsWriter(nullptr, 1024);
+	uint16 PointCount = Points.Num();
+	PointsWriter << PointCount;
+	for (FVector& Point : Points)
+	{
+		PointsWriter << Point;
+	}
+
+	const float StateBytes = StateWriter.GetNumBits() / 8.f;
+	const float PointsBytes = PointsWriter.GetNumBits() / 8.f;
+	AddInfo(FString::Printf(TEXT("Preview state %.1f bytes, %d points %.0f bytes"), StateBytes, Points.Num(), PointsBytes));
+	TestTrue(TEXT("Serialized"), bSuccess && !StateWriter.IsError() && !PointsWriter.IsError());
+
+	// About 15 bytes, against 12 bytes per point
+	TestTrue(TEXT("State within 16 bytes"), StateBytes <= 16.f);
+	TestTrue(TEXT("Point list at least 100 times larger"), PointsBytes >= 100.f * StateBytes);
+
+	return true;
+}
+
+#endif
@@ -0,0 +1,55 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TowerOfCodeThrowingCharacter.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTrajectoryPreviewSenderTest, "TowerOfCode.Throwing.PreviewSender",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FTrajectoryPreviewSenderTest::RunTest(const FString& Parameters)
+{
+	const float SendRate = 10.f;
+
+	auto MakeAim = [](float Yaw)
+	{
+		FTrajectoryPreviewState State;
+		State.bActive = true;
+		State.MuzzleLocation = FVector(0.f, 0.f, 100.f);
+		State.Direction = FRotator(0.f, Yaw, 0.f).Vector();
+		State.Speed = 3000;
+		State.BounceCount = 2;
+		return State;
+	};
+
+	FTrajectoryPreviewSender Sender;
+	TestEqual(TEXT("Nothing to send while not aiming"), Sender.Update(FTrajectoryPreviewState(), 0.f, SendRate), ETrajectoryPreviewSend::None);
+
+	// Starting carries the first aim
+	TestEqual(TEXT("Start"), Sender.Update(MakeAim(0.f), 1.f, SendRate), ETrajectoryPreviewSend::Reliable);
+	TestEqual(TEXT("Holding a reliably sent aim"), Sender.Update(MakeAim(0.f), 1.01f, SendRate), ETrajectoryPreviewSend::None);
+
+	// Aim changes are throttled and unreliable
+	TestEqual(TEXT("Aim change within the send interval"), Sender.Update(MakeAim(10.f), 1.05f, SendRate), ETrajectoryPreviewSend::None);
+	TestEqual(TEXT("Aim change"), Sender.Update(MakeAim(10.f), 1.2f, SendRate), ETrajectoryPreviewSend::Unreliable);
+	TestEqual(TEXT("Next aim change"), Sender.Update(MakeAim(20.f), 1.3f, SendRate), ETrajectoryPreviewSend::Unreliable);
+
+	// The aim the preview settles on is resent reliably once, in case the unreliable one was lost
+	TestEqual(TEXT("Settled aim"), Sender.Update(MakeAim(20.f), 1.31f, SendRate), ETrajectoryPreviewSend::Reliable);
+	TestEqual(TEXT("Holding the settled aim"), Sender.Update(MakeAim(20.f), 1.5f, SendRate), ETrajectoryPreviewSend::None);
+	TestEqual(TEXT("Holding within the tolerance"), Sender.Update(MakeAim(20.01f), 1.6f, SendRate), ETrajectoryPreviewSend::None);
+
+	// Stopping is never throttled
+	TestEqual(TEXT("Aim change before stopping"), Sender.Update(MakeAim(30.f), 1.7f, SendRate), ETrajectoryPreviewSend::Unreliable);
+	TestEqual(TEXT("Stop right after"), Sender.Update(FTrajectoryPreviewState(), 1.71f, SendRate), ETrajectoryPreviewSend::Reliable);
+	TestEqual(TEXT("Staying stopped"), Sender.Update(FTrajectoryPreviewState(), 2.f, SendRate), ETrajectoryPreviewSend::None);
+
+	// Starting again right away isn't throttled either
+	TestEqual(TEXT("Restart"), Sender.Update(MakeAim(30.f), 2.01f, SendRate), ETrajectoryPreviewSend::Reliable);
+
+	return true;
+}
+
+#endif
@@ -0,0 +1,153 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ThrowingTestWorld.h"
+#include "TowerOfCodeThrowingProjectile.h"
+#include "TrajectoryThrowStation.h"
+#include "Components/BoxComponent.h"
+#include "GameFramework/Character.h"
+#include "HAL/FileManager.h"
+#include "Misc/AutomationTest.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+namespace
+{
+	bool ArcsMatch(const FThrowStationArc& Arc, const FThrowStationArc& Expected)
+	{
+		if (Arc.Points.Num() != Expected.Points.Num())
+			return false;
+
+		for (int32 Index = 0; Index < Arc.Points.Num(); Index++)
+		{
+			if (!Arc.Points[Index].Equals(Expected.Points[Index], 1.f))
+				return false;
+		}
+		return true;
+	}
+}
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTrajectoryThrowStationTest, "TowerOfCode.Throwing.ThrowStation",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FTrajectoryThrowStationTest::RunTest(const FString& Parameters)
+{
+	FThrowingTestWorld TestWorld;
+	UWorld* World = TestWorld.Get();
+
+	// Floor two meters below the station, the level shots land on it after about 1900cm
+	TestWorld.SpawnStatic<UBoxComponent>(FTransform(FVector(0.f, 0.f, -250.f)),
+		[](UBoxComponent* Box) { Box->SetBoxExtent(FVector(10000.f, 10000.f, 50.f), false); });
+
+	const FString TableName = FString::Printf(TEXT("AutomationTest_%s"), *FGuid::NewGuid().ToString());
+	ATrajectoryThrowStation* Station = World->SpawnActorDeferred<ATrajectoryThrowStation>(ATrajectoryThrowStation::StaticClass(), FTransform::Identity);
+	Station->ProjectileClass = ATowerOfCodeThrowingProjectile::StaticClass();
+	Station->TableName = TableName;
+	Station->YawRange = FVector2D(-10.f, 10.f);
+	Station->PitchRange = FVector2D(-10.f, 10.f);
+	Station->YawSteps = 5;
+	Station->PitchSteps = 5;
+	Station->FinishSpawning(FTransform::Identity);
+
+	const TArray<AActor*> NoIgnoredActors;
+	const FThrowStationArc LiveArc = Station->QueryArc(FRotator::ZeroRotator, NoIgnoredActors);
+
+	auto GetTablePath = [](const FString& Name)
+	{
+		return FPaths::Combine(FPaths::ProjectContentDir(), TEXT("TrajectoryTables"), Name + TEXT(".trajtable"));
+	};
+
+	Station->BakeTable();
+	const bool bLoaded = TestTrue(TEXT("Table loaded"), Station->IsTableLoaded());
+	TArray<uint8> TableBytes;
+	FFileHelper::LoadFileToArray(TableBytes, *GetTablePath(TableName));
+	IFileManager::Get().Delete(*GetTablePath(TableName));
+	if (!bLoaded)
+		return false;
+
+	const FThrowStationArc BakedArc = Station->QueryArc(FRotator::ZeroRotator, NoIgnoredActors);
+	TestTrue(TEXT("Arc from the table"), BakedArc.bFromTable);
+	TestTrue(TEXT("Baked arc matches the live one"), ArcsMatch(BakedArc, LiveArc));
+	if (!TestTrue(TEXT("Arc lands on the floor"), BakedArc.Points.Num() >= 2))
+		return false;
+
+	// Whoever operates the station stands in the launch point
+	ACharacter* Operator = World->SpawnActor<ACharacter>(FVector(0.f, 0.f, 0.f), FRotator::ZeroRotator);
+	if (TestNotNull(TEXT("Operator"), Operator))
+	{
+		Station->SetInstigator(Operator);
+		TestTrue(TEXT("The instigator doesn't block the baked arc"), ArcsMatch(Station->QueryArc(FRotator::ZeroRotator, NoIgnoredActors), BakedArc));
+		Station->SetInstigator(nullptr);
+		TestTrue(TEXT("Ignored actors don't block the baked arc"), ArcsMatch(Station->QueryArc(FRotator::ZeroRotator, { Operator }), BakedArc));
+		Operator->Destroy();
+	}
+
+	// A projectile still in flight along the arc
+	ATowerOfCodeThrowingProjectile* Projectile = World->SpawnActor<ATowerOfCodeThrowingProjectile>(FVector(300.f, 0.f, -5.f), FRotator::ZeroRotator);
+	if (TestNotNull(TEXT("Projectile"), Projectile))
+	{
+		Projectile->GetProjectileMovement()->SetComponentTickEnabled(false);
+		TestTrue(TEXT("Projectiles in flight don't block the baked arc"), ArcsMatch(Station->QueryArc(FRotator::ZeroRotator, NoIgnoredActors), BakedArc));
+		Projectile->Destroy();
+	}
+
+	// Corrupt or stale tables are rejected and the arcs are simulated live
+	const int32 LaunchSpeedOffset = 28;
+	const int32 ClassHashOffset = 52;
+	auto TestRejected = [&](const TCHAR* What, int32 Offset, uint32 Value, bool bWithClass)
+	{
+		TArray<uint8> CorruptBytes = TableBytes;
+		if (Offset >= 0 && Offset + (int32)sizeof(Value) <= CorruptBytes.Num())
+		{
+			FMemory::Memcpy(CorruptBytes.GetData() + Offset, &Value, sizeof(Value));
+		}
+		const FString CorruptName = FString::Printf(TEXT("AutomationTest_%s"), *FGuid::NewGuid().ToString());
+		FFileHelper::SaveArrayToFile(CorruptBytes, *GetTablePath(CorruptName));
+
+		ATrajectoryThrowStation* CorruptStation = World->SpawnActorDeferred<ATrajectoryThrowStation>(ATrajectoryThrowStation::StaticClass(), FTransform::Identity);
+		CorruptStation->ProjectileClass = bWithClass ? ATowerOfCodeThrowingProjectile::StaticClass() : nullptr;
+		CorruptStation->TableName = CorruptName;
+		CorruptStation->YawRange = FVector2D(-10.f, 10.f);
+		CorruptStation->PitchRange = FVector2D(-10.f, 10.f);
+		CorruptStation->YawSteps = 5;
+		CorruptStation->PitchSteps = 5;
+		CorruptStation->FinishSpawning(FTransform::Identity);
+
+		TestFalse(FString::Printf(TEXT("Table with %s rejected"), What), CorruptStation->IsTableLoaded());
+		const FThrowStationArc Arc = CorruptStation->QueryArc(FRotator::ZeroRotator, NoIgnoredActors);
+		TestFalse(FString::Printf(TEXT("Arc with %s simulated live"), What), Arc.bFromTable);
+		if (bWithClass)
+		{
+			TestTrue(FString::Printf(TEXT("Live arc with %s matches"), What), ArcsMatch(Arc, LiveArc));
+		}
+
+		CorruptStation->Destroy();
+		IFileManager::Get().Delete(*GetTablePath(CorruptName));
+	};
+
+	// Bit patterns of a quiet NaN, 0, -1 and 10000
+	TestRejected(TEXT("a NaN speed"), LaunchSpeedOffset, 0x7FC00000, true);
+	TestRejected(TEXT("a zero speed"), LaunchSpeedOffset, 0x00000000, true);
+	TestRejected(TEXT("a negative speed"), LaunchSpeedOffset, 0xBF800000, true);
+	TestRejected(TEXT("a stale speed"), LaunchSpeedOffset, 0x461C4000, true);
+	TestRejected(TEXT("another projectile class"), ClassHashOffset, 0xDEADBEEF, true);
+	TestRejected(TEXT("no projectile class"), INDEX_NONE, 0, false);
+
+	// A dynamic wall before the floor bounces the arc back instead of ending it
+	UBoxComponent* Wall = TestWorld.SpawnDynamic<UBoxComponent>(FTransform(FVector(600.f, 0.f, 0.f)),
+		[](UBoxComponent* Box) { Box->SetBoxExtent(FVector(20.f, 500.f, 500.f), false); });
+	const FThrowStationArc BouncedArc = Station->QueryArc(FRotator::ZeroRotator, NoIgnoredActors);
+	if (TestTrue(TEXT("Arc hits the wall and goes on"), BouncedArc.Points.Num() >= 3))
+	{
+		TestTrue(TEXT("Hit on the wall's face"), FMath::IsNearlyEqual(BouncedArc.Points[1].X, 575.f, 2.f));
+		TestTrue(TEXT("Bounced back from the wall"), BouncedArc.Points[2].X < BouncedArc.Points[1].X);
+		TestTrue(TEXT("Times keep increasing"), BouncedArc.Times[2] > BouncedArc.Times[1]);
+	}
+	TestTrue(TEXT("Ignored wall doesn't change the arc"), ArcsMatch(Station->QueryArc(FRotator::ZeroRotator, { Wall->GetOwner() }), BakedArc));
+
+	return true;
+}
+
+#endif
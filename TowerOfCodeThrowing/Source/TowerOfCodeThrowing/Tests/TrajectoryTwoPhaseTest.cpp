@@ -0,0 +1,152 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "ThrowingTestWorld.h"
+#include "TowerOfCodeThrowingCharacter.h"
+#include "TowerOfCodeThrowingProjectile.h"
+#include "TrajectoryCollisionSubsystem.h"
+#include "TrajectoryIntegrator.h"
+#include "Components/BoxComponent.h"
+#include "Components/SphereComponent.h"
+#include "Misc/AutomationTest.h"
+
+#if WITH_DEV_AUTOMATION_TESTS
+
+IMPLEMENT_SIMPLE_AUTOMATION_TEST(FTrajectoryTwoPhaseTest, "TowerOfCode.Throwing.TwoPhase",
+	EAutomationTestFlags::ApplicationContextMask | EAutomationTestFlags::ProductFilter)
+
+bool FTrajectoryTwoPhaseTest::RunTest(const FString& Parameters)
+{
+	FThrowingTestWorld TestWorld;
+	UWorld* World = TestWorld.Get();
+
+	// A floor under every arc, a wall and a pillar to bounce off
+	TestWorld.SpawnStatic<UBoxComponent>(FTransform(FVector(0.f, 0.f, -50.f)),
+		[](UBoxComponent* Box) { Box->SetBoxExtent(FVector(8000.f, 8000.f, 50.f), false); });
+	TestWorld.SpawnStatic<UBoxComponent>(FTransform(FRotator(0.f, 20.f, 0.f), FVector(1500.f, 0.f, 300.f)),
+		[](UBoxComponent* Box) { Box->SetBoxExtent(FVector(50.f, 1200.f, 300.f), false); });
+	TestWorld.SpawnStatic<UBoxComponent>(FTransform(FVector(-600.f, 700.f, 200.f)),
+		[](UBoxComponent* Box) { Box->SetBoxExtent(FVector(60.f, 60.f, 200.f), false); });
+
+	// A box tilted on every axis floating in the air, the cache hits its inflated corners early
+	const FVector TiltedExtent(80.f, 60.f, 40.f);
+	const FTransform TiltedTransform(FRotator(35.f, 45.f, 20.f), FVector(-900.f, -700.f, 500.f));
+	TestWorld.SpawnStatic<UBoxComponent>(TiltedTransform,
+		[&TiltedExtent](UBoxComponent* Box) { Box->SetBoxExtent(TiltedExtent, false); });
+	TestWorld.SpawnStatic<USphereComponent>(FTransform(FVector(700.f, -900.f, 400.f)),
+		[](USphereComponent* Sphere) { Sphere->SetSphereRadius(50.f, false); });
+
+	// High above the arcs, the preview doesn't ignore its own character
+	ATowerOfCodeThrowingCharacter* Character = World->SpawnActor<ATowerOfCodeThrowingCharacter>(
+		ATowerOfCodeThrowingCharacter::StaticClass(), FVector(0.f, 0.f, 50000.f), FRotator::ZeroRotator);
+	if (!TestNotNull(TEXT("Character"), Character))
+		return false;
+	Character->ProjectileClass = ATowerOfCodeThrowingProjectile::StaticClass();
+	Character->bDrawBeam = true;
+	const float ProjectileRadius = Character->ProjectileClass.GetDefaultObject()->GetSimpleCollisionRadius();
+
+	// Where the preview marks its hits, from the entries DrawTrajectory added last
+	auto Preview = [Character, World](const FVector& Launch, const FVector& Velocity, bool bTwoPhase)
+	{
+		Character->bTwoPhaseTrace = bTwoPhase;
+		const int32 FirstHit = Character->HittedMeshArray.Num();
+		Character->DrawTrajectory(Launch, Velocity, FVector(0.f, 0.f, World->GetGravityZ()), 0.f, 3);
+
+		TArray<FVector> Hits;
+		for (int32 Index = FirstHit; Index < Character->HittedMeshArray.Num(); Index++)
+		{
+			Hits.Add(Character->HittedMeshArray[Index]->GetComponentLocation());
+		}
+		return Hits;
+	};
+
+	const FVector Launch(0.f, 0.f, 150.f);
+	const FVector Gravity(0.f, 0.f, World->GetGravityZ());
+
+	// The tilted box's corner facing the launch
+	FVector Corner = TiltedTransform.TransformPosition(TiltedExtent);
+	for (int32 CornerIndex = 1; CornerIndex < 8; CornerIndex++)
+	{
+		const FVector Signs(CornerIndex & 1 ? -1.f : 1.f, CornerIndex & 2 ? -1.f : 1.f, CornerIndex & 4 ? -1.f : 1.f);
+		const FVector Candidate = TiltedTransform.TransformPosition(TiltedExtent * Signs);
+		if (FVector::Dist(Candidate, Launch) < FVector::Dist(Corner, Launch))
+		{
+			Corner = Candidate;
+		}
+	}
+
+	const ETrajectoryCollisionBackend Backends[] = { ETrajectoryCollisionBackend::SceneQuery, ETrajectoryCollisionBackend::StaticCache };
+	const int32 RunLengths[] = { 1, 4, 16 };
+	FRandomStream Random(7);
+	for (ETrajectoryCollisionBackend Backend : Backends)
+	{
+		Character->CollisionBackend = Backend;
+		const TCHAR* BackendName = Backend == ETrajectoryCollisionBackend::SceneQuery ? TEXT("SceneQuery") : TEXT("StaticCache");
+		int32 HitCount = 0;
+
+		for (int32 RunLength : RunLengths)
+		{
+			Character->TwoPhaseRunLength = RunLength;
+			for (int32 Arc = 0; Arc < 96; Arc++)
+			{
+				FVector Velocity;
+				if (Arc % 2 == 0)
+				{
+					const FVector Direction = FRotator(Random.FRandRange(-10.f, 70.f), Random.FRandRange(-180.f, 180.f), 0.f).Vector();
+					Velocity = Direction * Random.FRandRange(500.f, 2500.f);
+				}
+				else
+				{
+					// Through a point up to three radii from the corner, so the arc grazes it
+					const FVector Target = Corner + Random.GetUnitVector() * Random.FRandRange(0.f, 3.f * ProjectileRadius);
+					const float FlightTime = Random.FRandRange(0.3f, 0.8f);
+					Velocity = (Target - Launch - 0.5f * Gravity * FlightTime * FlightTime) / FlightTime;
+				}
+
+				const TArray<FVector> Swept = Preview(Launch, Velocity, false);
+				const TArray<FVector> TwoPhase = Preview(Launch, Velocity, true);
+				HitCount += Swept.Num();
+
+				// The overlaps only skip sweeps that can't hit, so the arcs are the same
+				const FString Name = FString::Printf(TEXT("%s arc %d with runs of %d"), BackendName, Arc, RunLength);
+				if (!TestEqual(Name + TEXT(" hits"), TwoPhase.Num(), Swept.Num()))
+					continue;
+				for (int32 Hit = 0; Hit < Swept.Num(); Hit++)
+				{
+					TestTrue(FString::Printf(TEXT("%s, hit %d is %.3f cm off"), *Name, Hit, FVector::Dist(TwoPhase[Hit], Swept[Hit])),
+						TwoPhase[Hit].Equals(Swept[Hit], KINDA_SMALL_NUMBER));
+				}
+			}
+		}
+		TestTrue(FString::Printf(TEXT("%s arcs hit something"), BackendName), HitCount > 0);
+	}
+
+	// The broadphase reaches as far as the cache's inflated box corners
+	UTrajectoryCollisionSubsystem* CollisionCache = World->GetSubsystem<UTrajectoryCollisionSubsystem>();
+	if (TestTrue(TEXT("Cache built"), CollisionCache != nullptr && CollisionCache->GetCache().IsValid()))
+	{
+		TestTrue(TEXT("Inflation of boxes"), CollisionCache->GetCache()->GetInflationScale() >= FMath::Sqrt(3.f) - KINDA_SMALL_NUMBER);
+	}
+
+	// The run bounds hold every step of the run, without moving the caller's integrator
+	FTrajectoryFlightParams FlightParams;
+	FlightParams.Gravity = Gravity;
+	FlightParams.bBounce = false;
+	TTrajectoryIntegrator<FTrajectoryNoDrag, FTrajectoryNoWind, FTrajectoryNoBounce> Integrator(FlightParams);
+	Integrator.BeginLeg(Launch, FVector(800.f, 300.f, 1200.f));
+	const float SimFrequency = 1.e-2f;
+	const FVector TraceStart = Integrator.Sample(0.5f);
+	const FVector Velocity = Integrator.GetVelocity();
+	const FBox RunBounds = ATowerOfCodeThrowingCharacter::GetTrajectoryRunBounds(TraceStart, Integrator, 0.5f + SimFrequency, SimFrequency, 8);
+	TestTrue(TEXT("Integrator untouched"), Integrator.GetVelocity().Equals(Velocity));
+	TestTrue(TEXT("Run bounds hold the start"), RunBounds.IsInsideOrOn(TraceStart));
+	for (int32 Step = 1; Step <= 8; Step++)
+	{
+		TestTrue(FString::Printf(TEXT("Run bounds hold step %d"), Step), RunBounds.IsInsideOrOn(Integrator.Sample(0.5f + Step * SimFrequency)));
+	}
+	TestFalse(TEXT("Run bounds end with the run"), RunBounds.IsInsideOrOn(Integrator.Sample(0.5f + 10 * SimFrequency)));
+
+	return true;
+}
+
+#endif
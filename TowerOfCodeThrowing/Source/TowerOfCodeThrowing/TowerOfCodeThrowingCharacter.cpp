@@ -2,6 +2,7 @@
 
 #include "TowerOfCodeThrowingCharacter.h"
 #include "TowerOfCodeThrowingProjectile.h"
+#include "InputRecorderComponent.h"
 #include "Animation/AnimInstance.h"
 #include "Camera/CameraComponent.h"
 #include "Components/CapsuleComponent.h"
@@ -11,6 +12,10 @@
 #include "Kismet/GameplayStatics.h"
 #include "MotionControllerComponent.h"
 #include "XRMotionControllerBase.h" // for FXRMotionControllerBase::RightHandSourceId
+#include "Net/UnrealNetwork.h"
+#include "ProjectileRegistrySubsystem.h"
+#include "TrajectoryCollisionSubsystem.h"
+#include "TrajectoryProjectileMovementComponent.h"
 
 DEFINE_LOG_CATEGORY_STATIC(LogFPChar, Warning, All);
 
@@ -86,10 +91,27 @@ ATowerOfCodeThrowingCharacter::ATowerOfCodeThrowingCharacter()
 	BeamComp->SetupAttachment(FP_Gun);
 	BeamComp->bAutoActivate = false;
 
+	InputRecorder = CreateDefaultSubobject<UInputRecorderComponent>(TEXT("InputRecorder"));
+
 	// Uncomment the following line to turn motion controllers on by default:
 	//bUsingMotionControllers = true;
 
 	IsPredicting = false;
+	PredictionBounces = 2;
+	CollisionBackend = ETrajectoryCollisionBackend::SceneQuery;
+	bTwoPhaseTrace = true;
+	TwoPhaseRunLength = 8;
+	PreviewSendRate = 10.f;
+	bDrawBeam = false;
+	MaxBeamSegments = 16;
+}
+
+void ATowerOfCodeThrowingCharacter::GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const
+{
+	Super::GetLifetimeReplicatedProps(OutLifetimeProps);
+
+	// The owner draws its own preview every frame
+	DOREPLIFETIME_CONDITION(ATowerOfCodeThrowingCharacter, TrajectoryPreview, COND_SkipOwner);
 }
 
 void ATowerOfCodeThrowingCharacter::BeginPlay()
@@ -122,8 +144,8 @@ void ATowerOfCodeThrowingCharacter::SetupPlayerInputComponent(class UInputCompon
 	check(PlayerInputComponent);
 
 	// Bind jump events
-	PlayerInputComponent->BindAction("Jump", IE_Pressed, this, &ACharacter::Jump);
-	PlayerInputComponent->BindAction("Jump", IE_Released, this, &ACharacter::StopJumping);
+	PlayerInputComponent->BindAction("Jump", IE_Pressed, this, &ATowerOfCodeThrowingCharacter::OnJumpPressed);
+	PlayerInputComponent->BindAction("Jump", IE_Released, this, &ATowerOfCodeThrowingCharacter::OnJumpReleased);
 
 	// Bind fire event
 	PlayerInputComponent->BindAction("Fire", IE_Pressed, this, &ATowerOfCodeThrowingCharacter::OnFire);
@@ -144,14 +166,46 @@ void ATowerOfCodeThrowingCharacter::SetupPlayerInputComponent(class UInputCompon
 	// We have 2 versions of the rotation bindings to handle different kinds of devices differently
 	// "turn" handles devices that provide an absolute delta, such as a mouse.
 	// "turnrate" is for devices that we choose to treat as a rate of change, such as an analog joystick
-	PlayerInputComponent->BindAxis("Turn", this, &APawn::AddControllerYawInput);
+	PlayerInputComponent->BindAxis("Turn", this, &ATowerOfCodeThrowingCharacter::Turn);
 	PlayerInputComponent->BindAxis("TurnRate", this, &ATowerOfCodeThrowingCharacter::TurnAtRate);
-	PlayerInputComponent->BindAxis("LookUp", this, &APawn::AddControllerPitchInput);
+	PlayerInputComponent->BindAxis("LookUp", this, &ATowerOfCodeThrowingCharacter::LookUp);
 	PlayerInputComponent->BindAxis("LookUpRate", this, &ATowerOfCodeThrowingCharacter::LookUpAtRate);
+
+	// The same handlers are driven by the recorder while replaying
+	InputRecorder->BindAction(EInputRecordAction::Jump, true, FInputRecordActionHandler::CreateUObject(this, &ATowerOfCodeThrowingCharacter::OnJumpPressed));
+	InputRecorder->BindAction(EInputRecordAction::Jump, false, FInputRecordActionHandler::CreateUObject(this, &ATowerOfCodeThrowingCharacter::OnJumpReleased));
+	InputRecorder->BindAction(EInputRecordAction::Fire, true, FInputRecordActionHandler::CreateUObject(this, &ATowerOfCodeThrowingCharacter::OnFire));
+	InputRecorder->BindAction(EInputRecordAction::Predict, true, FInputRecordActionHandler::CreateUObject(this, &ATowerOfCodeThrowingCharacter::OnPredictPressed));
+	InputRecorder->BindAction(EInputRecordAction::Predict, false, FInputRecordActionHandler::CreateUObject(this, &ATowerOfCodeThrowingCharacter::OnPredictReleased));
+	InputRecorder->BindAxis(EInputRecordAxis::MoveForward, FInputRecordAxisHandler::CreateUObject(this, &ATowerOfCodeThrowingCharacter::MoveForward));
+	InputRecorder->BindAxis(EInputRecordAxis::MoveRight, FInputRecordAxisHandler::CreateUObject(this, &ATowerOfCodeThrowingCharacter::MoveRight));
+	InputRecorder->BindAxis(EInputRecordAxis::Turn, FInputRecordAxisHandler::CreateUObject(this, &ATowerOfCodeThrowingCharacter::Turn));
+	InputRecorder->BindAxis(EInputRecordAxis::TurnRate, FInputRecordAxisHandler::CreateUObject(this, &ATowerOfCodeThrowingCharacter::TurnAtRate));
+	InputRecorder->BindAxis(EInputRecordAxis::LookUp, FInputRecordAxisHandler::CreateUObject(this, &ATowerOfCodeThrowingCharacter::LookUp));
+	InputRecorder->BindAxis(EInputRecordAxis::LookUpRate, FInputRecordAxisHandler::CreateUObject(this, &ATowerOfCodeThrowingCharacter::LookUpAtRate));
+}
+
+void ATowerOfCodeThrowingCharacter::OnJumpPressed()
+{
+	if (!InputRecorder->FilterAction(EInputRecordAction::Jump, true))
+		return;
+
+	Jump();
+}
+
+void ATowerOfCodeThrowingCharacter::OnJumpReleased()
+{
+	if (!InputRecorder->FilterAction(EInputRecordAction::Jump, false))
+		return;
+
+	StopJumping();
 }
 
 void ATowerOfCodeThrowingCharacter::OnFire()
 {
+	if (!InputRecorder->FilterAction(EInputRecordAction::Fire, true))
+		return;
+
 	// try and fire a projectile
 	if (ProjectileClass != nullptr)
 	{
@@ -162,7 +216,11 @@ void ATowerOfCodeThrowingCharacter::OnFire()
 			{
 				const FRotator SpawnRotation = VR_MuzzleLocation->GetComponentRotation();
 				const FVector SpawnLocation = VR_MuzzleLocation->GetComponentLocation();
-				World->SpawnActor<ATowerOfCodeThrowingProjectile>(ProjectileClass, SpawnLocation, SpawnRotation);
+
+				// The instigator keeps the player's own shots significant, see UProjectileSignificanceSubsystem
+				FActorSpawnParameters ActorSpawnParams;
+				ActorSpawnParams.Instigator = this;
+				World->SpawnActor<ATowerOfCodeThrowingProjectile>(ProjectileClass, SpawnLocation, SpawnRotation, ActorSpawnParams);
 			}
 			else
 			{
@@ -173,6 +231,7 @@ void ATowerOfCodeThrowingCharacter::OnFire()
 				//Set Spawn Collision Handling Override
 				FActorSpawnParameters ActorSpawnParams;
 				ActorSpawnParams.SpawnCollisionHandlingOverride = ESpawnActorCollisionHandlingMethod::AdjustIfPossibleButDontSpawnIfColliding;
+				ActorSpawnParams.Instigator = this;
 
 				// spawn the projectile at the muzzle
 				World->SpawnActor<ATowerOfCodeThrowingProjectile>(ProjectileClass, SpawnLocation, SpawnRotation, ActorSpawnParams);
@@ -199,7 +258,8 @@ void ATowerOfCodeThrowingCharacter::OnFire()
 }
 
 
-void ATowerOfCodeThrowingCharacter::DrawTrajectory(const FVector InitialLocation, const FVector InitialVelocity, const FVector Gravity, float Duration) 
+template<typename IntegratorType>
+void ATowerOfCodeThrowingCharacter::DrawTrajectoryWith(IntegratorType Integrator, const FVector InitialLocation, const FVector InitialVelocity, int MaxSimBounce)
 {
 	bool bObjectHit;
 	FHitResult ObjectTraceHit(NoInit);
@@ -207,47 +267,81 @@ void ATowerOfCodeThrowingCharacter::DrawTrajectory(const FVector InitialLocation
 	FVector StartVelocity = InitialVelocity;
 	FVector TraceStart;
 	FVector TraceEnd;
-	TraceStart = TraceEnd = CalculateProjectileLocationOnTime(StartLocation, StartVelocity, Gravity, 0.0f);
+	Integrator.BeginLeg(StartLocation, StartVelocity);
+	TraceStart = TraceEnd = Integrator.Sample(0.0f);
 	UWorld const* const World = GetWorld();
 	const float ProjectileRadius = ProjectileClass.GetDefaultObject()->GetSimpleCollisionRadius();
 	FCollisionQueryParams QueryParams(NAME_None, false, NULL);
 	FCollisionObjectQueryParams ObjQueryParams;
 	const float MaxSimTime = 2.0f;
-	const int MaxSimBounce = 2;
 	const float SimFrequency = 1.e-2f;
 	float SimTime = 0.f;
 	int SimBounce = 0;
-	float Friction = ProjectileClass.GetDefaultObject()->GetProjectileMovement()->Friction;
-	float Bounciness = ProjectileClass.GetDefaultObject()->GetProjectileMovement()->Bounciness;
 	FVector CurrentVelocity = StartVelocity;
 
 	// to ignore the projectiles
-	TArray<AActor*> FoundActors;
-	UGameplayStatics::GetAllActorsOfClass(GetWorld(), ProjectileClass.GetDefaultObject()->StaticClass(), FoundActors);
-	QueryParams.AddIgnoredActors(FoundActors);
+	if (UProjectileRegistrySubsystem* Registry = GetWorld()->GetSubsystem<UProjectileRegistrySubsystem>())
+	{
+		QueryParams.AddIgnoredActors(Registry->GetSnapshot()->Projectiles);
+	}
 
-	//ClearBeams();
 	DestroyTrajectory();
 
+	TArray<FVector> BeamPoints;
+	if (bDrawBeam)
+	{
+		BeamPoints.Add(TraceStart);
+	}
+
+	UTrajectoryCollisionSubsystem* CollisionCache = GetWorld()->GetSubsystem<UTrajectoryCollisionSubsystem>();
+	if (CollisionBackend == ETrajectoryCollisionBackend::StaticCache && CollisionCache != nullptr)
+	{
+		CollisionCache->EnsureCoverage(InitialLocation);
+	}
+
+	// Steps left in the current broadphase run, and whether the run touches nothing
+	const bool bTwoPhase = bTwoPhaseTrace && CollisionCache != nullptr;
+	int32 RunStepsLeft = 0;
+	bool bRunClear = false;
+
 	while (SimTime < MaxSimTime) 
 	{
-		bObjectHit = World->SweepSingleByObjectType(ObjectTraceHit, TraceStart, TraceEnd,
-			FQuat::Identity, ObjQueryParams, FCollisionShape::MakeSphere(ProjectileRadius), QueryParams);
+		if (bTwoPhase && RunStepsLeft == 0)
+		{
+			RunStepsLeft = FMath::Max(1, TwoPhaseRunLength);
+			const FBox RunBounds = GetTrajectoryRunBounds(TraceStart, Integrator, SimTime, SimFrequency, RunStepsLeft);
+			bRunClear = !CollisionCache->OverlapSweptBounds(RunBounds, ProjectileRadius, ObjQueryParams, QueryParams);
+		}
+
+		bObjectHit = bTwoPhase && bRunClear
+			? false
+			: SweepTrajectory(ObjectTraceHit, TraceStart, TraceEnd, ProjectileRadius, ObjQueryParams, QueryParams);
+		if (bTwoPhase)
+		{
+			RunStepsLeft--;
+		}
 
 		FVector StartTangent = CurrentVelocity;
-		FVector EndTangent = StartVelocity + Gravity * SimTime;
+		// The integrator was last sampled at TraceEnd
+		FVector EndTangent = Integrator.GetVelocity();
 		StartTangent.Normalize();
 		EndTangent.Normalize();
 
-		USplineMeshComponent* pSplineMesh = NewObject<USplineMeshComponent>(this, USplineMeshComponent::StaticClass());
-		pSplineMesh->CreationMethod = EComponentCreationMethod::UserConstructionScript;
-		pSplineMesh->SetStartScale(FVector2D(3, 3));
-		pSplineMesh->SetEndScale(FVector2D(3, 3));
-		pSplineMesh->SetStaticMesh(MyMesh);
-		pSplineMesh->SetStartAndEnd(TraceStart, StartTangent, TraceEnd, EndTangent);
+		if (bDrawBeam)
+		{
+			BeamPoints.Add(bObjectHit ? ObjectTraceHit.Location : TraceEnd);
+		}
+		else
+		{
+			USplineMeshComponent* pSplineMesh = NewObject<USplineMeshComponent>(this, USplineMeshComponent::StaticClass());
+			pSplineMesh->CreationMethod = EComponentCreationMethod::UserConstructionScript;
+			pSplineMesh->SetStartScale(FVector2D(3, 3));
+			pSplineMesh->SetEndScale(FVector2D(3, 3));
+			pSplineMesh->SetStaticMesh(MyMesh);
+			pSplineMesh->SetStartAndEnd(TraceStart, StartTangent, TraceEnd, EndTangent);
+		}
 
-		//AddNewBeam(TraceStart, TraceEnd);
-		CurrentVelocity = StartVelocity + Gravity * SimTime;
+		CurrentVelocity = Integrator.GetVelocity();
 
 		if (bObjectHit) 
 		{
@@ -265,19 +359,25 @@ void ATowerOfCodeThrowingCharacter::DrawTrajectory(const FVector InitialLocation
 
 			HittedMeshArray.Add(pHittedMesh);
 
-			CurrentVelocity = StartVelocity + Gravity * (SimTime - SimFrequency * (1 - ObjectTraceHit.Time));
+			// Projectiles that don't bounce stop at the first hit
+			if (!IntegratorType::bBounces)
+			{
+				break;
+			}
+
+			Integrator.Sample(SimTime - SimFrequency * (1 - ObjectTraceHit.Time));
+			CurrentVelocity = Integrator.GetVelocity();
 
-			FVector ComponentOfImpactNormal = ObjectTraceHit.ImpactNormal * FVector::DotProduct(ObjectTraceHit.ImpactNormal, CurrentVelocity);
-			FVector FrictionVector = (CurrentVelocity - ComponentOfImpactNormal) * Friction;
-			FVector BouncinessVector = ComponentOfImpactNormal * Bounciness;
-			StartVelocity = CurrentVelocity - ComponentOfImpactNormal - BouncinessVector - FrictionVector;
-			StartVelocity = GetReflectedVector(ObjectTraceHit.ImpactNormal, CurrentVelocity, Friction, Bounciness);
+			StartVelocity = Integrator.Bounce(ObjectTraceHit.ImpactNormal, CurrentVelocity);
 			StartLocation = TraceEnd = ObjectTraceHit.Location;
 
 			SimTime = 0.0005f;
-			TraceEnd = CalculateProjectileLocationOnTime(StartLocation, StartVelocity
-				, Gravity, SimTime);
-			CurrentVelocity = StartVelocity + Gravity * (SimTime - SimFrequency * (1 - ObjectTraceHit.Time));
+			Integrator.BeginLeg(StartLocation, StartVelocity);
+			TraceEnd = Integrator.Sample(SimTime);
+
+			// The next run starts from the bounce
+			RunStepsLeft = 0;
+			CurrentVelocity = StartVelocity;
 
 			ProjectileClass.GetDefaultObject()->GetCollisionComp();
 
@@ -287,10 +387,42 @@ void ATowerOfCodeThrowingCharacter::DrawTrajectory(const FVector InitialLocation
 		}
 		TraceStart = TraceEnd;
 		SimTime += SimFrequency;
-		TraceEnd = CalculateProjectileLocationOnTime(StartLocation, StartVelocity, Gravity, SimTime);
+		TraceEnd = Integrator.Sample(SimTime);
 
 	}
 	RegisterAllComponents();
+
+	if (bDrawBeam)
+	{
+		UpdateBeam(BeamPoints);
+	}
+	else
+	{
+		ClearBeams();
+	}
+}
+
+void ATowerOfCodeThrowingCharacter::DrawTrajectory(const FVector InitialLocation, const FVector InitialVelocity, const FVector Gravity, float Duration, int MaxSimBounce)
+{
+	// The flight model is picked once per preview, each one has its own copy of the loop
+	FTrajectoryFlightParams FlightParams = UTrajectoryProjectileMovementComponent::MakeFlightParams(
+		ProjectileClass.GetDefaultObject()->GetProjectileMovement(), Gravity.Z);
+	TrajectoryIntegrator::Visit(FlightParams, [&](auto Integrator)
+	{
+		DrawTrajectoryWith(Integrator, InitialLocation, InitialVelocity, MaxSimBounce);
+	});
+}
+
+bool ATowerOfCodeThrowingCharacter::SweepTrajectory(FHitResult& OutHit, const FVector& Start, const FVector& End, float Radius, const FCollisionObjectQueryParams& ObjectParams, const FCollisionQueryParams& Params)
+{
+	if (CollisionBackend == ETrajectoryCollisionBackend::StaticCache)
+	{
+		if (UTrajectoryCollisionSubsystem* CollisionCache = GetWorld()->GetSubsystem<UTrajectoryCollisionSubsystem>())
+			return CollisionCache->SweepSphere(OutHit, Start, End, Radius, ObjectParams, Params);
+	}
+
+	return GetWorld()->SweepSingleByObjectType(OutHit, Start, End,
+		FQuat::Identity, ObjectParams, FCollisionShape::MakeSphere(Radius), Params);
 }
 
 void ATowerOfCodeThrowingCharacter::DestroyTrajectory()
@@ -321,9 +453,111 @@ void ATowerOfCodeThrowingCharacter::Tick(float DeltaSeconds) {
 		float Speed = Movement->InitialSpeed;
 		const float Gravity = UPhysicsSettings::Get()->DefaultGravityZ;
 		FVector InitialVelocity = ForwardVector * Speed;
+		DrawTrajectory(LocationVector, InitialVelocity, FVector(0, 0, Gravity), DeltaSeconds + .01f, PredictionBounces);
+		SendTrajectoryPreview(LocationVector, ForwardVector, Speed);
+	}
+}
+
+ETrajectoryPreviewSend FTrajectoryPreviewSender::Update(const FTrajectoryPreviewState& State, float Now, float SendRate)
+{
+	ETrajectoryPreviewSend Send = ETrajectoryPreviewSend::None;
+	if (State.bActive != LastSent.bActive)
+	{
+		Send = ETrajectoryPreviewSend::Reliable;
+	}
+	else if (State == LastSent)
+	{
+		// Holding still costs nothing once the aim is known to have arrived
+		if (!bLastSentReliably)
+		{
+			Send = ETrajectoryPreviewSend::Reliable;
+		}
+	}
+	else if (SendRate <= 0.f || Now - LastSendTime >= 1.f / SendRate)
+	{
+		Send = ETrajectoryPreviewSend::Unreliable;
+	}
+
+	if (Send != ETrajectoryPreviewSend::None)
+	{
+		LastSent = State;
+		LastSendTime = Now;
+		bLastSentReliably = Send == ETrajectoryPreviewSend::Reliable;
+	}
+	return Send;
+}
+
+void ATowerOfCodeThrowingCharacter::SendTrajectoryPreview(const FVector MuzzleLocation, const FVector Direction, float Speed)
+{
+	if (GetNetMode() == NM_Standalone)
+		return;
+
+	FTrajectoryPreviewState State;
+	State.bActive = IsPredicting;
+	if (State.bActive)
+	{
+		State.MuzzleLocation = MuzzleLocation;
+		State.Direction = Direction;
+		State.Speed = (uint16)FMath::Clamp(FMath::RoundToInt(Speed), 0, (int32)MAX_uint16);
+		State.BounceCount = (uint8)FMath::Clamp(PredictionBounces, 0, (int32)MAX_uint8);
+	}
+
+	const ETrajectoryPreviewSend Send = PreviewSender.Update(State, GetWorld()->GetTimeSeconds(), PreviewSendRate);
+	if (Send == ETrajectoryPreviewSend::None)
+		return;
+
+	if (HasAuthority())
+	{
+		TrajectoryPreview = State;
+	}
+	else if (Send == ETrajectoryPreviewSend::Reliable)
+	{
+		ServerSetTrajectoryPreview(State);
+	}
+	else
+	{
+		ServerUpdateTrajectoryPreview(State);
+	}
+}
+
+void ATowerOfCodeThrowingCharacter::ServerUpdateTrajectoryPreview_Implementation(const FTrajectoryPreviewState& State)
+{
+	// A late update must not bring back a stopped preview, the reliable start carries the first aim
+	if (!State.bActive || !TrajectoryPreview.bActive)
+		return;
+
+	SetTrajectoryPreview(State);
+}
+
+void ATowerOfCodeThrowingCharacter::ServerSetTrajectoryPreview_Implementation(const FTrajectoryPreviewState& State)
+{
+	SetTrajectoryPreview(State);
+}
+
+void ATowerOfCodeThrowingCharacter::SetTrajectoryPreview(const FTrajectoryPreviewState& State)
+{
+	TrajectoryPreview = State;
+
+	// A listen server host sees remote players' previews too
+	if (!IsLocallyControlled() && GetNetMode() == NM_ListenServer)
+	{
+		OnRep_TrajectoryPreview();
+	}
+}
+
+void ATowerOfCodeThrowingCharacter::OnRep_TrajectoryPreview()
+{
+	if (!TrajectoryPreview.bActive)
+	{
+		DestroyTrajectory();
 		ClearBeams();
-		DrawTrajectory(LocationVector, InitialVelocity, FVector(0, 0, Gravity), DeltaSeconds + .01f);
+		return;
 	}
+
+	// Rebuilt only when a new launch state arrives, not every frame
+	const float Gravity = UPhysicsSettings::Get()->DefaultGravityZ;
+	const FVector InitialVelocity = FVector(TrajectoryPreview.Direction) * TrajectoryPreview.Speed;
+	DrawTrajectory(TrajectoryPreview.MuzzleLocation, InitialVelocity, FVector(0, 0, Gravity), 0.f, TrajectoryPreview.BounceCount);
 }
 
 void ATowerOfCodeThrowingCharacter::OnResetVR()
@@ -333,6 +567,9 @@ void ATowerOfCodeThrowingCharacter::OnResetVR()
 
 void ATowerOfCodeThrowingCharacter::OnPredictPressed()
 {
+	if (!InputRecorder->FilterAction(EInputRecordAction::Predict, true))
+		return;
+
 	GEngine->AddOnScreenDebugMessage(-1, 10.0f, FColor::White, TEXT("Predict Pressed"));
 	IsPredicting = true;
 
@@ -342,29 +579,14 @@ void ATowerOfCodeThrowingCharacter::OnPredictPressed()
 
 void ATowerOfCodeThrowingCharacter::OnPredictReleased()
 {
+	if (!InputRecorder->FilterAction(EInputRecordAction::Predict, false))
+		return;
+
 	GEngine->AddOnScreenDebugMessage(-1, 10.0f, FColor::White, TEXT("Predict Released"));
 	IsPredicting = false;
 	DestroyTrajectory();
-	//ClearBeams();
-}
-
-FVector ATowerOfCodeThrowingCharacter::CalculateProjectileLocationOnTime(const FVector StartLocation,
-	const FVector InitialVelocity, const FVector Gravity, const float Time)
-{
-	FVector ResultVector;
-	ResultVector = StartLocation + InitialVelocity * Time + 0.5f * Gravity * Time * Time;
-	return ResultVector;
-}
-
-FVector ATowerOfCodeThrowingCharacter::GetReflectedVector(const FVector ImpactNormal, const FVector Velocity, float Friction, float Bounciness)
-{
-	FVector ComponentAlongImpactNormal = ImpactNormal * FVector::DotProduct(ImpactNormal, Velocity);
-	FVector FrictionVector = (Velocity - ComponentAlongImpactNormal) * Friction;
-	FVector BouncinessVector = ComponentAlongImpactNormal * Bounciness;
-
-	FVector ResultVector = Velocity - ComponentAlongImpactNormal - BouncinessVector - FrictionVector;
-
-	return ResultVector;
+	SendTrajectoryPreview(FVector::ZeroVector, FVector::ZeroVector, 0.f);
+	ClearBeams();
 }
 
 
@@ -393,21 +615,57 @@ void ATowerOfCodeThrowingCharacter::EndTouch(const ETouchIndex::Type FingerIndex
 	TouchItem.bIsPressed = false;
 }
 
-void ATowerOfCodeThrowingCharacter::ClearBeams() {
-	for (UParticleSystemComponent* beam : BeamArray) {
-		beam->DestroyComponent();
+void ATowerOfCodeThrowingCharacter::ClearBeams()
+{
+	if (BeamComp->IsActive())
+	{
+		BeamComp->DeactivateSystem();
 	}
-	BeamArray.Empty();
 }
 
-void ATowerOfCodeThrowingCharacter::AddNewBeam(FVector Point1, FVector Point2)
+void ATowerOfCodeThrowingCharacter::UpdateBeam(const TArray<FVector>& Points)
 {
+	if (BeamFX == nullptr || Points.Num() < 2)
+	{
+		ClearBeams();
+		return;
+	}
+
+	if (BeamComp->Template != BeamFX)
+	{
+		BeamComp->SetTemplate(BeamFX);
+	}
+
+	// Each beam spans a run of points and curves through its end tangents,
+	// beams past the end of the arc collapse onto the last point
+	const int32 LastPoint = Points.Num() - 1;
+	const int32 NumSegments = FMath::Min(MaxBeamSegments, LastPoint);
+	for (int32 Segment = 0; Segment < MaxBeamSegments; Segment++)
+	{
+		if (Segment >= NumSegments)
+		{
+			BeamComp->SetBeamSourcePoint(0, Points[LastPoint], Segment);
+			BeamComp->SetBeamTargetPoint(0, Points[LastPoint], Segment);
+			continue;
+		}
 
-	BeamComp = UGameplayStatics::SpawnEmitterAtLocation(GetWorld(), BeamFX, Point1, FRotator::ZeroRotator, true);
-	BeamArray.Add(BeamComp);
+		const int32 First = Segment * LastPoint / NumSegments;
+		const int32 Last = (Segment + 1) * LastPoint / NumSegments;
+		const FVector SourceTangent = (Points[First + 1] - Points[First]) * (Last - First);
+		const FVector TargetTangent = (Points[Last] - Points[Last - 1]) * (Last - First);
+
+		BeamComp->SetBeamSourcePoint(0, Points[First], Segment);
+		BeamComp->SetBeamSourceTangent(0, SourceTangent.GetSafeNormal(), Segment);
+		BeamComp->SetBeamSourceStrength(0, SourceTangent.Size(), Segment);
+		BeamComp->SetBeamTargetPoint(0, Points[Last], Segment);
+		BeamComp->SetBeamTargetTangent(0, TargetTangent.GetSafeNormal(), Segment);
+		BeamComp->SetBeamTargetStrength(0, TargetTangent.Size(), Segment);
+	}
 
-	BeamComp->SetBeamSourcePoint(0, Point1, 0);
-	BeamComp->SetBeamTargetPoint(0, Point2, 0);
+	if (!BeamComp->IsActive())
+	{
+		BeamComp->ActivateSystem();
+	}
 }
 
 //Commenting this section out to be consistent with FPS BP template.
@@ -450,6 +708,9 @@ void ATowerOfCodeThrowingCharacter::AddNewBeam(FVector Point1, FVector Point2)
 
 void ATowerOfCodeThrowingCharacter::MoveForward(float Value)
 {
+	if (!InputRecorder->FilterAxis(EInputRecordAxis::MoveForward, Value))
+		return;
+
 	if (Value != 0.0f)
 	{
 		// add movement in that direction
@@ -459,6 +720,9 @@ void ATowerOfCodeThrowingCharacter::MoveForward(float Value)
 
 void ATowerOfCodeThrowingCharacter::MoveRight(float Value)
 {
+	if (!InputRecorder->FilterAxis(EInputRecordAxis::MoveRight, Value))
+		return;
+
 	if (Value != 0.0f)
 	{
 		// add movement in that direction
@@ -466,14 +730,36 @@ void ATowerOfCodeThrowingCharacter::MoveRight(float Value)
 	}
 }
 
+void ATowerOfCodeThrowingCharacter::Turn(float Value)
+{
+	if (!InputRecorder->FilterAxis(EInputRecordAxis::Turn, Value))
+		return;
+
+	AddControllerYawInput(Value);
+}
+
+void ATowerOfCodeThrowingCharacter::LookUp(float Value)
+{
+	if (!InputRecorder->FilterAxis(EInputRecordAxis::LookUp, Value))
+		return;
+
+	AddControllerPitchInput(Value);
+}
+
 void ATowerOfCodeThrowingCharacter::TurnAtRate(float Rate)
 {
+	if (!InputRecorder->FilterAxis(EInputRecordAxis::TurnRate, Rate))
+		return;
+
 	// calculate delta for this frame from the rate information
 	AddControllerYawInput(Rate * BaseTurnRate * GetWorld()->GetDeltaSeconds());
 }
 
 void ATowerOfCodeThrowingCharacter::LookUpAtRate(float Rate)
 {
+	if (!InputRecorder->FilterAxis(EInputRecordAxis::LookUpRate, Rate))
+		return;
+
 	// calculate delta for this frame from the rate information
 	AddControllerPitchInput(Rate * BaseLookUpRate * GetWorld()->GetDeltaSeconds());
 }
@@ -10,6 +10,7 @@
 #include "Components/SplineComponent.h"
 #include "Components/SplineMeshComponent.h"
 #include "Particles/ParticleSystemComponent.h"
+#include "Engine/NetSerialization.h"
 #include "TowerOfCodeThrowingCharacter.generated.h"
 
 class UInputComponent;
@@ -19,6 +20,77 @@ class UCameraComponent;
 class UMotionControllerComponent;
 class UAnimMontage;
 class USoundBase;
+class UInputRecorderComponent;
+
+/** Where the trajectory preview gets its collision from */
+UENUM(BlueprintType)
+enum class ETrajectoryCollisionBackend : uint8
+{
+	/** Every step is a physics scene query */
+	SceneQuery,
+	/** Static geometry comes from UTrajectoryCollisionSubsystem, only the rest is queried */
+	StaticCache
+};
+
+/** Launch state other machines rebuild a player's trajectory preview from */
+USTRUCT()
+struct FTrajectoryPreviewState
+{
+	GENERATED_BODY()
+
+	UPROPERTY()
+		FVector_NetQuantize MuzzleLocation;
+
+	UPROPERTY()
+		FVector_NetQuantizeNormal Direction;
+
+	/** Launch speed in cm/sec */
+	UPROPERTY()
+		uint16 Speed = 0;
+
+	UPROPERTY()
+		uint8 BounceCount = 0;
+
+	UPROPERTY()
+		bool bActive = false;
+
+	bool operator==(const FTrajectoryPreviewState& Other) const
+	{
+		return bActive == Other.bActive
+			&& Speed == Other.Speed
+			&& BounceCount == Other.BounceCount
+			&& MuzzleLocation.Equals(Other.MuzzleLocation, 1.f)
+			&& Direction.Equals(Other.Direction, 1.e-3f);
+	}
+
+	bool operator!=(const FTrajectoryPreviewState& Other) const { return !(*this == Other); }
+};
+
+/** How a preview update travels to the server */
+enum class ETrajectoryPreviewSend : uint8
+{
+	/** Nothing new, or throttled */
+	None,
+	/** An aim change, the next one replaces it if it's lost */
+	Unreliable,
+	/** Starting or stopping the preview, or the aim it settled on */
+	Reliable
+};
+
+/**
+ * Decides which preview states an owner sends. Aim changes go out unreliably at most SendRate times
+ * per second. Edges and the last aim before holding still go out reliably, so a lost packet never
+ * leaves the other machines with a stale or stuck preview.
+ */
+struct FTrajectoryPreviewSender
+{
+	ETrajectoryPreviewSend Update(const FTrajectoryPreviewState& State, float Now, float SendRate);
+
+	FTrajectoryPreviewState LastSent;
+	float LastSendTime = 0.f;
+	/** LastSent is known to arrive, holding still needs nothing more */
+	bool bLastSentReliably = true;
+};
 
 UCLASS(config = Game)
 class ATowerOfCodeThrowingCharacter : public ACharacter
@@ -59,6 +131,10 @@ class ATowerOfCodeThrowingCharacter : public ACharacter
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, meta = (AllowPrivateAccess = "true"))
 		UMotionControllerComponent* L_MotionController;
 
+	/** Records or replays the input bindings for repeatable performance runs */
+	UPROPERTY(VisibleDefaultsOnly, Category = Input)
+		UInputRecorderComponent* InputRecorder;
+
 	bool IsPredicting;
 
 public:
@@ -75,11 +151,47 @@ public:
 
 	UPROPERTY(VisibleAnywhere, BlueprintReadOnly, Category = "ThrowPosition")
 		UParticleSystemComponent* BeamComp;
-	TArray<UParticleSystemComponent*>BeamArray;
+
+	/** Draws the preview with BeamFX on BeamComp instead of spline meshes */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "ThrowPosition")
+		bool bDrawBeam;
+
+	/** Beams the arc is split into, BeamFX has to spawn at least this many user-set beams */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "ThrowPosition", meta = (ClampMin = "1"))
+		int32 MaxBeamSegments;
+
+	/** Bounces simulated by the trajectory preview */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Prediction")
+		int32 PredictionBounces;
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Prediction")
+		ETrajectoryCollisionBackend CollisionBackend;
+
+	/**
+	 * Tests runs of TwoPhaseRunLength steps with one box overlap first and only sweeps the runs that touch something.
+	 * Finds the same hits as sweeping every step, with far fewer queries in open space.
+	 */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Prediction")
+		bool bTwoPhaseTrace;
+
+	/** Steps covered by one broadphase overlap of bTwoPhaseTrace */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Prediction", meta = (ClampMin = "1"))
+		int32 TwoPhaseRunLength;
+
+	/** How often per second the preview is sent to teammates and spectators */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = "Prediction")
+		float PreviewSendRate;
 
 public:
 	ATowerOfCodeThrowingCharacter();
 
+	/**
+	 * Bounds of the next RunLength steps of the arc, the first one ending at SimTime, as bTwoPhaseTrace overlaps them.
+	 * Integrator is a copy, so looking ahead doesn't move the caller's.
+	 */
+	template<typename IntegratorType>
+	static FBox GetTrajectoryRunBounds(const FVector& TraceStart, IntegratorType Integrator, float SimTime, float SimFrequency, int32 RunLength);
+
 protected:
 	virtual void BeginPlay();
 	virtual void Tick(float DeltaSeconds);
@@ -118,18 +230,45 @@ protected:
 	/** Fires a projectile. */
 	void OnFire();
 
+	void OnJumpPressed();
+	void OnJumpReleased();
+
 	/** Predict the trajectory */
 	void OnPredictPressed();
 	void OnPredictReleased();
 
-	FVector CalculateProjectileLocationOnTime(const FVector StartLocation, const FVector InitialVelocity, const FVector Gravity, const float Time);
-	FVector GetReflectedVector(const FVector ImpactNormal, const FVector Velocity, float Friction, float Bounciness);
-	void DrawTrajectory(const FVector StartLocation, const FVector InitialVelocity, const FVector Gravity, float Duration);
-	void AddNewBeam(FVector Point1, FVector Point2);
+	void DrawTrajectory(const FVector StartLocation, const FVector InitialVelocity, const FVector Gravity, float Duration, int MaxSimBounce);
+	/** DrawTrajectory compiled for the flight model of one projectile class, see TTrajectoryIntegrator */
+	template<typename IntegratorType>
+	void DrawTrajectoryWith(IntegratorType Integrator, const FVector InitialLocation, const FVector InitialVelocity, int MaxSimBounce);
+	bool SweepTrajectory(FHitResult& OutHit, const FVector& Start, const FVector& End, float Radius, const FCollisionObjectQueryParams& ObjectParams, const FCollisionQueryParams& Params);
+	/** Feeds the points of the arc to BeamComp, activating it if needed */
+	void UpdateBeam(const TArray<FVector>& Points);
 	void ClearBeams();
 
 	void DestroyTrajectory();
 
+	/** Shares the local preview with the other machines, see FTrajectoryPreviewSender */
+	void SendTrajectoryPreview(const FVector MuzzleLocation, const FVector Direction, float Speed);
+
+	/** Aim updates while the preview is active, ignored outside of it */
+	UFUNCTION(Server, Unreliable)
+		void ServerUpdateTrajectoryPreview(const FTrajectoryPreviewState& State);
+
+	UFUNCTION(Server, Reliable)
+		void ServerSetTrajectoryPreview(const FTrajectoryPreviewState& State);
+
+	void SetTrajectoryPreview(const FTrajectoryPreviewState& State);
+
+	UFUNCTION()
+		void OnRep_TrajectoryPreview();
+
+	/** Replicated preview of this player, only the launch state travels and each receiver rebuilds the arc */
+	UPROPERTY(ReplicatedUsing = OnRep_TrajectoryPreview)
+		FTrajectoryPreviewState TrajectoryPreview;
+
+	FTrajectoryPreviewSender PreviewSender;
+
 	/** Resets HMD orientation and position in VR. */
 	void OnResetVR();
 
@@ -139,6 +278,10 @@ protected:
 	/** Handles stafing movement, left and right */
 	void MoveRight(float Val);
 
+	/** Handles absolute yaw and pitch deltas such as a mouse */
+	void Turn(float Val);
+	void LookUp(float Val);
+
 	/**
 	 * Called via input to turn at a given rate.
 	 * @param Rate	This is a normalized rate, i.e. 1.0 means 100% of desired turn rate
@@ -164,6 +307,9 @@ protected:
 	void TouchUpdate(const ETouchIndex::Type FingerIndex, const FVector Location);
 	TouchData	TouchItem;
 
+public:
+	virtual void GetLifetimeReplicatedProps(TArray<FLifetimeProperty>& OutLifetimeProps) const override;
+
 protected:
 	// APawn interface
 	virtual void SetupPlayerInputComponent(UInputComponent* InputComponent) override;
@@ -183,5 +329,20 @@ public:
 	/** Returns FirstPersonCameraComponent subobject **/
 	UCameraComponent* GetFirstPersonCameraComponent() const { return FirstPersonCameraComponent; }
 
+	/** Compares DrawTrajectory with and without bTwoPhaseTrace */
+	friend class FTrajectoryTwoPhaseTest;
 };
 
+template<typename IntegratorType>
+FBox ATowerOfCodeThrowingCharacter::GetTrajectoryRunBounds(const FVector& TraceStart, IntegratorType Integrator, float SimTime, float SimFrequency, int32 RunLength)
+{
+	// Same time steps as DrawTrajectory, so the bounds hold every segment of the run
+	FBox Bounds(TraceStart, TraceStart);
+	for (int32 Step = 0; Step < RunLength; Step++)
+	{
+		Bounds += Integrator.Sample(SimTime);
+		SimTime += SimFrequency;
+	}
+	return Bounds;
+}
+
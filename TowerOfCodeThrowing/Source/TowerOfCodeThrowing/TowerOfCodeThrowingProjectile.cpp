@@ -1,8 +1,9 @@
 // Copyright Epic Games, Inc. All Rights Reserved.
 
 #include "TowerOfCodeThrowingProjectile.h"
-#include "GameFramework/ProjectileMovementComponent.h"
+#include "TrajectoryProjectileMovementComponent.h"
 #include "Components/SphereComponent.h"
+#include "ProjectileRegistrySubsystem.h"
 
 ATowerOfCodeThrowingProjectile::ATowerOfCodeThrowingProjectile() 
 {
@@ -19,8 +20,8 @@ ATowerOfCodeThrowingProjectile::ATowerOfCodeThrowingProjectile()
 	// Set as root component
 	RootComponent = CollisionComp;
 
-	// Use a ProjectileMovementComponent to govern this projectile's movement
-	ProjectileMovement = CreateDefaultSubobject<UProjectileMovementComponent>(TEXT("ProjectileComp"));
+	// Use a ProjectileMovementComponent to govern this projectile's movement, drag and wind are set per class
+	ProjectileMovement = CreateDefaultSubobject<UTrajectoryProjectileMovementComponent>(TEXT("ProjectileComp"));
 	ProjectileMovement->UpdatedComponent = CollisionComp;
 	ProjectileMovement->InitialSpeed = 3000.f;
 	ProjectileMovement->MaxSpeed = 3000.f;
@@ -29,6 +30,29 @@ ATowerOfCodeThrowingProjectile::ATowerOfCodeThrowingProjectile()
 
 	// Die after 3 seconds by default
 	InitialLifeSpan = 3.0f;
+
+	SignificanceBias = 0.f;
+	SignificanceTier = INDEX_NONE;
+}
+
+void ATowerOfCodeThrowingProjectile::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (UProjectileRegistrySubsystem* Registry = GetWorld()->GetSubsystem<UProjectileRegistrySubsystem>())
+	{
+		Registry->Register(this);
+	}
+}
+
+void ATowerOfCodeThrowingProjectile::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	if (UProjectileRegistrySubsystem* Registry = GetWorld()->GetSubsystem<UProjectileRegistrySubsystem>())
+	{
+		Registry->Unregister(this);
+	}
+
+	Super::EndPlay(EndPlayReason);
 }
 
 void ATowerOfCodeThrowingProjectile::OnHit(UPrimitiveComponent* HitComp, AActor* OtherActor, UPrimitiveComponent* OtherComp, FVector NormalImpulse, const FHitResult& Hit)
@@ -31,6 +31,11 @@ class ATowerOfCodeThrowingProjectile : public AActor
 public:
 	ATowerOfCodeThrowingProjectile();
 
+protected:
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+public:
 	/** called when projectile hits something */
 	UFUNCTION()
 	void OnHit(UPrimitiveComponent* HitComp, AActor* OtherActor, UPrimitiveComponent* OtherComp, FVector NormalImpulse, const FHitResult& Hit);
@@ -39,5 +44,12 @@ public:
 	USphereComponent* GetCollisionComp() const { return CollisionComp; }
 	/** Returns ProjectileMovement subobject **/
 	UProjectileMovementComponent* GetProjectileMovement() const { return ProjectileMovement; }
+
+	/** Gameplay importance added to the significance, see UProjectileSignificanceSubsystem */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Projectile)
+	float SignificanceBias;
+
+	/** Significance tier the movement is set up for, INDEX_NONE at full rate */
+	int32 SignificanceTier;
 };
 
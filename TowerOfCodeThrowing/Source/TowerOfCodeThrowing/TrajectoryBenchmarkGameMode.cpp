@@ -0,0 +1,215 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TrajectoryBenchmarkGameMode.h"
+#include "TowerOfCodeThrowingCharacter.h"
+#include "TrajectoryCollisionSubsystem.h"
+#include "TrajectoryIntegrator.h"
+#include "GameFramework/PlayerController.h"
+#include "GameFramework/Pawn.h"
+#include "Misc/CommandLine.h"
+#include "Misc/DateTime.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogTrajectoryBenchmark, Log, All);
+
+namespace
+{
+	// Same stepping as the character's preview, without bounces
+	const float MaxSimTime = 2.0f;
+	const float SimFrequency = 1.e-2f;
+
+	typedef TTrajectoryIntegrator<FTrajectoryNoDrag, FTrajectoryNoWind, FTrajectoryNoBounce> FGravityIntegrator;
+}
+
+ATrajectoryBenchmarkGameMode::ATrajectoryBenchmarkGameMode()
+	: Super()
+{
+	PrimaryActorTick.bCanEverTick = true;
+
+	ArcCount = 1000;
+	Passes = 3;
+	LaunchSpeed = 3000.f;
+	ProjectileRadius = 5.f;
+	RandomSeed = 1234;
+	TwoPhaseRunLength = 8;
+	Origin = FVector::ZeroVector;
+	bDone = false;
+}
+
+void ATrajectoryBenchmarkGameMode::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	// The player is possessed after BeginPlay, so the run happens on the first tick
+	if (bDone)
+		return;
+	bDone = true;
+
+	FParse::Value(FCommandLine::Get(), TEXT("BenchArcs="), ArcCount);
+	FParse::Value(FCommandLine::Get(), TEXT("BenchPasses="), Passes);
+	FParse::Value(FCommandLine::Get(), TEXT("BenchRunLength="), TwoPhaseRunLength);
+
+	APlayerController* PlayerController = GetWorld()->GetFirstPlayerController();
+	if (PlayerController != nullptr && PlayerController->GetPawn() != nullptr)
+	{
+		Origin = PlayerController->GetPawn()->GetActorLocation();
+	}
+
+	FRandomStream Random(RandomSeed);
+	LaunchVelocities.Reset();
+	for (int32 Index = 0; Index < ArcCount; Index++)
+	{
+		const FRotator Aim(Random.FRandRange(-30.f, 60.f), Random.FRandRange(0.f, 360.f), 0.f);
+		LaunchVelocities.Add(Aim.Vector() * LaunchSpeed);
+	}
+
+	UTrajectoryCollisionSubsystem* CollisionCache = GetWorld()->GetSubsystem<UTrajectoryCollisionSubsystem>();
+	CollisionCache->EnsureCoverage(Origin);
+
+	Rows.Reset();
+	Rows.Add(TEXT("Backend,Arcs,Sweeps,BuildMs,TotalMs,UsPerSweep,Hits,Mismatches,Overlaps"));
+
+	const TCHAR* BackendNames[] = { TEXT("SceneQuery"), TEXT("StaticCache"), TEXT("TwoPhase") };
+	TArray<FArcResult> SceneResults;
+	TArray<FArcResult> Results;
+	for (int32 BackendIndex = 0; BackendIndex < 3; BackendIndex++)
+	{
+		const EArcBackend Backend = (EArcBackend)BackendIndex;
+
+		double BestSeconds = TNumericLimits<double>::Max();
+		int32 Sweeps = 0;
+		int32 Overlaps = 0;
+		for (int32 Pass = 0; Pass < FMath::Max(1, Passes); Pass++)
+		{
+			BestSeconds = FMath::Min(BestSeconds, RunArcs(Backend, Sweeps, Overlaps, Results));
+		}
+		if (Backend == EArcBackend::SceneQuery)
+		{
+			SceneResults = Results;
+		}
+
+		// Edges and corners of the cache are inflated, a few cm of difference is expected.
+		// Two-phase runs the same sweeps as the scene, the TowerOfCode.Throwing.TwoPhase test checks it matches exactly.
+		const float Tolerance = Backend == EArcBackend::StaticCache ? ProjectileRadius * 2.f : KINDA_SMALL_NUMBER;
+		int32 Hits = 0;
+		int32 Mismatches = 0;
+		for (int32 Index = 0; Index < Results.Num(); Index++)
+		{
+			Hits += Results[Index].bHit ? 1 : 0;
+
+			if (Results[Index].bHit != SceneResults[Index].bHit
+				|| FVector::Dist(Results[Index].Location, SceneResults[Index].Location) > Tolerance)
+			{
+				Mismatches++;
+			}
+		}
+
+		Rows.Add(FString::Printf(TEXT("%s,%d,%d,%.3f,%.3f,%.4f,%d,%d,%d"),
+			BackendNames[BackendIndex],
+			ArcCount,
+			Sweeps,
+			Backend == EArcBackend::StaticCache ? CollisionCache->GetLastBuildSeconds() * 1000.0 : 0.0,
+			BestSeconds * 1000.0,
+			Sweeps > 0 ? BestSeconds * 1000000.0 / Sweeps : 0.0,
+			Hits,
+			Mismatches,
+			Overlaps));
+	}
+
+	WriteResults();
+	FPlatformMisc::RequestExit(false);
+}
+
+double ATrajectoryBenchmarkGameMode::RunArcs(EArcBackend Backend, int32& OutSweeps, int32& OutOverlaps, TArray<FArcResult>& OutResults)
+{
+	UWorld* World = GetWorld();
+	UTrajectoryCollisionSubsystem* CollisionCache = World->GetSubsystem<UTrajectoryCollisionSubsystem>();
+
+	APlayerController* PlayerController = World->GetFirstPlayerController();
+	FCollisionQueryParams QueryParams(NAME_None, false, PlayerController != nullptr ? PlayerController->GetPawn() : nullptr);
+	const FCollisionObjectQueryParams ObjectParams(FCollisionObjectQueryParams::AllObjects);
+	const FCollisionShape Shape = FCollisionShape::MakeSphere(ProjectileRadius);
+
+	FTrajectoryFlightParams FlightParams;
+	FlightParams.Gravity = FVector(0.f, 0.f, World->GetGravityZ());
+	FlightParams.bBounce = false;
+
+	const bool bUseCache = Backend == EArcBackend::StaticCache;
+	const int32 RunLength = FMath::Max(1, TwoPhaseRunLength);
+
+	OutSweeps = 0;
+	OutOverlaps = 0;
+	OutResults.Reset();
+	OutResults.AddDefaulted(LaunchVelocities.Num());
+
+	const double StartTime = FPlatformTime::Seconds();
+	for (int32 Index = 0; Index < LaunchVelocities.Num(); Index++)
+	{
+		FGravityIntegrator Integrator(FlightParams);
+		Integrator.BeginLeg(Origin, LaunchVelocities[Index]);
+
+		FVector TraceStart = Origin;
+		int32 RunStepsLeft = 0;
+		bool bRunClear = false;
+		for (float SimTime = SimFrequency; SimTime < MaxSimTime; SimTime += SimFrequency)
+		{
+			const FVector TraceEnd = Integrator.Sample(SimTime);
+
+			if (Backend == EArcBackend::TwoPhase)
+			{
+				if (RunStepsLeft == 0)
+				{
+					const FBox RunBounds = ATowerOfCodeThrowingCharacter::GetTrajectoryRunBounds(TraceStart, Integrator, SimTime, SimFrequency, RunLength);
+					bRunClear = !CollisionCache->OverlapSweptBounds(RunBounds, ProjectileRadius, ObjectParams, QueryParams);
+					RunStepsLeft = RunLength;
+					OutOverlaps++;
+				}
+
+				RunStepsLeft--;
+				if (bRunClear)
+				{
+					TraceStart = TraceEnd;
+					continue;
+				}
+			}
+
+			FHitResult Hit;
+			const bool bHit = bUseCache
+				? CollisionCache->SweepSphere(Hit, TraceStart, TraceEnd, ProjectileRadius, ObjectParams, QueryParams)
+				: World->SweepSingleByObjectType(Hit, TraceStart, TraceEnd, FQuat::Identity, ObjectParams, Shape, QueryParams);
+			OutSweeps++;
+
+			if (bHit)
+			{
+				OutResults[Index].bHit = true;
+				OutResults[Index].Location = Hit.Location;
+				break;
+			}
+			TraceStart = TraceEnd;
+		}
+	}
+	return FPlatformTime::Seconds() - StartTime;
+}
+
+void ATrajectoryBenchmarkGameMode::WriteResults()
+{
+	FString OutputPath;
+	if (!FParse::Value(FCommandLine::Get(), TEXT("BenchOutput="), OutputPath))
+	{
+		OutputPath = FPaths::Combine(
+			FPaths::ProjectSavedDir(),
+			TEXT("Benchmarks"),
+			FString::Printf(TEXT("TrajectoryCollision_%s.csv"), *FDateTime::Now().ToString()));
+	}
+
+	if (FFileHelper::SaveStringArrayToFile(Rows, *OutputPath))
+	{
+		UE_LOG(LogTrajectoryBenchmark, Log, TEXT("Wrote %s"), *OutputPath);
+	}
+	else
+	{
+		UE_LOG(LogTrajectoryBenchmark, Error, TEXT("Failed to write %s"), *OutputPath);
+	}
+}
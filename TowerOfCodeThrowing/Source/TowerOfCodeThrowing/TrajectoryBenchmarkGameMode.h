@@ -0,0 +1,75 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "TowerOfCodeThrowingGameMode.h"
+#include "TrajectoryBenchmarkGameMode.generated.h"
+
+/**
+ * Compares the trajectory collision backends on the loaded map.
+ * Throws a fixed set of random arcs from the player start, sweeps every step of every arc with
+ * UWorld::SweepSingleByObjectType and with UTrajectoryCollisionSubsystem, and writes the timings
+ * and the number of arcs whose first hit differs as CSV.
+ * The TwoPhase rows sweep the scene only where a box overlap around a run of steps found something,
+ * with the run bounds of ATowerOfCodeThrowingCharacter::GetTrajectoryRunBounds. That they hit exactly
+ * what sweeping every step hits is checked by the TowerOfCode.Throwing.TwoPhase automation test.
+ *
+ * Runs on any map, e.g.
+ * "TowerOfCodeThrowing <Map>?game=TrajectoryBenchmark -game -nullrhi -BenchArcs=2000"
+ */
+UCLASS(minimalapi)
+class ATrajectoryBenchmarkGameMode : public ATowerOfCodeThrowingGameMode
+{
+	GENERATED_BODY()
+
+public:
+	ATrajectoryBenchmarkGameMode();
+
+	/** Arcs thrown per backend, overridden by -BenchArcs= */
+	UPROPERTY(EditAnywhere, Category = Benchmark)
+		int32 ArcCount;
+
+	/** Times each backend runs the whole set, the fastest pass is kept. Overridden by -BenchPasses= */
+	UPROPERTY(EditAnywhere, Category = Benchmark)
+		int32 Passes;
+
+	UPROPERTY(EditAnywhere, Category = Benchmark)
+		float LaunchSpeed;
+
+	UPROPERTY(EditAnywhere, Category = Benchmark)
+		float ProjectileRadius;
+
+	UPROPERTY(EditAnywhere, Category = Benchmark)
+		int32 RandomSeed;
+
+	/** Steps per broadphase overlap of the TwoPhase rows, overridden by -BenchRunLength= */
+	UPROPERTY(EditAnywhere, Category = Benchmark)
+		int32 TwoPhaseRunLength;
+
+	virtual void Tick(float DeltaSeconds) override;
+
+private:
+	struct FArcResult
+	{
+		bool bHit = false;
+		FVector Location = FVector::ZeroVector;
+	};
+
+	enum class EArcBackend : uint8
+	{
+		SceneQuery,
+		StaticCache,
+		TwoPhase
+	};
+
+	/** Sweeps every arc once, @returns the elapsed seconds */
+	double RunArcs(EArcBackend Backend, int32& OutSweeps, int32& OutOverlaps, TArray<FArcResult>& OutResults);
+
+	void WriteResults();
+
+	FVector Origin;
+	TArray<FVector> LaunchVelocities;
+	bool bDone;
+	TArray<FString> Rows;
+};
@@ -0,0 +1,553 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TrajectoryCollisionCache.h"
+#include "Components/PrimitiveComponent.h"
+#include "EngineUtils.h"
+#include "PhysicsEngine/BodySetup.h"
+
+namespace
+{
+	const int32 MaxLeafShapes = 4;
+
+	/** Entry time of a segment into a box, or false if it misses or enters after MaxTime */
+	bool SegmentHitsBox(const FVector& Start, const FVector& Delta, const FBox& Box, float MaxTime, float& OutTime)
+	{
+		float EnterTime = 0.f;
+		float ExitTime = MaxTime;
+		for (int32 Axis = 0; Axis < 3; Axis++)
+		{
+			if (FMath::Abs(Delta[Axis]) < KINDA_SMALL_NUMBER)
+			{
+				if (Start[Axis] < Box.Min[Axis] || Start[Axis] > Box.Max[Axis])
+					return false;
+				continue;
+			}
+
+			const float InvDelta = 1.f / Delta[Axis];
+			float Near = (Box.Min[Axis] - Start[Axis]) * InvDelta;
+			float Far = (Box.Max[Axis] - Start[Axis]) * InvDelta;
+			if (Near > Far)
+			{
+				Swap(Near, Far);
+			}
+			EnterTime = FMath::Max(EnterTime, Near);
+			ExitTime = FMath::Min(ExitTime, Far);
+			if (EnterTime > ExitTime)
+				return false;
+		}
+
+		OutTime = EnterTime;
+		return true;
+	}
+
+	bool SweepSphereCore(const FVector& Start, const FVector& Delta, const FVector& Center, float Radius, float& InOutTime, FVector& OutNormal)
+	{
+		const FVector Offset = Start - Center;
+		const float C = Offset.SizeSquared() - Radius * Radius;
+		if (C <= 0.f)
+		{
+			InOutTime = 0.f;
+			OutNormal = Offset.GetSafeNormal();
+			return true;
+		}
+
+		const float B = FVector::DotProduct(Offset, Delta);
+		const float A = Delta.SizeSquared();
+		if (B >= 0.f || A < SMALL_NUMBER)
+			return false;
+
+		const float Discriminant = B * B - A * C;
+		if (Discriminant < 0.f)
+			return false;
+
+		const float Time = (-B - FMath::Sqrt(Discriminant)) / A;
+		if (Time > InOutTime)
+			return false;
+
+		InOutTime = Time;
+		OutNormal = (Offset + Delta * Time) / Radius;
+		return true;
+	}
+
+	bool SweepSphereCapsule(const FVector& Start, const FVector& Delta, const FVector& Center, const FVector& Axis, float Radius, float& InOutTime, FVector& OutNormal)
+	{
+		const FVector A = Center - Axis;
+		const FVector D = Axis * 2.f;
+		const FVector M = Start - A;
+		const float DD = D.SizeSquared();
+
+		// The first contact with the union is the earliest of its parts: the side of the cylinder and the two caps
+		bool bHit = SweepSphereCore(Start, Delta, A, Radius, InOutTime, OutNormal);
+		bHit |= SweepSphereCore(Start, Delta, A + D, Radius, InOutTime, OutNormal);
+
+		const float MD = FVector::DotProduct(M, D);
+		const float ND = FVector::DotProduct(Delta, D);
+		const float QA = DD * Delta.SizeSquared() - ND * ND;
+		if (DD < SMALL_NUMBER || FMath::Abs(QA) < SMALL_NUMBER)
+			return bHit;
+
+		const float K = M.SizeSquared() - Radius * Radius;
+		const float QC = DD * K - MD * MD;
+		if (QC <= 0.f && MD >= 0.f && MD <= DD)
+		{
+			InOutTime = 0.f;
+			OutNormal = (M - D * (MD / DD)).GetSafeNormal();
+			return true;
+		}
+
+		const float QB = DD * FVector::DotProduct(M, Delta) - ND * MD;
+		const float Discriminant = QB * QB - QA * QC;
+		if (Discriminant < 0.f)
+			return bHit;
+
+		const float Time = (-QB - FMath::Sqrt(Discriminant)) / QA;
+		const float AlongAxis = MD + Time * ND;
+		if (Time < 0.f || Time > InOutTime || AlongAxis < 0.f || AlongAxis > DD)
+			return bHit;
+
+		const FVector Point = M + Delta * Time;
+		InOutTime = Time;
+		OutNormal = (Point - D * (AlongAxis / DD)).GetSafeNormal();
+		return true;
+	}
+}
+
+void FTrajectoryCollisionCache::Build(UWorld* World, const FBox& InRegion)
+{
+	check(IsInGameThread());
+
+	Region = InRegion;
+	Nodes.Reset();
+	Shapes.Reset();
+	Planes.Reset();
+	MovableComponents.Reset();
+
+	for (TActorIterator<AActor> It(World); It; ++It)
+	{
+		TInlineComponentArray<UPrimitiveComponent*> Components(*It);
+		for (UPrimitiveComponent* Component : Components)
+		{
+			if (!Component->IsRegistered()
+				|| !CollisionEnabledHasQuery(Component->GetCollisionEnabled())
+				|| Component->GetCollisionObjectType() != ECC_WorldStatic
+				|| !Component->Bounds.GetBox().Intersect(Region))
+				continue;
+
+			if (Component->Mobility != EComponentMobility::Static)
+			{
+				MovableComponents.Add(Component);
+				continue;
+			}
+
+			AddComponent(Component);
+		}
+	}
+
+	if (Shapes.Num() == 0)
+		return;
+
+	TArray<int32> ShapeIndices;
+	ShapeIndices.Reserve(Shapes.Num());
+	for (int32 Index = 0; Index < Shapes.Num(); Index++)
+	{
+		ShapeIndices.Add(Index);
+	}
+
+	// Leaves reference contiguous ranges, so the shapes are reordered while the tree is built
+	TArray<FTrajectoryCollisionShape> OrderedShapes;
+	OrderedShapes.Reserve(Shapes.Num());
+	Nodes.Reserve(Shapes.Num() * 2 / MaxLeafShapes + 1);
+	Nodes.AddDefaulted();
+	BuildNode(0, ShapeIndices, 0, ShapeIndices.Num(), OrderedShapes);
+	Shapes = MoveTemp(OrderedShapes);
+}
+
+FTrajectoryCollisionShape& FTrajectoryCollisionCache::AddShape(ETrajectoryShapeType Type, UPrimitiveComponent* Component)
+{
+	FTrajectoryCollisionShape& Shape = Shapes.AddDefaulted_GetRef();
+	Shape.Type = Type;
+	Shape.Component = Component;
+	Shape.Actor = Component->GetOwner();
+	Shape.ActorId = Component->GetOwner() != nullptr ? Component->GetOwner()->GetUniqueID() : 0;
+
+	// Corners of the inflated box are sqrt(3) radii from the box's
+	if (Type == ETrajectoryShapeType::Box)
+	{
+		InflationScale = FMath::Max(InflationScale, FMath::Sqrt(3.f));
+	}
+	return Shape;
+}
+
+void FTrajectoryCollisionCache::AddComponent(UPrimitiveComponent* Component)
+{
+	UBodySetup* BodySetup = Component->GetBodySetup();
+	if (BodySetup == nullptr
+		|| BodySetup->CollisionTraceFlag == CTF_UseComplexAsSimple
+		|| BodySetup->AggGeom.GetElementCount() == 0
+		|| BodySetup->AggGeom.TaperedCapsuleElems.Num() > 0)
+	{
+		FTrajectoryCollisionShape& Shape = AddShape(ETrajectoryShapeType::Component, Component);
+		Shape.Bounds = Component->Bounds.GetBox();
+		return;
+	}
+
+	const FKAggregateGeom& Geometry = BodySetup->AggGeom;
+	const FTransform ComponentTransform = Component->GetComponentTransform();
+	const FVector Scale = ComponentTransform.GetScale3D().GetAbs();
+
+	for (const FKSphereElem& Element : Geometry.SphereElems)
+	{
+		FTrajectoryCollisionShape& Shape = AddShape(ETrajectoryShapeType::Sphere, Component);
+		Shape.Center = ComponentTransform.TransformPosition(Element.Center);
+		Shape.Radius = Element.Radius * Scale.GetMin();
+		Shape.Bounds = FBox(Shape.Center - FVector(Shape.Radius), Shape.Center + FVector(Shape.Radius));
+	}
+
+	for (const FKBoxElem& Element : Geometry.BoxElems)
+	{
+		// Non-uniform scale on a rotated element is approximated by scaling its extent
+		FTrajectoryCollisionShape& Shape = AddShape(ETrajectoryShapeType::Box, Component);
+		Shape.Center = ComponentTransform.TransformPosition(Element.Center);
+		Shape.Rotation = ComponentTransform.GetRotation() * Element.Rotation.Quaternion();
+		Shape.Extent = FVector(Element.X, Element.Y, Element.Z) * 0.5f * Scale;
+		Shape.Bounds = FBox(-Shape.Extent, Shape.Extent).TransformBy(FTransform(Shape.Rotation, Shape.Center));
+	}
+
+	for (const FKSphylElem& Element : Geometry.SphylElems)
+	{
+		FTrajectoryCollisionShape& Shape = AddShape(ETrajectoryShapeType::Capsule, Component);
+		Shape.Center = ComponentTransform.TransformPosition(Element.Center);
+		Shape.Rotation = ComponentTransform.GetRotation() * Element.Rotation.Quaternion();
+		Shape.Axis = Shape.Rotation.RotateVector(FVector(0.f, 0.f, Element.Length * 0.5f * Scale.Z));
+		Shape.Radius = Element.Radius * FMath::Max(Scale.X, Scale.Y);
+		Shape.Bounds = FBox(ForceInit);
+		Shape.Bounds += Shape.Center - Shape.Axis;
+		Shape.Bounds += Shape.Center + Shape.Axis;
+		Shape.Bounds = Shape.Bounds.ExpandBy(Shape.Radius);
+	}
+
+	for (const FKConvexElem& Element : Geometry.ConvexElems)
+	{
+		const FMatrix ElementToWorld = (Element.GetTransform() * ComponentTransform).ToMatrixWithScale();
+
+		TArray<FVector> Vertices;
+		Vertices.Reserve(Element.VertexData.Num());
+		for (const FVector& Vertex : Element.VertexData)
+		{
+			Vertices.Add(ElementToWorld.TransformPosition(Vertex));
+		}
+
+		AddConvex(Vertices, Element.IndexData, Component);
+	}
+}
+
+void FTrajectoryCollisionCache::AddConvex(const TArray<FVector>& Vertices, const TArray<int32>& Indices, UPrimitiveComponent* Component)
+{
+	if (Vertices.Num() == 0)
+		return;
+
+	const FBox Bounds(Vertices);
+
+	// Hulls cooked without index data only keep their bounds, which is conservative
+	if (Indices.Num() < 3)
+	{
+		FTrajectoryCollisionShape& Shape = AddShape(ETrajectoryShapeType::Box, Component);
+		Shape.Center = Bounds.GetCenter();
+		Shape.Extent = Bounds.GetExtent();
+		Shape.Bounds = Bounds;
+		return;
+	}
+
+	FVector Centroid = FVector::ZeroVector;
+	for (const FVector& Vertex : Vertices)
+	{
+		Centroid += Vertex;
+	}
+	Centroid /= Vertices.Num();
+
+	const int32 FirstPlane = Planes.Num();
+	for (int32 Index = 0; Index + 2 < Indices.Num(); Index += 3)
+	{
+		if (!Vertices.IsValidIndex(Indices[Index])
+			|| !Vertices.IsValidIndex(Indices[Index + 1])
+			|| !Vertices.IsValidIndex(Indices[Index + 2]))
+			continue;
+
+		FPlane Plane(Vertices[Indices[Index]], Vertices[Indices[Index + 1]], Vertices[Indices[Index + 2]]);
+		if (Plane.IsNearlyZero())
+			continue;
+
+		// Make every plane face outwards regardless of the winding
+		if (Plane.PlaneDot(Centroid) > 0.f)
+		{
+			Plane = Plane.Flip();
+		}
+
+		bool bDuplicate = false;
+		for (int32 Existing = FirstPlane; Existing < Planes.Num() && !bDuplicate; Existing++)
+		{
+			bDuplicate = FVector::DotProduct(Planes[Existing], Plane) > 1.f - KINDA_SMALL_NUMBER
+				&& FMath::IsNearlyEqual(Planes[Existing].W, Plane.W, 0.01f);
+		}
+		if (!bDuplicate)
+		{
+			Planes.Add(Plane);
+		}
+	}
+
+	// Each corner of the pushed out planes is where three planes of a hull vertex meet,
+	// the offset solving N1.S = N2.S = N3.S = 1 is how many radii it is away from that vertex
+	const float VertexTolerance = 0.1f;
+	for (const FVector& Vertex : Vertices)
+	{
+		TArray<FVector, TInlineAllocator<8>> Normals;
+		for (int32 Index = FirstPlane; Index < Planes.Num(); Index++)
+		{
+			if (FMath::Abs(Planes[Index].PlaneDot(Vertex)) < VertexTolerance)
+			{
+				Normals.Add(Planes[Index]);
+			}
+		}
+
+		for (int32 A = 0; A < Normals.Num(); A++)
+		{
+			for (int32 B = A + 1; B < Normals.Num(); B++)
+			{
+				for (int32 C = B + 1; C < Normals.Num(); C++)
+				{
+					const float Determinant = FVector::DotProduct(Normals[A], FVector::CrossProduct(Normals[B], Normals[C]));
+					if (FMath::Abs(Determinant) < KINDA_SMALL_NUMBER)
+						continue;
+
+					const FVector Offset = (FVector::CrossProduct(Normals[B], Normals[C])
+						+ FVector::CrossProduct(Normals[C], Normals[A])
+						+ FVector::CrossProduct(Normals[A], Normals[B])) / Determinant;
+
+					// Triples whose corner is cut off by another plane of the vertex aren't corners
+					bool bCorner = true;
+					for (const FVector& Normal : Normals)
+					{
+						bCorner &= FVector::DotProduct(Normal, Offset) <= 1.f + KINDA_SMALL_NUMBER;
+					}
+					if (bCorner)
+					{
+						InflationScale = FMath::Max(InflationScale, Offset.Size());
+					}
+				}
+			}
+		}
+	}
+
+	FTrajectoryCollisionShape& Shape = AddShape(ETrajectoryShapeType::Convex, Component);
+	Shape.FirstPlane = FirstPlane;
+	Shape.NumPlanes = Planes.Num() - FirstPlane;
+	Shape.Bounds = Bounds;
+}
+
+void FTrajectoryCollisionCache::BuildNode(int32 NodeIndex, TArray<int32>& ShapeIndices, int32 First, int32 Count, TArray<FTrajectoryCollisionShape>& OrderedShapes)
+{
+	FBox Bounds(ForceInit);
+	FBox CentroidBounds(ForceInit);
+	for (int32 Index = First; Index < First + Count; Index++)
+	{
+		const FBox& ShapeBounds = Shapes[ShapeIndices[Index]].Bounds;
+		Bounds += ShapeBounds;
+		CentroidBounds += ShapeBounds.GetCenter();
+	}
+	Nodes[NodeIndex].Bounds = Bounds;
+
+	if (Count <= MaxLeafShapes)
+	{
+		Nodes[NodeIndex].First = OrderedShapes.Num();
+		Nodes[NodeIndex].Count = Count;
+		for (int32 Index = First; Index < First + Count; Index++)
+		{
+			OrderedShapes.Add(Shapes[ShapeIndices[Index]]);
+		}
+		return;
+	}
+
+	// Median split along the widest spread of the shape centers
+	const FVector Spread = CentroidBounds.GetSize();
+	const int32 Axis = Spread.X >= Spread.Y && Spread.X >= Spread.Z ? 0 : (Spread.Y >= Spread.Z ? 1 : 2);
+	Sort(ShapeIndices.GetData() + First, Count, [this, Axis](int32 Left, int32 Right)
+	{
+		return Shapes[Left].Bounds.GetCenter()[Axis] < Shapes[Right].Bounds.GetCenter()[Axis];
+	});
+
+	const int32 ChildIndex = Nodes.Num();
+	Nodes.AddDefaulted(2);
+	Nodes[NodeIndex].First = ChildIndex;
+	Nodes[NodeIndex].Count = 0;
+
+	const int32 Half = Count / 2;
+	BuildNode(ChildIndex, ShapeIndices, First, Half, OrderedShapes);
+	BuildNode(ChildIndex + 1, ShapeIndices, First + Half, Count - Half, OrderedShapes);
+}
+
+bool FTrajectoryCollisionCache::SweepSphere(const FVector& Start, const FVector& End, float SphereRadius, FHitResult& OutHit, TArrayView<const uint32> IgnoredActorIds, TArray<TWeakObjectPtr<UPrimitiveComponent>>* OutDeferred) const
+{
+	if (Nodes.Num() == 0)
+		return false;
+
+	const FVector Delta = End - Start;
+	float BestTime = 1.f;
+	int32 BestShape = INDEX_NONE;
+	FVector BestNormal = FVector::UpVector;
+
+	TArray<int32, TInlineAllocator<64>> Stack;
+	Stack.Add(0);
+	while (Stack.Num() > 0)
+	{
+		const FNode& Node = Nodes[Stack.Pop(false)];
+
+		float EnterTime;
+		if (!SegmentHitsBox(Start, Delta, Node.Bounds.ExpandBy(SphereRadius), BestTime, EnterTime))
+			continue;
+
+		if (Node.Count == 0)
+		{
+			Stack.Add(Node.First);
+			Stack.Add(Node.First + 1);
+			continue;
+		}
+
+		for (int32 Index = Node.First; Index < Node.First + Node.Count; Index++)
+		{
+			const FTrajectoryCollisionShape& Shape = Shapes[Index];
+			if (IgnoredActorIds.Contains(Shape.ActorId))
+				continue;
+
+			if (Shape.Type == ETrajectoryShapeType::Component)
+			{
+				if (OutDeferred != nullptr && SegmentHitsBox(Start, Delta, Shape.Bounds.ExpandBy(SphereRadius), 1.f, EnterTime))
+				{
+					OutDeferred->AddUnique(Shape.Component);
+				}
+				continue;
+			}
+
+			float Time = BestTime;
+			FVector Normal;
+			if (SweepShape(Shape, Start, Delta, SphereRadius, Time, Normal))
+			{
+				BestTime = Time;
+				BestShape = Index;
+				BestNormal = Normal;
+			}
+		}
+	}
+
+	if (BestShape == INDEX_NONE)
+		return false;
+
+	const FTrajectoryCollisionShape& Shape = Shapes[BestShape];
+	OutHit = FHitResult();
+	OutHit.bBlockingHit = true;
+	OutHit.bStartPenetrating = BestTime <= 0.f;
+	OutHit.Time = BestTime;
+	OutHit.Distance = Delta.Size() * BestTime;
+	OutHit.TraceStart = Start;
+	OutHit.TraceEnd = End;
+	OutHit.Location = Start + Delta * BestTime;
+	OutHit.ImpactPoint = OutHit.Location - BestNormal * SphereRadius;
+	OutHit.Normal = BestNormal;
+	OutHit.ImpactNormal = BestNormal;
+	OutHit.Component = Shape.Component;
+	OutHit.Actor = Shape.Actor;
+	return true;
+}
+
+bool FTrajectoryCollisionCache::SweepShape(const FTrajectoryCollisionShape& Shape, const FVector& Start, const FVector& Delta, float SphereRadius, float& InOutTime, FVector& OutNormal) const
+{
+	switch (Shape.Type)
+	{
+	case ETrajectoryShapeType::Sphere:
+		return SweepSphereCore(Start, Delta, Shape.Center, Shape.Radius + SphereRadius, InOutTime, OutNormal);
+
+	case ETrajectoryShapeType::Capsule:
+		return SweepSphereCapsule(Start, Delta, Shape.Center, Shape.Axis, Shape.Radius + SphereRadius, InOutTime, OutNormal);
+
+	case ETrajectoryShapeType::Box:
+	{
+		// Box inflated by the sphere radius, slightly early on edges and corners
+		const FVector LocalStart = Shape.Rotation.UnrotateVector(Start - Shape.Center);
+		const FVector LocalDelta = Shape.Rotation.UnrotateVector(Delta);
+		const FVector Extent = Shape.Extent + FVector(SphereRadius);
+
+		float EnterTime = 0.f;
+		float ExitTime = InOutTime;
+		FVector LocalNormal = FVector::ZeroVector;
+		for (int32 Axis = 0; Axis < 3; Axis++)
+		{
+			if (FMath::Abs(LocalDelta[Axis]) < KINDA_SMALL_NUMBER)
+			{
+				if (FMath::Abs(LocalStart[Axis]) > Extent[Axis])
+					return false;
+				continue;
+			}
+
+			const float Sign = LocalDelta[Axis] > 0.f ? -1.f : 1.f;
+			const float Near = (Sign * Extent[Axis] - LocalStart[Axis]) / LocalDelta[Axis];
+			const float Far = (-Sign * Extent[Axis] - LocalStart[Axis]) / LocalDelta[Axis];
+			if (Near > EnterTime)
+			{
+				EnterTime = Near;
+				LocalNormal = FVector::ZeroVector;
+				LocalNormal[Axis] = Sign;
+			}
+			ExitTime = FMath::Min(ExitTime, Far);
+			if (EnterTime > ExitTime)
+				return false;
+		}
+
+		InOutTime = EnterTime;
+		OutNormal = LocalNormal.IsZero() ? -Delta.GetSafeNormal() : Shape.Rotation.RotateVector(LocalNormal);
+		return true;
+	}
+
+	case ETrajectoryShapeType::Convex:
+	{
+		// Hull planes pushed out by the sphere radius, slightly early on edges and corners
+		float EnterTime = 0.f;
+		float ExitTime = InOutTime;
+		FVector Normal = FVector::ZeroVector;
+		for (int32 Index = Shape.FirstPlane; Index < Shape.FirstPlane + Shape.NumPlanes; Index++)
+		{
+			const FPlane& Plane = Planes[Index];
+			const float Distance = Plane.PlaneDot(Start) - SphereRadius;
+			const float Speed = FVector::DotProduct(Plane, Delta);
+			if (FMath::Abs(Speed) < KINDA_SMALL_NUMBER)
+			{
+				if (Distance > 0.f)
+					return false;
+				continue;
+			}
+
+			const float Time = -Distance / Speed;
+			if (Speed < 0.f)
+			{
+				if (Time > EnterTime)
+				{
+					EnterTime = Time;
+					Normal = Plane;
+				}
+			}
+			else
+			{
+				ExitTime = FMath::Min(ExitTime, Time);
+			}
+			if (EnterTime > ExitTime)
+				return false;
+		}
+
+		InOutTime = EnterTime;
+		OutNormal = Normal.IsZero() ? -Delta.GetSafeNormal() : Normal;
+		return true;
+	}
+
+	default:
+		return false;
+	}
+}
@@ -0,0 +1,112 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Engine/EngineTypes.h"
+
+class UPrimitiveComponent;
+class UWorld;
+
+enum class ETrajectoryShapeType : uint8
+{
+	Sphere,
+	Capsule,
+	Box,
+	Convex,
+	/** Collision the cache can't express, swept through the component on the game thread */
+	Component
+};
+
+/** Simple collision element of a static component, in world space */
+struct FTrajectoryCollisionShape
+{
+	ETrajectoryShapeType Type = ETrajectoryShapeType::Sphere;
+	FBox Bounds = FBox(ForceInit);
+
+	/** Sphere, capsule and box center */
+	FVector Center = FVector::ZeroVector;
+	/** Half of the capsule's core segment */
+	FVector Axis = FVector::ZeroVector;
+	float Radius = 0.f;
+
+	FQuat Rotation = FQuat::Identity;
+	FVector Extent = FVector::ZeroVector;
+
+	/** Range of the convex planes in FTrajectoryCollisionCache::Planes */
+	int32 FirstPlane = 0;
+	int32 NumPlanes = 0;
+
+	TWeakObjectPtr<UPrimitiveComponent> Component;
+	TWeakObjectPtr<AActor> Actor;
+	/** Unique id of Actor, comparable against FCollisionQueryParams::GetIgnoredActors on any thread */
+	uint32 ActorId = 0;
+};
+
+/**
+ * Bounding volume hierarchy over the simplified collision of the static geometry around a point.
+ *
+ * Build walks the world's actors and must run on the game thread, it blocks it for the whole rebuild.
+ * A built cache is never modified, so SweepSphere may also run on another thread while the game thread
+ * keeps a reference, but the component and actor of its hits are weak pointers only valid to resolve on
+ * the game thread. Nothing in the project sweeps off the game thread yet.
+ *
+ * Only WorldStatic components with static mobility are cached. Everything else has to be
+ * queried from the scene, see UTrajectoryCollisionSubsystem.
+ *
+ * Shapes are swept exactly except for these approximations:
+ * - Boxes and convex hulls are inflated by the sphere radius along their faces instead of rounded,
+ *   so a sweep grazing an edge or a corner hits early, never late. A hit is at most GetInflationScale
+ *   times the radius away from the real shape, sqrt(3) for boxes and more for hulls with sharp corners.
+ * - A rotated box under non-uniform scale keeps its rotation and scales its extent.
+ * - Spheres take the smallest scale axis and capsules the largest of X and Y, like the physics engine.
+ * - Convex hulls cooked without index data become their bounding box.
+ */
+class FTrajectoryCollisionCache
+{
+public:
+	/** Collects the static collision overlapping Region */
+	void Build(UWorld* World, const FBox& Region);
+
+	/**
+	 * Sweeps a sphere against the cached shapes.
+	 * Component shapes are not swept, they are added to OutDeferred if given, and skipped otherwise.
+	 * @returns true on a blocking hit.
+	 */
+	bool SweepSphere(const FVector& Start, const FVector& End, float SphereRadius, FHitResult& OutHit, TArrayView<const uint32> IgnoredActorIds = TArrayView<const uint32>(), TArray<TWeakObjectPtr<UPrimitiveComponent>>* OutDeferred = nullptr) const;
+
+	const FBox& GetRegion() const { return Region; }
+	int32 GetShapeCount() const { return Shapes.Num(); }
+
+	/** Farthest a swept sphere's center may be from the shape it hits, in sphere radii */
+	float GetInflationScale() const { return InflationScale; }
+
+	/** Movable WorldStatic components inside the region at build time, they have to be queried live */
+	const TArray<TWeakObjectPtr<UPrimitiveComponent>>& GetMovableComponents() const { return MovableComponents; }
+
+private:
+	struct FNode
+	{
+		FBox Bounds;
+		/** First child for inner nodes, first shape for leaves */
+		int32 First;
+		/** Shape count for leaves, zero for inner nodes whose children are First and First + 1 */
+		int32 Count;
+	};
+
+	void AddComponent(UPrimitiveComponent* Component);
+	void AddConvex(const TArray<FVector>& Vertices, const TArray<int32>& Indices, UPrimitiveComponent* Component);
+	FTrajectoryCollisionShape& AddShape(ETrajectoryShapeType Type, UPrimitiveComponent* Component);
+	void BuildNode(int32 NodeIndex, TArray<int32>& ShapeIndices, int32 First, int32 Count, TArray<FTrajectoryCollisionShape>& OrderedShapes);
+
+	bool SweepShape(const FTrajectoryCollisionShape& Shape, const FVector& Start, const FVector& Delta, float SphereRadius, float& InOutTime, FVector& OutNormal) const;
+
+	FBox Region = FBox(ForceInit);
+	TArray<FNode> Nodes;
+	TArray<FTrajectoryCollisionShape> Shapes;
+	TArray<FPlane> Planes;
+	TArray<TWeakObjectPtr<UPrimitiveComponent>> MovableComponents;
+	float InflationScale = 1.f;
+};
+
+typedef TSharedPtr<const FTrajectoryCollisionCache, ESPMode::ThreadSafe> FTrajectoryCollisionCachePtr;
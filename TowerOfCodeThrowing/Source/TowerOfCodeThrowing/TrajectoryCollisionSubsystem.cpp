@@ -0,0 +1,144 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TrajectoryCollisionSubsystem.h"
+#include "Components/PrimitiveComponent.h"
+#include "Engine/World.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogTrajectoryCollision, Log, All);
+
+UTrajectoryCollisionSubsystem::UTrajectoryCollisionSubsystem()
+{
+	// A throw covers about 6000cm in its 2 simulated seconds
+	CacheExtent = 10000.f;
+	RebuildMargin = 6000.f;
+	bCacheDirty = true;
+	LastBuildSeconds = 0.0;
+}
+
+void UTrajectoryCollisionSubsystem::Initialize(FSubsystemCollectionBase& Collection)
+{
+	Super::Initialize(Collection);
+
+	LevelAddedHandle = FWorldDelegates::LevelAddedToWorld.AddUObject(this, &UTrajectoryCollisionSubsystem::OnLevelsChanged);
+	LevelRemovedHandle = FWorldDelegates::LevelRemovedFromWorld.AddUObject(this, &UTrajectoryCollisionSubsystem::OnLevelsChanged);
+}
+
+void UTrajectoryCollisionSubsystem::Deinitialize()
+{
+	FWorldDelegates::LevelAddedToWorld.Remove(LevelAddedHandle);
+	FWorldDelegates::LevelRemovedFromWorld.Remove(LevelRemovedHandle);
+	Cache.Reset();
+
+	Super::Deinitialize();
+}
+
+void UTrajectoryCollisionSubsystem::OnLevelsChanged(ULevel* Level, UWorld* World)
+{
+	if (World == GetWorld())
+	{
+		bCacheDirty = true;
+	}
+}
+
+FTrajectoryCollisionCachePtr UTrajectoryCollisionSubsystem::EnsureCoverage(const FVector& Center)
+{
+	check(IsInGameThread());
+
+	const FBox Needed = FBox(Center, Center).ExpandBy(RebuildMargin);
+	if (!bCacheDirty && Cache.IsValid() && Cache->GetRegion().IsInside(Needed))
+		return Cache;
+
+	const double StartTime = FPlatformTime::Seconds();
+
+	TSharedPtr<FTrajectoryCollisionCache, ESPMode::ThreadSafe> NewCache = MakeShared<FTrajectoryCollisionCache, ESPMode::ThreadSafe>();
+	NewCache->Build(GetWorld(), FBox(Center, Center).ExpandBy(FMath::Max(CacheExtent, RebuildMargin)));
+
+	// Readers of the old cache keep it alive until they are done
+	Cache = NewCache;
+	bCacheDirty = false;
+	LastBuildSeconds = FPlatformTime::Seconds() - StartTime;
+
+	UE_LOG(LogTrajectoryCollision, Log, TEXT("Cached %d static shapes in %.2fms"), Cache->GetShapeCount(), LastBuildSeconds * 1000.0);
+	return Cache;
+}
+
+bool UTrajectoryCollisionSubsystem::SweepSphere(FHitResult& OutHit, const FVector& Start, const FVector& End, float Radius, const FCollisionObjectQueryParams& ObjectParams, const FCollisionQueryParams& Params)
+{
+	check(IsInGameThread());
+
+	UWorld* World = GetWorld();
+	const FCollisionShape Shape = FCollisionShape::MakeSphere(Radius);
+
+	FCollisionObjectQueryParams SceneParams = ObjectParams.IsValid()
+		? ObjectParams
+		: FCollisionObjectQueryParams(FCollisionObjectQueryParams::AllObjects);
+	const bool bQueryStatic = (SceneParams.GetObjectTypesToQuery() & ECC_TO_BITFIELD(ECC_WorldStatic)) != 0;
+
+	if (!bQueryStatic || !Cache.IsValid())
+		return World->SweepSingleByObjectType(OutHit, Start, End, FQuat::Identity, SceneParams, Shape, Params);
+
+	OutHit = FHitResult(1.f);
+	bool bHit = false;
+
+	TArray<TWeakObjectPtr<UPrimitiveComponent>> Deferred;
+	FHitResult CacheHit;
+	if (Cache->SweepSphere(Start, End, Radius, CacheHit, MakeArrayView(Params.GetIgnoredActors()), &Deferred))
+	{
+		OutHit = CacheHit;
+		bHit = true;
+	}
+
+	// Collision the cache couldn't express, and WorldStatic components that may have moved since the build
+	for (const TWeakObjectPtr<UPrimitiveComponent>& Component : Cache->GetMovableComponents())
+	{
+		if (Component.IsValid())
+		{
+			Deferred.AddUnique(Component);
+		}
+	}
+
+	for (const TWeakObjectPtr<UPrimitiveComponent>& WeakComponent : Deferred)
+	{
+		UPrimitiveComponent* Component = WeakComponent.Get();
+		if (Component == nullptr
+			|| (Component->GetOwner() != nullptr && Params.GetIgnoredActors().Contains(Component->GetOwner()->GetUniqueID())))
+			continue;
+
+		FHitResult ComponentHit;
+		if (Component->SweepComponent(ComponentHit, Start, End, FQuat::Identity, Shape, Params.bTraceComplex)
+			&& ComponentHit.Time < OutHit.Time)
+		{
+			OutHit = ComponentHit;
+			bHit = true;
+		}
+	}
+
+	// Everything that isn't WorldStatic comes from the scene as before
+	SceneParams.RemoveObjectTypesToQuery(ECC_WorldStatic);
+	FHitResult SceneHit;
+	if (SceneParams.IsValid()
+		&& World->SweepSingleByObjectType(SceneHit, Start, End, FQuat::Identity, SceneParams, Shape, Params)
+		&& SceneHit.Time < OutHit.Time)
+	{
+		OutHit = SceneHit;
+		bHit = true;
+	}
+
+	return bHit;
+}
+
+bool UTrajectoryCollisionSubsystem::OverlapSweptBounds(const FBox& SegmentBounds, float Radius, const FCollisionObjectQueryParams& ObjectParams, const FCollisionQueryParams& Params) const
+{
+	check(IsInGameThread());
+
+	// As far as the cache may hit early, and a little more, so the overlap's tolerances can't miss a sweep's grazing hit
+	const float BroadphaseMargin = 2.f;
+	const float InflationScale = Cache.IsValid() ? Cache->GetInflationScale() : 1.f;
+	const FCollisionShape Box = FCollisionShape::MakeBox(SegmentBounds.GetExtent() + FVector(Radius * InflationScale + BroadphaseMargin));
+	const FCollisionObjectQueryParams SceneParams = ObjectParams.IsValid()
+		? ObjectParams
+		: FCollisionObjectQueryParams(FCollisionObjectQueryParams::AllObjects);
+
+	return GetWorld()->OverlapAnyTestByObjectType(SegmentBounds.GetCenter(), FQuat::Identity, SceneParams, Box, Params);
+}
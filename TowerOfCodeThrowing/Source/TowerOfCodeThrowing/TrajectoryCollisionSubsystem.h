@@ -0,0 +1,70 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "Subsystems/WorldSubsystem.h"
+#include "TrajectoryCollisionCache.h"
+#include "TrajectoryCollisionSubsystem.generated.h"
+
+/**
+ * Owns the static collision cache of a world and answers trajectory sweeps from it,
+ * falling back to scene queries only for what the cache can't hold.
+ *
+ * The cache covers a region around the last requested center. It is rebuilt synchronously on the
+ * game thread when a request leaves the inner part of that region or when a level is streamed in or out,
+ * GetLastBuildSeconds tells how long that stalled the frame. Published caches are never modified, see
+ * FTrajectoryCollisionCache for what other threads may do with one.
+ */
+UCLASS()
+class UTrajectoryCollisionSubsystem : public UWorldSubsystem
+{
+	GENERATED_BODY()
+
+public:
+	UTrajectoryCollisionSubsystem();
+
+	/** Half size of the cached region, in cm */
+	UPROPERTY()
+		float CacheExtent;
+
+	/** Distance a request may be from the region's border before the cache is rebuilt, in cm */
+	UPROPERTY()
+		float RebuildMargin;
+
+	virtual void Initialize(FSubsystemCollectionBase& Collection) override;
+	virtual void Deinitialize() override;
+
+	/** Makes sure the cache covers Center, rebuilding it if needed. Game thread only. */
+	FTrajectoryCollisionCachePtr EnsureCoverage(const FVector& Center);
+
+	/** Current cache, may be null. Game thread only. */
+	FTrajectoryCollisionCachePtr GetCache() const { return Cache; }
+
+	/** Seconds the last rebuild took */
+	double GetLastBuildSeconds() const { return LastBuildSeconds; }
+
+	/**
+	 * Sphere sweep equivalent to UWorld::SweepSingleByObjectType: static geometry from the cache,
+	 * the other object types and uncacheable components from the scene. Game thread only.
+	 */
+	bool SweepSphere(FHitResult& OutHit, const FVector& Start, const FVector& End, float Radius, const FCollisionObjectQueryParams& ObjectParams, const FCollisionQueryParams& Params);
+
+	/**
+	 * Broadphase of two-phase tracing: one box overlap around segments inside SegmentBounds, inflated by Radius
+	 * times the cache's FTrajectoryCollisionCache::GetInflationScale.
+	 * False guarantees that every sphere sweep of Radius along those segments misses, with either backend.
+	 * Game thread only.
+	 */
+	bool OverlapSweptBounds(const FBox& SegmentBounds, float Radius, const FCollisionObjectQueryParams& ObjectParams, const FCollisionQueryParams& Params) const;
+
+private:
+	void OnLevelsChanged(ULevel* Level, UWorld* World);
+
+	FTrajectoryCollisionCachePtr Cache;
+	bool bCacheDirty;
+	double LastBuildSeconds;
+
+	FDelegateHandle LevelAddedHandle;
+	FDelegateHandle LevelRemovedHandle;
+};
@@ -0,0 +1,278 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "TrajectoryIntegrator.generated.h"
+
+/** How the air slows a projectile down */
+UENUM(BlueprintType)
+enum class ETrajectoryDragModel : uint8
+{
+	None,
+	/** Deceleration proportional to the speed relative to the air, e.g. light objects in slow flight */
+	Linear,
+	/** Deceleration proportional to the squared speed relative to the air, e.g. balls and bullets */
+	Quadratic
+};
+
+/** Everything a projectile's flight depends on, see UTrajectoryProjectileMovementComponent::MakeFlightParams */
+struct FTrajectoryFlightParams
+{
+	FVector Gravity = FVector(0.f, 0.f, -980.f);
+
+	ETrajectoryDragModel DragModel = ETrajectoryDragModel::None;
+	/** 1/sec for linear drag, 1/cm for quadratic drag */
+	float DragCoefficient = 0.f;
+
+	/** Velocity of the air, drag pulls the projectile's velocity towards it */
+	FVector Wind = FVector::ZeroVector;
+
+	bool bBounce = true;
+	float Bounciness = 0.6f;
+	float Friction = 0.2f;
+
+	/** Drag at Velocity, branching on the model. For the runtime movement, the predictor uses the policies below. */
+	FVector GetDragAcceleration(const FVector& Velocity) const;
+};
+
+/** Start of a flight between two bounces */
+struct FTrajectoryLeg
+{
+	FVector Location = FVector::ZeroVector;
+	FVector Velocity = FVector::ZeroVector;
+};
+
+/** Where the projectile is Time seconds into its leg */
+struct FTrajectoryState
+{
+	FVector Location = FVector::ZeroVector;
+	FVector Velocity = FVector::ZeroVector;
+	float Time = 0.f;
+};
+
+/*
+ * Wind policies, the air velocity drag works against.
+ */
+
+struct FTrajectoryNoWind
+{
+	static FVector GetWind(const FTrajectoryFlightParams& Params) { return FVector::ZeroVector; }
+};
+
+struct FTrajectoryConstantWind
+{
+	static FVector GetWind(const FTrajectoryFlightParams& Params) { return Params.Wind; }
+};
+
+/*
+ * Drag policies. Advance moves InOutState to LegTime, in closed form where the model has one.
+ */
+
+struct FTrajectoryNoDrag
+{
+	static FVector GetAcceleration(const FVector& AirVelocity, float Coefficient) { return FVector::ZeroVector; }
+
+	template<typename WindPolicy>
+	static void Advance(const FTrajectoryFlightParams& Params, const FTrajectoryLeg& Leg, float LegTime, FTrajectoryState& InOutState)
+	{
+		InOutState.Location = Leg.Location + Leg.Velocity * LegTime + 0.5f * Params.Gravity * LegTime * LegTime;
+		InOutState.Velocity = Leg.Velocity + Params.Gravity * LegTime;
+		InOutState.Time = LegTime;
+	}
+};
+
+struct FTrajectoryLinearDrag
+{
+	static FVector GetAcceleration(const FVector& AirVelocity, float Coefficient) { return AirVelocity * -Coefficient; }
+
+	template<typename WindPolicy>
+	static void Advance(const FTrajectoryFlightParams& Params, const FTrajectoryLeg& Leg, float LegTime, FTrajectoryState& InOutState)
+	{
+		const float Coefficient = Params.DragCoefficient;
+		if (Coefficient < KINDA_SMALL_NUMBER)
+		{
+			FTrajectoryNoDrag::Advance<WindPolicy>(Params, Leg, LegTime, InOutState);
+			return;
+		}
+
+		// The velocity decays exponentially towards the terminal velocity
+		const FVector Terminal = WindPolicy::GetWind(Params) + Params.Gravity / Coefficient;
+		const float Decay = FMath::Exp(-Coefficient * LegTime);
+		InOutState.Location = Leg.Location + Terminal * LegTime + (Leg.Velocity - Terminal) * ((1.f - Decay) / Coefficient);
+		InOutState.Velocity = Terminal + (Leg.Velocity - Terminal) * Decay;
+		InOutState.Time = LegTime;
+	}
+};
+
+struct FTrajectoryQuadraticDrag
+{
+	/** Longest integration step, quadratic drag has no closed form in 3D */
+	static constexpr float MaxSubstep = 1.f / 120.f;
+
+	static FVector GetAcceleration(const FVector& AirVelocity, float Coefficient) { return AirVelocity * (-Coefficient * AirVelocity.Size()); }
+
+	template<typename WindPolicy>
+	static void Advance(const FTrajectoryFlightParams& Params, const FTrajectoryLeg& Leg, float LegTime, FTrajectoryState& InOutState)
+	{
+		// Samples usually move forward, going back starts over from the leg
+		if (LegTime < InOutState.Time)
+		{
+			InOutState.Location = Leg.Location;
+			InOutState.Velocity = Leg.Velocity;
+			InOutState.Time = 0.f;
+		}
+
+		const FVector Wind = WindPolicy::GetWind(Params);
+		while (InOutState.Time < LegTime)
+		{
+			// Midpoint method
+			const float Step = FMath::Min(MaxSubstep, LegTime - InOutState.Time);
+			const FVector HalfVelocity = InOutState.Velocity
+				+ (Params.Gravity + GetAcceleration(InOutState.Velocity - Wind, Params.DragCoefficient)) * (0.5f * Step);
+			InOutState.Location += HalfVelocity * Step;
+			InOutState.Velocity += (Params.Gravity + GetAcceleration(HalfVelocity - Wind, Params.DragCoefficient)) * Step;
+			InOutState.Time += Step;
+		}
+		InOutState.Time = LegTime;
+	}
+};
+
+inline FVector FTrajectoryFlightParams::GetDragAcceleration(const FVector& Velocity) const
+{
+	switch (DragModel)
+	{
+	case ETrajectoryDragModel::Linear:
+		return FTrajectoryLinearDrag::GetAcceleration(Velocity - Wind, DragCoefficient);
+	case ETrajectoryDragModel::Quadratic:
+		return FTrajectoryQuadraticDrag::GetAcceleration(Velocity - Wind, DragCoefficient);
+	default:
+		return FVector::ZeroVector;
+	}
+}
+
+/*
+ * Bounce policies, the velocity after a blocking hit.
+ */
+
+struct FTrajectoryNoBounce
+{
+	static constexpr bool bBounces = false;
+
+	static FVector Bounce(const FTrajectoryFlightParams& Params, const FVector& ImpactNormal, const FVector& Velocity) { return FVector::ZeroVector; }
+};
+
+struct FTrajectoryProjectileBounce
+{
+	static constexpr bool bBounces = true;
+
+	static FVector Bounce(const FTrajectoryFlightParams& Params, const FVector& ImpactNormal, const FVector& Velocity)
+	{
+		const FVector ComponentAlongImpactNormal = ImpactNormal * FVector::DotProduct(ImpactNormal, Velocity);
+		const FVector FrictionVector = (Velocity - ComponentAlongImpactNormal) * Params.Friction;
+		const FVector BouncinessVector = ComponentAlongImpactNormal * Params.Bounciness;
+		return Velocity - ComponentAlongImpactNormal - BouncinessVector - FrictionVector;
+	}
+};
+
+/**
+ * Samples a projectile's flight with the models fixed at compile time, so the loops using it carry no
+ * branches on the flight model and gravity-only or linear drag flights are evaluated in closed form.
+ * Copies are cheap, e.g. to look ahead without moving the original.
+ */
+template<typename DragPolicy, typename WindPolicy, typename BouncePolicy>
+class TTrajectoryIntegrator
+{
+public:
+	static constexpr bool bBounces = BouncePolicy::bBounces;
+
+	explicit TTrajectoryIntegrator(const FTrajectoryFlightParams& InParams)
+		: Params(InParams)
+	{
+	}
+
+	/** Starts a leg, at the launch or after a bounce */
+	void BeginLeg(const FVector& Location, const FVector& Velocity)
+	{
+		Leg.Location = Location;
+		Leg.Velocity = Velocity;
+		State.Location = Location;
+		State.Velocity = Velocity;
+		State.Time = 0.f;
+	}
+
+	/** Location LegTime seconds into the current leg, GetVelocity is updated to the same time */
+	FVector Sample(float LegTime)
+	{
+		DragPolicy::template Advance<WindPolicy>(Params, Leg, LegTime, State);
+		return State.Location;
+	}
+
+	const FVector& GetVelocity() const { return State.Velocity; }
+
+	FVector Bounce(const FVector& ImpactNormal, const FVector& Velocity) const
+	{
+		return BouncePolicy::Bounce(Params, ImpactNormal, Velocity);
+	}
+
+	FVector GetAcceleration(const FVector& Velocity) const
+	{
+		return Params.Gravity + DragPolicy::GetAcceleration(Velocity - WindPolicy::GetWind(Params), Params.DragCoefficient);
+	}
+
+private:
+	FTrajectoryFlightParams Params;
+	FTrajectoryLeg Leg;
+	FTrajectoryState State;
+};
+
+namespace TrajectoryIntegrator
+{
+	template<typename DragPolicy, typename WindPolicy, typename VisitorType>
+	void VisitBounce(const FTrajectoryFlightParams& Params, VisitorType& Visitor)
+	{
+		if (Params.bBounce)
+		{
+			Visitor(TTrajectoryIntegrator<DragPolicy, WindPolicy, FTrajectoryProjectileBounce>(Params));
+		}
+		else
+		{
+			Visitor(TTrajectoryIntegrator<DragPolicy, WindPolicy, FTrajectoryNoBounce>(Params));
+		}
+	}
+
+	template<typename DragPolicy, typename VisitorType>
+	void VisitWind(const FTrajectoryFlightParams& Params, VisitorType& Visitor)
+	{
+		if (Params.Wind.IsNearlyZero())
+		{
+			VisitBounce<DragPolicy, FTrajectoryNoWind>(Params, Visitor);
+		}
+		else
+		{
+			VisitBounce<DragPolicy, FTrajectoryConstantWind>(Params, Visitor);
+		}
+	}
+
+	/**
+	 * Calls Visitor, usually a generic lambda, with the integrator specialized for Params' flight model.
+	 * The model is looked at once here, every instantiation of Visitor's loop is compiled for one model.
+	 */
+	template<typename VisitorType>
+	void Visit(const FTrajectoryFlightParams& Params, VisitorType&& Visitor)
+	{
+		switch (Params.DragModel)
+		{
+		case ETrajectoryDragModel::Linear:
+			VisitWind<FTrajectoryLinearDrag>(Params, Visitor);
+			break;
+		case ETrajectoryDragModel::Quadratic:
+			VisitWind<FTrajectoryQuadraticDrag>(Params, Visitor);
+			break;
+		default:
+			// Wind only acts through drag
+			VisitBounce<FTrajectoryNoDrag, FTrajectoryNoWind>(Params, Visitor);
+			break;
+		}
+	}
+}
@@ -0,0 +1,271 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TrajectoryIntegratorBenchmarkGameMode.h"
+#include "TowerOfCodeThrowingProjectile.h"
+#include "TrajectoryProjectileMovementComponent.h"
+#include "Misc/CommandLine.h"
+#include "Misc/DateTime.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogTrajectoryIntegratorBenchmark, Log, All);
+
+namespace
+{
+	// Same stepping as the character's preview, without bounces
+	const float MaxSimTime = 2.0f;
+	const float SimFrequency = 1.e-2f;
+
+	// High enough that the test flights never reach the map
+	const FVector FlightOrigin(0.f, 0.f, 50000.f);
+
+	template<typename DragPolicy>
+	void AdvanceBranchingWind(const FTrajectoryFlightParams& Params, const FTrajectoryLeg& Leg, float LegTime, FTrajectoryState& InOutState)
+	{
+		if (Params.Wind.IsNearlyZero())
+		{
+			DragPolicy::template Advance<FTrajectoryNoWind>(Params, Leg, LegTime, InOutState);
+		}
+		else
+		{
+			DragPolicy::template Advance<FTrajectoryConstantWind>(Params, Leg, LegTime, InOutState);
+		}
+	}
+
+	/** The integrator's own policies, with the model looked at on every sample instead of once per arc */
+	void AdvanceBranching(const FTrajectoryFlightParams& Params, const FTrajectoryLeg& Leg, float LegTime, FTrajectoryState& InOutState)
+	{
+		switch (Params.DragModel)
+		{
+		case ETrajectoryDragModel::Linear:
+			AdvanceBranchingWind<FTrajectoryLinearDrag>(Params, Leg, LegTime, InOutState);
+			break;
+		case ETrajectoryDragModel::Quadratic:
+			AdvanceBranchingWind<FTrajectoryQuadraticDrag>(Params, Leg, LegTime, InOutState);
+			break;
+		default:
+			FTrajectoryNoDrag::Advance<FTrajectoryNoWind>(Params, Leg, LegTime, InOutState);
+			break;
+		}
+	}
+}
+
+ATrajectoryIntegratorBenchmarkGameMode::ATrajectoryIntegratorBenchmarkGameMode()
+	: Super()
+{
+	PrimaryActorTick.bCanEverTick = true;
+
+	ArcCount = 1000;
+	Passes = 3;
+	LaunchSpeed = 3000.f;
+	RandomSeed = 1234;
+	FlightSeconds = 1.f;
+	FlightTickSeconds = 1.f / 60.f;
+	FlightTolerance = 0.01f;
+	bDone = false;
+}
+
+void ATrajectoryIntegratorBenchmarkGameMode::Tick(float DeltaSeconds)
+{
+	Super::Tick(DeltaSeconds);
+
+	if (bDone)
+		return;
+	bDone = true;
+
+	FParse::Value(FCommandLine::Get(), TEXT("BenchArcs="), ArcCount);
+	FParse::Value(FCommandLine::Get(), TEXT("BenchPasses="), Passes);
+
+	FRandomStream Random(RandomSeed);
+	LaunchVelocities.Reset();
+	for (int32 Index = 0; Index < ArcCount; Index++)
+	{
+		const FRotator Aim(Random.FRandRange(-30.f, 60.f), Random.FRandRange(0.f, 360.f), 0.f);
+		LaunchVelocities.Add(Aim.Vector() * LaunchSpeed);
+	}
+
+	const FVector Gravity(0.f, 0.f, GetWorld()->GetGravityZ());
+	const FVector CrossWind(0.f, 500.f, 0.f);
+	TArray<FFlightModel> Models;
+	auto AddModel = [&Models, &Gravity](const TCHAR* Name, ETrajectoryDragModel DragModel, float DragCoefficient, const FVector& Wind)
+	{
+		FFlightModel& Model = Models.AddDefaulted_GetRef();
+		Model.Name = Name;
+		Model.Params.Gravity = Gravity;
+		Model.Params.DragModel = DragModel;
+		Model.Params.DragCoefficient = DragCoefficient;
+		Model.Params.Wind = Wind;
+	};
+	AddModel(TEXT("Gravity"), ETrajectoryDragModel::None, 0.f, FVector::ZeroVector);
+	AddModel(TEXT("Linear"), ETrajectoryDragModel::Linear, 0.5f, FVector::ZeroVector);
+	AddModel(TEXT("LinearWind"), ETrajectoryDragModel::Linear, 0.5f, CrossWind);
+	AddModel(TEXT("Quadratic"), ETrajectoryDragModel::Quadratic, 1.e-4f, FVector::ZeroVector);
+	AddModel(TEXT("QuadraticWind"), ETrajectoryDragModel::Quadratic, 1.e-4f, CrossWind);
+
+	Rows.Reset();
+	Rows.Add(TEXT("Model,Arcs,Samples,SpecializedMs,BranchingMs,Speedup,BranchingDeviation,FlightError,FlightTolerance,Passed"));
+
+	TArray<FVector> SpecializedEnds;
+	TArray<FVector> BranchingEnds;
+	for (const FFlightModel& Model : Models)
+	{
+		double SpecializedSeconds = TNumericLimits<double>::Max();
+		double BranchingSeconds = TNumericLimits<double>::Max();
+		for (int32 Pass = 0; Pass < FMath::Max(1, Passes); Pass++)
+		{
+			SpecializedSeconds = FMath::Min(SpecializedSeconds, RunSpecialized(Model.Params, SpecializedEnds));
+			BranchingSeconds = FMath::Min(BranchingSeconds, RunBranching(Model.Params, BranchingEnds));
+		}
+
+		// Both arms run the same math, anything but zero means they no longer compare the same thing
+		float BranchingDeviation = 0.f;
+		for (int32 Index = 0; Index < SpecializedEnds.Num(); Index++)
+		{
+			BranchingDeviation = FMath::Max(BranchingDeviation, FVector::Dist(SpecializedEnds[Index], BranchingEnds[Index]));
+		}
+
+		float FlightError = 0.f;
+		float FlightDistance = 0.f;
+		const bool bFlown = FlyProjectile(Model.Params, FlightError, FlightDistance);
+		const float Tolerance = 1.f + FlightDistance * FlightTolerance;
+		const bool bPassed = bFlown && FlightError <= Tolerance;
+		if (!bPassed)
+		{
+			UE_LOG(LogTrajectoryIntegratorBenchmark, Error, TEXT("%s: the projectile ended %.2f cm away from the integrator, %.2f cm allowed"),
+				Model.Name, FlightError, Tolerance);
+		}
+
+		const int32 Samples = ArcCount * FMath::CeilToInt(MaxSimTime / SimFrequency);
+		Rows.Add(FString::Printf(TEXT("%s,%d,%d,%.3f,%.3f,%.2f,%.3f,%.3f,%.3f,%d"),
+			Model.Name,
+			ArcCount,
+			Samples,
+			SpecializedSeconds * 1000.0,
+			BranchingSeconds * 1000.0,
+			SpecializedSeconds > 0.0 ? BranchingSeconds / SpecializedSeconds : 0.0,
+			BranchingDeviation,
+			FlightError,
+			Tolerance,
+			bPassed ? 1 : 0));
+	}
+
+	WriteResults();
+	FPlatformMisc::RequestExit(false);
+}
+
+double ATrajectoryIntegratorBenchmarkGameMode::RunSpecialized(const FTrajectoryFlightParams& Params, TArray<FVector>& OutEnds) const
+{
+	OutEnds.Reset();
+	OutEnds.AddZeroed(LaunchVelocities.Num());
+
+	const double StartTime = FPlatformTime::Seconds();
+	TrajectoryIntegrator::Visit(Params, [this, &OutEnds](auto Integrator)
+	{
+		for (int32 Index = 0; Index < LaunchVelocities.Num(); Index++)
+		{
+			Integrator.BeginLeg(FVector::ZeroVector, LaunchVelocities[Index]);
+			FVector Location = FVector::ZeroVector;
+			for (float SimTime = SimFrequency; SimTime < MaxSimTime; SimTime += SimFrequency)
+			{
+				Location = Integrator.Sample(SimTime);
+			}
+			OutEnds[Index] = Location;
+		}
+	});
+	return FPlatformTime::Seconds() - StartTime;
+}
+
+double ATrajectoryIntegratorBenchmarkGameMode::RunBranching(const FTrajectoryFlightParams& Params, TArray<FVector>& OutEnds) const
+{
+	OutEnds.Reset();
+	OutEnds.AddZeroed(LaunchVelocities.Num());
+
+	const double StartTime = FPlatformTime::Seconds();
+	for (int32 Index = 0; Index < LaunchVelocities.Num(); Index++)
+	{
+		FTrajectoryLeg Leg;
+		Leg.Velocity = LaunchVelocities[Index];
+		FTrajectoryState State;
+		State.Velocity = Leg.Velocity;
+		for (float SimTime = SimFrequency; SimTime < MaxSimTime; SimTime += SimFrequency)
+		{
+			AdvanceBranching(Params, Leg, SimTime, State);
+		}
+		OutEnds[Index] = State.Location;
+	}
+	return FPlatformTime::Seconds() - StartTime;
+}
+
+bool ATrajectoryIntegratorBenchmarkGameMode::FlyProjectile(const FTrajectoryFlightParams& Params, float& OutError, float& OutDistance)
+{
+	UWorld* World = GetWorld();
+	const FVector Aim = FRotator(30.f, 0.f, 0.f).Vector();
+	ATowerOfCodeThrowingProjectile* Projectile = World->SpawnActorDeferred<ATowerOfCodeThrowingProjectile>(
+		ATowerOfCodeThrowingProjectile::StaticClass(),
+		FTransform(Aim.Rotation(), FlightOrigin),
+		nullptr,
+		nullptr,
+		ESpawnActorCollisionHandlingMethod::AlwaysSpawn);
+	if (Projectile == nullptr)
+		return false;
+
+	UTrajectoryProjectileMovementComponent* Movement = Cast<UTrajectoryProjectileMovementComponent>(Projectile->GetProjectileMovement());
+	if (Movement == nullptr)
+	{
+		Projectile->Destroy();
+		return false;
+	}
+
+	Movement->InitialSpeed = LaunchSpeed;
+	Movement->MaxSpeed = 0.f;
+	Movement->DragModel = Params.DragModel;
+	Movement->DragCoefficient = Params.DragCoefficient;
+	Movement->WindVelocity = Params.Wind;
+	Projectile->FinishSpawning(FTransform(Aim.Rotation(), FlightOrigin));
+	Projectile->SetActorEnableCollision(false);
+
+	// Ticked here rather than by the world, so the flight time is exact
+	Movement->SetComponentTickEnabled(false);
+	const FVector LaunchLocation = Projectile->GetActorLocation();
+	const FVector LaunchVelocity = Movement->Velocity;
+	const int32 Ticks = FMath::Max(1, FMath::RoundToInt(FlightSeconds / FlightTickSeconds));
+	for (int32 TickIndex = 0; TickIndex < Ticks; TickIndex++)
+	{
+		Movement->TickComponent(FlightTickSeconds, LEVELTICK_All, &Movement->PrimaryComponentTick);
+	}
+
+	FVector Predicted = LaunchLocation;
+	TrajectoryIntegrator::Visit(UTrajectoryProjectileMovementComponent::MakeFlightParams(Movement, World->GetGravityZ()),
+		[&Predicted, &LaunchLocation, &LaunchVelocity, Ticks, this](auto Integrator)
+	{
+		Integrator.BeginLeg(LaunchLocation, LaunchVelocity);
+		Predicted = Integrator.Sample(Ticks * FlightTickSeconds);
+	});
+
+	OutError = FVector::Dist(Projectile->GetActorLocation(), Predicted);
+	OutDistance = FVector::Dist(LaunchLocation, Predicted);
+	Projectile->Destroy();
+	return true;
+}
+
+void ATrajectoryIntegratorBenchmarkGameMode::WriteResults()
+{
+	FString OutputPath;
+	if (!FParse::Value(FCommandLine::Get(), TEXT("BenchOutput="), OutputPath))
+	{
+		OutputPath = FPaths::Combine(
+			FPaths::ProjectSavedDir(),
+			TEXT("Benchmarks"),
+			FString::Printf(TEXT("TrajectoryIntegrator_%s.csv"), *FDateTime::Now().ToString()));
+	}
+
+	if (FFileHelper::SaveStringArrayToFile(Rows, *OutputPath))
+	{
+		UE_LOG(LogTrajectoryIntegratorBenchmark, Log, TEXT("Wrote %s"), *OutputPath);
+	}
+	else
+	{
+		UE_LOG(LogTrajectoryIntegratorBenchmark, Error, TEXT("Failed to write %s"), *OutputPath);
+	}
+}
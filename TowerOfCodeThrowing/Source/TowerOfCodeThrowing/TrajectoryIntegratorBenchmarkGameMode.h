@@ -0,0 +1,76 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "TowerOfCodeThrowingGameMode.h"
+#include "TrajectoryIntegrator.h"
+#include "TrajectoryIntegratorBenchmarkGameMode.generated.h"
+
+/**
+ * Measures and checks the trajectory integrators, one row per flight model.
+ * Times the specialized TTrajectoryIntegrator against the same drag and wind policies picked by a switch
+ * on every sample, so the difference is the cost of branching alone, then flies a real projectile with that model by ticking its movement component by hand and compares
+ * where it ends up with the integrator. Any model off by more than the tolerance is logged as an error.
+ *
+ * Needs no geometry, the projectiles fly without collision, e.g.
+ * "TowerOfCodeThrowing <Map>?game=TrajectoryIntegratorBenchmark -game -nullrhi -BenchArcs=2000"
+ */
+UCLASS(minimalapi)
+class ATrajectoryIntegratorBenchmarkGameMode : public ATowerOfCodeThrowingGameMode
+{
+	GENERATED_BODY()
+
+public:
+	ATrajectoryIntegratorBenchmarkGameMode();
+
+	/** Arcs sampled per flight model, overridden by -BenchArcs= */
+	UPROPERTY(EditAnywhere, Category = Benchmark)
+		int32 ArcCount;
+
+	/** Times each flight model runs the whole set, the fastest pass is kept. Overridden by -BenchPasses= */
+	UPROPERTY(EditAnywhere, Category = Benchmark)
+		int32 Passes;
+
+	UPROPERTY(EditAnywhere, Category = Benchmark)
+		float LaunchSpeed;
+
+	UPROPERTY(EditAnywhere, Category = Benchmark)
+		int32 RandomSeed;
+
+	/** Length of the projectile flights compared with the integrators */
+	UPROPERTY(EditAnywhere, Category = Benchmark)
+		float FlightSeconds;
+
+	/** Tick length the projectile flights are simulated with */
+	UPROPERTY(EditAnywhere, Category = Benchmark)
+		float FlightTickSeconds;
+
+	/** Allowed distance between the projectile and the integrator, as a fraction of the distance flown */
+	UPROPERTY(EditAnywhere, Category = Benchmark)
+		float FlightTolerance;
+
+	virtual void Tick(float DeltaSeconds) override;
+
+private:
+	struct FFlightModel
+	{
+		const TCHAR* Name;
+		FTrajectoryFlightParams Params;
+	};
+
+	/** Samples every arc with the specialized integrator, @returns the elapsed seconds */
+	double RunSpecialized(const FTrajectoryFlightParams& Params, TArray<FVector>& OutEnds) const;
+
+	/** Samples every arc with the same policies, branching on the model at each sample, @returns the elapsed seconds */
+	double RunBranching(const FTrajectoryFlightParams& Params, TArray<FVector>& OutEnds) const;
+
+	/** Flies a projectile with Params, @returns how far it ended up from the integrator and how far it flew */
+	bool FlyProjectile(const FTrajectoryFlightParams& Params, float& OutError, float& OutDistance);
+
+	void WriteResults();
+
+	TArray<FVector> LaunchVelocities;
+	bool bDone;
+	TArray<FString> Rows;
+};
@@ -0,0 +1,44 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TrajectoryProjectileMovementComponent.h"
+
+UTrajectoryProjectileMovementComponent::UTrajectoryProjectileMovementComponent()
+{
+	DragModel = ETrajectoryDragModel::None;
+	DragCoefficient = 0.f;
+	WindVelocity = FVector::ZeroVector;
+}
+
+FTrajectoryFlightParams UTrajectoryProjectileMovementComponent::MakeFlightParams(const UProjectileMovementComponent* Movement, float WorldGravityZ)
+{
+	FTrajectoryFlightParams Params;
+	if (Movement == nullptr)
+	{
+		Params.Gravity = FVector(0.f, 0.f, WorldGravityZ);
+		return Params;
+	}
+
+	Params.Gravity = FVector(0.f, 0.f, WorldGravityZ * Movement->ProjectileGravityScale);
+	Params.bBounce = Movement->bShouldBounce;
+	Params.Bounciness = Movement->Bounciness;
+	Params.Friction = Movement->Friction;
+
+	if (const UTrajectoryProjectileMovementComponent* TrajectoryMovement = Cast<UTrajectoryProjectileMovementComponent>(Movement))
+	{
+		Params.DragModel = TrajectoryMovement->DragModel;
+		Params.DragCoefficient = TrajectoryMovement->DragCoefficient;
+		Params.Wind = TrajectoryMovement->WindVelocity;
+	}
+	return Params;
+}
+
+FVector UTrajectoryProjectileMovementComponent::ComputeAcceleration(const FVector& InVelocity, float DeltaTime) const
+{
+	FTrajectoryFlightParams Params;
+	Params.DragModel = DragModel;
+	Params.DragCoefficient = DragCoefficient;
+	Params.Wind = WindVelocity;
+
+	return Super::ComputeAcceleration(InVelocity, DeltaTime) + Params.GetDragAcceleration(InVelocity);
+}
@@ -0,0 +1,38 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/ProjectileMovementComponent.h"
+#include "TrajectoryIntegrator.h"
+#include "TrajectoryProjectileMovementComponent.generated.h"
+
+/**
+ * Projectile movement with air drag and wind. The trajectory preview reads the same settings from the
+ * projectile class, see MakeFlightParams, and integrates them with the matching TTrajectoryIntegrator.
+ */
+UCLASS(ClassGroup = Movement, meta = (BlueprintSpawnableComponent))
+class UTrajectoryProjectileMovementComponent : public UProjectileMovementComponent
+{
+	GENERATED_BODY()
+
+public:
+	UTrajectoryProjectileMovementComponent();
+
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Drag)
+		ETrajectoryDragModel DragModel;
+
+	/** 1/sec for linear drag, 1/cm for quadratic drag */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Drag, meta = (ClampMin = "0"))
+		float DragCoefficient;
+
+	/** Velocity of the air, only felt through drag */
+	UPROPERTY(EditAnywhere, BlueprintReadWrite, Category = Drag)
+		FVector WindVelocity;
+
+	/** Flight model of Movement, which doesn't have to be a UTrajectoryProjectileMovementComponent */
+	static FTrajectoryFlightParams MakeFlightParams(const UProjectileMovementComponent* Movement, float WorldGravityZ);
+
+protected:
+	virtual FVector ComputeAcceleration(const FVector& InVelocity, float DeltaTime) const override;
+};
@@ -0,0 +1,657 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+
+#include "TrajectoryThrowStation.h"
+#include "ProjectileRegistrySubsystem.h"
+#include "TowerOfCodeThrowingProjectile.h"
+#include "TrajectoryCollisionCache.h"
+#include "TrajectoryProjectileMovementComponent.h"
+#include "Components/PrimitiveComponent.h"
+#include "Components/SphereComponent.h"
+#include "GameFramework/ProjectileMovementComponent.h"
+#include "HAL/PlatformFilemanager.h"
+#include "Misc/FileHelper.h"
+#include "Misc/Paths.h"
+
+DEFINE_LOG_CATEGORY_STATIC(LogThrowStation, Log, All);
+
+namespace
+{
+	const uint32 TableMagic = 0x4C425454; // "TTBL"
+	const uint16 TableVersion = 3;
+
+	// Same stepping as the character's preview
+	const float MaxSimTime = 2.0f;
+	const float SimFrequency = 1.e-2f;
+
+	/** File header, followed by YawSteps * PitchSteps records */
+	struct FTrajectoryTableHeader
+	{
+		uint32 Magic;
+		uint16 Version;
+		uint8 MaxPoints;
+		uint8 Reserved;
+		uint16 YawSteps;
+		uint16 PitchSteps;
+		float MinYaw;
+		float MaxYaw;
+		float MinPitch;
+		float MaxPitch;
+		float LaunchSpeed;
+		float GravityZ;
+		float BakeLocation[3];
+		float BakeYaw;
+		/** CRC of the projectile class path, see GetClassHash */
+		uint32 ProjectileClassHash;
+	};
+	static_assert(sizeof(FTrajectoryTableHeader) == 56, "The table header is read straight from the mapped file");
+
+	uint32 GetClassHash(const UClass* Class)
+	{
+		return Class != nullptr ? FCrc::StrCrc32(*Class->GetPathName()) : 0;
+	}
+
+	/**
+	 * A record is the point count and a reserved byte, then MaxPoints times in milliseconds,
+	 * MaxPoints points relative to the station in centimeters and MaxPoints velocities relative
+	 * to the station in cm/sec, all 16 bit. The launch point is implicit, the velocities are
+	 * those leaving the launch point and each point but the last.
+	 */
+	int32 GetRecordSize(int32 MaxPoints)
+	{
+		return 2 + MaxPoints * (sizeof(uint16) + 6 * sizeof(int16));
+	}
+
+	int16 QuantizeCoordinate(float Value)
+	{
+		return (int16)FMath::Clamp(FMath::RoundToInt(Value), (int32)MIN_int16, (int32)MAX_int16);
+	}
+
+	/**
+	 * Velocity leaving a key point. Arcs made without velocities, e.g. in a blueprint, are taken as
+	 * drag-free, which fixes the velocity between two key points.
+	 */
+	FVector GetLegVelocity(const FThrowStationArc& Arc, int32 Key, const FVector& Gravity)
+	{
+		if (Arc.Velocities.IsValidIndex(Key))
+			return Arc.Velocities[Key];
+
+		const float Duration = Arc.Times[Key + 1] - Arc.Times[Key];
+		if (Duration <= KINDA_SMALL_NUMBER)
+			return FVector::ZeroVector;
+
+		return (Arc.Points[Key + 1] - Arc.Points[Key] - 0.5f * Gravity * Duration * Duration) / Duration;
+	}
+}
+
+ATrajectoryThrowStation::ATrajectoryThrowStation()
+{
+	PrimaryActorTick.bCanEverTick = false;
+
+	RootComponent = CreateDefaultSubobject<USceneComponent>(TEXT("Root"));
+
+	YawRange = FVector2D(-60.f, 60.f);
+	PitchRange = FVector2D(-20.f, 60.f);
+	YawSteps = 121;
+	PitchSteps = 81;
+	InterpolationTolerance = 200.f;
+	MaxBounces = 2;
+
+	TableData = nullptr;
+	TableMaxPoints = 0;
+	TableYawSteps = 0;
+	TablePitchSteps = 0;
+	TableGravityZ = 0.f;
+}
+
+void ATrajectoryThrowStation::BeginPlay()
+{
+	Super::BeginPlay();
+
+	if (!LoadTable())
+	{
+		UE_LOG(LogThrowStation, Warning, TEXT("%s has no usable table at %s, arcs are simulated live"), *GetName(), *GetTablePath());
+	}
+}
+
+void ATrajectoryThrowStation::EndPlay(const EEndPlayReason::Type EndPlayReason)
+{
+	UnloadTable();
+
+	Super::EndPlay(EndPlayReason);
+}
+
+ATrajectoryThrowStation::FProjectileSettings ATrajectoryThrowStation::GetProjectileSettings() const
+{
+	FProjectileSettings Settings;
+	if (ProjectileClass == nullptr)
+		return Settings;
+
+	const ATowerOfCodeThrowingProjectile* Projectile = ProjectileClass.GetDefaultObject();
+	Settings.Speed = Projectile->GetProjectileMovement()->InitialSpeed;
+	Settings.Radius = Projectile->GetCollisionComp()->GetUnscaledSphereRadius();
+	return Settings;
+}
+
+FTrajectoryFlightParams ATrajectoryThrowStation::GetFlightParams(float GravityZ) const
+{
+	const UProjectileMovementComponent* Movement = ProjectileClass != nullptr ? ProjectileClass.GetDefaultObject()->GetProjectileMovement() : nullptr;
+	return UTrajectoryProjectileMovementComponent::MakeFlightParams(Movement, GravityZ);
+}
+
+FString ATrajectoryThrowStation::GetTablePath() const
+{
+	return FPaths::Combine(
+		FPaths::ProjectContentDir(),
+		TEXT("TrajectoryTables"),
+		(TableName.IsEmpty() ? GetName() : TableName) + TEXT(".trajtable"));
+}
+
+FThrowStationArc ATrajectoryThrowStation::MakeLaunchArc() const
+{
+	FThrowStationArc Arc;
+	Arc.Points.Add(GetActorLocation());
+	Arc.Times.Add(0.f);
+	Arc.Velocities.Add(FVector::ZeroVector);
+	return Arc;
+}
+
+void ATrajectoryThrowStation::SimulateArc(const FVector& Velocity, int32 Bounces, TFunctionRef<bool(FHitResult&, const FVector&, const FVector&)> Sweep, FThrowStationArc& InOutArc) const
+{
+	// The flight model is picked once per arc, like the character's preview does
+	TrajectoryIntegrator::Visit(GetFlightParams(GetWorld()->GetGravityZ()), [this, &Velocity, Bounces, &Sweep, &InOutArc](auto Integrator)
+	{
+		Integrator.BeginLeg(InOutArc.Points.Last(), Velocity);
+		InOutArc.Velocities.Last() = Velocity;
+
+		FVector TraceStart = InOutArc.Points.Last();
+		FVector TraceEnd = TraceStart;
+		float SegmentStartTime = InOutArc.Times.Last();
+		float SimTime = 0.f;
+		int32 SimBounces = Bounces;
+
+		while (SimTime < MaxSimTime)
+		{
+			SimTime += SimFrequency;
+			TraceEnd = Integrator.Sample(SimTime);
+
+			FHitResult Hit;
+			if (!Sweep(Hit, TraceStart, TraceEnd))
+			{
+				TraceStart = TraceEnd;
+				continue;
+			}
+
+			const float HitTime = SimTime - SimFrequency * (1.f - Hit.Time);
+			InOutArc.Points.Add(Hit.Location);
+			InOutArc.Times.Add(SegmentStartTime + HitTime);
+			InOutArc.Velocities.Add(FVector::ZeroVector);
+
+			// Projectiles that don't bounce stop at the first hit
+			if (!decltype(Integrator)::bBounces || ++SimBounces >= MaxBounces)
+				return;
+
+			Integrator.Sample(HitTime);
+			const FVector BounceVelocity = Integrator.Bounce(Hit.ImpactNormal, Integrator.GetVelocity());
+			InOutArc.Velocities.Last() = BounceVelocity;
+			Integrator.BeginLeg(Hit.Location, BounceVelocity);
+			TraceStart = Hit.Location;
+			SegmentStartTime += HitTime;
+			SimTime = 0.f;
+		}
+
+		InOutArc.Points.Add(TraceEnd);
+		InOutArc.Times.Add(SegmentStartTime + SimTime);
+		InOutArc.Velocities.Add(FVector::ZeroVector);
+	});
+}
+
+FCollisionQueryParams ATrajectoryThrowStation::MakeQueryParams(const TArray<AActor*>& IgnoredActors) const
+{
+	FCollisionQueryParams QueryParams(SCENE_QUERY_STAT(ThrowStation), false, this);
+	QueryParams.AddIgnoredActor(GetInstigator());
+	for (const AActor* Actor : IgnoredActors)
+	{
+		QueryParams.AddIgnoredActor(Actor);
+	}
+
+	// The station's own shots and everyone else's are no obstacle, they've moved on by the time this one flies
+	if (const UProjectileRegistrySubsystem* Registry = GetWorld()->GetSubsystem<UProjectileRegistrySubsystem>())
+	{
+		for (const ATowerOfCodeThrowingProjectile* Projectile : Registry->GetProjectiles())
+		{
+			QueryParams.AddIgnoredActor(Projectile);
+		}
+	}
+	return QueryParams;
+}
+
+void ATrajectoryThrowStation::BakeTable()
+{
+	UWorld* World = GetWorld();
+	if (World == nullptr)
+		return;
+
+	const FProjectileSettings Settings = GetProjectileSettings();
+	const int32 MaxPoints = FMath::Max(1, MaxBounces) + 1;
+	const int32 RecordSize = GetRecordSize(MaxPoints);
+	const FTransform StationTransform = GetActorTransform();
+
+	// Only static geometry is baked, whatever moves is swept live
+	FTrajectoryCollisionCache Cache;
+	Cache.Build(World, FBox(GetActorLocation(), GetActorLocation()).ExpandBy(Settings.Speed * MaxSimTime * 1.5f));
+
+	auto SweepStatic = [&Cache, &Settings](FHitResult& OutHit, const FVector& Start, const FVector& End)
+	{
+		TArray<TWeakObjectPtr<UPrimitiveComponent>> Deferred;
+		bool bHit = Cache.SweepSphere(Start, End, Settings.Radius, OutHit, TArrayView<const uint32>(), &Deferred);
+		for (const TWeakObjectPtr<UPrimitiveComponent>& Component : Deferred)
+		{
+			FHitResult ComponentHit;
+			if (Component.IsValid()
+				&& Component->SweepComponent(ComponentHit, Start, End, FQuat::Identity, FCollisionShape::MakeSphere(Settings.Radius))
+				&& (!bHit || ComponentHit.Time < OutHit.Time))
+			{
+				OutHit = ComponentHit;
+				bHit = true;
+			}
+		}
+		return bHit;
+	};
+
+	FTrajectoryTableHeader Header;
+	FMemory::Memzero(Header);
+	Header.Magic = TableMagic;
+	Header.Version = TableVersion;
+	Header.MaxPoints = (uint8)MaxPoints;
+	Header.YawSteps = (uint16)FMath::Clamp(YawSteps, 2, (int32)MAX_uint16);
+	Header.PitchSteps = (uint16)FMath::Clamp(PitchSteps, 2, (int32)MAX_uint16);
+	Header.MinYaw = YawRange.X;
+	Header.MaxYaw = YawRange.Y;
+	Header.MinPitch = PitchRange.X;
+	Header.MaxPitch = PitchRange.Y;
+	Header.LaunchSpeed = Settings.Speed;
+	Header.GravityZ = World->GetGravityZ();
+	Header.BakeLocation[0] = GetActorLocation().X;
+	Header.BakeLocation[1] = GetActorLocation().Y;
+	Header.BakeLocation[2] = GetActorLocation().Z;
+	Header.BakeYaw = GetActorRotation().Yaw;
+	Header.ProjectileClassHash = GetClassHash(ProjectileClass);
+
+	TArray<uint8> Bytes;
+	Bytes.SetNumZeroed(sizeof(Header) + Header.YawSteps * Header.PitchSteps * RecordSize);
+	FMemory::Memcpy(Bytes.GetData(), &Header, sizeof(Header));
+
+	for (int32 YawIndex = 0; YawIndex < Header.YawSteps; YawIndex++)
+	{
+		for (int32 PitchIndex = 0; PitchIndex < Header.PitchSteps; PitchIndex++)
+		{
+			const FRotator RelativeAim(
+				FMath::Lerp(PitchRange.X, PitchRange.Y, PitchIndex / float(Header.PitchSteps - 1)),
+				FMath::Lerp(YawRange.X, YawRange.Y, YawIndex / float(Header.YawSteps - 1)),
+				0.f);
+			const FVector Velocity = StationTransform.TransformVectorNoScale(RelativeAim.Vector()) * Settings.Speed;
+			FThrowStationArc Arc = MakeLaunchArc();
+			SimulateArc(Velocity, 0, SweepStatic, Arc);
+
+			uint8* Record = Bytes.GetData() + sizeof(Header) + (YawIndex * Header.PitchSteps + PitchIndex) * RecordSize;
+			const int32 PointCount = FMath::Min(Arc.Points.Num() - 1, MaxPoints);
+			Record[0] = (uint8)PointCount;
+
+			uint8* Times = Record + 2;
+			uint8* Points = Times + MaxPoints * sizeof(uint16);
+			uint8* Velocities = Points + MaxPoints * 3 * sizeof(int16);
+			for (int32 Index = 0; Index < PointCount; Index++)
+			{
+				const uint16 TimeMs = (uint16)FMath::Clamp(FMath::RoundToInt(Arc.Times[Index + 1] * 1000.f), 0, (int32)MAX_uint16);
+				FMemory::Memcpy(Times + Index * sizeof(uint16), &TimeMs, sizeof(uint16));
+
+				const FVector Local = StationTransform.InverseTransformPositionNoScale(Arc.Points[Index + 1]);
+				const int16 Coordinates[3] = { QuantizeCoordinate(Local.X), QuantizeCoordinate(Local.Y), QuantizeCoordinate(Local.Z) };
+				FMemory::Memcpy(Points + Index * sizeof(Coordinates), Coordinates, sizeof(Coordinates));
+
+				const FVector LocalVelocity = StationTransform.InverseTransformVectorNoScale(Arc.Velocities[Index]);
+				const int16 VelocityCoordinates[3] = { QuantizeCoordinate(LocalVelocity.X), QuantizeCoordinate(LocalVelocity.Y), QuantizeCoordinate(LocalVelocity.Z) };
+				FMemory::Memcpy(Velocities + Index * sizeof(VelocityCoordinates), VelocityCoordinates, sizeof(VelocityCoordinates));
+			}
+		}
+	}
+
+	UnloadTable();
+
+	const FString Path = GetTablePath();
+	if (FFileHelper::SaveArrayToFile(Bytes, *Path))
+	{
+		UE_LOG(LogThrowStation, Log, TEXT("Baked %dx%d samples (%d bytes, %d static shapes) to %s"),
+			Header.YawSteps, Header.PitchSteps, Bytes.Num(), Cache.GetShapeCount(), *Path);
+	}
+	else
+	{
+		UE_LOG(LogThrowStation, Error, TEXT("Failed to write %s"), *Path);
+	}
+
+	if (HasActorBegunPlay())
+	{
+		LoadTable();
+	}
+}
+
+bool ATrajectoryThrowStation::LoadTable()
+{
+	UnloadTable();
+
+	const FString Path = GetTablePath();
+	const uint8* Data = nullptr;
+	int64 Size = 0;
+
+	MappedFile.Reset(FPlatformFileManager::Get().GetPlatformFile().OpenMapped(*Path));
+	if (MappedFile.IsValid())
+	{
+		MappedRegion.Reset(MappedFile->MapRegion(0, MappedFile->GetFileSize()));
+	}
+
+	if (MappedRegion.IsValid())
+	{
+		Data = MappedRegion->GetMappedPtr();
+		Size = MappedRegion->GetMappedSize();
+	}
+	else if (FFileHelper::LoadFileToArray(LoadedBytes, *Path, FILEREAD_Silent))
+	{
+		// Platforms without mapping support read the whole table instead
+		Data = LoadedBytes.GetData();
+		Size = LoadedBytes.Num();
+	}
+
+	if (Data == nullptr || Size < (int64)sizeof(FTrajectoryTableHeader))
+	{
+		UnloadTable();
+		return false;
+	}
+
+	FTrajectoryTableHeader Header;
+	FMemory::Memcpy(&Header, Data, sizeof(Header));
+
+	const int64 ExpectedSize = sizeof(Header) + (int64)Header.YawSteps * Header.PitchSteps * GetRecordSize(Header.MaxPoints);
+	if (Header.Magic != TableMagic || Header.Version != TableVersion || Header.MaxPoints == 0 || Size < ExpectedSize)
+	{
+		UE_LOG(LogThrowStation, Warning, TEXT("%s is not a valid trajectory table"), *Path);
+		UnloadTable();
+		return false;
+	}
+
+	// A corrupt or stale header would launch with a garbage speed or another projectile's flight
+	const bool bValidRanges = Header.YawSteps >= 2 && Header.PitchSteps >= 2
+		&& FMath::IsFinite(Header.MinYaw) && FMath::IsFinite(Header.MaxYaw) && Header.MinYaw <= Header.MaxYaw
+		&& FMath::IsFinite(Header.MinPitch) && FMath::IsFinite(Header.MaxPitch) && Header.MinPitch <= Header.MaxPitch
+		&& FMath::IsFinite(Header.GravityZ);
+	if (!bValidRanges || !FMath::IsFinite(Header.LaunchSpeed) || Header.LaunchSpeed <= 0.f)
+	{
+		UE_LOG(LogThrowStation, Warning, TEXT("%s has a corrupt header"), *Path);
+		UnloadTable();
+		return false;
+	}
+
+	if (ProjectileClass == nullptr
+		|| Header.ProjectileClassHash != GetClassHash(ProjectileClass)
+		|| !FMath::IsNearlyEqual(Header.LaunchSpeed, GetProjectileSettings().Speed, 1.f))
+	{
+		UE_LOG(LogThrowStation, Warning, TEXT("%s was baked for another projectile than %s's, bake it again"), *Path, *GetName());
+		UnloadTable();
+		return false;
+	}
+
+	const FVector BakeLocation(Header.BakeLocation[0], Header.BakeLocation[1], Header.BakeLocation[2]);
+	if (!BakeLocation.Equals(GetActorLocation(), 1.f) || !FMath::IsNearlyEqual(Header.BakeYaw, GetActorRotation().Yaw, 0.1f))
+	{
+		UE_LOG(LogThrowStation, Warning, TEXT("%s moved since %s was baked, bake it again"), *GetName(), *Path);
+		UnloadTable();
+		return false;
+	}
+
+	TableData = Data + sizeof(Header);
+	TableMaxPoints = Header.MaxPoints;
+	TableYawSteps = Header.YawSteps;
+	TablePitchSteps = Header.PitchSteps;
+	TableYawRange = FVector2D(Header.MinYaw, Header.MaxYaw);
+	TablePitchRange = FVector2D(Header.MinPitch, Header.MaxPitch);
+	TableGravityZ = Header.GravityZ;
+	return true;
+}
+
+void ATrajectoryThrowStation::UnloadTable()
+{
+	TableData = nullptr;
+	MappedRegion.Reset();
+	MappedFile.Reset();
+	LoadedBytes.Empty();
+}
+
+bool ATrajectoryThrowStation::ReadRecord(int32 YawIndex, int32 PitchIndex, FThrowStationArc& OutArc) const
+{
+	const uint8* Record = TableData + (YawIndex * TablePitchSteps + PitchIndex) * GetRecordSize(TableMaxPoints);
+	const int32 PointCount = FMath::Min((int32)Record[0], TableMaxPoints);
+	if (PointCount == 0)
+		return false;
+
+	const uint8* Times = Record + 2;
+	const uint8* Points = Times + TableMaxPoints * sizeof(uint16);
+	const uint8* Velocities = Points + TableMaxPoints * 3 * sizeof(int16);
+
+	OutArc.Points.Reset(PointCount + 1);
+	OutArc.Times.Reset(PointCount + 1);
+	OutArc.Velocities.Reset(PointCount + 1);
+	OutArc.Points.Add(FVector::ZeroVector);
+	OutArc.Times.Add(0.f);
+	for (int32 Index = 0; Index < PointCount; Index++)
+	{
+		uint16 TimeMs;
+		int16 Coordinates[3];
+		int16 VelocityCoordinates[3];
+		FMemory::Memcpy(&TimeMs, Times + Index * sizeof(uint16), sizeof(uint16));
+		FMemory::Memcpy(Coordinates, Points + Index * sizeof(Coordinates), sizeof(Coordinates));
+		FMemory::Memcpy(VelocityCoordinates, Velocities + Index * sizeof(VelocityCoordinates), sizeof(VelocityCoordinates));
+
+		OutArc.Points.Add(FVector(Coordinates[0], Coordinates[1], Coordinates[2]));
+		OutArc.Times.Add(TimeMs / 1000.f);
+		OutArc.Velocities.Add(FVector(VelocityCoordinates[0], VelocityCoordinates[1], VelocityCoordinates[2]));
+	}
+	OutArc.Velocities.Add(FVector::ZeroVector);
+	return true;
+}
+
+FThrowStationArc ATrajectoryThrowStation::QueryArc(FRotator RelativeAim, const TArray<AActor*>& IgnoredActors) const
+{
+	const float Yaw = FRotator::NormalizeAxis(RelativeAim.Yaw);
+	const float Pitch = FRotator::NormalizeAxis(RelativeAim.Pitch);
+	const FCollisionQueryParams QueryParams = MakeQueryParams(IgnoredActors);
+
+	if (TableData == nullptr
+		|| Yaw < TableYawRange.X || Yaw > TableYawRange.Y
+		|| Pitch < TablePitchRange.X || Pitch > TablePitchRange.Y)
+	{
+		const FProjectileSettings Settings = GetProjectileSettings();
+		const FCollisionObjectQueryParams ObjectParams(FCollisionObjectQueryParams::AllObjects);
+		const FCollisionShape Shape = FCollisionShape::MakeSphere(Settings.Radius);
+		UWorld* World = GetWorld();
+
+		FThrowStationArc Arc = MakeLaunchArc();
+		SimulateArc(
+			GetActorTransform().TransformVectorNoScale(FRotator(Pitch, Yaw, 0.f).Vector()) * Settings.Speed,
+			0,
+			[World, &QueryParams, &ObjectParams, &Shape](FHitResult& OutHit, const FVector& Start, const FVector& End)
+			{
+				return World->SweepSingleByObjectType(OutHit, Start, End, FQuat::Identity, ObjectParams, Shape, QueryParams);
+			},
+			Arc);
+		return Arc;
+	}
+
+	const float YawAlpha = (Yaw - TableYawRange.X) / FMath::Max(KINDA_SMALL_NUMBER, TableYawRange.Y - TableYawRange.X) * (TableYawSteps - 1);
+	const float PitchAlpha = (Pitch - TablePitchRange.X) / FMath::Max(KINDA_SMALL_NUMBER, TablePitchRange.Y - TablePitchRange.X) * (TablePitchSteps - 1);
+	const int32 Yaw0 = FMath::Clamp(FMath::FloorToInt(YawAlpha), 0, TableYawSteps - 1);
+	const int32 Pitch0 = FMath::Clamp(FMath::FloorToInt(PitchAlpha), 0, TablePitchSteps - 1);
+	const int32 Yaw1 = FMath::Min(Yaw0 + 1, TableYawSteps - 1);
+	const int32 Pitch1 = FMath::Min(Pitch0 + 1, TablePitchSteps - 1);
+	const float YawBlend = YawAlpha - Yaw0;
+	const float PitchBlend = PitchAlpha - Pitch0;
+
+	FThrowStationArc Corners[4];
+	const bool bRead =
+		ReadRecord(Yaw0, Pitch0, Corners[0])
+		& ReadRecord(Yaw1, Pitch0, Corners[1])
+		& ReadRecord(Yaw0, Pitch1, Corners[2])
+		& ReadRecord(Yaw1, Pitch1, Corners[3]);
+
+	// Samples that bounce off different surfaces can't be blended, the nearest one is the best guess
+	bool bBlend = bRead;
+	for (int32 Corner = 1; Corner < 4 && bBlend; Corner++)
+	{
+		bBlend = Corners[Corner].Points.Num() == Corners[0].Points.Num();
+		for (int32 Index = 0; Index < Corners[0].Points.Num() && bBlend; Index++)
+		{
+			bBlend = FVector::Dist(Corners[Corner].Points[Index], Corners[0].Points[Index]) <= InterpolationTolerance;
+		}
+	}
+
+	FThrowStationArc Arc;
+	if (bBlend)
+	{
+		Arc = Corners[0];
+		for (int32 Index = 0; Index < Arc.Points.Num(); Index++)
+		{
+			Arc.Points[Index] = FMath::Lerp(
+				FMath::Lerp(Corners[0].Points[Index], Corners[1].Points[Index], YawBlend),
+				FMath::Lerp(Corners[2].Points[Index], Corners[3].Points[Index], YawBlend),
+				PitchBlend);
+			Arc.Times[Index] = FMath::Lerp(
+				FMath::Lerp(Corners[0].Times[Index], Corners[1].Times[Index], YawBlend),
+				FMath::Lerp(Corners[2].Times[Index], Corners[3].Times[Index], YawBlend),
+				PitchBlend);
+			Arc.Velocities[Index] = FMath::Lerp(
+				FMath::Lerp(Corners[0].Velocities[Index], Corners[1].Velocities[Index], YawBlend),
+				FMath::Lerp(Corners[2].Velocities[Index], Corners[3].Velocities[Index], YawBlend),
+				PitchBlend);
+		}
+	}
+	else if (!ReadRecord(
+		YawBlend < 0.5f ? Yaw0 : Yaw1,
+		PitchBlend < 0.5f ? Pitch0 : Pitch1,
+		Arc))
+	{
+		return Arc;
+	}
+
+	const FTransform StationTransform = GetActorTransform();
+	for (FVector& Point : Arc.Points)
+	{
+		Point = StationTransform.TransformPositionNoScale(Point);
+	}
+	for (FVector& Velocity : Arc.Velocities)
+	{
+		Velocity = StationTransform.TransformVectorNoScale(Velocity);
+	}
+	Arc.bFromTable = true;
+
+	ResweepDynamic(Arc, QueryParams);
+	return Arc;
+}
+
+void ATrajectoryThrowStation::GetArcPolyline(const FThrowStationArc& Arc, float StepSeconds, TArray<FVector>& OutPoints) const
+{
+	OutPoints.Reset();
+	if (Arc.Points.Num() == 0)
+		return;
+
+	const FVector Gravity(0.f, 0.f, GetTableGravityZ());
+	const float Step = FMath::Max(StepSeconds, SimFrequency);
+
+	OutPoints.Add(Arc.Points[0]);
+	TrajectoryIntegrator::Visit(GetFlightParams(GetTableGravityZ()), [&Arc, &OutPoints, &Gravity, Step](auto Integrator)
+	{
+		for (int32 Index = 0; Index + 1 < Arc.Points.Num(); Index++)
+		{
+			const float Duration = Arc.Times[Index + 1] - Arc.Times[Index];
+			Integrator.BeginLeg(Arc.Points[Index], GetLegVelocity(Arc, Index, Gravity));
+			for (float Time = Step; Time < Duration; Time += Step)
+			{
+				OutPoints.Add(Integrator.Sample(Time));
+			}
+			OutPoints.Add(Arc.Points[Index + 1]);
+		}
+	});
+}
+
+float ATrajectoryThrowStation::GetTableGravityZ() const
+{
+	return TableData != nullptr ? TableGravityZ : GetWorld()->GetGravityZ();
+}
+
+void ATrajectoryThrowStation::ResweepDynamic(FThrowStationArc& Arc, const FCollisionQueryParams& QueryParams) const
+{
+	UWorld* World = GetWorld();
+	const FProjectileSettings Settings = GetProjectileSettings();
+
+	TArray<FVector> Polyline;
+	GetArcPolyline(Arc, SimFrequency, Polyline);
+	if (Polyline.Num() < 2)
+		return;
+
+	const FCollisionObjectQueryParams DynamicParams(FCollisionObjectQueryParams::AllDynamicObjects);
+
+	// One broadphase query decides whether the baked arc can be trusted as is
+	const FBox Bounds = FBox(Polyline).ExpandBy(Settings.Radius);
+	if (!World->OverlapAnyTestByObjectType(Bounds.GetCenter(), FQuat::Identity, DynamicParams, FCollisionShape::MakeBox(Bounds.GetExtent()), QueryParams))
+		return;
+
+	const FCollisionShape Shape = FCollisionShape::MakeSphere(Settings.Radius);
+	const FVector Gravity(0.f, 0.f, GetTableGravityZ());
+	TrajectoryIntegrator::Visit(GetFlightParams(GetTableGravityZ()), [this, World, &Arc, &QueryParams, &DynamicParams, &Shape, &Gravity](auto Integrator)
+	{
+		for (int32 Key = 0; Key + 1 < Arc.Points.Num(); Key++)
+		{
+			const float Duration = Arc.Times[Key + 1] - Arc.Times[Key];
+			Integrator.BeginLeg(Arc.Points[Key], GetLegVelocity(Arc, Key, Gravity));
+
+			FVector TraceStart = Arc.Points[Key];
+			float PreviousTime = 0.f;
+			for (float Time = SimFrequency; PreviousTime < Duration; Time += SimFrequency)
+			{
+				const float EndTime = FMath::Min(Time, Duration);
+				const FVector TraceEnd = EndTime >= Duration
+					? Arc.Points[Key + 1]
+					: Integrator.Sample(EndTime);
+
+				FHitResult Hit;
+				if (World->SweepSingleByObjectType(Hit, TraceStart, TraceEnd, FQuat::Identity, DynamicParams, Shape, QueryParams))
+				{
+					// The baked key points after the dynamic object are dropped
+					const float LegHitTime = FMath::Lerp(PreviousTime, EndTime, Hit.Time);
+					const float HitTime = Arc.Times[Key] + LegHitTime;
+					Arc.Points.SetNum(Key + 1);
+					Arc.Times.SetNum(Key + 1);
+					Arc.Velocities.SetNum(Key + 1);
+					Arc.Points.Add(Hit.Location);
+					Arc.Times.Add(HitTime);
+					Arc.Velocities.Add(FVector::ZeroVector);
+
+					// It bounces off like off static geometry, the rest of the flight is simulated live against everything
+					const int32 Bounces = Key + 1;
+					if (decltype(Integrator)::bBounces && Bounces < MaxBounces)
+					{
+						Integrator.Sample(LegHitTime);
+						const FVector Velocity = Integrator.Bounce(Hit.ImpactNormal, Integrator.GetVelocity());
+						const FCollisionObjectQueryParams ObjectParams(FCollisionObjectQueryParams::AllObjects);
+						SimulateArc(Velocity, Bounces, [World, &QueryParams, &ObjectParams, &Shape](FHitResult& OutHit, const FVector& Start, const FVector& End)
+						{
+							return World->SweepSingleByObjectType(OutHit, Start, End, FQuat::Identity, ObjectParams, Shape, QueryParams);
+						}, Arc);
+					}
+					return;
+				}
+
+				TraceStart = TraceEnd;
+				PreviousTime = EndTime;
+			}
+		}
+	});
+}
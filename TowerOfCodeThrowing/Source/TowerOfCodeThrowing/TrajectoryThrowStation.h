@@ -0,0 +1,151 @@
+// Fill out your copyright notice in the Description page of Project Settings.
+
+#pragma once
+
+#include "CoreMinimal.h"
+#include "GameFramework/Actor.h"
+#include "Async/MappedFileHandle.h"
+#include "TrajectoryIntegrator.h"
+#include "TrajectoryThrowStation.generated.h"
+
+class ATowerOfCodeThrowingProjectile;
+
+/** Key points of an arc: the launch, every bounce and where it stopped */
+USTRUCT(BlueprintType)
+struct FThrowStationArc
+{
+	GENERATED_BODY()
+
+	UPROPERTY(BlueprintReadOnly)
+		TArray<FVector> Points;
+
+	/** Seconds since launch at each point */
+	UPROPERTY(BlueprintReadOnly)
+		TArray<float> Times;
+
+	/** Velocity leaving each point, zero at the last one. Drag makes the flight between two points depend on it. */
+	UPROPERTY(BlueprintReadOnly)
+		TArray<FVector> Velocities;
+
+	/** Whether the arc came from the baked table rather than a live simulation */
+	UPROPERTY(BlueprintReadOnly)
+		bool bFromTable = false;
+};
+
+/**
+ * Fixed launch point, such as a turret, whose trajectories are baked offline.
+ *
+ * BakeTable samples a yaw/pitch grid against the static geometry and writes the bounce points
+ * of each sample to a compact file, which is memory-mapped on BeginPlay. Queries interpolate
+ * between the neighbouring samples and only sweep again when dynamic objects are near the arc.
+ * Add Content/TrajectoryTables to the directories to package as non-assets.
+ *
+ * Arcs fly like ProjectileClass, drag, wind and bounce settings included, with the same
+ * TTrajectoryIntegrator as the character's preview. Bake again after changing them.
+ */
+UCLASS()
+class ATrajectoryThrowStation : public AActor
+{
+	GENERATED_BODY()
+
+public:
+	ATrajectoryThrowStation();
+
+	/** Yaw range relative to the station, in degrees */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Table")
+		FVector2D YawRange;
+
+	/** Pitch range relative to the station, in degrees */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Table")
+		FVector2D PitchRange;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Table", meta = (ClampMin = "2"))
+		int32 YawSteps;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Table", meta = (ClampMin = "2"))
+		int32 PitchSteps;
+
+	/** Neighbouring samples further apart than this are not blended, the nearest one is used */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Table")
+		float InterpolationTolerance;
+
+	/** Table file under Content/TrajectoryTables, defaults to the actor name */
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Table")
+		FString TableName;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Projectile")
+		TSubclassOf<ATowerOfCodeThrowingProjectile> ProjectileClass;
+
+	UPROPERTY(EditAnywhere, BlueprintReadOnly, Category = "Projectile")
+		int32 MaxBounces;
+
+	/** Samples the grid against the static geometry and writes the table */
+	UFUNCTION(CallInEditor, BlueprintCallable, Category = "Table")
+		void BakeTable();
+
+	/**
+	 * Arc for an aim relative to the station, from the table if possible.
+	 * The station, its instigator, the projectiles in flight and IgnoredActors, e.g. whoever operates the station, don't block it.
+	 */
+	UFUNCTION(BlueprintCallable, Category = "Table", meta = (AutoCreateRefTerm = "IgnoredActors"))
+		FThrowStationArc QueryArc(FRotator RelativeAim, const TArray<AActor*>& IgnoredActors) const;
+
+	/** Rebuilds the ballistic curve between the key points of an arc */
+	UFUNCTION(BlueprintCallable, Category = "Table")
+		void GetArcPolyline(const FThrowStationArc& Arc, float StepSeconds, TArray<FVector>& OutPoints) const;
+
+	UFUNCTION(BlueprintPure, Category = "Table")
+		bool IsTableLoaded() const { return TableData != nullptr; }
+
+protected:
+	virtual void BeginPlay() override;
+	virtual void EndPlay(const EEndPlayReason::Type EndPlayReason) override;
+
+private:
+	struct FProjectileSettings
+	{
+		float Speed = 3000.f;
+		float Radius = 5.f;
+	};
+
+	FProjectileSettings GetProjectileSettings() const;
+
+	/** Flight model of ProjectileClass under GravityZ */
+	FTrajectoryFlightParams GetFlightParams(float GravityZ) const;
+	FString GetTablePath() const;
+	bool LoadTable();
+	void UnloadTable();
+
+	/**
+	 * Continues InOutArc from its last key point, leaving it with Velocity after Bounces bounces.
+	 * Simulates like the character's preview, recording only the key points.
+	 */
+	void SimulateArc(const FVector& Velocity, int32 Bounces, TFunctionRef<bool(FHitResult&, const FVector&, const FVector&)> Sweep, FThrowStationArc& InOutArc) const;
+
+	/** Arc made of the launch point only */
+	FThrowStationArc MakeLaunchArc() const;
+
+	/** Actors the live sweeps ignore, see QueryArc */
+	FCollisionQueryParams MakeQueryParams(const TArray<AActor*>& IgnoredActors) const;
+
+	bool ReadRecord(int32 YawIndex, int32 PitchIndex, FThrowStationArc& OutArc) const;
+
+	/** Gravity the key points were baked with */
+	float GetTableGravityZ() const;
+
+	/** Bounces Arc off the first dynamic object it runs into, simulating the rest of it live */
+	void ResweepDynamic(FThrowStationArc& Arc, const FCollisionQueryParams& QueryParams) const;
+
+	TUniquePtr<IMappedFileHandle> MappedFile;
+	TUniquePtr<IMappedFileRegion> MappedRegion;
+	/** Fallback storage where mapping is not supported */
+	TArray<uint8> LoadedBytes;
+
+	const uint8* TableData;
+	int32 TableMaxPoints;
+	int32 TableYawSteps;
+	int32 TablePitchSteps;
+	FVector2D TableYawRange;
+	FVector2D TablePitchRange;
+	float TableGravityZ;
+};